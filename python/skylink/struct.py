@@ -6,21 +6,26 @@ ExtType = Enum(BitsInteger(4),
     ARQControl=2,
     ARQHandshake=3,
     TDDControl=4,
-    HMACSequenceReset=5
+    HMACSequenceReset=5,
+    ARQControlCompressed=6,
+    TDDControlCompressed=7,
+    ARQSack=8,
+    ARQParity=9
 )
 
-ExtARQSeq = BitStruct(
-    'sequence' / BitsInteger(8)
+# ARQ sequences are 8 or 16 bits as agreed in the ARQ handshake. The width is told by the extension length.
+ExtARQSeq = Struct(
+    'sequence' / BytesInteger(lambda ctx: ctx._._len)
 )
 
-ExtARQReq = BitStruct(
-    'sequence' / BitsInteger(8),
-    'mask' / BitsInteger(16)
+ExtARQReq = Struct(
+    'sequence' / BytesInteger(lambda ctx: ctx._._len - 2),
+    'mask' / Int16ub
 )
 
-ExtARQCtrl = BitStruct(
-    'tx_sequence' / BitsInteger(8),
-    'rx_sequence' / BitsInteger(8)
+ExtARQCtrl = Struct(
+    'tx_sequence' / BytesInteger(lambda ctx: ctx._._len // 2),
+    'rx_sequence' / BytesInteger(lambda ctx: ctx._._len // 2)
 )
 
 ExtARQHandshake = BitStruct(
@@ -37,6 +42,26 @@ ExtHMACSequenceReset = BitStruct(
     'sequence' / BitsInteger(16)
 )
 
+ExtARQCtrlCompressed = BitStruct(
+    'tx_sequence' / BitsInteger(4),
+    'rx_sequence' / BitsInteger(4)
+)
+
+ExtTDDControlCompressed = BitStruct(
+    'remaining' / BitsInteger(16)
+)
+
+ExtARQSack = Struct(
+    'sequence' / BytesInteger(lambda ctx: 2 - ctx._._len % 2),
+    'mask' / BytesInteger(lambda ctx: ctx._._len - 2 + ctx._._len % 2)
+)
+
+ExtARQParity = Struct(
+    'sequence' / BytesInteger(lambda ctx: ctx._._len - 2),
+    'count' / Int8ub,
+    'length' / Int8ub
+)
+
 SkyExtensionHeader = BitStruct(
     '_len' / BitsInteger(4),
     'type' / ExtType,
@@ -47,39 +72,43 @@ SkyExtensionHeader = BitStruct(
             ExtType.ARQControl: ExtARQCtrl,
             ExtType.ARQHandshake: ExtARQHandshake,
             ExtType.TDDControl: ExtTDDControl,
-            ExtType.HMACSequenceReset: ExtHMACSequenceReset
+            ExtType.HMACSequenceReset: ExtHMACSequenceReset,
+            ExtType.ARQControlCompressed: ExtARQCtrlCompressed,
+            ExtType.TDDControlCompressed: ExtTDDControlCompressed,
+            ExtType.ARQSack: ExtARQSack,
+            ExtType.ARQParity: ExtARQParity
         }, default=Bytes(this._len)
     ))
 )
 
 
-def ARQSequence(sequence: int) -> bytes:
+def ARQSequence(sequence: int, wide: bool = False) -> bytes:
     return SkyExtensionHeader.build({
-        '_len': 1,
+        '_len': 2 if wide else 1,
         'type': ExtType.ARQSequence,
         'data' : {
-            'sequence': sequence
+            'sequence': sequence & (0xFFFF if wide else 0xFF)
         }
     })
 
 
-def ARQRequest(sequence: int, mask: int) -> bytes:
+def ARQRequest(sequence: int, mask: int, wide: bool = False) -> bytes:
     return SkyExtensionHeader.build({
-        '_len': 2,
+        '_len': 4 if wide else 3,
         'type': ExtType.ARQRequest,
         'data' : {
-            'sequence': sequence,
+            'sequence': sequence & (0xFFFF if wide else 0xFF),
             'mask': mask
         }
     })
 
-def ARQControl(tx_sequence: int, rx_sequence: int) -> bytes:
+def ARQControl(tx_sequence: int, rx_sequence: int, wide: bool = False) -> bytes:
     return SkyExtensionHeader.build({
-        '_len': 4,
+        '_len': 4 if wide else 2,
         'type': ExtType.ARQControl,
         'data' : {
-            'tx_sequence': tx_sequence,
-            'rx_sequence': rx_sequence
+            'tx_sequence': tx_sequence & (0xFFFF if wide else 0xFF),
+            'rx_sequence': rx_sequence & (0xFFFF if wide else 0xFF)
         }
     })
 
@@ -112,6 +141,47 @@ def HMACSequenceReset(sequence: int) -> bytes:
         }
     })
 
+def ARQControlCompressed(tx_sequence: int, rx_sequence: int) -> bytes:
+    return SkyExtensionHeader.build({
+        '_len': 1,
+        'type': ExtType.ARQControlCompressed,
+        'data' : {
+            'tx_sequence': tx_sequence & 0x0F,
+            'rx_sequence': rx_sequence & 0x0F
+        }
+    })
+
+def TDDControlCompressed(remaining: int) -> bytes:
+    return SkyExtensionHeader.build({
+        '_len': 2,
+        'type': ExtType.TDDControlCompressed,
+        'data' : {
+            'remaining': remaining
+        }
+    })
+
+def ARQSack(sequence: int, mask: int, wide: bool = False) -> bytes:
+    mask_len = 4 if mask < (1 << 32) else 8
+    return SkyExtensionHeader.build({
+        '_len': (2 if wide else 1) + mask_len,
+        'type': ExtType.ARQSack,
+        'data' : {
+            'sequence': sequence & (0xFFFF if wide else 0xFF),
+            'mask': mask
+        }
+    })
+
+def ARQParity(sequence: int, count: int, length: int, wide: bool = False) -> bytes:
+    return SkyExtensionHeader.build({
+        '_len': 4 if wide else 3,
+        'type': ExtType.ARQParity,
+        'data' : {
+            'sequence': sequence & (0xFFFF if wide else 0xFF),
+            'count': count,
+            'length': length
+        }
+    })
+
 
 SkyHeaderFlags = Struct(
     'fragment' / BitsInteger(2),
@@ -123,7 +193,8 @@ SkyHeaderFlags = Struct(
 SkyHeader = BitStruct(
     'version' / BitsInteger(5),
     '_ident_len' / BitsInteger(3),
-    'identifier' / Bytewise(Bytes(this._ident_len)),
+    # Zero identity length marks a compressed header with a single byte link ID
+    'identifier' / Bytewise(Bytes(lambda ctx: ctx._ident_len if ctx._ident_len != 0 else 1)),
     'flags' / SkyHeaderFlags,
     'vc' / BitsInteger(3),
     'extension_len' / BitsInteger(8),
@@ -137,7 +208,8 @@ SkyHeader = BitStruct(
 
 def _payload_len(ctx: Construct) -> int:
     """ Resolve payload field length. """
-    return ctx._.frame_len - 5 - ctx.header._ident_len - ctx.header.extension_len - (8 if ctx.header.flags.is_authenticated == 1 else 0)
+    ident_len = ctx.header._ident_len if ctx.header._ident_len != 0 else 1
+    return ctx._.frame_len - 5 - ident_len - ctx.header.extension_len - (8 if ctx.header.flags.is_authenticated == 1 else 0)
 
 
 SkyRadioFrame = Struct(
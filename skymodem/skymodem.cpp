@@ -90,6 +90,8 @@ SkyModem::SkyModem() :
 	config.arq.timeout_ticks = 12000; // [ticks]
 	config.arq.idle_frame_threshold = config.arq.timeout_ticks / 4; // [ticks]
 	config.arq.idle_frames_per_window = 1;
+	config.arq.speculative_resends_per_window = 0;
+	config.arq.parity_group_size = 0;
 
 
 	/*
@@ -13,7 +13,7 @@ using namespace suo;
 using json = nlohmann::json;
 
 #define ZMQ_URI_LEN 64
-#define PACKET_MAXLEN 256
+#define RX_BATCH_SIZE 16 // Packets read from a VC at once. Arena fits that many maximum size payloads.
 
 
 VCInterface::VCInterface(SkyHandle protocol_handle, unsigned int vc_base)
@@ -126,37 +126,39 @@ void VCInterface::VirtualChannelInterface::check()
 	}
 
 	/*
-	 * If packets appeared to some RX buffer, send them to ZMQ
+	 * If packets appeared to some RX buffer, send all of them to ZMQ
 	 */
-	uint8_t data[PACKET_MAXLEN];
-	int ret = sky_vc_read_next_received(vc_handle, data, PACKET_MAXLEN);
-	if (ret > 0) {
-		const size_t data_len = (size_t)ret;
-
-		SKY_PRINTF(SKY_DIAG_INFO | SKY_DIAG_FRAMES, "VC%u: Received %lu bytes\n", vc_index, data_len);
-
-		// Output the frame in porthouse's (frame format?)
-		json frame_dict = json::object();
-		frame_dict["packet_type"] = "tm";
-		frame_dict["timestamp"] = getCurrentISOTimestamp();
-		frame_dict["vc"] = vc_index;
-
-		// Format binary data to hexadecimal string
-		stringstream hexa_stream;
-		hexa_stream << setfill('0') << hex;
-		for (size_t i = 0; i < data_len; i++)
-			hexa_stream << setw(2) << (int)data[i];
-		frame_dict["data"] = hexa_stream.str();
-
-		// Metadata
-		json meta_dict = json::object();
-		meta_dict["vc"] = vc_index;
-		// Something more?
-		frame_dict["metadata"] = meta_dict;
+	SkyPacketView views[RX_BATCH_SIZE];
+	uint8_t arena[RX_BATCH_SIZE * SKY_PAYLOAD_MAX_LEN];
+	int n_packets;
+	while ((n_packets = sky_vc_read_received_batch(vc_handle, views, RX_BATCH_SIZE, arena, sizeof(arena))) > 0) {
+		for (int p = 0; p < n_packets; p++) {
+			const SkyPacketView &packet = views[p];
+			SKY_PRINTF(SKY_DIAG_INFO | SKY_DIAG_FRAMES, "VC%u: Received %u bytes\n", vc_index, packet.length);
+
+			// Output the frame in porthouse's (frame format?)
+			json frame_dict = json::object();
+			frame_dict["packet_type"] = "tm";
+			frame_dict["timestamp"] = getCurrentISOTimestamp();
+			frame_dict["vc"] = vc_index;
 
-		// Serialize dict and send it socket
-		string frame_str(frame_dict.dump());
-		publish_socket.send(zmq::buffer(frame_str), zmq::send_flags::dontwait);
+			// Format binary data to hexadecimal string
+			stringstream hexa_stream;
+			hexa_stream << setfill('0') << hex;
+			for (unsigned int i = 0; i < packet.length; i++)
+				hexa_stream << setw(2) << (int)packet.data[i];
+			frame_dict["data"] = hexa_stream.str();
+
+			// Metadata
+			json meta_dict = json::object();
+			meta_dict["vc"] = vc_index;
+			// Something more?
+			frame_dict["metadata"] = meta_dict;
+
+			// Serialize dict and send it socket
+			string frame_str(frame_dict.dump());
+			publish_socket.send(zmq::buffer(frame_str), zmq::send_flags::dontwait);
+		}
 	}
 
 
@@ -428,6 +430,8 @@ void set_config(const string &parameter, const string &value_)
 	set(protocol_handle, arq.timeout_ticks, value);
 	set(protocol_handle, arq.idle_frame_threshold, value);
 	set(protocol_handle, arq.idle_frames_per_window, value);
+	set(protocol_handle, arq.speculative_resends_per_window, value);
+	set(protocol_handle, arq.parity_group_size, value);
 
 }
 
@@ -456,6 +460,8 @@ void VCInterface::VirtualChannelInterface::set_config(const string &parameter, c
 	CONFIG_I(arq.timeout_ticks);
 	CONFIG_I(arq.idle_frame_threshold);
 	CONFIG_I(arq.idle_frames_per_window);
+	CONFIG_I(arq.speculative_resends_per_window);
+	CONFIG_I(arq.parity_group_size);
 
 #undef CONFIG_I
 
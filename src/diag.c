@@ -4,14 +4,15 @@
 #include "skylink/skylink.h"
 #include "skylink/diag.h"
 #include "skylink/reliable_vc.h"
+#include "skylink/utilities.h"
 
 #include <string.h> // memset
 
 unsigned int sky_diag_mask = SKY_DIAG_INFO | SKY_DIAG_BUG;
 
-//Allocate a new diagnostics struct and zero it.
-SkyDiagnostics* sky_diag_create(){
-	SkyDiagnostics* diag = SKY_MALLOC(sizeof(SkyDiagnostics));
+//Allocate a new diagnostics struct from the arena, or from the heap if it is NULL, and zero it.
+SkyDiagnostics* sky_diag_create(SkyArena* arena){
+	SkyDiagnostics* diag = sky_allocate(arena, sizeof(SkyDiagnostics));
 	SKY_ASSERT(diag != NULL);
 	memset(diag, 0, sizeof(SkyDiagnostics));
 	return diag;
@@ -70,6 +71,10 @@ void sky_print_link_state(SkyHandle self)
 			SKY_PRINTF(SKY_DIAG_LINK_STATE, "ON  ");
 			break;
 
+		case ARQ_STATE_RESYNC:
+			SKY_PRINTF(SKY_DIAG_LINK_STATE, "SYNC");
+			break;
+
 		default:
 			SKY_PRINTF(SKY_DIAG_LINK_STATE, "????"); //Unknown state
 		}
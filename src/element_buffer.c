@@ -18,8 +18,44 @@ The first element in the chain has a pointer to the previous element set to EB_E
 The pointers in the header of the other elements in the chain point to the previous and next elements in the chain.
 
 The first two bytes of the data section of the first element in the chain is used for storing the length of the data in the chain.
+
+With EB_LAYOUT_SPLIT the pool holds the data sections of all elements back to back, followed by an array of the previous
+pointers and an array of the next pointers. Checking and walking the chains then only touches the link arrays, and the data
+of a chain stored in adjacent elements is one contiguous block. Copies are made per block of physically adjacent data,
+so in this layout a contiguous chain is read or written with a single memcpy.
+
+Free elements have the previous pointer set to EB_NULL_IDX. Their next pointers link them to a singly linked free list
+starting from buffer->free_head and ending to EB_NULL_IDX. Elements are taken from and returned to the head of the list,
+so storing or deleting a chain of n elements takes O(n) time regardless of how full the buffer is.
+
+Wiping doesn't touch the elements. Instead buffer->fresh_index is reset to 0: the elements from the fresh index onwards
+are free and their links are stale, left from before the wipe. Elements are taken from the free list first and from the
+fresh index once the list is empty, so after a wipe they are taken in ascending order as before. Indexes at or past the
+fresh index are rejected by the public functions since a stale link could make them look like a chain.
+
+With the EB_ALLOC_CONTIGUOUS policy the free list is replaced by a bitmap of the free elements. A new chain is placed
+in the first run of enough adjacent free elements found onwards from the last written element. If there is no such run,
+the free elements are taken in ascending order, which still keeps the chain in as few runs as the pool allows.
+Elements skipped over between the fresh index and a taken element are initialized free when the fresh index passes them.
+
+A buffer can be shared by several owners, such as the virtual channels of a link, with quotas enabled. Each chain
+is then charged to the owner it was stored for, and the owner of a chain is kept by its first element so that deleting
+needs no owner. The free elements that the owners below their minimum could still claim are reserved for them:
+an owner can take the free elements that are not reserved for the others, up to its maximum.
+
+A slab buffer holds a few size classes, each an element buffer of its own with a different element size. A payload is
+stored in the smallest class that fits it in a single element, so short payloads don't waste the space of large
+elements and long payloads don't pay for the links and length of many small ones. If that class is full, the larger
+classes are tried and then the smaller ones. The indexes of the classes follow each other, so a chain is found from
+its index alone and the functions on a slab buffer pass the calls on to the class holding the chain.
 */
 
+// Number of 32-bit words in the free element bitmap of a buffer with given element count.
+#define FREE_MAP_WORDS(count) (((count) + 31) / 32)
+
+// Size of the pool of a buffer with given usable element size and count. Extra bytes align the link arrays of the split layout.
+#define POOL_SIZE(usable, count) ((size_t)(count) * ((usable) + 2 * sizeof(sky_element_idx_t)) + sizeof(sky_element_idx_t))
+
 
 
 
@@ -31,7 +67,6 @@ static int32_t min_i32(int32_t a, int32_t b){
 	return a;
 }
 
-/*
 //The maximum of two 32 bit integers.
 static int32_t max_i32(int32_t a, int32_t b){
 	if (a < b){
@@ -39,7 +74,6 @@ static int32_t max_i32(int32_t a, int32_t b){
 	}
 	return a;
 }
-*/
 
 /*
 Returns the parameter mem as a BufferElement. The parameter mem is assumed to have its first two bytes as the previous pointer, the next two bytes as the address for the next pointer.
@@ -61,18 +95,18 @@ static BufferElement as_element(void* mem)
 	return element;
 }
 
-//Takes index idx and returns a corresponding valid index in the range [0, buffer->element_count).
-static sky_element_idx_t wrap_element(SkyElementBuffer* buffer, int32_t idx)
-{
-	int32_t m = (int32_t) buffer->element_count;
-	int32_t r = positive_modulo(idx, m);
-	//int32_t r = ((idx % m) + m) % m;
-	return (sky_element_idx_t) r;
-}
-
 //Returns the ith element in the buffer.
 static BufferElement element_i(SkyElementBuffer* elementBuffer, sky_element_idx_t i)
 {
+	//With the split layout the links are found in their own arrays.
+	if (elementBuffer->layout == EB_LAYOUT_SPLIT) {
+		BufferElement element;
+		element.previous = &elementBuffer->previous_links[i];
+		element.next = &elementBuffer->next_links[i];
+		element.data = elementBuffer->pool + i * elementBuffer->element_usable_space;
+		return element;
+	}
+
 	//Give as_element the address of the ith element in the buffer and return the element.
 	return as_element(elementBuffer->pool + i * elementBuffer->element_size);
 }
@@ -80,14 +114,30 @@ static BufferElement element_i(SkyElementBuffer* elementBuffer, sky_element_idx_
 //Returns whether the element is free.
 static int element_is_free(BufferElement element)
 {
-	//Check if the previous and next pointers are equal to EB_NULL_IDX.
-	if (*element.previous == EB_NULL_IDX && *element.next == EB_NULL_IDX)
+	//Check if the previous pointer is equal to EB_NULL_IDX. The next pointer of a free element links the free list.
+	if (*element.previous == EB_NULL_IDX)
 		return 1;
 
 	//Element is not free. Return 0.
 	return 0;
 }
 
+//Returns whether the element has not been taken since the last wipe. Such elements are free whatever their links say.
+static int element_is_untouched(SkyElementBuffer* buffer, sky_element_idx_t idx)
+{
+	return idx >= buffer->fresh_index;
+}
+
+//Advances the fresh index past the element, marking the skipped elements free.
+static void touch_element(SkyElementBuffer* buffer, sky_element_idx_t idx)
+{
+	while (buffer->fresh_index <= idx) {
+		BufferElement el = element_i(buffer, buffer->fresh_index++);
+		*el.previous = EB_NULL_IDX;
+		*el.next = EB_NULL_IDX;
+	}
+}
+
 //Returns whether the element is the first in a chain.
 static int element_is_first(SkyElementBuffer* buffer, BufferElement element)
 {
@@ -148,59 +198,122 @@ static int element_is_in_chain(SkyElementBuffer* buffer, BufferElement element)
 	return 0;
 }
 
-//Wipes the element. Sets the previous and next pointers to EB_NULL_IDX.
-static void wipe_element(BufferElement element)
+//Frees the element by pushing it to the head of the free list, or by marking it in the free map.
+static void release_element(SkyElementBuffer* buffer, sky_element_idx_t idx)
 {
+	BufferElement element = element_i(buffer, idx);
 	*element.previous = EB_NULL_IDX;
-	*element.next = EB_NULL_IDX;
+	if (buffer->allocation_policy == EB_ALLOC_CONTIGUOUS) {
+		*element.next = EB_NULL_IDX;
+		buffer->free_map[idx / 32] |= (uint32_t)1 << (idx % 32);
+	}
+	else {
+		*element.next = buffer->free_head;
+		buffer->free_head = idx;
+	}
+	buffer->free_elements++;
 }
 
-//Returns the index of the next free element in the buffer.
-static int element_buffer_get_next_free(SkyElementBuffer* buffer, sky_element_idx_t start_idx)
+//Returns the first index from 'idx' onwards whose bit in the free map equals 'free', or the element count if there is none.
+static int32_t free_map_find(SkyElementBuffer* buffer, int32_t idx, int free)
 {
+	const int32_t count = buffer->element_count;
+	while (idx < count) {
+		uint32_t word = buffer->free_map[idx / 32];
+		if (!free)
+			word = ~word;
+		word &= ~(uint32_t)0 << (idx % 32);
+		if (word != 0) {
+			idx = (idx & ~31) + __builtin_ctz(word);
+			return (idx < count) ? idx : count;
+		}
+		idx = (idx & ~31) + 32;
+	}
+	return count;
+}
 
-	//Loop through all elements in the buffer and return the index of the first free element.
-	for (sky_element_idx_t i = 0; i < buffer->element_count; ++i) {
-
-		//Get the index of the element and the element at that index.
-		sky_element_idx_t idx = wrap_element(buffer, start_idx + i);
-		BufferElement element = element_i(buffer, idx);
-
-		//Return the index of the element if it is free.
-		if (element_is_free(element))
-			return idx;
+//Finds the first run of n adjacent free elements starting between 'from' and 'to'. Returns its first index or -1.
+static int32_t free_map_find_run(SkyElementBuffer* buffer, int32_t n, int32_t from, int32_t to)
+{
+	int32_t idx = from;
+	while (idx < to) {
+		int32_t first = free_map_find(buffer, idx, 1);
+		if (first >= to)
+			break;
+		int32_t end = free_map_find(buffer, first, 0);
+		if (end - first >= n)
+			return first;
+		idx = end;
 	}
-	//No free element was found, return -1.
 	return -1;
 }
 
-//Returns the indexes of the next n free elements in the buffer.
-static int element_buffer_get_n_free(SkyElementBuffer* buffer, int32_t n, sky_element_idx_t start_idx, sky_element_idx_t* tgt)
+//Takes the element from the free map.
+static sky_element_idx_t take_mapped_element(SkyElementBuffer* buffer, int32_t idx)
 {
-	//Get the first free element in the buffer. Return -1 if no free element was found.
-	int idx0 = element_buffer_get_next_free(buffer, start_idx);
-	if (idx0 < 0)
-		return -1;
-
-	//Set the first index in the target array to the index of the first free element.
-	tgt[0] = (sky_element_idx_t)idx0;
-
-	//Loop through the rest of the elements and set the indexes in the target array to the indexes of the next free elements.
-	for (int i = 1; i < n; ++i) {
+	buffer->free_map[idx / 32] &= ~((uint32_t)1 << (idx % 32));
+	touch_element(buffer, (sky_element_idx_t)idx);
+	buffer->free_elements--;
+	return (sky_element_idx_t)idx;
+}
 
-		//Get the index of the next free element and return -1 if no free element was found or if the index is equal to the index of the first free element.
-		int idx = element_buffer_get_next_free(buffer, wrap_element(buffer, tgt[i - 1] + 1));
-		if (idx == idx0)
-			return -1;
-		if(idx < 0)
-			return -1;
+//Pops an element from the head of the free list, or takes the next untouched element once the list is empty.
+static sky_element_idx_t take_listed_element(SkyElementBuffer* buffer)
+{
+	sky_element_idx_t idx = buffer->free_head;
+	if (idx == EB_NULL_IDX) {
+		//The free element count is kept in step, so there must be untouched elements left.
+		SKY_ASSERT(buffer->fresh_index < buffer->element_count)
+		idx = buffer->fresh_index++;
+	}
+	else {
+		buffer->free_head = *element_i(buffer, idx).next;
+	}
+	buffer->free_elements--;
+	return idx;
+}
 
-		//Set the index in the target array to the index of the next free element.
-		tgt[i] = (sky_element_idx_t)idx;
+/*
+Takes the first element for a new chain of n elements. The caller has checked that there are enough free elements.
+With the contiguous policy, '*in_run' is set if the chain fits in a run of adjacent free elements starting from the
+returned one. Either way the rest of the chain is taken one element at a time with take_next_free_element.
+*/
+static sky_element_idx_t take_first_free_element(SkyElementBuffer* buffer, int32_t n, int* in_run)
+{
+	*in_run = 0;
+	if (buffer->allocation_policy != EB_ALLOC_CONTIGUOUS)
+		return take_listed_element(buffer);
+
+	//Look for a long enough run onwards from the last written element, then from the beginning.
+	const int32_t start = buffer->last_write_index;
+	int32_t first = free_map_find_run(buffer, n, start, buffer->element_count);
+	if (first < 0)
+		first = free_map_find_run(buffer, n, 0, start);
+	if (first >= 0) {
+		*in_run = 1;
+		return take_mapped_element(buffer, first);
 	}
 
-	//Return 0 if the indexes of the next n free elements were found.
-	return 0;
+	//No run is long enough. Take the free elements in ascending order from the start.
+	first = free_map_find(buffer, start, 1);
+	if (first >= buffer->element_count)
+		first = free_map_find(buffer, 0, 1);
+	return take_mapped_element(buffer, first);
+}
+
+//Takes the element following 'previous' in the chain being stored.
+static sky_element_idx_t take_next_free_element(SkyElementBuffer* buffer, sky_element_idx_t previous, int in_run)
+{
+	if (buffer->allocation_policy != EB_ALLOC_CONTIGUOUS)
+		return take_listed_element(buffer);
+	if (in_run)
+		return take_mapped_element(buffer, previous + 1);
+
+	//The next free element in ascending order, wrapping to the beginning.
+	int32_t idx = free_map_find(buffer, previous + 1, 1);
+	if (idx >= buffer->element_count)
+		idx = free_map_find(buffer, 0, 1);
+	return take_mapped_element(buffer, idx);
 }
 
 //Returns whether the chain is ok backwards. This means that all elements in the chain have a valid previous pointer until the first element in the chain is reached.
@@ -262,6 +375,68 @@ static int chain_is_ok_forward(SkyElementBuffer* buffer, sky_element_idx_t idx)
 }
 
 
+//Returns the number of free elements reserved for the owner by its minimum.
+static int32_t quota_reserve(const SkyElementQuota* quota)
+{
+	return max_i32(quota->minimum - quota->used, 0);
+}
+
+//Charges 'n' elements to the owner, or credits them back if 'n' is negative. Chains of no owner are not counted.
+static void charge_owner(SkyElementBuffer* buffer, int owner, int32_t n)
+{
+	if (buffer->quotas == NULL || owner < 0 || owner >= buffer->quota_count)
+		return;
+	SkyElementQuota* quota = &buffer->quotas[owner];
+	buffer->reserved_elements -= quota_reserve(quota);
+	quota->used += n;
+	quota->peak = max_i32(quota->peak, quota->used);
+	buffer->reserved_elements += quota_reserve(quota);
+}
+
+//Updates the fill level gauges after a chain of 'n' elements was stored, or deleted if 'added' is -1.
+static void count_chain(SkyElementBuffer* buffer, int32_t n, int added)
+{
+	buffer->chain_lengths[min_i32(n, EB_CHAIN_LENGTH_BINS) - 1] += added;
+	buffer->peak_used_elements = max_i32(buffer->peak_used_elements, buffer->element_count - buffer->free_elements);
+}
+
+
+//Returns the size class of a slab buffer that holds the index, and makes the index local to the class.
+static int slab_of(SkyElementBuffer* buffer, sky_element_idx_t* idx)
+{
+	int c = buffer->slab_count - 1;
+	while (c > 0 && *idx < buffer->slab_base[c])
+		c--;
+	*idx -= buffer->slab_base[c];
+	return c;
+}
+
+//Returns the size class tried first for a payload: the smallest class that fits it in a single element, or the largest class.
+static int slab_preferred(SkyElementBuffer* buffer, int32_t length)
+{
+	for (int c = 0; c < buffer->slab_count; ++c)
+		if (length + EB_LEN_BYTES <= buffer->slabs[c]->element_usable_space)
+			return c;
+	return buffer->slab_count - 1;
+}
+
+//Returns the i:th size class tried for a payload. The preferred class, then the larger ones and finally the smaller ones, closest first.
+static int slab_order(SkyElementBuffer* buffer, int preferred, int i)
+{
+	if (preferred + i < buffer->slab_count)
+		return preferred + i;
+	return buffer->slab_count - 1 - i;
+}
+
+//Updates the free elements count of a slab buffer from its classes.
+static void slab_count_free(SkyElementBuffer* buffer)
+{
+	buffer->free_elements = 0;
+	for (int c = 0; c < buffer->slab_count; ++c)
+		buffer->free_elements += buffer->slabs[c]->free_elements;
+}
+
+
 /*
 Returns the number of elements required for storing 'length' bytes.
 This differs from sky_element_buffer_element_requirement_for, because it uses a value for element size instead of a buffer given as a parameter.
@@ -277,19 +452,19 @@ int sky_element_buffer_element_requirement(int32_t element_size, int32_t length)
 
 // ==== PUBLIC FUNCTIONS ===============================================================================================
 
-//Creates a new element buffer and returns a pointer to it. 
-SkyElementBuffer* sky_element_buffer_create(int32_t usable_element_size, int32_t element_count)
+//Creates a new element buffer in the arena, or on the heap if it is NULL, and returns a pointer to it.
+SkyElementBuffer* sky_element_buffer_create(SkyArena* arena, int32_t usable_element_size, int32_t element_count)
 {
 	//Make sure that the element count for the buffer is not larger than the maximum allowed. (65530)
 	SKY_ASSERT(element_count <= EB_MAX_ELEMENT_COUNT);
 
 	//Allocate memory for the buffer and assert that it was succesfully allocated. 
-	SkyElementBuffer* buffer = SKY_MALLOC(sizeof(SkyElementBuffer));
+	SkyElementBuffer* buffer = sky_allocate(arena, sizeof(SkyElementBuffer));
 	SKY_ASSERT(buffer != NULL);
 
 	//Allocate memory for the pool and assert that it was succesfully allocated.
-	uint8_t* pool = SKY_MALLOC(element_count * (usable_element_size + (int32_t)(2 * sizeof(sky_element_idx_t))));
-	SKY_ASSERT(buffer != NULL);
+	uint8_t* pool = sky_allocate(arena, POOL_SIZE(usable_element_size, element_count));
+	SKY_ASSERT(pool != NULL);
 
 	//Initialize the buffer.
 	buffer->pool = pool;
@@ -298,6 +473,17 @@ SkyElementBuffer* sky_element_buffer_create(int32_t usable_element_size, int32_t
 	buffer->element_size = usable_element_size + (int32_t)(2 * sizeof(sky_element_idx_t));
 	buffer->element_count = element_count;
 	buffer->element_usable_space = usable_element_size;
+	buffer->allocation_policy = EB_ALLOC_FREE_LIST;
+	buffer->free_map = NULL;
+	buffer->layout = EB_LAYOUT_INTERLEAVED;
+	buffer->previous_links = NULL;
+	buffer->next_links = NULL;
+	buffer->quotas = NULL;
+	buffer->chain_owner = NULL;
+	buffer->quota_count = 0;
+	buffer->reserved_elements = 0;
+	buffer->slab_count = 0;
+	buffer->peak_used_elements = 0;
 
 	//Erase all data in the buffer and mark all elements as free.
 	sky_element_buffer_wipe(buffer);
@@ -305,11 +491,80 @@ SkyElementBuffer* sky_element_buffer_create(int32_t usable_element_size, int32_t
 	return buffer;
 }
 
+//Creates a slab element buffer with the given size classes in the arena, or on the heap if it is NULL, and returns a pointer to it.
+SkyElementBuffer* sky_element_buffer_create_slab(SkyArena* arena, const int32_t* usable_element_sizes, const int32_t* element_counts, int n_classes)
+{
+	SKY_ASSERT(n_classes >= 1 && n_classes <= EB_MAX_SLABS);
+
+	//Allocate memory for the buffer. The elements are in the pools of the classes, so it has no pool of its own.
+	SkyElementBuffer* buffer = sky_allocate(arena, sizeof(SkyElementBuffer));
+	SKY_ASSERT(buffer != NULL);
+	memset(buffer, 0, sizeof(SkyElementBuffer));
+
+	//Create each class as a buffer of its own. Its indexes follow those of the smaller classes.
+	int32_t element_count = 0;
+	for (int c = 0; c < n_classes; ++c) {
+		SKY_ASSERT(element_counts[c] > 0);
+		SKY_ASSERT(c == 0 || usable_element_sizes[c] > usable_element_sizes[c - 1]);
+		buffer->slabs[c] = sky_element_buffer_create(arena, usable_element_sizes[c], element_counts[c]);
+		buffer->slab_base[c] = (sky_element_idx_t)element_count;
+		element_count += element_counts[c];
+	}
+	SKY_ASSERT(element_count <= EB_MAX_ELEMENT_COUNT);
+	buffer->slab_count = (uint8_t)n_classes;
+
+	//Initialize the buffer as a whole. The size of the elements is that of the largest class.
+	buffer->element_count = element_count;
+	buffer->element_usable_space = usable_element_sizes[n_classes - 1];
+	buffer->element_size = buffer->slabs[n_classes - 1]->element_size;
+	buffer->free_elements = element_count;
+	buffer->fresh_index = (sky_element_idx_t)element_count;
+	buffer->free_head = EB_NULL_IDX;
+	buffer->allocation_policy = EB_ALLOC_FREE_LIST;
+	buffer->layout = EB_LAYOUT_INTERLEAVED;
+
+	return buffer;
+}
+
+
+//Returns the memory taken from an arena by a buffer with the given allocation policy, shared by 'owners' owners if not 0.
+size_t sky_element_buffer_required_memory(int32_t usable_element_size, int32_t element_count, int policy, int owners)
+{
+	size_t size = SKY_ARENA_SIZE(sizeof(SkyElementBuffer)) + SKY_ARENA_SIZE(POOL_SIZE(usable_element_size, element_count));
+	if (policy == EB_ALLOC_CONTIGUOUS)
+		size += SKY_ARENA_SIZE(FREE_MAP_WORDS(element_count) * sizeof(uint32_t));
+	if (owners > 0)
+		size += SKY_ARENA_SIZE(EB_MAX_OWNERS * sizeof(SkyElementQuota)) + SKY_ARENA_SIZE(element_count * sizeof(uint8_t));
+	return size;
+}
+
+//Returns the memory taken from an arena by a slab buffer with the given allocation policy.
+size_t sky_element_buffer_slab_required_memory(const int32_t* usable_element_sizes, const int32_t* element_counts, int n_classes, int policy)
+{
+	size_t size = SKY_ARENA_SIZE(sizeof(SkyElementBuffer));
+	for (int c = 0; c < n_classes; ++c)
+		size += sky_element_buffer_required_memory(usable_element_sizes[c], element_counts[c], policy, 0);
+	return size;
+}
 
 //Destroys the given element buffer.
 void sky_element_buffer_destroy(SkyElementBuffer* buffer)
 {
+	//A slab buffer only owns its classes.
+	if (buffer->slab_count > 0) {
+		for (int c = 0; c < buffer->slab_count; ++c)
+			sky_element_buffer_destroy(buffer->slabs[c]);
+		SKY_FREE(buffer);
+		return;
+	}
+
 	//Free the pool and the buffer.
+	if (buffer->free_map != NULL)
+		SKY_FREE(buffer->free_map);
+	if (buffer->quotas != NULL) {
+		SKY_FREE(buffer->quotas);
+		SKY_FREE(buffer->chain_owner);
+	}
 	SKY_FREE(buffer->pool);
 	SKY_FREE(buffer);
 }
@@ -318,14 +573,216 @@ void sky_element_buffer_destroy(SkyElementBuffer* buffer)
 //Erases all data in the buffer and marks all elements free.
 void sky_element_buffer_wipe(SkyElementBuffer* buffer)
 {
-	//Loop through all elements in the buffer and wipe them. Wiping means setting the previous and next pointers to EB_NULL_IDX.
-	for (sky_element_idx_t i = 0; i < buffer->element_count; ++i) {
-		BufferElement el = element_i(buffer, i);
-		wipe_element(el);
+	if (buffer->slab_count > 0) {
+		for (int c = 0; c < buffer->slab_count; ++c)
+			sky_element_buffer_wipe(buffer->slabs[c]);
+		buffer->free_elements = buffer->element_count;
+		memset(buffer->chain_lengths, 0, sizeof(buffer->chain_lengths));
+		return;
 	}
-	//Reset the last write index and the free elements count to their initial values.
+
+	//Every element becomes untouched. They are initialized when taken, so the elements themselves are not visited.
+	buffer->fresh_index = 0;
+
+	//Mark every element free in the free map. The bits after the last element stay cleared.
+	if (buffer->allocation_policy == EB_ALLOC_CONTIGUOUS) {
+		memset(buffer->free_map, 0, FREE_MAP_WORDS(buffer->element_count) * sizeof(uint32_t));
+		for (int32_t i = 0; i < buffer->element_count / 32; ++i)
+			buffer->free_map[i] = ~(uint32_t)0;
+		if (buffer->element_count % 32)
+			buffer->free_map[buffer->element_count / 32] = ((uint32_t)1 << (buffer->element_count % 32)) - 1;
+	}
+	//Reset the last write index, the free list and the free elements count to their initial values.
 	buffer->last_write_index = 0;
+	buffer->free_head = EB_NULL_IDX;
 	buffer->free_elements = buffer->element_count;
+	memset(buffer->chain_lengths, 0, sizeof(buffer->chain_lengths));
+
+	//Nothing is charged to the owners anymore, so their whole minimums are reserved.
+	buffer->reserved_elements = 0;
+	for (int i = 0; i < buffer->quota_count; ++i) {
+		buffer->quotas[i].used = 0;
+		buffer->reserved_elements += quota_reserve(&buffer->quotas[i]);
+	}
+}
+
+//Selects the allocation policy. The buffer must be empty since the free elements are tracked differently.
+int sky_element_buffer_set_allocation_policy(SkyArena* arena, SkyElementBuffer* buffer, int policy)
+{
+	if (buffer->free_elements != buffer->element_count)
+		return SKY_RET_EBUFFER_NOT_EMPTY;
+
+	//A slab buffer uses the policy in every class.
+	if (buffer->slab_count > 0) {
+		for (int c = 0; c < buffer->slab_count; ++c)
+			sky_element_buffer_set_allocation_policy(arena, buffer->slabs[c], policy);
+		buffer->allocation_policy = (policy == EB_ALLOC_CONTIGUOUS) ? EB_ALLOC_CONTIGUOUS : EB_ALLOC_FREE_LIST;
+		return 0;
+	}
+
+	if (policy == EB_ALLOC_CONTIGUOUS && buffer->free_map == NULL) {
+		buffer->free_map = sky_allocate(arena, FREE_MAP_WORDS(buffer->element_count) * sizeof(uint32_t));
+		SKY_ASSERT(buffer->free_map != NULL);
+	}
+	buffer->allocation_policy = (policy == EB_ALLOC_CONTIGUOUS) ? EB_ALLOC_CONTIGUOUS : EB_ALLOC_FREE_LIST;
+
+	//Rebuild the free list or the free map.
+	sky_element_buffer_wipe(buffer);
+	return 0;
+}
+
+//Selects the pool layout. The buffer must be empty since the links move.
+int sky_element_buffer_set_layout(SkyElementBuffer* buffer, int layout)
+{
+	if (buffer->free_elements != buffer->element_count)
+		return SKY_RET_EBUFFER_NOT_EMPTY;
+
+	//A slab buffer uses the layout in every class.
+	if (buffer->slab_count > 0) {
+		for (int c = 0; c < buffer->slab_count; ++c)
+			sky_element_buffer_set_layout(buffer->slabs[c], layout);
+		buffer->layout = (layout == EB_LAYOUT_SPLIT) ? EB_LAYOUT_SPLIT : EB_LAYOUT_INTERLEAVED;
+		return 0;
+	}
+
+	if (layout == EB_LAYOUT_SPLIT) {
+		//The link arrays follow the data of all elements, aligned for the index type.
+		size_t data_size = (size_t)buffer->element_count * buffer->element_usable_space;
+		data_size = (data_size + sizeof(sky_element_idx_t) - 1) / sizeof(sky_element_idx_t) * sizeof(sky_element_idx_t);
+		buffer->previous_links = (sky_element_idx_t*)((uint8_t*)buffer->pool + data_size);
+		buffer->next_links = buffer->previous_links + buffer->element_count;
+		buffer->layout = EB_LAYOUT_SPLIT;
+	}
+	else {
+		buffer->previous_links = NULL;
+		buffer->next_links = NULL;
+		buffer->layout = EB_LAYOUT_INTERLEAVED;
+	}
+
+	//Mark all elements free in their new place.
+	sky_element_buffer_wipe(buffer);
+	return 0;
+}
+
+//Shares the buffer between the given number of owners. The buffer must be empty since the existing chains have no owner.
+int sky_element_buffer_enable_quotas(SkyArena* arena, SkyElementBuffer* buffer, int owners)
+{
+	if (buffer->free_elements != buffer->element_count)
+		return SKY_RET_EBUFFER_NOT_EMPTY;
+	if (owners < 1 || owners > EB_MAX_OWNERS || buffer->slab_count > 0)
+		return SKY_RET_EBUFFER_INVALID_QUOTA;
+
+	if (buffer->quotas == NULL) {
+		buffer->quotas = sky_allocate(arena, EB_MAX_OWNERS * sizeof(SkyElementQuota));
+		SKY_ASSERT(buffer->quotas != NULL);
+		buffer->chain_owner = sky_allocate(arena, buffer->element_count * sizeof(uint8_t));
+		SKY_ASSERT(buffer->chain_owner != NULL);
+	}
+	memset(buffer->quotas, 0, EB_MAX_OWNERS * sizeof(SkyElementQuota));
+	buffer->quota_count = (uint8_t)owners;
+	buffer->reserved_elements = 0;
+	return 0;
+}
+
+//Sets the minimum and maximum of an owner. Can be changed at any time, the chains already stored are kept.
+int sky_element_buffer_set_quota(SkyElementBuffer* buffer, int owner, int32_t minimum, int32_t maximum)
+{
+	if (owner < 0 || owner >= buffer->quota_count || minimum < 0 || maximum < 0)
+		return SKY_RET_EBUFFER_INVALID_QUOTA;
+	if (maximum > 0 && minimum > maximum)
+		return SKY_RET_EBUFFER_INVALID_QUOTA;
+
+	//The minimums must be possible to give at the same time.
+	int32_t minimums = minimum;
+	for (int i = 0; i < buffer->quota_count; ++i)
+		if (i != owner)
+			minimums += buffer->quotas[i].minimum;
+	if (minimums > buffer->element_count)
+		return SKY_RET_EBUFFER_INVALID_QUOTA;
+
+	SkyElementQuota* quota = &buffer->quotas[owner];
+	buffer->reserved_elements -= quota_reserve(quota);
+	quota->minimum = minimum;
+	quota->maximum = maximum;
+	buffer->reserved_elements += quota_reserve(quota);
+	return 0;
+}
+
+//Returns the number of elements that can be stored for the owner.
+int sky_element_buffer_available_elements(SkyElementBuffer* buffer, int owner)
+{
+	if (buffer->quotas == NULL)
+		return buffer->free_elements;
+
+	//The free elements that are not reserved for the others, up to the maximum of the owner.
+	int32_t available = buffer->free_elements - buffer->reserved_elements;
+	if (owner >= 0 && owner < buffer->quota_count) {
+		const SkyElementQuota* quota = &buffer->quotas[owner];
+		available += quota_reserve(quota);
+		if (quota->maximum > 0)
+			available = min_i32(available, quota->maximum - quota->used);
+	}
+	return max_i32(available, 0);
+}
+
+//Computes fragmentation statistics of the buffer.
+void sky_element_buffer_get_stats(SkyElementBuffer* buffer, SkyElementBufferStats* stats)
+{
+	memset(stats, 0, sizeof(SkyElementBufferStats));
+
+	//In a slab buffer, the statistics of the classes added up. The runs are within the classes.
+	if (buffer->slab_count > 0) {
+		for (int c = 0; c < buffer->slab_count; ++c) {
+			SkyElementBufferStats slab_stats;
+			sky_element_buffer_get_stats(buffer->slabs[c], &slab_stats);
+			stats->free_elements += slab_stats.free_elements;
+			stats->free_runs += slab_stats.free_runs;
+			stats->largest_free_run = max_i32(stats->largest_free_run, slab_stats.largest_free_run);
+			stats->chains += slab_stats.chains;
+			stats->fragmented_chains += slab_stats.fragmented_chains;
+		}
+		return;
+	}
+
+	int32_t run = 0;
+	for (sky_element_idx_t i = 0; i < buffer->element_count; ++i) {
+		BufferElement el = element_i(buffer, i);
+
+		//Count the runs of free elements.
+		if (element_is_untouched(buffer, i) || element_is_free(el)) {
+			stats->free_elements++;
+			if (run++ == 0)
+				stats->free_runs++;
+			if (run > stats->largest_free_run)
+				stats->largest_free_run = run;
+			continue;
+		}
+		run = 0;
+
+		//Walk the chains from their first elements and check if every element is followed by the adjacent one.
+		if (!element_is_first(buffer, el))
+			continue;
+		stats->chains++;
+		sky_element_idx_t idx = i;
+		while (!element_is_last(buffer, el)) {
+			if (*el.next != idx + 1) {
+				stats->fragmented_chains++;
+				break;
+			}
+			idx = *el.next;
+			el = element_i(buffer, idx);
+		}
+	}
+}
+
+//Starts the peaks over from the current fill level.
+void sky_element_buffer_reset_peaks(SkyElementBuffer* buffer)
+{
+	for (int c = 0; c < buffer->slab_count; ++c)
+		sky_element_buffer_reset_peaks(buffer->slabs[c]);
+	buffer->peak_used_elements = buffer->element_count - buffer->free_elements;
+	for (int i = 0; i < buffer->quota_count; ++i)
+		buffer->quotas[i].peak = buffer->quotas[i].used;
 }
 
 /*
@@ -334,81 +791,225 @@ This differs from sky_element_buffer_element_requirement, because it uses a buff
 */
 int sky_element_buffer_element_requirement_for(SkyElementBuffer* buffer, int32_t length)
 {
+	if (buffer->slab_count > 0)
+		return sky_element_buffer_element_requirement_for(buffer->slabs[slab_preferred(buffer, length)], length);
 	SKY_ASSERT(buffer->element_usable_space > 0)
 	int32_t n = (length + EB_LEN_BYTES + buffer->element_usable_space - 1) / buffer->element_usable_space;
 	return n;
 }
 
+//Returns the number of payload bytes that fit in the free elements as one payload.
+int sky_element_buffer_free_space(SkyElementBuffer* buffer)
+{
+	//In a slab buffer, a payload is stored in one class.
+	if (buffer->slab_count > 0) {
+		int space = 0;
+		for (int c = 0; c < buffer->slab_count; ++c)
+			space = max_i32(space, sky_element_buffer_free_space(buffer->slabs[c]));
+		return space;
+	}
+	int32_t space = buffer->free_elements * buffer->element_usable_space - EB_LEN_BYTES;
+	return (space > 0) ? space : 0;
+}
+
+//Returns the number of payload bytes that fit as one payload in the elements available for the owner.
+int sky_element_buffer_free_space_for(SkyElementBuffer* buffer, int owner)
+{
+	if (buffer->slab_count > 0)
+		return sky_element_buffer_free_space(buffer);
+	int32_t space = sky_element_buffer_available_elements(buffer, owner) * buffer->element_usable_space - EB_LEN_BYTES;
+	return (space > 0) ? space : 0;
+}
+
+//Returns 1 if all of the packets could be stored for the owner, 0 otherwise.
+int sky_element_buffer_can_store_all(SkyElementBuffer* buffer, int owner, const struct sky_iovec* packets, int count)
+{
+	//In a slab buffer, place the packets in the free elements of the classes one by one as the stores would.
+	if (buffer->slab_count > 0) {
+		int32_t free_elements[EB_MAX_SLABS];
+		for (int c = 0; c < buffer->slab_count; ++c)
+			free_elements[c] = buffer->slabs[c]->free_elements;
+		for (int i = 0; i < count; ++i) {
+			const int32_t length = (int32_t)packets[i].iov_len;
+			const int preferred = slab_preferred(buffer, length);
+			int placed = 0;
+			for (int j = 0; j < buffer->slab_count && !placed; ++j) {
+				const int c = slab_order(buffer, preferred, j);
+				const int32_t n = sky_element_buffer_element_requirement_for(buffer->slabs[c], length);
+				if (n <= free_elements[c]) {
+					free_elements[c] -= n;
+					placed = 1;
+				}
+			}
+			if (!placed)
+				return 0;
+		}
+		return 1;
+	}
+
+	int32_t elements_required = 0;
+	for (int i = 0; i < count; ++i)
+		elements_required += sky_element_buffer_element_requirement_for(buffer, (int32_t)packets[i].iov_len);
+	return elements_required <= sky_element_buffer_available_elements(buffer, owner);
+}
+
+//Cursor over a list of scatter-gather fragments.
+typedef struct {
+	const struct sky_iovec* iov;
+	int i;
+	size_t offset;
+} IovCursor;
+
+//Copies the next 'n' bytes of the fragments to the target and advances the cursor.
+static void iov_gather(IovCursor* cursor, uint8_t* target, int32_t n)
+{
+	while (n > 0) {
+		//Copy as much as the current fragment has left.
+		const struct sky_iovec* v = &cursor->iov[cursor->i];
+		int32_t chunk = min_i32(n, (int32_t)(v->iov_len - cursor->offset));
+		memcpy(target, (const uint8_t*)v->iov_base + cursor->offset, chunk);
+		target += chunk;
+		n -= chunk;
+		cursor->offset += chunk;
+
+		//Move to the next fragment when the current one is exhausted.
+		if (cursor->offset == v->iov_len) {
+			cursor->i++;
+			cursor->offset = 0;
+		}
+	}
+}
+
 //Store data to the buffer with the given length. Returns the index of the first element in the chain, or negative error if no space.
 int sky_element_buffer_store(SkyElementBuffer* buffer, const uint8_t* data, sky_element_length_t length)
 {
+	struct sky_iovec iov = { data, length };
+	return sky_element_buffer_store_iov(buffer, &iov, 1);
+}
+
+//Store the concatenated fragments to the buffer. Returns the index of the first element in the chain, or negative error if no space.
+int sky_element_buffer_store_iov(SkyElementBuffer* buffer, const struct sky_iovec* iov, int iovcnt)
+{
+	return sky_element_buffer_store_iov_for(buffer, EB_NO_OWNER, iov, iovcnt);
+}
+
+//Store the concatenated fragments for the owner. Returns the index of the first element in the chain, or negative error if no space.
+int sky_element_buffer_store_iov_for(SkyElementBuffer* buffer, int owner, const struct sky_iovec* iov, int iovcnt)
+{
+	//Calculate the total length of the fragments and make sure it fits in the length field.
+	size_t total_length = 0;
+	for (int i = 0; i < iovcnt; ++i)
+		total_length += iov[i].iov_len;
+	if (total_length > (sky_element_length_t)~0)
+		return SKY_RET_EBUFFER_TOO_LONG_PAYLOAD;
+	sky_element_length_t length = (sky_element_length_t)total_length;
+	IovCursor cursor = { iov, 0, 0 };
+
+	//In a slab buffer, store to the first class in the order that has space.
+	if (buffer->slab_count > 0) {
+		const int preferred = slab_preferred(buffer, length);
+		const int32_t free_before = buffer->free_elements;
+		int ret = SKY_RET_EBUFFER_NO_SPACE;
+		for (int i = 0; i < buffer->slab_count && ret < 0; ++i) {
+			const int c = slab_order(buffer, preferred, i);
+			ret = sky_element_buffer_store_iov_for(buffer->slabs[c], owner, iov, iovcnt);
+			if (ret >= 0)
+				ret += buffer->slab_base[c];
+		}
+		slab_count_free(buffer);
+		if (ret >= 0)
+			count_chain(buffer, free_before - buffer->free_elements, 1);
+		return ret;
+	}
+
 	// Calculate number of elements required.
 	int32_t n_required = sky_element_buffer_element_requirement_for(buffer, length); // A fast ceil-division.
 
-	//check if there is enough space.
+	//check if there is enough space. With quotas, the space the owner is allowed to use.
 	if (n_required > buffer->free_elements)
 		return SKY_RET_EBUFFER_NO_SPACE;
+	if (buffer->quotas != NULL && n_required > sky_element_buffer_available_elements(buffer, owner))
+		return SKY_RET_EBUFFER_NO_SPACE;
 
 
 	//make sure that there is at least one element required.
 	if (n_required == 0)
 		n_required++;
 
-	// Acquire the elements.
-	sky_element_idx_t indexes[42]; //todo parametrize this maximum element count used.
-
-	//Store the indexes of the elements next 'n_required' free elements in the indexes array.
-	int r = element_buffer_get_n_free(buffer, n_required, buffer->last_write_index, indexes);
-
-	if (r < 0)
-		return SKY_RET_EBUFFER_NO_SPACE; // Exit if not enough space
-
-	// Write the metadata to the first element
-	BufferElement el0 = element_i(buffer, indexes[0]);
+	// Take the first element and write the metadata to it. The rest are taken and linked as they are filled.
+	int in_run;
+	const sky_element_idx_t first_idx = take_first_free_element(buffer, n_required, &in_run);
+	BufferElement el0 = element_i(buffer, first_idx);
 	*el0.previous = EB_END_IDX;
 	memcpy(el0.data, &length, sizeof(sky_element_length_t));
 
-	// Copy (USABLE_SPACE - 4) bytes to the first element.
+	// Copy (USABLE_SPACE - 4) bytes to the first element. The copy is made once the block of adjacent data ends.
 	int32_t to_copy = min_i32(length, buffer->element_usable_space - EB_LEN_BYTES);
-	memcpy(el0.data + EB_LEN_BYTES, data, to_copy);
+	uint8_t* block = (uint8_t*)el0.data + EB_LEN_BYTES;
+	int32_t block_len = to_copy;
 	*el0.next = EB_END_IDX;
 	int32_t data_cursor = to_copy;
 	BufferElement el = el0;
+	sky_element_idx_t idx = first_idx;
 
 	//copy the rest of the data to the successive elements.
 	for (int i = 1; i < n_required; ++i) {
 
-		//Set the next pointer of the previous element to the index of the current element.
-		*el.next = indexes[i];
+		//Take the next element and set the next pointer of the previous element to it.
+		const sky_element_idx_t previous_idx = idx;
+		idx = take_next_free_element(buffer, previous_idx, in_run);
+		*el.next = idx;
 
 		//Get the current element.
-		el = element_i(buffer, indexes[i]);
+		el = element_i(buffer, idx);
 
 		//Initialize the element. Next is set to end index, but is overwritten if this is not the last element.
 		*el.next = EB_END_IDX;
-		*el.previous = indexes[i-1];
+		*el.previous = previous_idx;
 
 		//Copy the data to the element. Check if the data is longer than the usable space of the element.
+		//If the data of the element directly follows the current block, it is just extended.
 		to_copy = min_i32(buffer->element_usable_space, length - data_cursor);
-		memcpy(el.data, data+data_cursor, to_copy);
+		if ((uint8_t*)el.data == block + block_len) {
+			block_len += to_copy;
+		}
+		else {
+			iov_gather(&cursor, block, block_len);
+			block = el.data;
+			block_len = to_copy;
+		}
 
 		//Update the data cursor by adding the number of bytes copied.
 		data_cursor += to_copy;
 	}
+	iov_gather(&cursor, block, block_len);
 
-	//update the buffer metadata by setting the last write index and subtracting the number of used elements from the free elements count.
-	buffer->last_write_index = indexes[n_required-1];
-	buffer->free_elements -= n_required;
+	//update the buffer metadata by setting the last write index. The free elements count was updated when the elements were taken.
+	buffer->last_write_index = idx;
+	count_chain(buffer, n_required, 1);
+
+	//Charge the elements to the owner.
+	if (buffer->quotas != NULL) {
+		buffer->chain_owner[first_idx] = (uint8_t)owner;
+		charge_owner(buffer, owner, n_required);
+	}
 
 	//Return the index of the first element added.
-	return indexes[0];
+	return first_idx;
 }
 
 
 //Returns the length of the data stored in the chain starting with the given index. The length of the data is stored in the beginning of the first element in the chain.
 int sky_element_buffer_get_data_length(SkyElementBuffer* buffer, sky_element_idx_t idx)
 {
+	if (buffer->slab_count > 0) {
+		const int c = slab_of(buffer, &idx);
+		return sky_element_buffer_get_data_length(buffer->slabs[c], idx);
+	}
+
 	//Get the element at the given index.
+	if (element_is_untouched(buffer, idx))
+		return SKY_RET_EBUFFER_INVALID_INDEX;
 	BufferElement el = element_i(buffer, idx);
 
 	//Check if the element is the first element in a chain.
@@ -424,8 +1025,14 @@ int sky_element_buffer_get_data_length(SkyElementBuffer* buffer, sky_element_idx
 //Reads the data from the chain starting with the given index to the target buffer. Returns the number of bytes read, or negative error if the index is invalid or the target buffer is too small.
 int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_element_idx_t idx, unsigned int max_len)
 {
+	if (buffer->slab_count > 0) {
+		const int c = slab_of(buffer, &idx);
+		return sky_element_buffer_read(buffer->slabs[c], target, idx, max_len);
+	}
 
 	//Get the element at the given index.
+	if (element_is_untouched(buffer, idx))
+		return SKY_RET_EBUFFER_INVALID_INDEX;
 	BufferElement el = element_i(buffer, idx);
 
 	//check if the element is the first element in a chain.
@@ -438,8 +1045,11 @@ int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_eleme
 		return SKY_RET_EBUFFER_TOO_LONG_PAYLOAD;
 
 	// Read from first element, if the data is longer than the usable space of the element, read all of the data from the element.
+	// The copy is made once the block of adjacent data ends.
 	int32_t to_read = min_i32(buffer->element_usable_space - EB_LEN_BYTES, element_length);
-	memcpy(target, el.data + EB_LEN_BYTES, to_read);
+	const uint8_t* block = (const uint8_t*)el.data + EB_LEN_BYTES;
+	int32_t block_len = to_read;
+	int32_t block_cursor = 0;
 
 	// Set the element that was read to be the previous element. Initialize the cursor to the number of bytes read and get the amount of elements required for storing the data.
 	BufferElement previous_el = el;
@@ -455,8 +1065,17 @@ int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_eleme
 			return SKY_RET_EBUFFER_CHAIN_CORRUPTED;
 
 		//Check how much data to read from the element and read it. If the element is the last element in the chain there might be less data to read than the usable space of the element.
+		//If the data of the element directly follows the current block, it is just extended.
 		to_read = min_i32(buffer->element_usable_space, element_length - cursor);
-		memcpy(target+cursor, el.data, to_read);
+		if ((const uint8_t*)el.data == block + block_len) {
+			block_len += to_read;
+		}
+		else {
+			memcpy(target + block_cursor, block, block_len);
+			block_cursor += block_len;
+			block = el.data;
+			block_len = to_read;
+		}
 
 		//Update the cursor and the previous element.
 		cursor += to_read;
@@ -466,6 +1085,7 @@ int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_eleme
 	//Check that the final element that was read is the last element in the chain.
 	if (!element_is_last(buffer, el))
 		return SKY_RET_EBUFFER_CHAIN_CORRUPTED;
+	memcpy(target + block_cursor, block, block_len);
 
 	//Return the number of bytes read.
 	return element_length;
@@ -473,36 +1093,108 @@ int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_eleme
 
 
 
+//Gets read-only views to the data chain starting with the given index. Returns the number of spans, or negative error.
+int sky_element_buffer_get_spans(SkyElementBuffer* buffer, sky_element_idx_t idx, struct sky_iovec* spans, int max_spans)
+{
+	if (buffer->slab_count > 0) {
+		const int c = slab_of(buffer, &idx);
+		return sky_element_buffer_get_spans(buffer->slabs[c], idx, spans, max_spans);
+	}
+
+	//Get the element at the given index and check that it starts a chain.
+	if (element_is_untouched(buffer, idx))
+		return SKY_RET_EBUFFER_INVALID_INDEX;
+	BufferElement el = element_i(buffer, idx);
+	if (!element_is_first(buffer, el))
+		return SKY_RET_EBUFFER_INVALID_INDEX;
+
+	//Check that there are enough spans for every element in the chain.
+	int32_t element_length = *(sky_element_length_t*)(el.data);
+	int32_t n_elements = sky_element_buffer_element_requirement_for(buffer, element_length);
+	if (n_elements > max_spans)
+		return SKY_RET_EBUFFER_TOO_LONG_PAYLOAD;
+
+	//The first element starts after the length field.
+	spans[0].iov_base = el.data + EB_LEN_BYTES;
+	spans[0].iov_len = min_i32(buffer->element_usable_space - EB_LEN_BYTES, element_length);
+	int32_t cursor = spans[0].iov_len;
+
+	//Point rest of the spans to the following elements in the chain. Adjacent data is merged to the previous span.
+	int n_spans = 1;
+	for (int i = 1; i < n_elements; ++i) {
+
+		// Get the next element and make sure that the chain is intact.
+		el = element_i(buffer, *el.next);
+		if (element_is_free(el))
+			return SKY_RET_EBUFFER_CHAIN_CORRUPTED;
+
+		int32_t len = min_i32(buffer->element_usable_space, element_length - cursor);
+		struct sky_iovec* last = &spans[n_spans - 1];
+		if ((const uint8_t*)el.data == (const uint8_t*)last->iov_base + last->iov_len) {
+			last->iov_len += len;
+		}
+		else {
+			spans[n_spans].iov_base = el.data;
+			spans[n_spans].iov_len = len;
+			n_spans++;
+		}
+		cursor += len;
+	}
+
+	//Check that the final element is the last element in the chain.
+	if (!element_is_last(buffer, el))
+		return SKY_RET_EBUFFER_CHAIN_CORRUPTED;
+
+	return n_spans;
+}
+
+
 //Delete a data chain starting with the given index. Returns negative error if the index is invalid.
 int sky_element_buffer_delete(SkyElementBuffer* buffer, sky_element_idx_t idx)
 {
+	if (buffer->slab_count > 0) {
+		const int c = slab_of(buffer, &idx);
+		const int32_t free_before = buffer->free_elements;
+		int ret = sky_element_buffer_delete(buffer->slabs[c], idx);
+		slab_count_free(buffer);
+		if (ret == 0)
+			count_chain(buffer, buffer->free_elements - free_before, -1);
+		return ret;
+	}
+
 	//Get the element at the given index.
+	if (element_is_untouched(buffer, idx))
+		return SKY_RET_EBUFFER_INVALID_INDEX;
 	BufferElement el = element_i(buffer, idx);
 
 	//Check if the element is the first element in a chain.
 	if (!element_is_first(buffer, el))
 		return SKY_RET_EBUFFER_INVALID_INDEX;
+	const int owner = (buffer->quotas != NULL) ? buffer->chain_owner[idx] : EB_NO_OWNER;
+	int32_t n_released = 0;
 
 	//Loop through elements until the end of the chain is reached.
 	while(1){
 
 		//Set a variable for the next element and check if the element is the last element in the chain.
 		sky_element_idx_t next = *el.next;
-		if(element_is_last(buffer, el)){
-			//Wipe the element and increment the free elements count.
-			wipe_element(el);
-			buffer->free_elements++;
-			break;
-		}
+		int last = element_is_last(buffer, el);
 
-		//Wipe the element and increment the free elements count.
-		wipe_element(el);
-		buffer->free_elements++;
+		//Return the element to the free list. This also increments the free elements count.
+		release_element(buffer, idx);
+		n_released++;
+		if (last)
+			break;
 
 		//Get the next element.
+		idx = next;
 		el = element_i(buffer, next);
 	}
 
+	//Credit the elements back to the owner of the chain.
+	charge_owner(buffer, owner, -n_released);
+	count_chain(buffer, n_released, -1);
+
 	//Return 0 if the chain was deleted succesfully.
 	return 0;
 }
@@ -512,6 +1204,12 @@ int sky_element_buffer_delete(SkyElementBuffer* buffer, sky_element_idx_t idx)
 //Returns whether the chain starting with the given index is valid. This is a test function.
 int sky_element_buffer_valid_chain(SkyElementBuffer* buffer, sky_element_idx_t idx)
 {
+	if (buffer->slab_count > 0) {
+		const int c = slab_of(buffer, &idx);
+		return sky_element_buffer_valid_chain(buffer->slabs[c], idx);
+	}
+	if (element_is_untouched(buffer, idx))
+		return 0;
 	BufferElement el = element_i(buffer, idx);
 	if (!element_is_in_chain(buffer, el))
 		return 0;
@@ -528,6 +1226,17 @@ This is a test function.
 */
 int sky_element_buffer_entire_buffer_is_ok(SkyElementBuffer* buffer)
 {
+	//A slab buffer is ok if all of its classes are, and their free elements add up.
+	if (buffer->slab_count > 0) {
+		int32_t free_elements = 0;
+		for (int c = 0; c < buffer->slab_count; ++c) {
+			if (!sky_element_buffer_entire_buffer_is_ok(buffer->slabs[c]))
+				return 0;
+			free_elements += buffer->slabs[c]->free_elements;
+		}
+		return free_elements == buffer->free_elements;
+	}
+
 	//Initialize the number of counted free elements as 0.
 	int counted_free = 0;
 
@@ -538,7 +1247,7 @@ int sky_element_buffer_entire_buffer_is_ok(SkyElementBuffer* buffer)
 		BufferElement el = element_i(buffer, i);
 
 		//If the element is free, increment the counted free elements and continue to the next element.
-		if(element_is_free(el)){
+		if(element_is_untouched(buffer, i) || element_is_free(el)){
 			counted_free++;
 			continue;
 		}
@@ -557,6 +1266,51 @@ int sky_element_buffer_entire_buffer_is_ok(SkyElementBuffer* buffer)
 		return 0;
 	}
 
+	//With quotas, make sure that each owner is charged for exactly the elements of its chains.
+	if (buffer->quotas != NULL) {
+		int32_t charged[EB_MAX_OWNERS] = { 0 };
+		for (sky_element_idx_t i = 0; i < buffer->fresh_index; ++i) {
+			BufferElement el = element_i(buffer, i);
+			if (element_is_free(el) || !element_is_first(buffer, el) || buffer->chain_owner[i] >= buffer->quota_count)
+				continue;
+			int32_t n = 1;
+			while (!element_is_last(buffer, el)) {
+				el = element_i(buffer, *el.next);
+				n++;
+			}
+			charged[buffer->chain_owner[i]] += n;
+		}
+		int32_t reserved = 0;
+		for (int i = 0; i < buffer->quota_count; ++i) {
+			if (charged[i] != buffer->quotas[i].used)
+				return 0;
+			reserved += quota_reserve(&buffer->quotas[i]);
+		}
+		if (reserved != buffer->reserved_elements)
+			return 0;
+	}
+
+	//With the free map, make sure that the map marks exactly the free elements.
+	if (buffer->allocation_policy == EB_ALLOC_CONTIGUOUS) {
+		for (sky_element_idx_t i = 0; i < buffer->element_count; ++i) {
+			int marked = (buffer->free_map[i / 32] >> (i % 32)) & 1;
+			if (marked != (element_is_untouched(buffer, i) || element_is_free(element_i(buffer, i))))
+				return 0;
+		}
+		return 1;
+	}
+
+	//Make sure that the free list links exactly the free elements that have been touched.
+	int listed_free = buffer->element_count - buffer->fresh_index;
+	for (sky_element_idx_t i = buffer->free_head; i != EB_NULL_IDX; i = *element_i(buffer, i).next) {
+		if (element_is_untouched(buffer, i) || !element_is_free(element_i(buffer, i)) || listed_free >= counted_free)
+			return 0;
+		listed_free++;
+	}
+	if(listed_free != counted_free){
+		return 0;
+	}
+
 	//Return 1 if the buffer is ok.
 	return 1;
 }
@@ -8,7 +8,12 @@
 #include "skylink/conf.h"
 #include "skylink/frame.h"
 
+#include "skylink/utilities.h"
+
 #include "ext/libfec/fec.h"
+#include "ext/libfec/fixed.h"
+
+#include <string.h> // memset, memcpy, memmove
 
 #if SKY_FRAME_MAX_LEN > RS_MSGLEN
 #error "Too small buffer for radio frames"
@@ -130,3 +135,143 @@ int sky_fec_encode(SkyRadioFrame *frame)
 
 	return SKY_RET_OK;
 }
+
+
+/** Encode a frame to transmit into an external buffer */
+int sky_fec_encode_to(const SkyRadioFrame *frame, uint8_t *out, unsigned int max_length)
+{
+	// Check frame length
+	if (frame->length > RS_MSGLEN || frame->length + RS_PARITYS > max_length)
+		return SKY_RET_RS_INVALID_LENGTH;
+
+	/*
+	 * Calculate Reed-Solomon parity bytes straight to the output buffer.
+	 * The encoder only reads the message bytes.
+	 */
+	encode_rs_8((uint8_t*)frame->raw, &out[frame->length], RS_MSGLEN - frame->length);
+
+	/*
+	 * Copy the message and apply data whitening in the same pass.
+	 */
+	for (unsigned int i = 0; i < frame->length; i++)
+		out[i] = frame->raw[i] ^ whitening[i & 0xFF];
+	for (unsigned int i = frame->length; i < frame->length + RS_PARITYS; i++)
+		out[i] ^= whitening[i & 0xFF];
+
+	return frame->length + RS_PARITYS;
+}
+
+
+/*
+ * Advance the encoder by one message symbol. Same as one round of the loop in encode_rs.h.
+ */
+static void rs_encode_step(uint8_t *parity, uint8_t symbol)
+{
+	const int feedback = INDEX_OF[symbol ^ parity[0]];
+	if (feedback != NN) {
+		for (int j = 1; j < NROOTS; j++)
+			parity[j] ^= ALPHA_TO[MODNN(feedback + GENPOLY[NROOTS - j])];
+	}
+	memmove(&parity[0], &parity[1], NROOTS - 1);
+	parity[NROOTS - 1] = (feedback != NN) ? ALPHA_TO[MODNN(feedback + GENPOLY[0])] : 0;
+}
+
+
+/** Create a codeword cache and tabulate the parity of each message position */
+SkyFecCache* sky_fec_cache_create(SkyArena* arena, int entry_count)
+{
+	SkyFecCache* cache = sky_allocate(arena, sky_fec_cache_required_memory(entry_count));
+	SKY_ASSERT(cache != NULL);
+	cache->entry_count = entry_count;
+	for (int i = 0; i < entry_count; i++)
+		cache->entries[i].key = -1;
+
+	/*
+	 * A unit symbol at the last position followed by k zero symbols has the parity of a unit
+	 * at position RS_MSGLEN - 1 - k, so each row is one encoder step from the previous one.
+	 */
+	uint8_t parity[RS_PARITYS];
+	memset(parity, 0, sizeof(parity));
+	for (int position = RS_MSGLEN - 1; position >= 0; position--) {
+		rs_encode_step(parity, (position == RS_MSGLEN - 1) ? 1 : 0);
+		for (int j = 0; j < RS_PARITYS; j++)
+			cache->parity_log[position][j] = INDEX_OF[parity[j]];
+	}
+	return cache;
+}
+
+
+/** Size of the codeword cache */
+size_t sky_fec_cache_required_memory(int entry_count)
+{
+	return SKY_ARENA_SIZE(sizeof(SkyFecCache) + entry_count * sizeof(SkyFecCacheEntry));
+}
+
+
+/** Free the codeword cache */
+void sky_fec_cache_destroy(SkyFecCache* cache)
+{
+	SKY_FREE(cache);
+}
+
+
+/** Encode a frame to transmit, updating the parity of a cached codeword when possible */
+int sky_fec_encode_cached(SkyFecCache* cache, SkyRadioFrame *frame, int32_t key)
+{
+	if (key < 0 || cache->entry_count <= 0)
+		return sky_fec_encode(frame);
+
+	// Check frame length
+	if (frame->length > RS_MSGLEN)
+		return SKY_RET_RS_INVALID_LENGTH;
+
+	const unsigned int length = frame->length;
+	SkyFecCacheEntry *entry = &cache->entries[key % cache->entry_count];
+	uint8_t *parity = &frame->raw[length];
+
+	/*
+	 * Count the changed bytes. Each costs about as much to patch as a byte costs to encode,
+	 * so the patch is used only when clearly less than half of the frame has changed.
+	 */
+	unsigned int changed = 0;
+	if (entry->key == key && entry->length == length) {
+		for (unsigned int i = 0; i < length; i++)
+			changed += (frame->raw[i] != entry->codeword[i]);
+	}
+	else
+		changed = length;
+
+	if (2 * changed < length) {
+		memcpy(parity, &entry->codeword[length], RS_PARITYS);
+		const unsigned int pad = RS_MSGLEN - length;
+		for (unsigned int i = 0; i < length && changed > 0; i++) {
+			const uint8_t delta = frame->raw[i] ^ entry->codeword[i];
+			if (delta == 0)
+				continue;
+			const int delta_log = INDEX_OF[delta];
+			const uint8_t *row = cache->parity_log[pad + i];
+			for (int j = 0; j < RS_PARITYS; j++) {
+				if (row[j] != NN)
+					parity[j] ^= ALPHA_TO[MODNN(row[j] + delta_log)];
+			}
+			changed--;
+		}
+	}
+	else
+		encode_rs_8(frame->raw, parity, RS_MSGLEN - length);
+
+	// Keep the codeword for the next transmission of the payload.
+	entry->key = key;
+	entry->length = length;
+	memcpy(entry->codeword, frame->raw, length + RS_PARITYS);
+	frame->length += RS_PARITYS;
+
+	/*
+	 * Apply data whitening
+	 */
+	for (unsigned int i = 0; i < frame->length; i++){
+		frame->raw[i] ^= whitening[i & 0xFF];
+	}
+
+	return SKY_RET_OK;
+}
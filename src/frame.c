@@ -32,65 +32,148 @@ void sky_frame_clear(SkyRadioFrame* frame)
 //=== ENCODING =========================================================================================================
 //======================================================================================================================
 
-// Add ARQ sequence number to the frame.
-int sky_frame_add_extension_arq_sequence(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence)
+// Number of sequence fields in an ARQ extension.
+static unsigned int arq_sequence_fields(unsigned int type)
+{
+	switch (type) {
+	case EXTENSION_ARQ_SEQUENCE:
+	case EXTENSION_ARQ_REQUEST:
+	case EXTENSION_ARQ_SACK:
+	case EXTENSION_ARQ_PARITY:
+		return 1;
+	case EXTENSION_ARQ_CTRL:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+// Get the data length of an ARQ extension.
+unsigned int sky_frame_get_arq_extension_length(unsigned int type, int wide_sequences)
+{
+	unsigned int length;
+	switch (type) {
+	case EXTENSION_ARQ_SEQUENCE: length = sizeof(ExtARQSeq); break;
+	case EXTENSION_ARQ_REQUEST:  length = sizeof(ExtARQReq); break;
+	case EXTENSION_ARQ_CTRL:     length = sizeof(ExtARQCtrl); break;
+	case EXTENSION_ARQ_SACK:     length = sizeof(sky_arq_sequence_t) + SKY_ARQ_SACK_MASK_MIN_BYTES; break;
+	case EXTENSION_ARQ_PARITY:   length = sizeof(ExtARQParity); break;
+	default: return 0;
+	}
+
+	// Narrow form drops the high byte of each sequence.
+	if (!wide_sequences)
+		length -= arq_sequence_fields(type) * (sizeof(sky_arq_sequence_t) - 1);
+	return length;
+}
+
+// Width of the sequences in a parsed ARQ extension in bytes. The parser has validated the length.
+static unsigned int arq_sequence_width(const SkyHeaderExtension *extension)
 {
-	// Ensure that the extensions field is the last field in the frame and the frame still has room for the extension.
+	unsigned int narrow = sky_frame_get_arq_extension_length(extension->type, 0);
+	if (extension->type == EXTENSION_ARQ_SACK)
+		return (extension->length == narrow || extension->length == narrow - SKY_ARQ_SACK_MASK_MIN_BYTES + SKY_ARQ_SACK_MASK_MAX_BYTES) ? 1 : 2;
+	return (extension->length == narrow) ? 1 : 2;
+}
+
+// Start an ARQ extension at the cursor. Returns pointer to its data.
+static uint8_t* arq_extension_begin(SkyTransmitFrame *tx_frame, unsigned int type, unsigned int length)
+{
+	// Ensure that the extensions field is the last field in the frame and frame has still room for the extension.
 	SKY_ASSERT(tx_frame->hdr->flag_has_payload == 0);
-	SKY_ASSERT(tx_frame->frame->length + 1 + sizeof(ExtARQSeq) < SKY_PAYLOAD_MAX_LEN);
+	SKY_ASSERT(tx_frame->frame->length + 1 + length < SKY_PAYLOAD_MAX_LEN);
 
 	// Cast a pointer to the cursor position and fill the extension header.
 	SkyHeaderExtension *extension = (SkyHeaderExtension *)tx_frame->ptr;
-	extension->type = EXTENSION_ARQ_SEQUENCE;
-	extension->length = sizeof(ExtARQSeq);
-	extension->ARQSeq.sequence = sky_arq_seq_hton(sequence);
+	extension->type = type;
+	extension->length = length;
 
 	// Move cursor forward and update frame and extension length.
-	const unsigned int len = 1 + sizeof(ExtARQSeq);
-	tx_frame->hdr->extension_length += len;
-	tx_frame->frame->length += len;
-	tx_frame->ptr += len;
+	tx_frame->hdr->extension_length += 1 + length;
+	tx_frame->frame->length += 1 + length;
+	tx_frame->ptr += 1 + length;
+	return (uint8_t*)&extension->ARQSeq;
+}
+
+// Write a sequence in network byte order. Returns pointer past it.
+static uint8_t* put_arq_sequence(uint8_t *data, sky_arq_sequence_t sequence, int wide_sequences)
+{
+	if (wide_sequences)
+		*data++ = (uint8_t)(sequence >> 8);
+	*data++ = (uint8_t)sequence;
+	return data;
+}
+
+// Add ARQ sequence number to the frame.
+int sky_frame_add_extension_arq_sequence(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, int wide_sequences)
+{
+	uint8_t *data = arq_extension_begin(tx_frame, EXTENSION_ARQ_SEQUENCE, sky_frame_get_arq_extension_length(EXTENSION_ARQ_SEQUENCE, wide_sequences));
+	put_arq_sequence(data, sequence, wide_sequences);
 	return SKY_RET_OK;
 }
 
 // Add ARQ Retransmit Request header to the frame.
-int sky_frame_add_extension_arq_request(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_mask_t mask)
+int sky_frame_add_extension_arq_request(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_mask_t mask, int wide_sequences)
 {
-	// Ensure that the extensions field is the last field in the frame and frame has still room for the extension.
-	SKY_ASSERT(tx_frame->hdr->flag_has_payload == 0);
-	SKY_ASSERT(tx_frame->frame->length + 1 + sizeof(ExtARQReq) < SKY_PAYLOAD_MAX_LEN);
+	uint8_t *data = arq_extension_begin(tx_frame, EXTENSION_ARQ_REQUEST, sky_frame_get_arq_extension_length(EXTENSION_ARQ_REQUEST, wide_sequences));
+	data = put_arq_sequence(data, sequence, wide_sequences);
+	data[0] = (uint8_t)(mask >> 8);
+	data[1] = (uint8_t)mask;
+	return SKY_RET_OK;
+}
 
-	// Cast a pointer to the extension header and fill the extension header.
-	SkyHeaderExtension *extension = (SkyHeaderExtension *)tx_frame->ptr;
-	extension->type = EXTENSION_ARQ_REQUEST;
-	extension->length = sizeof(ExtARQReq);
-	extension->ARQReq.sequence = sky_arq_seq_hton(sequence);
-	extension->ARQReq.mask = sky_arq_mask_hton(mask);
+// Get the number of bytes the wide ARQ Retransmit Request takes in the frame.
+unsigned int sky_frame_get_arq_sack_length(sky_arq_wide_mask_t mask, int wide_sequences)
+{
+	unsigned int mask_bytes = (mask >> 32) ? SKY_ARQ_SACK_MASK_MAX_BYTES : SKY_ARQ_SACK_MASK_MIN_BYTES;
+	return 1 + sky_frame_get_arq_extension_length(EXTENSION_ARQ_SACK, wide_sequences) - SKY_ARQ_SACK_MASK_MIN_BYTES + mask_bytes;
+}
 
-	// Move cursor forward and update frame and extension length.
-	const unsigned int len = 1 + sizeof(ExtARQReq);
-	tx_frame->hdr->extension_length += len;
-	tx_frame->frame->length += len;
-	tx_frame->ptr += len;
+// Add wide ARQ Retransmit Request header to the frame.
+int sky_frame_add_extension_arq_sack(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_wide_mask_t mask, int wide_sequences)
+{
+	const unsigned int mask_bytes = (mask >> 32) ? SKY_ARQ_SACK_MASK_MAX_BYTES : SKY_ARQ_SACK_MASK_MIN_BYTES;
+	uint8_t *data = arq_extension_begin(tx_frame, EXTENSION_ARQ_SACK, sky_frame_get_arq_sack_length(mask, wide_sequences) - 1);
+	data = put_arq_sequence(data, sequence, wide_sequences);
+	for (unsigned int i = 0; i < mask_bytes; i++)
+		data[i] = (uint8_t)(mask >> (8 * (mask_bytes - 1 - i)));
+	return SKY_RET_OK;
+}
+
+// Add ARQ Parity header to the frame.
+int sky_frame_add_extension_arq_parity(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, uint8_t count, uint8_t length, int wide_sequences)
+{
+	uint8_t *data = arq_extension_begin(tx_frame, EXTENSION_ARQ_PARITY, sky_frame_get_arq_extension_length(EXTENSION_ARQ_PARITY, wide_sequences));
+	data = put_arq_sequence(data, sequence, wide_sequences);
+	data[0] = count;
+	data[1] = length;
 	return SKY_RET_OK;
 }
 
 // Add ARQ Control header to the frame.
-int sky_frame_add_extension_arq_ctrl(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence)
+int sky_frame_add_extension_arq_ctrl(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence, int wide_sequences)
+{
+	uint8_t *data = arq_extension_begin(tx_frame, EXTENSION_ARQ_CTRL, sky_frame_get_arq_extension_length(EXTENSION_ARQ_CTRL, wide_sequences));
+	data = put_arq_sequence(data, tx_sequence, wide_sequences);
+	put_arq_sequence(data, rx_sequence, wide_sequences);
+	return SKY_RET_OK;
+}
+
+// Add compressed ARQ Control header to the frame.
+int sky_frame_add_extension_arq_ctrl_compressed(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence)
 {
 	// Ensure that the extensions field is the last field in the frame and frame has still room for the extension.
 	SKY_ASSERT(tx_frame->hdr->flag_has_payload == 0);
-	SKY_ASSERT(tx_frame->frame->length + 1 + sizeof(ExtARQCtrl) < SKY_PAYLOAD_MAX_LEN);
+	SKY_ASSERT(tx_frame->frame->length + 1 + sizeof(ExtARQCtrlCompressed) < SKY_PAYLOAD_MAX_LEN);
 
 	// Cast a pointer to the extension header and fill the extension header.
 	SkyHeaderExtension *extension = (SkyHeaderExtension *)tx_frame->ptr;
-	extension->type = EXTENSION_ARQ_CTRL;
-	extension->length = sizeof(ExtARQCtrl);
-	extension->ARQCtrl.tx_sequence = sky_arq_seq_hton(tx_sequence);
-	extension->ARQCtrl.rx_sequence = sky_arq_seq_hton(rx_sequence);
+	extension->type = EXTENSION_ARQ_CTRL_COMPRESSED;
+	extension->length = sizeof(ExtARQCtrlCompressed);
+	extension->ARQCtrlCompressed.sequences = (uint8_t)(((tx_sequence & 0x0F) << 4) | (rx_sequence & 0x0F));
 
 	// Move cursor forward and update frame and extension length.
-	const unsigned int len = 1 + sizeof(ExtARQCtrl);
+	const unsigned int len = 1 + sizeof(ExtARQCtrlCompressed);
 	tx_frame->hdr->extension_length += len;
 	tx_frame->frame->length += len;
 	tx_frame->ptr += len;
@@ -141,6 +224,27 @@ int sky_frame_add_extension_mac_tdd_control(SkyTransmitFrame *tx_frame, uint16_t
 	return SKY_RET_OK;
 }
 
+// Add compressed MAC TDD control header to the frame.
+int sky_frame_add_extension_mac_tdd_compressed(SkyTransmitFrame *tx_frame, uint16_t remaining)
+{
+	// Ensure that the extensions field is the last field in the frame and frame has still room for the extension.
+	SKY_ASSERT(tx_frame->hdr->flag_has_payload == 0);
+	SKY_ASSERT(tx_frame->frame->length < SKY_PAYLOAD_MAX_LEN - sizeof(ExtTDDControlCompressed));
+
+	// Cast a pointer to the extension header and fill the extension header.
+	SkyHeaderExtension *extension = (SkyHeaderExtension *)tx_frame->ptr;
+	extension->type = EXTENSION_MAC_TDD_COMPRESSED;
+	extension->length = sizeof(ExtTDDControlCompressed);
+	extension->TDDControlCompressed.remaining = sky_hton16(remaining);
+
+	// Move cursor forward and update frame and extension length.
+	const unsigned int len = 1 + sizeof(ExtTDDControlCompressed);
+	tx_frame->hdr->extension_length += len;
+	tx_frame->frame->length += len;
+	tx_frame->ptr += len;
+	return SKY_RET_OK;
+}
+
 // Add HMAC sequence reset header to the frame.
 int sky_frame_add_extension_hmac_sequence_reset(SkyTransmitFrame *tx_frame, uint16_t sequence)
 {
@@ -162,6 +266,15 @@ int sky_frame_add_extension_hmac_sequence_reset(SkyTransmitFrame *tx_frame, uint
 	return SKY_RET_OK;
 }
 
+// Get the length of the identity field in the frame.
+unsigned int sky_frame_get_identity_field_length(const SkyRadioFrame *frame)
+{
+	const unsigned int identity_len = frame->raw[0] & SKYLINK_FRAME_IDENTITY_MASK;
+	if (identity_len == SKY_IDENTITY_LEN_COMPRESSED)
+		return SKY_LINK_ID_LEN;
+	return identity_len;
+}
+
 // Get number of bytes left in the frame.
 int sky_frame_get_space_left(const SkyRadioFrame *frame)
 {
@@ -191,13 +304,65 @@ int sky_frame_extend_with_payload(SkyTransmitFrame *tx_frame, const uint8_t *pay
 //======================================================================================================================
 
 
+// Read a sequence from a parsed ARQ extension. Narrow sequences are resolved to the one nearest to the reference.
+sky_arq_sequence_t sky_frame_read_arq_sequence(const SkyHeaderExtension *extension, unsigned int field, sky_arq_sequence_t reference)
+{
+	const uint8_t *data = (const uint8_t*)&extension->ARQSeq;
+	if (arq_sequence_width(extension) == 2)
+		return (sky_arq_sequence_t)((data[2 * field] << 8) | data[2 * field + 1]);
+
+	int8_t offset = (int8_t)(uint8_t)(data[field] - (uint8_t)reference);
+	return (sky_arq_sequence_t)(reference + offset);
+}
+
+// Read the mask from a parsed ARQ Retransmit Request header.
+sky_arq_mask_t sky_frame_read_arq_request_mask(const SkyHeaderExtension *extension)
+{
+	const uint8_t *data = (const uint8_t*)&extension->ARQSeq + arq_sequence_width(extension);
+	return (sky_arq_mask_t)((data[0] << 8) | data[1]);
+}
+
+// Read the mask from a parsed wide ARQ Retransmit Request header.
+int sky_frame_read_arq_sack_mask(const SkyHeaderExtension *extension, sky_arq_wide_mask_t *mask)
+{
+	const unsigned int width = arq_sequence_width(extension);
+	const unsigned int mask_bytes = extension->length - width;
+	const uint8_t *data = (const uint8_t*)&extension->ARQSeq + width;
+	sky_arq_wide_mask_t m = 0;
+	for (unsigned int i = 0; i < mask_bytes; i++)
+		m = (m << 8) | data[i];
+	*mask = m;
+	return 8 * mask_bytes;
+}
+
+// Read the group size and the length parity from a parsed ARQ Parity header.
+void sky_frame_read_arq_parity(const SkyHeaderExtension *extension, uint8_t *count, uint8_t *length_parity)
+{
+	const uint8_t *data = (const uint8_t*)&extension->ARQSeq + arq_sequence_width(extension);
+	*count = data[0];
+	*length_parity = data[1];
+}
+
+// Whether the length of an ARQ extension matches either the narrow or the wide form.
+static int arq_extension_length_valid(const SkyHeaderExtension *extension)
+{
+	for (int wide = 0; wide <= 1; wide++) {
+		unsigned int length = sky_frame_get_arq_extension_length(extension->type, wide);
+		if (extension->length == length)
+			return 1;
+		if (extension->type == EXTENSION_ARQ_SACK && extension->length == length - SKY_ARQ_SACK_MASK_MIN_BYTES + SKY_ARQ_SACK_MASK_MAX_BYTES)
+			return 1;
+	}
+	return 0;
+}
+
 // Parse and validate all header extensions inside the frame.
 int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame* parsed)
 {
 
 
 	// Get cursor position for the start of the extension header.
-	unsigned int cursor = 1 + (frame->raw[0] & SKYLINK_FRAME_IDENTITY_MASK) + sizeof(SkyStaticHeader);
+	unsigned int cursor = 1 + sky_frame_get_identity_field_length(frame) + sizeof(SkyStaticHeader);
 	// Get the end position of the extension header.
 	unsigned int end = cursor + parsed->hdr.extension_length;
 	// Check for overflow
@@ -219,10 +384,10 @@ int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame
 		switch (ext->type)
 		{
 		case EXTENSION_ARQ_SEQUENCE:
-			// Check for redundant extensions and invalid length.
-			if (parsed->arq_sequence != NULL)
+			// Check for redundant extensions and invalid length. Payload is either a packet or a parity.
+			if (parsed->arq_sequence != NULL || parsed->arq_parity != NULL)
 				return SKY_RET_REDUNDANT_EXTENSIONS;
-			if (ext->length != sizeof(ExtARQSeq))
+			if (!arq_extension_length_valid(ext))
 				return SKY_RET_INVALID_EXT_LENGTH;
 
 			// Store pointer to the frame.
@@ -230,10 +395,10 @@ int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame
 			break; // TODO: Endianess swaps could be done during this step.
 
 		case EXTENSION_ARQ_REQUEST:
-			// Check for redundant extensions and invalid length.
+			// Check for redundant extensions and invalid length. A wide request may accompany it for a window further out.
 			if (parsed->arq_request != NULL)
 				return SKY_RET_REDUNDANT_EXTENSIONS;
-			if (ext->length != sizeof(ExtARQReq))
+			if (!arq_extension_length_valid(ext))
 				return SKY_RET_INVALID_EXT_LENGTH;
 
 			// Store pointer to the frame.
@@ -242,9 +407,9 @@ int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame
 
 		case EXTENSION_ARQ_CTRL:
 			// Check for redundant extensions and invalid length.
-			if (parsed->arq_ctrl != NULL)
+			if (parsed->arq_ctrl != NULL || parsed->arq_ctrl_compressed != NULL)
 				return SKY_RET_REDUNDANT_EXTENSIONS;
-			if (ext->length != sizeof(ExtARQCtrl))
+			if (!arq_extension_length_valid(ext))
 				return SKY_RET_INVALID_EXT_LENGTH;
 
 			// Store pointer to the frame.
@@ -264,7 +429,7 @@ int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame
 
 		case EXTENSION_MAC_TDD_CONTROL:
 			// Check for redundant extensions and invalid length.
-			if (parsed->mac_tdd != NULL)
+			if (parsed->mac_tdd != NULL || parsed->mac_tdd_compressed != NULL)
 				return SKY_RET_REDUNDANT_EXTENSIONS;
 			if (ext->length != sizeof(ExtTDDControl))
 				return SKY_RET_INVALID_EXT_LENGTH;
@@ -284,6 +449,50 @@ int sky_frame_parse_extension_headers(const SkyRadioFrame* frame, SkyParsedFrame
 			parsed->hmac_reset = ext;
 			break;
 
+		case EXTENSION_ARQ_CTRL_COMPRESSED:
+			// Check for redundant extensions and invalid length. Full and compressed control can't coexist.
+			if (parsed->arq_ctrl_compressed != NULL || parsed->arq_ctrl != NULL)
+				return SKY_RET_REDUNDANT_EXTENSIONS;
+			if (ext->length != sizeof(ExtARQCtrlCompressed))
+				return SKY_RET_INVALID_EXT_LENGTH;
+
+			// Store pointer to the frame.
+			parsed->arq_ctrl_compressed = ext;
+			break;
+
+		case EXTENSION_MAC_TDD_COMPRESSED:
+			// Check for redundant extensions and invalid length. Full and compressed control can't coexist.
+			if (parsed->mac_tdd_compressed != NULL || parsed->mac_tdd != NULL)
+				return SKY_RET_REDUNDANT_EXTENSIONS;
+			if (ext->length != sizeof(ExtTDDControlCompressed))
+				return SKY_RET_INVALID_EXT_LENGTH;
+
+			// Store pointer to the frame.
+			parsed->mac_tdd_compressed = ext;
+			break;
+
+		case EXTENSION_ARQ_SACK:
+			// Check for redundant extensions and invalid length.
+			if (parsed->arq_sack != NULL)
+				return SKY_RET_REDUNDANT_EXTENSIONS;
+			if (!arq_extension_length_valid(ext))
+				return SKY_RET_INVALID_EXT_LENGTH;
+
+			// Store pointer to the frame.
+			parsed->arq_sack = ext;
+			break;
+
+		case EXTENSION_ARQ_PARITY:
+			// Check for redundant extensions and invalid length. Payload is either a packet or a parity.
+			if (parsed->arq_parity != NULL || parsed->arq_sequence != NULL)
+				return SKY_RET_REDUNDANT_EXTENSIONS;
+			if (!arq_extension_length_valid(ext))
+				return SKY_RET_INVALID_EXT_LENGTH;
+
+			// Store pointer to the frame.
+			parsed->arq_parity = ext;
+			break;
+
 		default: // Invalid extension type
 			return SKY_RET_INVALID_EXT_TYPE;
 		}
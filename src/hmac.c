@@ -20,21 +20,21 @@ const unsigned int SKY_HMAC_CTX_SIZE = sizeof(blake3_hasher);
 
 
 
-// Allocate and initialize HMAC state instance
-SkyHMAC* sky_hmac_create(SkyHMACConfig* config)
+// Allocate HMAC state instance from the arena, or from the heap if it is NULL, and initialize it
+SkyHMAC* sky_hmac_create(SkyArena* arena, SkyHMACConfig* config)
 {
 	// Allocate memory for HMAC struct and clear
-	SkyHMAC* hmac = SKY_MALLOC(sizeof(SkyHMAC));
+	SkyHMAC* hmac = sky_allocate(arena, sizeof(SkyHMAC));
 	SKY_ASSERT(hmac != NULL);
 	memset(hmac, 0, sizeof(SkyHMAC));
 
 	// Allocate context memory for HMAC hash function
-	hmac->ctx = SKY_MALLOC(SKY_HMAC_CTX_SIZE);
+	hmac->ctx = sky_allocate(arena, SKY_HMAC_CTX_SIZE);
 	SKY_ASSERT(hmac->ctx != NULL);
 
 	// Allocate memory for HMAC key and copy it.
 	SKY_ASSERT(config->key_length == BLAKE3_KEY_LEN);
-	hmac->key = SKY_MALLOC(config->key_length);
+	hmac->key = sky_allocate(arena, config->key_length);
 	SKY_ASSERT(hmac->key != NULL);
 	memcpy(hmac->key, config->key, config->key_length);
 	hmac->key_len = config->key_length;
@@ -42,6 +42,12 @@ SkyHMAC* sky_hmac_create(SkyHMACConfig* config)
 	return hmac;
 }
 
+// Memory taken from an arena by the struct, the context and the key.
+size_t sky_hmac_required_memory(const SkyHMACConfig* config)
+{
+	return SKY_ARENA_SIZE(sizeof(SkyHMAC)) + SKY_ARENA_SIZE(SKY_HMAC_CTX_SIZE) + SKY_ARENA_SIZE(config->key_length);
+}
+
 // Free HMAC context, key and the struct itself.
 void sky_hmac_destroy(SkyHMAC* hmac)
 {
@@ -38,8 +38,8 @@ static sky_tick_t wrap_tdd_cycle(SkyMAC* mac, sky_tick_t ticks)
 
 // === PUBLIC FUNCTIONS ================================================================================================
 
-// Create a new MAC instance and initialize it with the given configuration.
-SkyMAC* sky_mac_create(SkyMACConfig* config)
+// Create a new MAC instance in the arena, or on the heap if it is NULL, and initialize it with the given configuration.
+SkyMAC* sky_mac_create(SkyArena* arena, SkyMACConfig* config)
 {
 	//Check that values are within allowed parameters, if not set them to default.
 
@@ -66,7 +66,7 @@ SkyMAC* sky_mac_create(SkyMACConfig* config)
 		config->window_adjustment_period = 4;
 
 	//Allocate memory for the MAC struct.
-	SkyMAC* mac = SKY_MALLOC(sizeof(SkyMAC));
+	SkyMAC* mac = sky_allocate(arena, sizeof(SkyMAC));
 
 	//Initialize the MAC struct.
 	mac->config = config;
@@ -168,6 +168,12 @@ int32_t mac_peer_window_remaining(SkyMAC* mac, sky_tick_t now)
 	return mac->peer_window_length - dt;
 }
 
+// Returns the length of a full TDD cycle in ticks.
+sky_tick_t mac_get_cycle_length(SkyMAC* mac)
+{
+	return get_mac_cycle(mac);
+}
+
 // Returns boolean whether MAC thinks it is our time to speak now.
 bool mac_can_send(SkyMAC* mac, sky_tick_t now)
 {
@@ -286,3 +292,20 @@ int mac_set_frame_fields(SkyMAC* mac, SkyTransmitFrame* tx_frame, sky_tick_t now
 	// Add MAC/TDD control extension with window length and remaining ticks to tx_frame.
 	return sky_frame_add_extension_mac_tdd_control(tx_frame, (uint16_t)mac->my_window_length, (uint16_t)remaining);
 }
+
+
+int mac_set_compressed_frame_fields(SkyMAC* mac, SkyTransmitFrame* tx_frame, sky_tick_t now)
+{
+	// Announce the full window on the first frame of the window.
+	if (mac->total_frames_sent_in_current_window == 0)
+		return mac_set_frame_fields(mac, tx_frame, now);
+
+	// Get how much is remaining of own window.
+	int32_t remaining = mac_own_window_remaining(mac, now);
+
+	// Give at least 1 tick of window remaining.
+	remaining = (remaining < 1) ? 1 : remaining;
+
+	// Add compressed MAC/TDD control extension with only the remaining ticks to tx_frame.
+	return sky_frame_add_extension_mac_tdd_compressed(tx_frame, (uint16_t)remaining);
+}
@@ -9,6 +9,8 @@
 
 #include "sky_platform.h"
 
+#include <string.h> // memcpy
+
 
 // Get current skylink protocol state and save it to the pointer state.
 void sky_get_state(SkyHandle self, SkyState* state)
@@ -29,6 +31,53 @@ void sky_get_state(SkyHandle self, SkyState* state)
 
 }
 
+// Get the fill levels of the rings and element buffers of all virtual channels.
+void sky_get_fill_levels(SkyHandle self, SkyFillLevels* levels)
+{
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		SkyVirtualChannel* vc = self->virtual_channels[i];
+		SkyVCFillLevel* level = &levels->vc[i];
+		SkyElementBuffer* buffer = vc->elementBuffer;
+
+		level->send_ring_used = (uint16_t)vc->sendRing->storage_count;
+		level->send_ring_peak = (uint16_t)vc->sendRing->peak_storage_count;
+		level->resend_queue = (uint16_t)vc->sendRing->resend_count;
+		level->rcv_ring_used = (uint16_t)vc->rcvRing->storage_count;
+		level->rcv_ring_peak = (uint16_t)vc->rcvRing->peak_storage_count;
+
+		// In the shared pool, the virtual channel holds what is charged to its quota.
+		if (vc->shared_element_buffer) {
+			const SkyElementQuota* quota = &buffer->quotas[vc->sendRing->element_owner];
+			level->used_elements = quota->used;
+			level->peak_elements = quota->peak;
+		}
+		else {
+			level->used_elements = buffer->element_count - buffer->free_elements;
+			level->peak_elements = buffer->peak_used_elements;
+		}
+		level->free_elements = sky_element_buffer_available_elements(buffer, vc->sendRing->element_owner);
+		memcpy(level->chain_lengths, buffer->chain_lengths, sizeof(level->chain_lengths));
+	}
+}
+
+// Start the fill level peaks over from the current levels.
+void sky_reset_fill_peaks(SkyHandle self)
+{
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		SkyVirtualChannel* vc = self->virtual_channels[i];
+		vc->sendRing->peak_storage_count = vc->sendRing->storage_count;
+		vc->rcvRing->peak_storage_count = vc->rcvRing->storage_count;
+		if (!vc->shared_element_buffer)
+			sky_element_buffer_reset_peaks(vc->elementBuffer);
+	}
+	if (self->element_pool != NULL)
+		sky_element_buffer_reset_peaks(self->element_pool);
+}
+
+
+// Usable element sizes of the slab size classes. The largest fits a payload of maximum length with its length field.
+static const int32_t slab_usable_element_sizes[SKY_VC_SLAB_CLASSES] = { 32, 96, SKY_PAYLOAD_MAX_LEN + EB_LEN_BYTES };
+
 
 static int compute_required_element_count(int elementsize, int total_ring_slots, int maximum_pl_size)
 {
@@ -41,51 +90,171 @@ static int compute_required_element_count(int elementsize, int total_ring_slots,
 
 //===== SKYLINK VIRTUAL CHANNEL  =======================================================================================
 
+// Forget the round trip time estimate and stop timing.
+static void reset_rtt_estimate(SkyVirtualChannel* vchannel, sky_tick_t now)
+{
+	vchannel->srtt = 0;
+	vchannel->rttvar = 0;
+	vchannel->rto = 0;
+	vchannel->rtt_probe_active = 0;
+	vchannel->rtt_probe_sequence = 0;
+	vchannel->rtt_probe_tick = 0;
+	vchannel->retransmit_timer_tick = now;
+}
+
+// Empty the rings. An own element buffer is wiped at once, in constant time, instead of deleting the payloads one by one.
+// A shared buffer holds the payloads of the other virtual channels, so there the rings delete their own.
+static void wipe_rings(SkyVirtualChannel* vchannel)
+{
+	SkyElementBuffer* buffer = vchannel->shared_element_buffer ? vchannel->elementBuffer : NULL;
+	sky_send_ring_wipe(vchannel->sendRing, buffer, 0);
+	sky_rcv_ring_wipe(vchannel->rcvRing, buffer, 0);
+	if (!vchannel->shared_element_buffer)
+		sky_element_buffer_wipe(vchannel->elementBuffer);
+}
+
 // Create a virtual channel instance
 SkyVirtualChannel* sky_vc_create(SkyVCConfig* config)
 {
-	// Check that the configuration is valid, if not, set to default values.
-	if (config->rcv_ring_len < 6 || config->rcv_ring_len > 250)
+	return sky_vc_create_in_pool(NULL, config, NULL, EB_NO_OWNER);
+}
+
+// Check that the configuration is valid, if not, set to default values.
+static void check_config(SkyVCConfig* config)
+{
+	if (config->rcv_ring_len < 6 || config->rcv_ring_len > ARQ_MAXIMUM_RING_LENGTH)
 		config->rcv_ring_len = 32;
 	if(config->horizon_width > config->rcv_ring_len - 3)
 		config->horizon_width = config->rcv_ring_len - 3;
-	if (config->send_ring_len < 6 || config->send_ring_len > 250)
+	if (config->send_ring_len < 6 || config->send_ring_len > ARQ_MAXIMUM_RING_LENGTH)
 		config->send_ring_len = 32;
 	if (config->usable_element_size < 12 || config->usable_element_size > 500)
 		config->usable_element_size = 32;
 	if ((config->require_authentication & (SKY_CONFIG_FLAG_AUTHENTICATE_TX | SKY_CONFIG_FLAG_USE_CRC32)) == 0)
 		config->require_authentication |= SKY_CONFIG_FLAG_USE_CRC32;
+	if (config->header_compression > 1)
+		config->header_compression = 0;
+	if (config->wide_sequences > 1)
+		config->wide_sequences = 0;
+	if (config->contiguous_allocation > 1)
+		config->contiguous_allocation = 0;
+	if (config->split_element_layout > 1)
+		config->split_element_layout = 0;
+	if (config->pool_minimum_elements < 0)
+		config->pool_minimum_elements = 0;
+	if (config->pool_maximum_elements < 0)
+		config->pool_maximum_elements = 0;
+	int32_t slab_elements = 0;
+	for (int i = 0; i < SKY_VC_SLAB_CLASSES; i++) {
+		if (config->slab_element_counts[i] < 0 || config->slab_element_counts[i] > EB_MAX_ELEMENT_COUNT)
+			config->slab_element_counts[i] = 0;
+		slab_elements += config->slab_element_counts[i];
+	}
+	if (slab_elements > EB_MAX_ELEMENT_COUNT)
+		memset(config->slab_element_counts, 0, sizeof(config->slab_element_counts));
+	if (config->rcv_ring_len > ARQ_NARROW_SEQUENCE_WINDOW || config->send_ring_len > ARQ_NARROW_SEQUENCE_WINDOW)
+		config->wide_sequences = 1;
+}
+
+// Get the slab classes that have elements. Returns the number of classes, 0 for a single size element buffer.
+static int get_slab_classes(const SkyVCConfig* config, int32_t* sizes, int32_t* counts)
+{
+	int n_classes = 0;
+	for (int i = 0; i < SKY_VC_SLAB_CLASSES; i++) {
+		if (config->slab_element_counts[i] == 0)
+			continue;
+		sizes[n_classes] = slab_usable_element_sizes[i];
+		counts[n_classes] = config->slab_element_counts[i];
+		n_classes++;
+	}
+	return n_classes;
+}
+
+// Number of elements in a single size element buffer of a virtual channel.
+static int32_t own_element_count(const SkyVCConfig* config)
+{
+	int32_t ring_slots = config->rcv_ring_len + config->send_ring_len -2;
+	int32_t optimal_element_count = compute_required_element_count((config->usable_element_size + 4), ring_slots, SKY_PAYLOAD_MAX_LEN);
+	if (optimal_element_count > EB_MAX_ELEMENT_COUNT) // Long rings of small elements. Not every slot can hold a maximum size payload.
+		optimal_element_count = EB_MAX_ELEMENT_COUNT;
+	return optimal_element_count;
+}
+
+// Create a virtual channel instance in the arena, or on the heap if it is NULL, using a shared element buffer,
+// or its own one if 'pool' is NULL.
+SkyVirtualChannel* sky_vc_create_in_pool(SkyArena* arena, SkyVCConfig* config, SkyElementBuffer* pool, int owner)
+{
+	check_config(config);
 
 	// Allocate memory for the virtual channel struct.
-	SkyVirtualChannel* vchannel = SKY_MALLOC(sizeof(SkyVirtualChannel));
+	SkyVirtualChannel* vchannel = sky_allocate(arena, sizeof(SkyVirtualChannel));
 	SKY_ASSERT(vchannel != NULL);
+	vchannel->config = config;
 
 	// Create send ring
-	vchannel->sendRing = sky_send_ring_create(config->send_ring_len, 0);
+	vchannel->sendRing = sky_send_ring_create(arena, config->send_ring_len, 0);
 	SKY_ASSERT(vchannel->sendRing != NULL);
 
 	// Create receive ring
-	vchannel->rcvRing = sky_rcv_ring_create(config->rcv_ring_len, config->horizon_width, 0);
+	vchannel->rcvRing = sky_rcv_ring_create(arena, config->rcv_ring_len, config->horizon_width, 0);
 	SKY_ASSERT(vchannel->rcvRing != NULL);
 
-	// Create element buffer
-	int32_t ring_slots = config->rcv_ring_len + config->send_ring_len -2;
-	int32_t optimal_element_count = compute_required_element_count((config->usable_element_size + 4), ring_slots, SKY_PAYLOAD_MAX_LEN);
-	vchannel->elementBuffer = sky_element_buffer_create(config->usable_element_size, optimal_element_count);
+	// Use the shared element buffer. The rings charge their payloads to the quota of the virtual channel.
+	if (pool != NULL) {
+		vchannel->elementBuffer = pool;
+		vchannel->shared_element_buffer = 1;
+		vchannel->sendRing->element_owner = (uint8_t)owner;
+		vchannel->rcvRing->element_owner = (uint8_t)owner;
+		sky_vc_wipe_to_arq_off_state(vchannel);
+		return vchannel;
+	}
+
+	// Create a slab element buffer of the classes that have elements, or a single size element buffer.
+	int32_t sizes[SKY_VC_SLAB_CLASSES], counts[SKY_VC_SLAB_CLASSES];
+	int n_classes = get_slab_classes(config, sizes, counts);
+	if (n_classes > 0)
+		vchannel->elementBuffer = sky_element_buffer_create_slab(arena, sizes, counts, n_classes);
+	else
+		vchannel->elementBuffer = sky_element_buffer_create(arena, config->usable_element_size, own_element_count(config));
 	SKY_ASSERT(vchannel->elementBuffer != NULL);
+	vchannel->shared_element_buffer = 0;
+	if (config->contiguous_allocation)
+		sky_element_buffer_set_allocation_policy(arena, vchannel->elementBuffer, EB_ALLOC_CONTIGUOUS);
+	if (config->split_element_layout)
+		sky_element_buffer_set_layout(vchannel->elementBuffer, EB_LAYOUT_SPLIT);
 
 	// Reset ARQ state
 	sky_vc_wipe_to_arq_off_state(vchannel);
 	return vchannel;
 }
 
+// Memory taken from an arena by a virtual channel. The configuration is checked on a copy as the creation would.
+size_t sky_vc_required_memory(const SkyVCConfig* config, int in_pool)
+{
+	SkyVCConfig checked = *config;
+	check_config(&checked);
+	size_t size = SKY_ARENA_SIZE(sizeof(SkyVirtualChannel));
+	size += sky_send_ring_required_memory(checked.send_ring_len);
+	size += sky_rcv_ring_required_memory(checked.rcv_ring_len);
+	if (in_pool)
+		return size;
+
+	const int policy = checked.contiguous_allocation ? EB_ALLOC_CONTIGUOUS : EB_ALLOC_FREE_LIST;
+	int32_t sizes[SKY_VC_SLAB_CLASSES], counts[SKY_VC_SLAB_CLASSES];
+	int n_classes = get_slab_classes(&checked, sizes, counts);
+	if (n_classes > 0)
+		return size + sky_element_buffer_slab_required_memory(sizes, counts, n_classes, policy);
+	return size + sky_element_buffer_required_memory(checked.usable_element_size, own_element_count(&checked), policy, 0);
+}
+
 // Destroy virtual channel instance
 void sky_vc_destroy(SkyVirtualChannel* vchannel)
 {
 	// Destroy all the rings and the element buffer.
 	sky_send_ring_destroy(vchannel->sendRing);
 	sky_rcv_ring_destroy(vchannel->rcvRing);
-	sky_element_buffer_destroy(vchannel->elementBuffer);
+	if (!vchannel->shared_element_buffer)
+		sky_element_buffer_destroy(vchannel->elementBuffer);
 	// Free the virtual channel struct.
 	SKY_FREE(vchannel);
 }
@@ -94,9 +263,7 @@ void sky_vc_destroy(SkyVirtualChannel* vchannel)
 void sky_vc_wipe_to_arq_off_state(SkyVirtualChannel* vchannel)
 {
 	// Wipe the rings and the element buffer.
-	sky_send_ring_wipe(vchannel->sendRing, vchannel->elementBuffer, 0);
-	sky_rcv_ring_wipe(vchannel->rcvRing, vchannel->elementBuffer, 0);
-	sky_element_buffer_wipe(vchannel->elementBuffer);
+	wipe_rings(vchannel);
 
 	// Reset VC and set arq state to off.
 	vchannel->need_recall = 0;
@@ -107,14 +274,24 @@ void sky_vc_wipe_to_arq_off_state(SkyVirtualChannel* vchannel)
 	vchannel->last_ctrl_send_tick = 0;
 	vchannel->unconfirmed_payloads = 0;
 	vchannel->handshake_send = 0;
+	vchannel->header_compression = 0;
+	vchannel->wide_sequences = 0;
+	vchannel->link_initiator = 0;
+	vchannel->last_ctrl_rx_sequence = 0;
+	vchannel->speculative_sequence = 0;
+	vchannel->sack_sequence = 0;
+	vchannel->resync_realigned = 0;
+	vchannel->speculative_resends_in_window = 0;
+	vchannel->window_start_tick = 0;
+	vchannel->parity_sequence = 0;
+	reset_rtt_estimate(vchannel, 0);
 }
 
 // Clean the rings and set the VC to arq init state. (Start handshaking)
 void sky_vc_wipe_to_arq_init_state(SkyVirtualChannel *vchannel)
 {
-	// Wipe the rings.
-	sky_rcv_ring_wipe(vchannel->rcvRing, vchannel->elementBuffer, 0);
-	sky_send_ring_wipe(vchannel->sendRing, vchannel->elementBuffer, 0);
+	// Wipe the rings and the element buffer.
+	wipe_rings(vchannel);
 
 	// Reset VC and set arq state to init.
 	vchannel->need_recall = 0;
@@ -125,14 +302,24 @@ void sky_vc_wipe_to_arq_init_state(SkyVirtualChannel *vchannel)
 	vchannel->last_ctrl_send_tick = 0;
 	vchannel->unconfirmed_payloads = 0;
 	vchannel->handshake_send = 0;
+	vchannel->header_compression = 0;
+	vchannel->wide_sequences = 0;
+	vchannel->link_initiator = 0;
+	vchannel->last_ctrl_rx_sequence = 0;
+	vchannel->speculative_sequence = 0;
+	vchannel->sack_sequence = 0;
+	vchannel->resync_realigned = 0;
+	vchannel->speculative_resends_in_window = 0;
+	vchannel->window_start_tick = 0;
+	vchannel->parity_sequence = 0;
+	reset_rtt_estimate(vchannel, sky_get_tick_time());
 }
 
 // Clean the rings and set the VC to arq on state. (Reliable state)
 void sky_vc_wipe_to_arq_on_state(SkyVirtualChannel *vchannel, uint32_t identifier)
 {
-	// Wipe the rings.
-	sky_rcv_ring_wipe(vchannel->rcvRing, vchannel->elementBuffer, 0);
-	sky_send_ring_wipe(vchannel->sendRing, vchannel->elementBuffer, 0);
+	// Wipe the rings and the element buffer.
+	wipe_rings(vchannel);
 
 	// Reset VC and set arq state to on.
 	vchannel->need_recall = 0;
@@ -143,6 +330,17 @@ void sky_vc_wipe_to_arq_on_state(SkyVirtualChannel *vchannel, uint32_t identifie
 	vchannel->last_ctrl_send_tick = 0;
 	vchannel->unconfirmed_payloads = 0;
 	vchannel->handshake_send = 1;
+	vchannel->header_compression = 0;
+	vchannel->wide_sequences = 0;
+	vchannel->link_initiator = 0;
+	vchannel->last_ctrl_rx_sequence = 0;
+	vchannel->speculative_sequence = 0;
+	vchannel->sack_sequence = 0;
+	vchannel->resync_realigned = 0;
+	vchannel->speculative_resends_in_window = 0;
+	vchannel->window_start_tick = 0;
+	vchannel->parity_sequence = 0;
+	reset_rtt_estimate(vchannel, sky_get_tick_time());
 }
 
 // Start the ARQ connection procedure.
@@ -178,6 +376,113 @@ void sky_vc_check_timeouts(SkyVirtualChannel *vchannel, sky_tick_t now, sky_tick
 
 }
 
+// Update the round trip time estimate with a new sample. (Jacobson's algorithm, RFC 6298)
+void sky_vc_update_rtt(SkyVirtualChannel* vchannel, int32_t sample)
+{
+	if (sample < 0)
+		return;
+
+	if (vchannel->srtt == 0) {
+		// First measurement: SRTT = R, RTTVAR = R/2
+		vchannel->srtt = sample << 3;
+		vchannel->rttvar = sample << 1;
+	}
+	else {
+		// SRTT = 7/8 SRTT + 1/8 R, RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+		int32_t delta = sample - (vchannel->srtt >> 3);
+		vchannel->srtt += delta;
+		if (delta < 0)
+			delta = -delta;
+		vchannel->rttvar += delta - (vchannel->rttvar >> 2);
+	}
+
+	// RTO = SRTT + 4 * RTTVAR. This also clears any backoff.
+	vchannel->rto = (vchannel->srtt >> 3) + vchannel->rttvar;
+	if (vchannel->rto < 1)
+		vchannel->rto = 1;
+}
+
+// Schedule the unacknowledged packets for retransmission if the peer hasn't acknowledged anything in time.
+int sky_vc_check_retransmit_timeout(SkyVirtualChannel* vchannel, sky_tick_t now, sky_tick_t min_rto, sky_tick_t max_rto)
+{
+	// Only reliable channels with something in flight and no recovery already going on.
+	SkySendRing* sendRing = vchannel->sendRing;
+	if (vchannel->arq_state_flag != ARQ_STATE_ON)
+		return 0;
+	if (sendRing->tx_sequence == sendRing->tail_sequence || sendRing->resend_count > 0)
+		return 0;
+
+	// Without a measurement be conservative and wait for two full TDD cycles.
+	int32_t rto = (vchannel->rto > 0) ? vchannel->rto : 2 * min_rto;
+	if (rto < min_rto)
+		rto = min_rto;
+	if (rto > max_rto)
+		rto = max_rto;
+	if (wrap_time_ticks(now - vchannel->retransmit_timer_tick) <= rto)
+		return 0;
+
+	// Schedule everything not yet acknowledged.
+	int n_scheduled = 0;
+	for (sky_arq_sequence_t seq = sendRing->tail_sequence; seq != sendRing->tx_sequence; seq++) {
+		if (sendRing_schedule_resend(sendRing, seq) == SKY_RET_OK)
+			n_scheduled++;
+	}
+	SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Retransmit timeout (%d ticks), %d packets scheduled", (int)rto, n_scheduled);
+
+	// Back off until the next valid measurement. The timed packet is now ambiguous.
+	vchannel->rto = (2 * rto < max_rto) ? 2 * rto : max_rto;
+	vchannel->rtt_probe_active = 0;
+	vchannel->retransmit_timer_tick = now;
+	return n_scheduled;
+}
+
+
+/*
+ * Derive the 7-bit link ID base from the session identifier.
+ * The identifier is folded with XOR so that the result doesn't depend on the byte order
+ * in which the peers have stored the identifier.
+ */
+static uint8_t link_id_base(uint32_t identifier)
+{
+	uint8_t folded = (uint8_t)(identifier ^ (identifier >> 8) ^ (identifier >> 16) ^ (identifier >> 24));
+	return folded & (uint8_t)~SKY_LINK_ID_DIRECTION_BIT;
+}
+
+// Get link ID for compressed frame header or negative value if the full identity must be sent.
+int sky_vc_get_tx_link_id(SkyVirtualChannel* vchannel)
+{
+	// Compressed headers are used only on established links which have nothing to renegotiate.
+	if (vchannel->arq_state_flag != ARQ_STATE_ON || vchannel->header_compression == 0 || vchannel->handshake_send > 0)
+		return -1;
+
+	uint8_t link_id = link_id_base(vchannel->arq_session_identifier);
+	if (vchannel->link_initiator)
+		link_id |= SKY_LINK_ID_DIRECTION_BIT;
+	return link_id;
+}
+
+// Validate link ID of a received frame with compressed header.
+int sky_vc_check_rx_link_id(SkyVirtualChannel* vchannel, uint8_t link_id)
+{
+	// Without negotiated compression the link ID cannot be resolved. The link survives resynchronization.
+	if ((vchannel->arq_state_flag != ARQ_STATE_ON && vchannel->arq_state_flag != ARQ_STATE_RESYNC) || vchannel->header_compression == 0)
+		return SKY_RET_UNKNOWN_LINK_ID;
+
+	uint8_t own_link_id = link_id_base(vchannel->arq_session_identifier);
+	if (vchannel->link_initiator)
+		own_link_id |= SKY_LINK_ID_DIRECTION_BIT;
+
+	// Our own frame echoed back.
+	if (link_id == own_link_id)
+		return SKY_RET_FILTERED_BY_IDENTITY;
+
+	// The peer uses the opposite direction bit.
+	if (link_id != (own_link_id ^ SKY_LINK_ID_DIRECTION_BIT))
+		return SKY_RET_UNKNOWN_LINK_ID;
+
+	return SKY_RET_OK;
+}
+
 //===== SKYLINK VIRTUAL CHANNEL ========================================================================================
 
 
@@ -203,6 +508,48 @@ int sky_vc_push_packet_to_send(SkyVirtualChannel* vchannel, const uint8_t* paylo
 	return sendRing_push_packet_to_send(vchannel->sendRing, vchannel->elementBuffer, payload, length);
 }
 
+// Push packet gathered from fragments to send to element buffer.
+int sky_vc_push_packet_to_send_iov(SkyVirtualChannel *vchannel, const struct sky_iovec *iov, int iovcnt)
+{
+	size_t length = 0;
+	for (int i = 0; i < iovcnt; i++)
+		length += iov[i].iov_len;
+	if (length > SKY_PAYLOAD_MAX_LEN)
+		return SKY_RET_TOO_LONG_PAYLOAD;
+	return sendRing_push_packet_to_send_iov(vchannel->sendRing, vchannel->elementBuffer, iov, iovcnt);
+}
+
+// Push packet to send with a priority and an expiry.
+int sky_vc_push_packet_with_options(SkyVirtualChannel *vchannel, const uint8_t *payload, unsigned int length,
+                                    uint8_t priority, sky_tick_t ttl, sky_tick_t now)
+{
+	if (length > SKY_PAYLOAD_MAX_LEN)
+		return SKY_RET_TOO_LONG_PAYLOAD;
+	struct sky_iovec iov = { payload, length };
+	return sendRing_push_packet_with_options(vchannel->sendRing, vchannel->elementBuffer, &iov, 1, priority, ttl, now);
+}
+
+// Push a group of packets to send, all or none of them.
+int sky_vc_push_batch(SkyVirtualChannel *vchannel, const struct sky_iovec *packets, int count)
+{
+	for (int i = 0; i < count; i++)
+		if (packets[i].iov_len > SKY_PAYLOAD_MAX_LEN)
+			return SKY_RET_TOO_LONG_PAYLOAD;
+	return sendRing_push_batch(vchannel->sendRing, vchannel->elementBuffer, packets, count);
+}
+
+// Returns the number of free slots in the send ring.
+int sky_vc_count_free_send_slots(SkyVirtualChannel* vchannel)
+{
+	return sendRing_count_free_send_slots(vchannel->sendRing);
+}
+
+// Returns the number of payload bytes that still fit in the element buffer.
+int sky_vc_count_free_send_bytes(SkyVirtualChannel* vchannel)
+{
+	return sky_element_buffer_free_space_for(vchannel->elementBuffer, vchannel->sendRing->element_owner);
+}
+
 // Returns 1 if the buffer is full, 0 otherwise.
 int sky_vc_send_buffer_is_full(SkyVirtualChannel* vchannel)
 {
@@ -242,8 +589,19 @@ void sky_vc_update_tx_sync(SkyVirtualChannel *vchannel, sky_arq_sequence_t peer_
 	//Clean the send ring up to the sequence provided by the peer.
 	int n_cleared = sendRing_clean_tail_up_to(vchannel->sendRing, vchannel->elementBuffer, peer_rx_head_sequence_by_ctrl);
 	//If the ring was succesfully cleared, update the last tx tick.
-	if(n_cleared > 0)
+	if(n_cleared > 0) {
 		vchannel->last_tx_tick = now;
+		vchannel->retransmit_timer_tick = now;
+
+		//If the timed packet is no longer between the tail and tx head, it has been acknowledged.
+		SkySendRing* sendRing = vchannel->sendRing;
+		sky_arq_sequence_t probe_ahead_of_tail = vchannel->rtt_probe_sequence - sendRing->tail_sequence;
+		sky_arq_sequence_t tx_ahead_of_tail = sendRing->tx_sequence - sendRing->tail_sequence;
+		if (vchannel->rtt_probe_active && probe_ahead_of_tail >= tx_ahead_of_tail) {
+			vchannel->rtt_probe_active = 0;
+			sky_vc_update_rtt(vchannel, wrap_time_ticks(now - vchannel->rtt_probe_tick));
+		}
+	}
 
 	//Tx sequence is updated to the sequence provided by the peer.
 	if(vchannel->sendRing->tx_sequence == peer_rx_head_sequence_by_ctrl)
@@ -277,6 +635,24 @@ int sky_vc_read_next_received(SkyVirtualChannel* vchannel, uint8_t* tgt, unsigne
 	return rcvRing_read_next_received(vchannel->rcvRing, vchannel->elementBuffer, tgt, max_length);
 }
 
+// Get read-only views to the next received message. Return the number of spans, or negative error code.
+int sky_vc_peek_next_received(SkyVirtualChannel* vchannel, struct sky_iovec* spans, int max_spans)
+{
+	return rcvRing_peek_next_received(vchannel->rcvRing, vchannel->elementBuffer, spans, max_spans);
+}
+
+// Remove the message previously accessed by peeking. Return zero on success, or negative error code.
+int sky_vc_release_received(SkyVirtualChannel* vchannel)
+{
+	return rcvRing_release_next_received(vchannel->rcvRing, vchannel->elementBuffer);
+}
+
+// Read all readable messages to the arena. Return the number of messages read, or negative error code.
+int sky_vc_read_received_batch(SkyVirtualChannel* vchannel, SkyPacketView* out, int max, uint8_t* arena, size_t arena_len)
+{
+	return rcvRing_read_received_batch(vchannel->rcvRing, vchannel->elementBuffer, out, max, arena, arena_len);
+}
+
 // Push latest radio received message in. Returns how many steps the head has advanced or negative error.
 int sky_vc_push_rx_packet_monotonic(SkyVirtualChannel* vchannel, const uint8_t* src, unsigned int length)
 {
@@ -298,10 +674,30 @@ int sky_vc_push_rx_packet(SkyVirtualChannel* vchannel, const uint8_t* src, unsig
 	return r;
 }
 
+// Repair a missing packet of a parity group and push it to the buffer.
+int sky_vc_push_rx_parity(SkyVirtualChannel *vchannel, const uint8_t *parity, unsigned int length, sky_arq_sequence_t sequence, int count,
+                          uint8_t length_parity, sky_tick_t now)
+{
+	if (length > SKY_PAYLOAD_MAX_LEN)
+		return SKY_RET_TOO_LONG_PAYLOAD;
+
+	// The parity is turned into the missing packet in place, so work on a copy.
+	uint8_t packet[SKY_PAYLOAD_MAX_LEN];
+	memcpy(packet, parity, length);
+
+	sky_arq_sequence_t missing;
+	int packet_length = rcvRing_reconstruct_from_parity(vchannel->rcvRing, vchannel->elementBuffer, sequence, count, length_parity, packet, length, &missing);
+	if (packet_length < 0)
+		return packet_length;
+
+	SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Repaired ARQ packet %d from parity", (int)missing);
+	return sky_vc_push_rx_packet(vchannel, packet, packet_length, missing, now);
+}
+
 // Get sync status of the receive ring and act accordingly.
 void sky_vc_update_rx_sync(SkyVirtualChannel *vchannel, sky_arq_sequence_t peer_tx_head_sequence_by_ctrl, sky_tick_t now)
 {
-	int sync = rcvRing_get_sequence_sync_status(vchannel->rcvRing, peer_tx_head_sequence_by_ctrl);
+	int sync = rcvRing_get_sequence_sync_status(vchannel->rcvRing, peer_tx_head_sequence_by_ctrl, vchannel->wide_sequences);
 
 	if(sync == SKY_RET_OK) { // SKY_RET_RING_SEQUENCES_IN_SYNC
 		vchannel->last_rx_tick = now;
@@ -310,14 +706,95 @@ void sky_vc_update_rx_sync(SkyVirtualChannel *vchannel, sky_arq_sequence_t peer_
 	else if(sync == SKY_RET_RING_SEQUENCES_OUT_OF_SYNC) // Out of sync but recoverable.
 		vchannel->need_recall = 1;
 
-	else if(sync == SKY_RET_RING_SEQUENCES_DETACHED){
-		// vc->arq_state_flag = ARQ_STATE_BROKEN;
+	else if(sync == SKY_RET_RING_SEQUENCES_DETACHED && vchannel->arq_state_flag == ARQ_STATE_ON) {
+		// The packets ahead of head were numbered by a peer we have lost track of. Ask the peer to realign.
+		int n_dropped = rcvRing_drop_horizon(vchannel->rcvRing, vchannel->elementBuffer);
+		SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_INFO, "ARQ sequences detached, resyncing (%d packets dropped)", n_dropped);
+		vchannel->arq_state_flag = ARQ_STATE_RESYNC;
+		vchannel->need_recall = 0;
+		vchannel->unconfirmed_payloads = 0;
 	}
 }
+
+// Realign our send ring to the peer's receive head and send all packets the peer has not received again.
+static void sky_vc_realign_to_peer(SkyVirtualChannel *vchannel, sky_arq_sequence_t peer_rx_head_sequence, sky_tick_t now)
+{
+	// Packets before the peer's head were delivered even if the acknowledgements were lost. Only the rest is sent
+	// again, and renumbered only if the peer's head is not one of our sequences.
+	SkySendRing* sendRing = vchannel->sendRing;
+	sky_arq_sequence_t peer_head_ahead_of_tail = peer_rx_head_sequence - sendRing->tail_sequence;
+	sky_arq_sequence_t tx_ahead_of_tail = sendRing->tx_sequence - sendRing->tail_sequence;
+	if (peer_head_ahead_of_tail <= tx_ahead_of_tail)
+		sendRing_clean_tail_up_to(sendRing, vchannel->elementBuffer, peer_rx_head_sequence);
+	sendRing_realign(sendRing, peer_rx_head_sequence);
+	vchannel->speculative_sequence = peer_rx_head_sequence;
+	vchannel->parity_sequence = peer_rx_head_sequence;
+	vchannel->rtt_probe_active = 0;
+	vchannel->retransmit_timer_tick = now;
+	vchannel->last_tx_tick = now;
+	vchannel->handshake_send = 1;
+	vchannel->resync_realigned = 1;
+}
 //======================================================================================================================
 //======================================================================================================================
 
 
+// Whether a parity group has been transmitted and its parity is waiting to be sent.
+static int sky_vc_parity_pending(SkyVirtualChannel* vchannel, SkyConfig* config)
+{
+	if (config->arq.parity_group_size < 2)
+		return 0;
+	return (sky_arq_sequence_t)(vchannel->sendRing->tx_sequence - vchannel->parity_sequence) >= config->arq.parity_group_size;
+}
+
+// Session options offered in our handshake.
+static uint8_t sky_vc_handshake_options(SkyVirtualChannel* vchannel)
+{
+	uint8_t options = 0;
+	if (vchannel->config->header_compression)
+		options |= ARQ_HANDSHAKE_FLAG_COMPRESSION;
+	if (vchannel->config->wide_sequences)
+		options |= ARQ_HANDSHAKE_FLAG_WIDE_SEQUENCES;
+	return options;
+}
+
+// Get the unacknowledged sequence to be retransmitted speculatively, or -1 if there's none or the window budget is used.
+static int sky_vc_get_speculative_resend(SkyVirtualChannel* vchannel, SkyConfig* config, sky_tick_t now, uint16_t frames_sent_in_this_vc_window)
+{
+	SkySendRing* sendRing = vchannel->sendRing;
+
+	// The counter of the VC is left over from the previous window when nothing has been sent in this one yet.
+	int resends_in_window = (frames_sent_in_this_vc_window == 0) ? 0 : vchannel->speculative_resends_in_window;
+	if (resends_in_window >= config->arq.speculative_resends_per_window)
+		return -1;
+
+	// Only leftover time is used. New payloads, requested retransmissions and parities go first.
+	if (sendRing_count_packets_to_send(sendRing, 1) > 0 || sky_vc_parity_pending(vchannel, config))
+		return -1;
+
+	// Nothing unacknowledged?
+	const sky_arq_sequence_t in_flight = (sky_arq_sequence_t)(sendRing->tx_sequence - sendRing->tail_sequence);
+	if (in_flight == 0)
+		return -1;
+
+	// Continue from where the previous speculative retransmission left off, or restart from the oldest one.
+	sky_arq_sequence_t sequence = vchannel->speculative_sequence;
+	if ((sky_arq_sequence_t)(sequence - sendRing->tail_sequence) >= in_flight)
+		sequence = sendRing->tail_sequence;
+
+	// Is the acknowledgement of the packet overdue? Without a round trip estimate, anything sent in an earlier window is.
+	const sky_tick_t tx_tick = sendRing->options[sendRing_get_recall_ring_index(sendRing, sequence)].tx_tick;
+	if (vchannel->rto > 0) {
+		if (wrap_time_ticks(now - tx_tick) < (vchannel->srtt >> 3))
+			return -1;
+	}
+	else if (frames_sent_in_this_vc_window > 0) {
+		if (wrap_time_ticks(now - tx_tick) <= wrap_time_ticks(now - vchannel->window_start_tick))
+			return -1;
+	}
+	return sequence;
+}
+
 // sky_vc_has_content_to_send()
 /*
 Returns boolean 0/1 as to if there is content to be sent on this virtual channel.
@@ -331,15 +808,18 @@ int sky_vc_content_to_send(SkyVirtualChannel* vchannel, SkyConfig* config, sky_t
 		 * ARQ is off:
 		 */
 
-		// Transmit if there's something in the buffer
+		// Transmit if there's something in the buffer that hasn't expired. The expired ones are dropped here,
+		// otherwise a queue that has run out would start a frame with nothing to fill it with.
+		sendRing_prepare_unreliable_tx(vchannel->sendRing, vchannel->elementBuffer, now);
 		if (sendRing_count_packets_to_send(vchannel->sendRing, 0) > 0)
 			return 1;
 
 		return 0;
 
 	case ARQ_STATE_IN_INIT:
+	case ARQ_STATE_RESYNC:
 		/*
-		 * ARQ is handshaking but we haven't received response yet.
+		 * ARQ is handshaking or resyncing but we haven't received response yet.
 		 */
 
 		// Transmit if not too many idle frames have not been generated.
@@ -358,13 +838,21 @@ int sky_vc_content_to_send(SkyVirtualChannel* vchannel, SkyConfig* config, sky_t
 
 		// Yes, if and we have need to retransmit something and not all idle frame are used.
 		if (frames_sent_in_this_vc_window < config->arq.idle_frames_per_window && \
-		    (rcvRing_get_horizon_bitmap(vchannel->rcvRing) || vchannel->need_recall))
+		    (rcvRing_get_horizon_bitmap_wide(vchannel->rcvRing) || vchannel->need_recall))
 			return 1;
 
 		// Yes, if we need to response a ARQ handshake
 		if (vchannel->handshake_send)
 			return 1;
 
+		// Yes, if a parity group is complete.
+		if (sky_vc_parity_pending(vchannel, config))
+			return 1;
+
+		// Yes, if there is leftover time for speculative retransmissions.
+		if (sky_vc_get_speculative_resend(vchannel, config, now, frames_sent_in_this_vc_window) >= 0)
+			return 1;
+
 		// Can still generate more idle frames?
 		if (frames_sent_in_this_vc_window < config->arq.idle_frames_per_window) {
 
@@ -394,8 +882,9 @@ int sky_vc_fill_frame(SkyVirtualChannel *vchannel, SkyConfig *config, SkyTransmi
 		 * ARQ is off.
 		 */
 
-		// Try to read a new frame
+		// Try to read a new frame. The most urgent packet that hasn't expired goes first.
 		sky_arq_sequence_t sequence;
+		sendRing_prepare_unreliable_tx(vchannel->sendRing, vchannel->elementBuffer, now);
 		int length = sendRing_peek_next_tx_size_and_sequence(vchannel->sendRing, vchannel->elementBuffer, 0, &sequence);
 		if (length > 0)
 		{
@@ -423,7 +912,25 @@ int sky_vc_fill_frame(SkyVirtualChannel *vchannel, SkyConfig *config, SkyTransmi
 		if (frames_sent_in_this_vc_window < config->arq.idle_frames_per_window) {
 
 			// Add only a ARQ handshake extension to the packet
-			sky_frame_add_extension_arq_handshake(tx_frame, ARQ_STATE_IN_INIT, vchannel->arq_session_identifier);
+			sky_frame_add_extension_arq_handshake(tx_frame, ARQ_STATE_IN_INIT | sky_vc_handshake_options(vchannel), vchannel->arq_session_identifier);
+			return 1;
+		}
+
+		return 0;
+
+	case ARQ_STATE_RESYNC:
+		/*
+		 * Our receive ring has detached from the peer's sequences.
+		 */
+
+		// Transmit the resync request as an idle frame. The full control tells the peer where our receive head is.
+		// If we have realigned to the peer's own request, the control is in sync with the peer and answers it as well.
+		if (frames_sent_in_this_vc_window < config->arq.idle_frames_per_window) {
+			tx_frame->hdr->flag_arq_on = 1;
+			sky_frame_add_extension_arq_handshake(tx_frame, ARQ_STATE_RESYNC | sky_vc_handshake_options(vchannel), vchannel->arq_session_identifier);
+			sky_frame_add_extension_arq_ctrl(tx_frame, vchannel->sendRing->tx_sequence, vchannel->rcvRing->head_sequence, vchannel->wide_sequences);
+			vchannel->last_ctrl_rx_sequence = vchannel->rcvRing->head_sequence;
+			vchannel->last_ctrl_send_tick = now;
 			return 1;
 		}
 
@@ -438,36 +945,132 @@ int sky_vc_fill_frame(SkyVirtualChannel *vchannel, SkyConfig *config, SkyTransmi
 
 		tx_frame->hdr->flag_arq_on = 1;
 
+		// First frame of the window restarts the speculative retransmission budget.
+		if (frames_sent_in_this_vc_window == 0) {
+			vchannel->speculative_resends_in_window = 0;
+			vchannel->window_start_tick = now;
+		}
+
+		// Without parities the next group starts from the next new packet.
+		if (config->arq.parity_group_size < 2)
+			vchannel->parity_sequence = vchannel->sendRing->tx_sequence;
+
 		// Add ARQ handshake response if it is pending.
 		if (vchannel->handshake_send > 0) {
-			sky_frame_add_extension_arq_handshake(tx_frame, ARQ_STATE_ON, vchannel->arq_session_identifier);
+			sky_frame_add_extension_arq_handshake(tx_frame, ARQ_STATE_ON | sky_vc_handshake_options(vchannel), vchannel->arq_session_identifier);
 			vchannel->handshake_send--;
 			ret = 1;
 		}
 
 		// Add ARQ retransmit request extension if we see that there are missing frames.
-		sky_arq_mask_t mask = rcvRing_get_horizon_bitmap(vchannel->rcvRing);
-		if ((frames_sent_in_this_vc_window < config->arq.idle_frames_per_window) && (mask != 0 || vchannel->need_recall)){
-			sky_frame_add_extension_arq_request(tx_frame, vchannel->rcvRing->head_sequence, mask);
+		// Packets received only beyond the bitmap leave it empty but still need the ones before them requested.
+		sky_arq_wide_mask_t mask = rcvRing_get_horizon_bitmap_wide(vchannel->rcvRing);
+		const int extent = rcvRing_get_horizon_extent(vchannel->rcvRing);
+		if ((frames_sent_in_this_vc_window < config->arq.idle_frames_per_window) && (mask != 0 || extent > ARQ_HORIZON_MAP_BITS + 1 || vchannel->need_recall)){
+			/*
+			 * The 16 bit request covers most cases. The wide one is used only when packets beyond it have been received
+			 * and it still leaves room for the control extension and a maximum size payload.
+			 */
+			const int wide = vchannel->wide_sequences;
+			const int reserved = (1 + sky_frame_get_arq_extension_length(EXTENSION_ARQ_CTRL, wide)) + (1 + sky_frame_get_arq_extension_length(EXTENSION_ARQ_SEQUENCE, wide)) + SKY_PAYLOAD_MAX_LEN;
+			const int sack_length = (int)sky_frame_get_arq_sack_length(mask, wide);
+			int sack_used = 0;
+			if ((mask >> (8 * sizeof(sky_arq_mask_t))) != 0 && sky_frame_get_space_left(tx_frame->frame) - sack_length >= reserved) {
+				sky_frame_add_extension_arq_sack(tx_frame, vchannel->rcvRing->head_sequence, mask, wide);
+				sack_used = 1;
+			}
+			else
+				sky_frame_add_extension_arq_request(tx_frame, vchannel->rcvRing->head_sequence, (sky_arq_mask_t)mask, wide);
 			vchannel->need_recall = 0;
 			ret = 1;
+
+			// Report one more window of the horizon beyond the 16 bit request, continuing from where the last frame left off.
+			const int covered = 1 + 8 * sizeof(sky_arq_mask_t);
+			if (!sack_used && extent > covered &&
+			    sky_frame_get_space_left(tx_frame->frame) - (int)sky_frame_get_arq_sack_length(~(sky_arq_wide_mask_t)0, wide) >= reserved) {
+				int from = (sky_arq_sequence_t)(vchannel->sack_sequence - vchannel->rcvRing->head_sequence);
+				if (from < covered || from > vchannel->rcvRing->horizon_width)
+					from = covered;
+				sky_arq_sequence_t window_start;
+				sky_arq_wide_mask_t window_mask;
+				int next = rcvRing_get_horizon_window(vchannel->rcvRing, from, &window_start, &window_mask);
+				if (next < 0 && from > covered)
+					next = rcvRing_get_horizon_window(vchannel->rcvRing, covered, &window_start, &window_mask);
+				if (next >= 0) {
+					// A mask without bits in its upper half is sent in the short form, covering only that half.
+					sky_frame_add_extension_arq_sack(tx_frame, window_start, window_mask, wide);
+					const int window_bits = (window_mask >> (8 * SKY_ARQ_SACK_MASK_MIN_BYTES)) != 0 ? 8 * SKY_ARQ_SACK_MASK_MAX_BYTES : 8 * SKY_ARQ_SACK_MASK_MIN_BYTES;
+					vchannel->sack_sequence = window_start + 1 + window_bits;
+				}
+			}
+		}
+
+		// Nothing new to send? Use the leftover window time to retransmit the oldest unacknowledged payload.
+		int speculative_sequence = sky_vc_get_speculative_resend(vchannel, config, now, frames_sent_in_this_vc_window);
+		if (speculative_sequence >= 0 && sendRing_schedule_resend(vchannel->sendRing, (sky_arq_sequence_t)speculative_sequence) == SKY_RET_OK) {
+			vchannel->speculative_resends_in_window++;
+			vchannel->speculative_sequence = (sky_arq_sequence_t)(speculative_sequence + 1);
 		}
 
 		// Add ARQ Control/Sync extension if we have something to send or if we have been idle for too long.
-		int payload_to_send = sendRing_count_packets_to_send(vchannel->sendRing, 1) > 0;
+		int parity_to_send = sky_vc_parity_pending(vchannel, config) && vchannel->sendRing->resend_count == 0;
+		int payload_to_send = sendRing_count_packets_to_send(vchannel->sendRing, 1) > 0 || parity_to_send;
 		int b0 = frames_sent_in_this_vc_window < config->arq.idle_frames_per_window;
 		int b1 = wrap_time_ticks(now - vchannel->last_ctrl_send_tick) > config->arq.idle_frame_threshold;
 		int b2 = wrap_time_ticks(now - vchannel->last_tx_tick) > config->arq.idle_frame_threshold;
 		int b3 = wrap_time_ticks(now - vchannel->last_rx_tick) > config->arq.idle_frame_threshold;
 		int b4 = vchannel->unconfirmed_payloads > 0;
 		if ((b0 && (b1 || b2 || b3 || b4)) || payload_to_send){
-			sky_frame_add_extension_arq_ctrl(tx_frame, vchannel->sendRing->tx_sequence, vchannel->rcvRing->head_sequence);
+
+			/*
+			 * With compressed headers only the 4 lowest bits of the sequences are sent. The peer resolves them
+			 * against its own receive head and send tail, so they are unambiguous only within 16 steps of the
+			 * acknowledged values. Periodic keep-alive controls are always sent in full to recover from drift.
+			 */
+			sky_arq_sequence_t unacked_tx = vchannel->sendRing->tx_sequence - vchannel->sendRing->tail_sequence;
+			sky_arq_sequence_t unreported_rx = vchannel->rcvRing->head_sequence - vchannel->last_ctrl_rx_sequence;
+			if (vchannel->header_compression && !b1 && unacked_tx < 16 && unreported_rx < 16)
+				sky_frame_add_extension_arq_ctrl_compressed(tx_frame, vchannel->sendRing->tx_sequence, vchannel->rcvRing->head_sequence);
+			else
+				sky_frame_add_extension_arq_ctrl(tx_frame, vchannel->sendRing->tx_sequence, vchannel->rcvRing->head_sequence, vchannel->wide_sequences);
+
+			vchannel->last_ctrl_rx_sequence = vchannel->rcvRing->head_sequence;
 			vchannel->last_ctrl_send_tick = now;
 			vchannel->unconfirmed_payloads = 0;
 			ret = 1;
 		}
 
-		// If we have something to be send copy it to frame.
+		/*
+		 * Send the parity of the last complete group before new packets so that a loss in it can be repaired
+		 * as soon as possible. Requested retransmissions still go first. If any packet of the group has already
+		 * been acknowledged or the parity doesn't fit, the group is skipped.
+		 */
+		if (parity_to_send) {
+			const sky_arq_sequence_t group_sequence = vchannel->parity_sequence;
+			const int group_size = config->arq.parity_group_size;
+			vchannel->parity_sequence += group_size;
+
+			uint8_t parity[SKY_PAYLOAD_MAX_LEN];
+			uint8_t length_parity;
+			int parity_length = sendRing_build_parity(vchannel->sendRing, vchannel->elementBuffer, group_sequence, group_size, parity, &length_parity);
+			const int required_length = parity_length + 1 + (int)sky_frame_get_arq_extension_length(EXTENSION_ARQ_PARITY, vchannel->wide_sequences);
+			if (parity_length > 0 && required_length <= sky_frame_get_space_left(tx_frame->frame)) {
+				sky_frame_add_extension_arq_parity(tx_frame, group_sequence, (uint8_t)group_size, length_parity, vchannel->wide_sequences);
+				memcpy(tx_frame->ptr, parity, parity_length);
+				tx_frame->ptr += parity_length;
+				tx_frame->frame->length += parity_length;
+				tx_frame->hdr->flag_has_payload = 1;
+				return 1;
+			}
+		}
+
+		/*
+		 * If we have something to be send copy it to frame.
+		 *
+		 * Retransmissions are rebuilt the same way as new packets, since the frame sequence, ARQ and TDD fields
+		 * change on every transmission. The payload sequence is recorded so that the FEC encoder can update the
+		 * parity of the earlier transmission for the changed bytes only. The HMAC is always calculated again.
+		 */
 		if (sendRing_count_packets_to_send(vchannel->sendRing, 1) > 0)
 		{
 			// Get length and sequence of the next packet to be sent. Ret should not be 0 since the sendRing_count_packets_to_send() > 0.
@@ -477,17 +1080,37 @@ int sky_vc_fill_frame(SkyVirtualChannel *vchannel, SkyConfig *config, SkyTransmi
 				return packet_length;
 
 			// Does the packet fit in remaining space?
-			int required_length = packet_length + (int)sizeof(ExtARQSeq) + 1;
+			int required_length = packet_length + (int)sky_frame_get_arq_extension_length(EXTENSION_ARQ_SEQUENCE, vchannel->wide_sequences) + 1;
 			if (required_length <= sky_frame_get_space_left(tx_frame->frame))
 			{
 				// Add ARQ sequence number extension
-				sky_frame_add_extension_arq_sequence(tx_frame, packet_sequence);
+				sky_frame_add_extension_arq_sequence(tx_frame, packet_sequence, vchannel->wide_sequences);
 
 				// Copy the packet to the frame
+				const sky_arq_sequence_t tx_sequence_before = vchannel->sendRing->tx_sequence;
+				const int nothing_in_flight = (tx_sequence_before == vchannel->sendRing->tail_sequence);
 				int read = sendRing_read_to_tx(vchannel->sendRing, vchannel->elementBuffer, tx_frame->ptr, &packet_sequence, 1);
 				SKY_ASSERT(read >= 0);
+				vchannel->sendRing->options[sendRing_get_recall_ring_index(vchannel->sendRing, packet_sequence)].tx_tick = now;
+
+				// Update round trip timing. New packets can be timed, retransmitted ones can't.
+				if (vchannel->sendRing->tx_sequence != tx_sequence_before) {
+					if (nothing_in_flight)
+						vchannel->retransmit_timer_tick = now;
+					if (!vchannel->rtt_probe_active) {
+						vchannel->rtt_probe_active = 1;
+						vchannel->rtt_probe_sequence = packet_sequence;
+						vchannel->rtt_probe_tick = now;
+					}
+				}
+				else {
+					if (vchannel->rtt_probe_active && vchannel->rtt_probe_sequence == packet_sequence)
+						vchannel->rtt_probe_active = 0;
+					vchannel->retransmit_timer_tick = now;
+				}
 
 				// Update the frame.
+				tx_frame->payload_sequence = packet_sequence;
 				tx_frame->ptr += read;
 				tx_frame->frame->length += read;
 				tx_frame->hdr->flags |= SKY_FLAG_HAS_PAYLOAD;
@@ -515,6 +1138,12 @@ int sky_vc_fill_frame(SkyVirtualChannel *vchannel, SkyConfig *config, SkyTransmi
 // Process a handshake recieved in a packet.
 int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uint32_t identifier)
 {
+	// Separate session options from the peer's state. Compression is used only if both ends offer it,
+	// wide sequences if either one needs them.
+	const uint8_t compression = vchannel->config->header_compression && (peer_state & ARQ_HANDSHAKE_FLAG_COMPRESSION);
+	const uint8_t wide_sequences = vchannel->config->wide_sequences || (peer_state & ARQ_HANDSHAKE_FLAG_WIDE_SEQUENCES);
+	peer_state &= ARQ_HANDSHAKE_STATE_MASK;
+
 	switch (vchannel->arq_state_flag) {
 	case ARQ_STATE_OFF:
 		/*
@@ -523,6 +1152,8 @@ int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uin
 		 */
 		sky_vc_wipe_to_arq_on_state(vchannel, identifier);
 		vchannel->handshake_send = 1; // Is this needed? Same thing done when wiping to on.
+		vchannel->header_compression = compression;
+		vchannel->wide_sequences = wide_sequences;
 		return 1;
 
 	case ARQ_STATE_IN_INIT:
@@ -534,12 +1165,17 @@ int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uin
 			// Matching session identifier so ARQ is now connected.
 			vchannel->arq_state_flag = ARQ_STATE_ON;
 			vchannel->handshake_send = 0;
+			vchannel->header_compression = compression;
+			vchannel->wide_sequences = wide_sequences;
+			vchannel->link_initiator = 1;
 			return 1;
 		}
 		else if (identifier > vchannel->arq_session_identifier) { // TODO: Overflow not considered!
 			// A newer identifier is received.
 			sky_vc_wipe_to_arq_on_state(vchannel, identifier);
 			vchannel->handshake_send = 1; // Is this needed?
+			vchannel->header_compression = compression;
+			vchannel->wide_sequences = wide_sequences;
 			return 1;
 		}
 		else {
@@ -553,6 +1189,7 @@ int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uin
 		 */
 		if (identifier == vchannel->arq_session_identifier) {
 			// Matching session identifier matches so this is just redundant re-transmitted handshake.
+			// A resync request is answered once our send ring has been realigned.
 			vchannel->handshake_send = 0;
 			if (peer_state == ARQ_STATE_IN_INIT)
 				vchannel->handshake_send = 1;
@@ -562,6 +1199,28 @@ int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uin
 			// The peer is trying to reconnect to us so just accept the new handshake.
 			sky_vc_wipe_to_arq_on_state(vchannel, identifier);
 			vchannel->handshake_send = 1; // Needed?
+			vchannel->header_compression = compression;
+			vchannel->wide_sequences = wide_sequences;
+			return 1;
+		}
+
+	case ARQ_STATE_RESYNC:
+		/*
+		 * We are waiting for the peer to realign to our receive ring.
+		 */
+		if (identifier == vchannel->arq_session_identifier) {
+			// Handshake response from the same session means the peer has realigned.
+			if (peer_state == ARQ_STATE_ON) {
+				vchannel->arq_state_flag = ARQ_STATE_ON;
+				return 1;
+			}
+			return 0;
+		}
+		else {
+			// The peer has started a new session meanwhile.
+			sky_vc_wipe_to_arq_on_state(vchannel, identifier);
+			vchannel->header_compression = compression;
+			vchannel->wide_sequences = wide_sequences;
 			return 1;
 		}
 	}
@@ -578,15 +1237,34 @@ int sky_vc_process_frame(SkyVirtualChannel *vchannel, SkyParsedFrame *parsed, sk
 	if (parsed->arq_handshake != NULL) {
 		const ExtARQHandshake *handshake = &parsed->arq_handshake->ARQHandshake;
 		sky_vc_handle_handshake(vchannel, handshake->peer_state, handshake->identifier);
+
+		/* Resync request of the current session. The control extension sent with it gives the peer's receive head.
+		 * The send ring is realigned once per resync, repeated requests only get the handshake response again. */
+		if ((handshake->peer_state & ARQ_HANDSHAKE_STATE_MASK) == ARQ_STATE_RESYNC && parsed->arq_ctrl != NULL &&
+		    handshake->identifier == vchannel->arq_session_identifier &&
+		    (vchannel->arq_state_flag == ARQ_STATE_ON || vchannel->arq_state_flag == ARQ_STATE_RESYNC)) {
+			if (vchannel->resync_realigned == 0) {
+				sky_arq_sequence_t rx_sequence = sky_frame_read_arq_sequence(parsed->arq_ctrl, 1, vchannel->sendRing->tail_sequence);
+				SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_INFO, "Peer requested ARQ resync to %d", (int)rx_sequence);
+				sky_vc_realign_to_peer(vchannel, rx_sequence, now);
+			}
+			else
+				vchannel->handshake_send = 1;
+		}
 	}
 
+	/* A control extension without a resync request shows that the peer has left RESYNC. */
+	if ((parsed->arq_ctrl != NULL || parsed->arq_ctrl_compressed != NULL) &&
+	    (parsed->arq_handshake == NULL || (parsed->arq_handshake->ARQHandshake.peer_state & ARQ_HANDSHAKE_STATE_MASK) != ARQ_STATE_RESYNC))
+		vchannel->resync_realigned = 0;
+
 	switch (vchannel->arq_state_flag) {
 	case ARQ_STATE_OFF:
 		/*
 		 * ARQ is off.
 		 * Just pass the payload to buffer.
 		 */
-		if (parsed->payload_len > 0)
+		if (parsed->payload_len > 0 && parsed->arq_parity == NULL)
 			sky_vc_push_rx_packet_monotonic(vchannel, parsed->payload, parsed->payload_len);
 		break;
 
@@ -596,6 +1274,16 @@ int sky_vc_process_frame(SkyVirtualChannel *vchannel, SkyParsedFrame *parsed, sk
 		 * Ignore rest of the frame due to state missmatch. */
 		break;
 
+	case ARQ_STATE_RESYNC:
+		/* Waiting for the peer to realign. Anything numbered before that is ignored,
+		 * but a control extension in sync with our receive ring shows that the peer is done. */
+		if (parsed->arq_ctrl == NULL)
+			break;
+		if (rcvRing_get_sequence_sync_status(vchannel->rcvRing, sky_frame_read_arq_sequence(parsed->arq_ctrl, 0, vchannel->rcvRing->head_sequence), vchannel->wide_sequences) == SKY_RET_RING_SEQUENCES_DETACHED)
+			break;
+		vchannel->arq_state_flag = ARQ_STATE_ON;
+		// fall through
+
 	case ARQ_STATE_ON:
 		/*
 		 * ARQ is on, so parse and handle ARQ related extension headers and
@@ -605,15 +1293,44 @@ int sky_vc_process_frame(SkyVirtualChannel *vchannel, SkyParsedFrame *parsed, sk
 		if (parsed->arq_ctrl != NULL)
 		{
 			// Get the sequence numbers from the ARQ control and update the sync.
-			sky_arq_sequence_t rx_sequence = sky_arq_seq_ntoh(parsed->arq_ctrl->ARQCtrl.rx_sequence);
-			sky_arq_sequence_t tx_sequence = sky_arq_seq_ntoh(parsed->arq_ctrl->ARQCtrl.tx_sequence);
+			// 8 bit sequences are resolved against our receive head and send tail.
+			sky_arq_sequence_t tx_sequence = sky_frame_read_arq_sequence(parsed->arq_ctrl, 0, vchannel->rcvRing->head_sequence);
+			sky_arq_sequence_t rx_sequence = sky_frame_read_arq_sequence(parsed->arq_ctrl, 1, vchannel->sendRing->tail_sequence);
 			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received ARQ CTRL %d %d", (int)rx_sequence, (int)tx_sequence);
 			sky_vc_update_tx_sync(vchannel, rx_sequence, now);
 			sky_vc_update_rx_sync(vchannel, tx_sequence, now);
 		}
 
+		/* Handle compressed ARQ control extension */
+		if (parsed->arq_ctrl_compressed != NULL)
+		{
+			/*
+			 * Resolve the 4-bit sequences forward from the last acknowledged values: peer's receive head from our
+			 * send tail and peer's transmit head from our receive head. If the peer was further than that,
+			 * the result falls short of the true value which only delays acknowledgement until the next full control.
+			 */
+			uint8_t sequences = parsed->arq_ctrl_compressed->ARQCtrlCompressed.sequences;
+			sky_arq_sequence_t tail = vchannel->sendRing->tail_sequence;
+			sky_arq_sequence_t head = vchannel->rcvRing->head_sequence;
+			sky_arq_sequence_t rx_sequence = tail + (sky_arq_sequence_t)(((sequences & 0x0F) - tail) & 0x0F);
+			sky_arq_sequence_t tx_sequence = head + (sky_arq_sequence_t)(((sequences >> 4) - head) & 0x0F);
+			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received compressed ARQ CTRL %d %d", (int)rx_sequence, (int)tx_sequence);
+			sky_vc_update_tx_sync(vchannel, rx_sequence, now);
+			sky_vc_update_rx_sync(vchannel, tx_sequence, now);
+		}
+
+		/* Handle ARQ parity */
+		if (parsed->payload_len > 0 && parsed->arq_parity != NULL)
+		{
+			uint8_t count, length_parity;
+			sky_arq_sequence_t group_sequence = sky_frame_read_arq_sequence(parsed->arq_parity, 0, vchannel->rcvRing->head_sequence);
+			sky_frame_read_arq_parity(parsed->arq_parity, &count, &length_parity);
+			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received ARQ parity %d+%d", (int)group_sequence, (int)count);
+			sky_vc_push_rx_parity(vchannel, parsed->payload, parsed->payload_len, group_sequence, count, length_parity, now);
+		}
+
 		/* Handle ARQ data packet */
-		if (parsed->payload_len > 0) // TODO: Only non-zero and positive lengths?
+		else if (parsed->payload_len > 0) // TODO: Only non-zero and positive lengths?
 		{
 			/* Make sure we received ARQ sequence number header. */
 			if (parsed->arq_sequence == NULL)
@@ -623,7 +1340,7 @@ int sky_vc_process_frame(SkyVirtualChannel *vchannel, SkyParsedFrame *parsed, sk
 			}
 
 			// Get the sequence number from the ARQ sequence header and push the packet to buffer.
-			sky_arq_sequence_t packet_sequence = sky_arq_seq_ntoh(parsed->arq_sequence->ARQSeq.sequence);
+			sky_arq_sequence_t packet_sequence = sky_frame_read_arq_sequence(parsed->arq_sequence, 0, vchannel->rcvRing->head_sequence);
 			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received ARQ packet %d", (int)packet_sequence);
 			sky_vc_push_rx_packet(vchannel, parsed->payload, parsed->payload_len, packet_sequence, now);
 		}
@@ -632,12 +1349,22 @@ int sky_vc_process_frame(SkyVirtualChannel *vchannel, SkyParsedFrame *parsed, sk
 		if (parsed->arq_request != NULL)
 		{
 			// Get the sequence numbers from the ARQ request and a mask for resends then schedule the resends.
-			sky_arq_sequence_t window_start = sky_arq_seq_ntoh(parsed->arq_request->ARQReq.sequence);
-			sky_arq_mask_t mask = sky_arq_mask_ntoh(parsed->arq_request->ARQReq.mask);
+			sky_arq_sequence_t window_start = sky_frame_read_arq_sequence(parsed->arq_request, 0, vchannel->sendRing->tail_sequence);
+			sky_arq_mask_t mask = sky_frame_read_arq_request_mask(parsed->arq_request);
 			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received ARQ Request: %d %04x", (int)window_start, (int)mask);
 			sendRing_schedule_resends_by_mask(vchannel->sendRing, window_start, mask);
 		}
 
+		/* Handle wide retransmit request received */
+		if (parsed->arq_sack != NULL)
+		{
+			sky_arq_sequence_t window_start = sky_frame_read_arq_sequence(parsed->arq_sack, 0, vchannel->sendRing->tail_sequence);
+			sky_arq_wide_mask_t mask;
+			int mask_bits = sky_frame_read_arq_sack_mask(parsed->arq_sack, &mask);
+			SKY_PRINTF(SKY_DIAG_ARQ | SKY_DIAG_DEBUG, "Received wide ARQ Request: %d %016llx", (int)window_start, (unsigned long long)mask);
+			sendRing_schedule_resends_by_wide_mask(vchannel->sendRing, window_start, mask, mask_bits);
+		}
+
 		break;
 
 	default: // INVALID STATE
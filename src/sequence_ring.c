@@ -25,6 +25,19 @@ static inline int ring_wrap(int idx, int len) {
 	return positive_modulo(idx, len);
 }
 
+// Number of 32-bit words in the resend bitmap of a ring with given length.
+#define RESEND_BITMAP_WORDS(len) (((len) + 31) / 32)
+
+// XOR a payload stored in the element buffer into target. Returns the length of the payload or negative error code.
+static int xor_stored_payload(SkyElementBuffer *elementBuffer, sky_element_idx_t idx, uint8_t *target)
+{
+	uint8_t tmp[SKY_PAYLOAD_MAX_LEN];
+	int length = sky_element_buffer_read(elementBuffer, tmp, idx, SKY_PAYLOAD_MAX_LEN);
+	for (int i = 0; i < length; i++)
+		target[i] ^= tmp[i];
+	return length;
+}
+
 
 
 
@@ -33,11 +46,12 @@ static inline int ring_wrap(int idx, int len) {
 //Wipe a recieve ring and reset the sequence counters. Also delete the payloads from the element buffer.
 void sky_rcv_ring_wipe(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t initial_sequence)
 {
-	//Loop through the ring and delete all elements.
-	for (int i = 0; i < rcvRing->length; ++i) {
+	//Only the readable packets and those received ahead of the head can be stored, the other slots are already empty.
+	const int occupied = rcvRing_count_readable_packets(rcvRing) + rcvRing_get_horizon_extent(rcvRing);
+	for (int i = 0; i < occupied; ++i) {
 
 		//Get the item from the ring with the current index.
-		RingItem* item = &rcvRing->buff[i];
+		RingItem* item = &rcvRing->buff[ring_wrap(rcvRing->tail + i, rcvRing->length)];
 
 		//Delete the payload from the element buffer if the item has an index and the element buffer is not NULL.
 		if ((item->idx != EB_NULL_IDX) && elementBuffer )
@@ -54,34 +68,47 @@ void sky_rcv_ring_wipe(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, sky
 	rcvRing->storage_count = 0;
 	rcvRing->head_sequence = initial_sequence;
 	rcvRing->tail_sequence = initial_sequence;
+	rcvRing->horizon_map = 0;
+	rcvRing->horizon_end = initial_sequence;
 }
 
-//Create a new receive ring.
-SkyRcvRing *sky_rcv_ring_create(int length, int horizon_width, sky_arq_sequence_t initial_sequence)
+//Create a new receive ring in the arena, or on the heap if it is NULL.
+SkyRcvRing *sky_rcv_ring_create(SkyArena *arena, int length, int horizon_width, sky_arq_sequence_t initial_sequence)
 {
-	if (length < 3 || horizon_width < 0)
+	if (length < 3 || length > ARQ_MAXIMUM_RING_LENGTH || horizon_width < 0)
 		return NULL;
 	if (length < horizon_width + 3)
 		return NULL;
 
 	//Allocate memory for the ring and the buffer.
-	SkyRcvRing* rcvRing = SKY_MALLOC(sizeof(SkyRcvRing));
-	RingItem* ring = SKY_MALLOC(sizeof(RingItem)*length);
+	SkyRcvRing* rcvRing = sky_allocate(arena, sizeof(SkyRcvRing));
+	RingItem* ring = sky_allocate(arena, sizeof(RingItem)*length);
 
-	//Set the memory to zero.
+	//Set the memory to zero and mark every slot empty. Later wipes only visit the slots in use.
+	memset(rcvRing, 0, sizeof(SkyRcvRing));
 	memset(ring, 0, sizeof(RingItem)*length);
+	for (int i = 0; i < length; ++i)
+		ring[i].idx = EB_NULL_IDX;
 
 	//Set the ring parameters.
 	rcvRing->length = length;
 	rcvRing->buff = ring;
 	//Set the horizon width. If the horizon width is larger than the maximum horizon width, set it to the maximum horizon width.
 	rcvRing->horizon_width = (horizon_width <= ARQ_MAXIMUM_HORIZON) ? horizon_width : ARQ_MAXIMUM_HORIZON;
+	rcvRing->element_owner = EB_NO_OWNER;
+	rcvRing->peak_storage_count = 0;
 
 	//Wipe the ring to make sure it is empty.
 	sky_rcv_ring_wipe(rcvRing, NULL, initial_sequence);
 	return rcvRing;
 }
 
+//Returns the memory taken from an arena by a receive ring.
+size_t sky_rcv_ring_required_memory(int length)
+{
+	return SKY_ARENA_SIZE(sizeof(SkyRcvRing)) + SKY_ARENA_SIZE(sizeof(RingItem) * length);
+}
+
 //Destroy a recieve ring. Frees the buffer and the ring.
 void sky_rcv_ring_destroy(SkyRcvRing* rcvRing)
 {
@@ -109,6 +136,11 @@ static int rcvRing_advance_head(SkyRcvRing* rcvRing)
 		//Advance the head.
 		rcvRing->head = ring_wrap(rcvRing->head + 1, rcvRing->length);
 		rcvRing->head_sequence++; // natural overflow
+		rcvRing->horizon_map >>= 1;
+		//With a horizon wider than the map, the packet that enters the map is already in the ring.
+		if (rcvRing->horizon_width >= ARQ_HORIZON_MAP_BITS &&
+		    rcvRing->buff[ring_wrap(rcvRing->head + ARQ_HORIZON_MAP_BITS, rcvRing->length)].idx != EB_NULL_IDX)
+			rcvRing->horizon_map |= (sky_arq_wide_mask_t)1 << (ARQ_HORIZON_MAP_BITS - 1);
 		//Get the item from the ring with the current index.
 		item = &rcvRing->buff[rcvRing->head];
 		//Increment the return value.
@@ -135,6 +167,31 @@ int rcvRing_read_next_received(SkyRcvRing* rcvRing, SkyElementBuffer* elementBuf
 	if (ret < 0)
 		return ret;
 
+	// Remove the payload from the ring.
+	return rcvRing_release_next_received(rcvRing, elementBuffer);
+}
+
+//Get read-only views to the next readable payload without copying it. Returns the number of spans, or a negative error code.
+int rcvRing_peek_next_received(SkyRcvRing* rcvRing, SkyElementBuffer* elementBuffer, struct sky_iovec* spans, int max_spans)
+{
+	//Check if there are packets to read.
+	if (rcvRing_count_readable_packets(rcvRing) == 0)
+		return SKY_RET_RING_EMPTY;
+
+	// Point the spans to the payload of the item at the tail of the ring.
+	return sky_element_buffer_get_spans(elementBuffer, rcvRing->buff[rcvRing->tail].idx, spans, max_spans);
+}
+
+//Remove the next readable payload from the ring. Returns 0 on success, or a negative error code.
+int rcvRing_release_next_received(SkyRcvRing* rcvRing, SkyElementBuffer* elementBuffer)
+{
+	//Check if there are packets to release.
+	if (rcvRing_count_readable_packets(rcvRing) == 0)
+		return SKY_RET_RING_EMPTY;
+
+	// Get the item at the tail of the ring.
+	RingItem* tail_item = &rcvRing->buff[rcvRing->tail];
+
 	// Wipe the item from the element buffer and the ring.
 	sky_element_buffer_delete(elementBuffer, tail_item->idx);
 	tail_item->idx = EB_NULL_IDX;
@@ -149,6 +206,49 @@ int rcvRing_read_next_received(SkyRcvRing* rcvRing, SkyElementBuffer* elementBuf
 	return SKY_RET_OK;
 }
 
+//Read readable payloads one after another to the arena. Returns the number of payloads read, or a negative error code.
+int rcvRing_read_received_batch(SkyRcvRing* rcvRing, SkyElementBuffer* elementBuffer, SkyPacketView* views, int max,
+                                uint8_t* arena, size_t arena_len)
+{
+	int count = rcvRing_count_readable_packets(rcvRing);
+	if (count > max)
+		count = max;
+
+	size_t used = 0;
+	int n = 0;
+	for (; n < count; n++) {
+		RingItem* item = &rcvRing->buff[ring_wrap(rcvRing->tail + n, rcvRing->length)];
+
+		// Stop at the first payload that doesn't fit. It stays in the ring for the next read.
+		const size_t space = arena_len - used;
+		int ret = sky_element_buffer_read(elementBuffer, arena + used, item->idx, (space > UINT16_MAX) ? UINT16_MAX : (unsigned int)space);
+		if (ret < 0) {
+			if (n == 0)
+				return ret;
+			break;
+		}
+
+		views[n].data = arena + used;
+		views[n].length = (unsigned int)ret;
+		views[n].sequence = item->sequence;
+		used += ret;
+
+		// Wipe the item from the element buffer and the ring.
+		sky_element_buffer_delete(elementBuffer, item->idx);
+		item->idx = EB_NULL_IDX;
+		item->sequence = 0;
+	}
+
+	// Move the tail past all of the read payloads at once.
+	if (n > 0) {
+		rcvRing->storage_count -= n;
+		rcvRing->tail = ring_wrap(rcvRing->tail + n, rcvRing->length);
+		rcvRing->tail_sequence += n; // natural overflow
+		rcvRing_advance_head(rcvRing);
+	}
+	return n;
+}
+
 //Pushes a payload received with "sequence". Returns how many steps the head advances (>=0) or negative error code.
 int rcvRing_push_rx_packet(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, const uint8_t *src, unsigned int length, sky_arq_sequence_t sequence)
 {
@@ -167,7 +267,8 @@ int rcvRing_push_rx_packet(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer,
 		return SKY_RET_RING_PACKET_ALREADY_IN;
 
 	// Store the payload in the element buffer.
-	int idx = sky_element_buffer_store(elementBuffer, src, length);
+	struct sky_iovec iov = { src, length };
+	int idx = sky_element_buffer_store_iov_for(elementBuffer, rcvRing->element_owner, &iov, 1);
 	if (idx < 0)
 		return idx;
 
@@ -175,8 +276,16 @@ int rcvRing_push_rx_packet(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer,
 	item->idx = idx;
 	item->sequence = sequence;
 
+	// Mark the packet present in the horizon. Head itself is not contained in the map.
+	if (diff > 0 && diff <= ARQ_HORIZON_MAP_BITS)
+		rcvRing->horizon_map |= (sky_arq_wide_mask_t)1 << (diff - 1);
+	if (diff >= rcvRing_get_horizon_extent(rcvRing))
+		rcvRing->horizon_end = sequence + 1;
+
 	// Increment the storage count and advance the head.
 	rcvRing->storage_count++;
+	if (rcvRing->storage_count > rcvRing->peak_storage_count)
+		rcvRing->peak_storage_count = rcvRing->storage_count;
 	int advanced = rcvRing_advance_head(rcvRing);
 	return advanced;
 }
@@ -184,41 +293,138 @@ int rcvRing_push_rx_packet(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer,
 
 int rcvRing_get_horizon_bitmap(SkyRcvRing* rcvRing)
 {
-	//Get the amount of to be checked from the horizon for the ring (Max 16).
-	int scan_count = (rcvRing->horizon_width < 16) ? rcvRing->horizon_width : 16;
+	//The presence map is kept up to date on push and head advance, so only the first 16 bits need to be picked.
+	return (sky_arq_mask_t)rcvRing->horizon_map;
+}
+
+sky_arq_wide_mask_t rcvRing_get_horizon_bitmap_wide(SkyRcvRing* rcvRing)
+{
+	return rcvRing->horizon_map;
+}
+
+int rcvRing_get_horizon_extent(SkyRcvRing* rcvRing)
+{
+	//Once the head has passed the last received packet, the end is behind it and nothing is ahead.
+	sky_arq_sequence_t extent = rcvRing->horizon_end - rcvRing->head_sequence;
+	return (extent <= rcvRing->horizon_width + 1) ? extent : 0;
+}
+
+int rcvRing_get_horizon_window(SkyRcvRing* rcvRing, int from, sky_arq_sequence_t* start, sky_arq_wide_mask_t* mask)
+{
+	const int extent = rcvRing_get_horizon_extent(rcvRing);
+
+	//Find the first missing packet.
+	int offset = (from > 0) ? from : 0;
+	while (offset < extent && rcvRing->buff[ring_wrap(rcvRing->head + offset, rcvRing->length)].idx != EB_NULL_IDX)
+		offset++;
+	if (offset >= extent)
+		return SKY_RET_RING_EMPTY;
+
+	//Mark the received packets and those not sent yet as far as we know.
+	*start = rcvRing->head_sequence + offset;
+	*mask = 0;
+	for (int i = 0; i < ARQ_HORIZON_MAP_BITS; i++) {
+		int o = offset + 1 + i;
+		if (o >= extent || rcvRing->buff[ring_wrap(rcvRing->head + o, rcvRing->length)].idx != EB_NULL_IDX)
+			*mask |= (sky_arq_wide_mask_t)1 << i;
+	}
+	return offset + 1 + ARQ_HORIZON_MAP_BITS;
+}
+
+/*
+Reconstruct the missing payload of a parity group. Only possible if exactly one payload of the group is missing
+and all the others are still stored in the ring, that is, not yet read by the upper layer.
+*/
+int rcvRing_reconstruct_from_parity(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t sequence, int count,
+                                    uint8_t length_parity, uint8_t *parity, unsigned int parity_length, sky_arq_sequence_t *missing)
+{
+	if (count < 1 || count > ARQ_HORIZON_MAP_BITS || parity_length > SKY_PAYLOAD_MAX_LEN)
+		return SKY_RET_RING_INVALID_SEQUENCE;
+
+	// Number of packets between tail and head. These are stored but not yet read.
+	const sky_arq_sequence_t readable = rcvRing->head_sequence - rcvRing->tail_sequence;
+
+	int n_missing = 0;
+	int length = length_parity;
+	for (int i = 0; i < count; i++) {
+		const sky_arq_sequence_t seq = sequence + i; // natural overflow
+		const sky_arq_sequence_t ahead_of_head = seq - rcvRing->head_sequence;
+		const sky_arq_sequence_t ahead_of_tail = seq - rcvRing->tail_sequence;
+
+		// Find the ring slot of the packet. Anything before tail has already been read and is gone.
+		int ring_idx;
+		if (ahead_of_head <= rcvRing->horizon_width)
+			ring_idx = ring_wrap(rcvRing->head + ahead_of_head, rcvRing->length);
+		else if (ahead_of_tail < readable)
+			ring_idx = ring_wrap(rcvRing->tail + ahead_of_tail, rcvRing->length);
+		else
+			return SKY_RET_RING_INVALID_SEQUENCE;
 
-	//Loop through the ring and set the i:th bit in the bitmap if the i:th packet can be read.
-	sky_arq_mask_t map = 0;
-	for (int i = 0; i < scan_count; ++i) { //HEAD is not contained in the mask.
-		//Get the item from the ring with the current index.
-		int ring_idx = ring_wrap(rcvRing->head + 1 + i, rcvRing->length);
 		RingItem* item = &rcvRing->buff[ring_idx];
-		//If the item has an index, set the i:th bit in the bitmap.
-		if (item->idx != EB_NULL_IDX)
-			map |= (1U << i);
+		if (item->idx == EB_NULL_IDX) {
+			// Single parity can only recover one loss.
+			if (++n_missing > 1)
+				return SKY_RET_RING_INVALID_SEQUENCE;
+			*missing = seq;
+			continue;
+		}
+
+		// Cancel the packet out of the parity.
+		int ret = xor_stored_payload(elementBuffer, item->idx, parity);
+		if (ret < 0)
+			return ret;
+		if ((unsigned int)ret > parity_length)
+			return SKY_RET_RING_INVALID_SEQUENCE;
+		length ^= ret;
 	}
 
-	return map;
+	if (n_missing == 0)
+		return SKY_RET_RING_PACKET_ALREADY_IN;
+	if ((unsigned int)length > parity_length)
+		return SKY_RET_RING_INVALID_SEQUENCE;
+	return length;
 }
 
 /*
 Get the sync status of the recieve ring.
 Returns 0 if everything is in sync, or a negative error code if the ring is out of sync by some packets or irreversibly.
 */
-int rcvRing_get_sequence_sync_status(SkyRcvRing *rcvRing, sky_arq_sequence_t peer_tx_head_sequence_by_ctrl)
+int rcvRing_get_sequence_sync_status(SkyRcvRing *rcvRing, sky_arq_sequence_t peer_tx_head_sequence_by_ctrl, int wide_sequences)
 {
 	//Recieve ring is in sync.
 	if (peer_tx_head_sequence_by_ctrl == rcvRing->head_sequence)
 		return SKY_RET_OK; // SKY_RET_RING_SEQUENCES_IN_SYNC;
 
-	//Recieve ring is out of sync, but can be resynced.
+	//Recieve ring is out of sync, but can be resynced. The peer can't be further ahead than it has packets in flight.
+	//Narrow sequences are resolved within ARQ_NARROW_SEQUENCE_WINDOW of the head, and so are the narrow rings limited.
 	sky_arq_sequence_t offset = peer_tx_head_sequence_by_ctrl - rcvRing->head_sequence;
-	if (offset <= ARQ_MAXIMUM_HORIZON)
+	const int max_offset = wide_sequences ? ARQ_MAXIMUM_RING_LENGTH - 1 : ARQ_NARROW_SEQUENCE_WINDOW;
+	if (offset <= max_offset)
 		return SKY_RET_RING_SEQUENCES_OUT_OF_SYNC;
 
 	//Recieve ring is irreversibly out of sync.
 	return SKY_RET_RING_SEQUENCES_DETACHED;
 }
+
+//Delete the packets received ahead of the head. Readable packets are kept. Returns the number of packets deleted.
+int rcvRing_drop_horizon(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer)
+{
+	int n_dropped = 0;
+	//The horizon never reaches the tail, so only packets that have not been readable yet are touched.
+	for (int i = 0; i <= rcvRing->horizon_width; i++) {
+		RingItem* item = &rcvRing->buff[ring_wrap(rcvRing->head + i, rcvRing->length)];
+		if (item->idx == EB_NULL_IDX)
+			continue;
+		sky_element_buffer_delete(elementBuffer, item->idx);
+		item->idx = EB_NULL_IDX;
+		item->sequence = 0;
+		rcvRing->storage_count--;
+		n_dropped++;
+	}
+	rcvRing->horizon_map = 0;
+	rcvRing->horizon_end = rcvRing->head_sequence;
+	return n_dropped;
+}
 //===== RCV RING =======================================================================================================
 
 
@@ -229,19 +435,23 @@ int rcvRing_get_sequence_sync_status(SkyRcvRing *rcvRing, sky_arq_sequence_t pee
 //Wipe a send ring and reset the values of the ring to their initial values. Also delete the payloads from the element buffer.
 void sky_send_ring_wipe(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t initial_sequence)
 {
-	//Loop through the ring and delete all elements.
-	for (int i = 0; i < sendRing->length; ++i) {
-		RingItem* item = &sendRing->buff[i];
+	//Only the slots from tail to head are in use, the others are already empty. The options are set on push.
+	const int stored = ring_wrap(sendRing->head - sendRing->tail, sendRing->length);
+	for (int i = 0; i < stored; ++i) {
+		const int ring_idx = ring_wrap(sendRing->tail + i, sendRing->length);
+		RingItem* item = &sendRing->buff[ring_idx];
 		//If the item has an index and the element buffer is not NULL, delete the payload from the element buffer.
 		if ((item->idx != EB_NULL_IDX) && elementBuffer) {
 			sky_element_buffer_delete(elementBuffer, item->idx);
 		}
-		//Reset the item.
+		//Reset the item and unschedule it.
 		item->idx = EB_NULL_IDX;
 		item->sequence = 0;
+		sendRing->resend_pending[ring_idx / 32] &= ~((uint32_t)1 << (ring_idx % 32));
 	}
-	// Wipe the resend list..
-	memset(sendRing->resend_list, 0, sizeof(sendRing->resend_list));
+	// Wipe the resend schedule.
+	sendRing->resend_fifo_head = 0;
+	sendRing->resend_fifo_count = 0;
 	//Reset the ring counters.
 	sendRing->head = 0;
 	sendRing->tx_head = 0;
@@ -251,29 +461,52 @@ void sky_send_ring_wipe(SkySendRing *sendRing, SkyElementBuffer *elementBuffer,
 	sendRing->tail_sequence = initial_sequence;
 	sendRing->tx_sequence = initial_sequence;
 	sendRing->resend_count = 0;
+	memset(sendRing->queued_per_priority, 0, sizeof(sendRing->queued_per_priority));
 }
 
-//Create a new send ring.
-SkySendRing *sky_send_ring_create(int length, sky_arq_sequence_t initial_sequence)
+//Create a new send ring in the arena, or on the heap if it is NULL.
+SkySendRing *sky_send_ring_create(SkyArena *arena, int length, sky_arq_sequence_t initial_sequence)
 {
-	if(length < 4)
+	if(length < 4 || length > ARQ_MAXIMUM_RING_LENGTH)
 		return NULL;
 	//Allocate memory for the ring and the buffer.
-	SkySendRing* sendRing = SKY_MALLOC(sizeof(SkySendRing));
-	RingItem* ring = SKY_MALLOC(sizeof(RingItem)*length);
-	//Set the memory to zero.
+	SkySendRing* sendRing = sky_allocate(arena, sizeof(SkySendRing));
+	RingItem* ring = sky_allocate(arena, sizeof(RingItem)*length);
+	//Set the memory to zero and mark every slot empty. Later wipes only visit the slots in use.
+	memset(sendRing, 0, sizeof(SkySendRing));
 	memset(ring, 0, sizeof(RingItem)*length);
+	for (int i = 0; i < length; ++i)
+		ring[i].idx = EB_NULL_IDX;
 	//Set the ring parameters.
 	sendRing->buff = ring;
 	sendRing->length = length;
+	//Allocate the resend schedule. Every packet in the ring can be scheduled at the same time.
+	sendRing->resend_pending = sky_allocate(arena, RESEND_BITMAP_WORDS(length) * sizeof(uint32_t));
+	sendRing->resend_fifo = sky_allocate(arena, sizeof(sky_arq_sequence_t) * length);
+	sendRing->options = sky_allocate(arena, sizeof(SendItemOptions) * length);
+	memset(sendRing->resend_pending, 0, RESEND_BITMAP_WORDS(length) * sizeof(uint32_t));
+	memset(sendRing->options, 0, sizeof(SendItemOptions) * length);
+	sendRing->element_owner = EB_NO_OWNER;
+	sendRing->peak_storage_count = 0;
 	//Wipe the ring to make sure it is empty.
 	sky_send_ring_wipe(sendRing, NULL, initial_sequence);
 	return sendRing;
 }
 
+//Returns the memory taken from an arena by a send ring.
+size_t sky_send_ring_required_memory(int length)
+{
+	return SKY_ARENA_SIZE(sizeof(SkySendRing)) + SKY_ARENA_SIZE(sizeof(RingItem) * length) +
+	       SKY_ARENA_SIZE(RESEND_BITMAP_WORDS(length) * sizeof(uint32_t)) +
+	       SKY_ARENA_SIZE(sizeof(sky_arq_sequence_t) * length) + SKY_ARENA_SIZE(sizeof(SendItemOptions) * length);
+}
+
 //Destroy a send ring. Frees the buffer and the ring.
 void sky_send_ring_destroy(SkySendRing* sendRing)
 {
+	SKY_FREE(sendRing->resend_pending);
+	SKY_FREE(sendRing->resend_fifo);
+	SKY_FREE(sendRing->options);
 	SKY_FREE(sendRing->buff);
 	SKY_FREE(sendRing);
 }
@@ -319,13 +552,27 @@ int sendRing_get_recall_ring_index(SkySendRing *sendRing, sky_arq_sequence_t rec
 
 //Pushes a new packet to be sent. Returns the sequence it is associated with, or a negative error code.
 int sendRing_push_packet_to_send(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const uint8_t* payload, unsigned int length)
+{
+	struct sky_iovec iov = { payload, length };
+	return sendRing_push_packet_to_send_iov(sendRing, elementBuffer, &iov, 1);
+}
+
+//Push a new packet gathered from fragments to the ring. Returns the sequence number of the packet, or a negative error code.
+int sendRing_push_packet_to_send_iov(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* iov, int iovcnt)
+{
+	return sendRing_push_packet_with_options(sendRing, elementBuffer, iov, iovcnt, 0, 0, 0);
+}
+
+//Push a new packet with delivery options. Returns the sequence number of the packet, or a negative error code.
+int sendRing_push_packet_with_options(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* iov, int iovcnt,
+                                      uint8_t priority, sky_tick_t ttl, sky_tick_t now)
 {
 	//If the ring is full, return a negative error code.
 	if (sendRing_is_full(sendRing))
 		return SKY_RET_RING_RING_FULL;
 
-	//Store the payload in the element buffer. If the payload could not be stored, return a negative error code.
-	int idx = sky_element_buffer_store(elementBuffer, payload, length);
+	//Store the fragments in the element buffer. If the payload could not be stored, return a negative error code.
+	int idx = sky_element_buffer_store_iov_for(elementBuffer, sendRing->element_owner, iov, iovcnt);
 	if (idx < 0)
 		return idx;
 
@@ -335,38 +582,122 @@ int sendRing_push_packet_to_send(SkySendRing* sendRing, SkyElementBuffer* elemen
 	//Set the item parameters.
 	item->idx = idx;
 	item->sequence = sendRing->head_sequence;
+	sendRing->options[sendRing->head].push_tick = now;
+	sendRing->options[sendRing->head].ttl = ttl;
+	sendRing->options[sendRing->head].tx_tick = now;
+	sendRing->options[sendRing->head].priority = (priority < SKY_SEND_PRIORITY_CLASSES) ? priority : SKY_SEND_PRIORITY_CLASSES - 1;
+	sendRing->queued_per_priority[sendRing->options[sendRing->head].priority]++;
 
 	//Advance the head.
 	sendRing->storage_count++;
+	if (sendRing->storage_count > sendRing->peak_storage_count)
+		sendRing->peak_storage_count = sendRing->storage_count;
 	sendRing->head = ring_wrap(sendRing->head+1, sendRing->length);
 	sendRing->head_sequence++; // natural overflow
 	return item->sequence;
 }
 
+//Push several packets to the ring, all or none of them. Returns the sequence of the first packet, or a negative error code.
+int sendRing_push_batch(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* packets, int count)
+{
+	//Admit the batch only if every packet has a slot and an element chain.
+	if (sendRing_count_free_send_slots(sendRing) < count)
+		return SKY_RET_RING_RING_FULL;
+	if (!sky_element_buffer_can_store_all(elementBuffer, sendRing->element_owner, packets, count))
+		return SKY_RET_EBUFFER_NO_SPACE;
+
+	//Space was checked above so none of the pushes can fail.
+	const sky_arq_sequence_t first_sequence = sendRing->head_sequence;
+	for (int i = 0; i < count; i++) {
+		int ret = sendRing_push_packet_to_send_iov(sendRing, elementBuffer, &packets[i], 1);
+		SKY_ASSERT(ret >= 0);
+		(void)ret;
+	}
+	return first_sequence;
+}
+
 //Schedule a sequence for retransmission. Returns 0 if successful, or a negative error code.
-int sendRing_schedule_resend(SkySendRing *sendRing, sky_arq_sequence_t sequence)
+//Check if the ring slot is scheduled for resend.
+static int sendRing_resend_is_pending(SkySendRing *sendRing, int ring_idx)
 {
-	// If the resend list is full, return a negative error code.
-	if (sendRing->resend_count >= ARQ_RESEND_SCHEDULE_DEPTH)
-		return SKY_RET_RING_RESEND_FULL;
+	return (sendRing->resend_pending[ring_idx / 32] >> (ring_idx % 32)) & 1;
+}
 
+//Remove the ring slot from the resend schedule.
+static void sendRing_resend_clear_pending(SkySendRing *sendRing, int ring_idx)
+{
+	if (!sendRing_resend_is_pending(sendRing, ring_idx))
+		return;
+	sendRing->resend_pending[ring_idx / 32] &= ~((uint32_t)1 << (ring_idx % 32));
+	sendRing->resend_count--;
+
+	//If nothing is pending anymore, everything left in the FIFO is stale.
+	if (sendRing->resend_count == 0) {
+		sendRing->resend_fifo_head = 0;
+		sendRing->resend_fifo_count = 0;
+	}
+}
+
+//Drop the sequences from the FIFO which are no longer scheduled. Used only when the FIFO fills up.
+static void sendRing_compact_resend_fifo(SkySendRing *sendRing)
+{
+	int n = 0;
+	for (int i = 0; i < sendRing->resend_fifo_count; i++) {
+		sky_arq_sequence_t seq = sendRing->resend_fifo[ring_wrap(sendRing->resend_fifo_head + i, sendRing->length)];
+		int ring_idx = sendRing_get_recall_ring_index(sendRing, seq);
+		if (ring_idx >= 0 && sendRing_resend_is_pending(sendRing, ring_idx))
+			sendRing->resend_fifo[ring_wrap(sendRing->resend_fifo_head + n++, sendRing->length)] = seq;
+	}
+	sendRing->resend_fifo_count = n;
+}
+
+int sendRing_schedule_resend(SkySendRing *sendRing, sky_arq_sequence_t sequence)
+{
 	// Check if the sequence can be scheduled for retransmission. If not, return a negative error code.
-	if (!sendRing_can_recall(sendRing, sequence))
+	int ring_idx = sendRing_get_recall_ring_index(sendRing, sequence);
+	if (ring_idx < 0)
 		return SKY_RET_RING_CANNOT_RECALL;
 
-	// Check if the sequence is already in the resend list.
-	for (unsigned int i = 0; i < sendRing->resend_count; i++) {
-		if (sendRing->resend_list[i] == sequence)
-			return SKY_RET_OK;
-	}
+	// Check if the sequence is already scheduled.
+	if (sendRing_resend_is_pending(sendRing, ring_idx))
+		return SKY_RET_OK;
 
-	// Add the sequence to the resend list.
-	sendRing->resend_list[sendRing->resend_count++] = sequence;
+	// Make room by dropping stale sequences. Only the packets in the ring can be pending so this always succeeds.
+	if (sendRing->resend_fifo_count >= sendRing->length)
+		sendRing_compact_resend_fifo(sendRing);
+	if (sendRing->resend_fifo_count >= sendRing->length)
+		return SKY_RET_RING_RESEND_FULL;
+
+	// Add the sequence to the end of the FIFO and mark the slot pending.
+	sendRing->resend_fifo[ring_wrap(sendRing->resend_fifo_head + sendRing->resend_fifo_count, sendRing->length)] = sequence;
+	sendRing->resend_fifo_count++;
+	sendRing->resend_pending[ring_idx / 32] |= (uint32_t)1 << (ring_idx % 32);
+	sendRing->resend_count++;
 	return SKY_RET_OK;
 }
 
+//Get the sequence that will be resent next. Sequences which have been acknowledged meanwhile are dropped from the FIFO.
+int sendRing_get_next_resend_sequence(SkySendRing *sendRing)
+{
+	while (sendRing->resend_fifo_count > 0) {
+		sky_arq_sequence_t seq = sendRing->resend_fifo[sendRing->resend_fifo_head];
+		int ring_idx = sendRing_get_recall_ring_index(sendRing, seq);
+		if (ring_idx >= 0 && sendRing_resend_is_pending(sendRing, ring_idx))
+			return seq;
+
+		sendRing->resend_fifo_head = ring_wrap(sendRing->resend_fifo_head + 1, sendRing->length);
+		sendRing->resend_fifo_count--;
+	}
+	return SKY_RET_RING_EMPTY;
+}
+
 
 int sendRing_schedule_resends_by_mask(SkySendRing *sendRing, sky_arq_sequence_t sequence, sky_arq_mask_t mask)
+{
+	return sendRing_schedule_resends_by_wide_mask(sendRing, sequence, mask, 8 * sizeof(sky_arq_mask_t));
+}
+
+int sendRing_schedule_resends_by_wide_mask(SkySendRing *sendRing, sky_arq_sequence_t sequence, sky_arq_wide_mask_t mask, int mask_bits)
 {
 	int ret;
 
@@ -376,8 +707,8 @@ int sendRing_schedule_resends_by_mask(SkySendRing *sendRing, sky_arq_sequence_t
 	sequence++;
 
 	// Loop through the mask and schedule all the sequences that are marked absence for retransmission.
-	sky_arq_mask_t select_mask = 0x01;
-	for (unsigned int i = 0; i < 8 * sizeof(sky_arq_mask_t); i++) {
+	sky_arq_wide_mask_t select_mask = 0x01;
+	for (int i = 0; i < mask_bits; i++) {
 		if ((mask & select_mask) == 0) {
 			if ((ret = sendRing_schedule_resend(sendRing, sequence)) != SKY_RET_OK)
 				return ret;
@@ -409,22 +740,18 @@ int sendRing_count_packets_to_send(SkySendRing* sendRing, int include_resend)
 	return n;
 }
 
-//Pop the first sequence in the resend list. Returns the popped sequence or a negative error code.
+//Pop the first sequence in the resend schedule. Returns the popped sequence or a negative error code.
 static int sendRing_pop_resend_sequence(SkySendRing *sendRing)
 {
-	// Nothing to resend.
-	if (sendRing->resend_count == 0)
-		return SKY_RET_RING_EMPTY;
+	//Get the first sequence still scheduled.
+	int r = sendRing_get_next_resend_sequence(sendRing);
+	if (r < 0)
+		return r;
 
-	//Get the first sequence in the resend list.
-	sky_arq_sequence_t r = sendRing->resend_list[0];
-
-	//Decrement the resend count.
-	sendRing->resend_count--;
-
-	//If there are still sequences in the resend list, shift them one step.
-	for (unsigned int i = 1; i < sendRing->resend_count; i++)
-		sendRing->resend_list[i - 1] = sendRing->resend_list[i];
+	//Remove it from the FIFO and the bitmap.
+	sendRing->resend_fifo_head = ring_wrap(sendRing->resend_fifo_head + 1, sendRing->length);
+	sendRing->resend_fifo_count--;
+	sendRing_resend_clear_pending(sendRing, sendRing_get_recall_ring_index(sendRing, r));
 
 	//Return the popped sequence.
 	return r;
@@ -449,6 +776,7 @@ static int sendRing_read_new_packet_to_tx_(SkySendRing *sendRing, SkyElementBuff
 	*sequence = sendRing->tx_sequence;
 
 	// Advance the head and tx_sequence.
+	sendRing->queued_per_priority[sendRing->options[sendRing->tx_head].priority]--;
 	sendRing->tx_head = ring_wrap(sendRing->tx_head+1, sendRing->length);
 	sendRing->tx_sequence++; // Natural overflow
 
@@ -503,6 +831,61 @@ int sendRing_read_to_tx(SkySendRing *sendRing, SkyElementBuffer *elementBuffer,
 	return read;
 }
 
+//Move the packet at ring index 'from' to the first untransmitted slot. Packets in between shift one slot forward.
+static void sendRing_move_to_tx_head(SkySendRing *sendRing, int from)
+{
+	RingItem item = sendRing->buff[from];
+	SendItemOptions options = sendRing->options[from];
+	while (from != sendRing->tx_head) {
+		int prev = ring_wrap(from - 1, sendRing->length);
+		sendRing->buff[from].idx = sendRing->buff[prev].idx;
+		sendRing->options[from] = sendRing->options[prev];
+		from = prev;
+	}
+	// Sequences belong to the slots, only the payloads move.
+	sendRing->buff[from].idx = item.idx;
+	sendRing->options[from] = options;
+}
+
+//Bring the highest priority packet to the front and drop expired ones. Returns the number of packets dropped.
+int sendRing_prepare_unreliable_tx(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_tick_t now)
+{
+	int dropped = 0;
+	while (sendRing_count_packets_to_send(sendRing, 0) > 0) {
+		//Highest class with packets waiting. Only if the front is of a lower class, find the first packet of it.
+		int top = SKY_SEND_PRIORITY_CLASSES - 1;
+		while (sendRing->queued_per_priority[top] == 0)
+			top--;
+		if (sendRing->options[sendRing->tx_head].priority != top) {
+			int best = ring_wrap(sendRing->tx_head + 1, sendRing->length);
+			while (sendRing->options[best].priority != top)
+				best = ring_wrap(best + 1, sendRing->length);
+			sendRing_move_to_tx_head(sendRing, best);
+		}
+
+		//Send it if it's still valid.
+		const SendItemOptions *options = &sendRing->options[sendRing->tx_head];
+		if (options->ttl == 0 || wrap_time_ticks(now - options->push_tick) <= options->ttl)
+			break;
+
+		//Expired. Pass it as if it was sent and release it with the tail.
+		sendRing->queued_per_priority[top]--;
+		sendRing->tx_head = ring_wrap(sendRing->tx_head + 1, sendRing->length);
+		sendRing->tx_sequence++; // Natural overflow
+		sendRing_clean_tail_up_to(sendRing, elementBuffer, sendRing->tx_sequence);
+		dropped++;
+	}
+	return dropped;
+}
+
+//Count the untransmitted packets of each priority class.
+void sendRing_count_queued_priorities(SkySendRing *sendRing)
+{
+	memset(sendRing->queued_per_priority, 0, sizeof(sendRing->queued_per_priority));
+	for (int i = sendRing->tx_head; i != sendRing->head; i = ring_wrap(i + 1, sendRing->length))
+		sendRing->queued_per_priority[sendRing->options[i].priority]++;
+}
+
 //Writes the sequence and the length of the next packet to be sent to the pointers size and sequence.
 int sendRing_peek_next_tx_size_and_sequence(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, int include_resend, sky_arq_sequence_t *sequence)
 {
@@ -512,8 +895,9 @@ int sendRing_peek_next_tx_size_and_sequence(SkySendRing *sendRing, SkyElementBuf
 	}
 	//If include_resend is not 0, try to read a packet that is scheduled for retransmission.
 	if (include_resend && (sendRing->resend_count > 0)) {
-		//Get the ïndex of the first sequence in the resend list.
-		int idx = sendRing_get_recall_ring_index(sendRing, sendRing->resend_list[0]);
+		//Get the index of the first sequence in the resend schedule.
+		int seq = sendRing_get_next_resend_sequence(sendRing);
+		int idx = (seq >= 0) ? sendRing_get_recall_ring_index(sendRing, seq) : seq;
 		//If the index was found, get the length of the payload from the element buffer with the index given by the item.
 		if (idx >= 0) {
 			RingItem* item = &sendRing->buff[idx];
@@ -537,6 +921,33 @@ int sendRing_peek_next_tx_size_and_sequence(SkySendRing *sendRing, SkyElementBuf
 }
 
 
+//Calculate XOR parity over transmitted payloads. Returns the parity length, or a negative error code.
+int sendRing_build_parity(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t sequence, int count,
+                          uint8_t *target, uint8_t *length_parity)
+{
+	memset(target, 0, SKY_PAYLOAD_MAX_LEN);
+	int parity_length = 0;
+	uint8_t lengths = 0;
+
+	for (int i = 0; i < count; i++) {
+		// Only transmitted and not yet acknowledged packets are available.
+		int ring_idx = sendRing_get_recall_ring_index(sendRing, sequence + i);
+		if (ring_idx < 0)
+			return ring_idx;
+
+		int length = xor_stored_payload(elementBuffer, sendRing->buff[ring_idx].idx, target);
+		if (length < 0)
+			return length;
+		if (length > parity_length)
+			parity_length = length;
+		lengths ^= (uint8_t)length;
+	}
+
+	*length_parity = lengths;
+	return parity_length;
+}
+
+
 //Clears the tail of the ring up to the sequence given by new_tail_sequence. Returns the number of payloads cleared or a negative error code.
 int sendRing_clean_tail_up_to(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t new_tail_sequence)
 {
@@ -551,6 +962,8 @@ int sendRing_clean_tail_up_to(SkySendRing *sendRing, SkyElementBuffer *elementBu
 	while (sendRing->tail_sequence != new_tail_sequence) {
 		//Get the item at the tail.
 		RingItem* tail_item = &sendRing->buff[sendRing->tail];
+		//Acknowledged packet doesn't need to be resent anymore.
+		sendRing_resend_clear_pending(sendRing, sendRing->tail);
 		//Delete the payload from the element buffer that is associated with the item.
 		sky_element_buffer_delete(elementBuffer, tail_item->idx);
 		//Reset the item.
@@ -565,4 +978,24 @@ int sendRing_clean_tail_up_to(SkySendRing *sendRing, SkyElementBuffer *elementBu
 	}
 	return n_cleared; //the number of payloads cleared.
 }
+
+//Renumber the stored packets to start from new_tail_sequence and schedule all of them to be transmitted again.
+void sendRing_realign(SkySendRing *sendRing, sky_arq_sequence_t new_tail_sequence)
+{
+	sky_arq_sequence_t shift = new_tail_sequence - sendRing->tail_sequence;
+	for (int i = sendRing->tail; i != sendRing->head; i = ring_wrap(i + 1, sendRing->length))
+		sendRing->buff[i].sequence += shift; // natural overflow
+
+	//Everything from the tail is sent again in order, so earlier resend requests are void.
+	memset(sendRing->resend_pending, 0, RESEND_BITMAP_WORDS(sendRing->length) * sizeof(uint32_t));
+	sendRing->resend_fifo_head = 0;
+	sendRing->resend_fifo_count = 0;
+	sendRing->resend_count = 0;
+
+	sendRing->tx_head = sendRing->tail;
+	sendRing_count_queued_priorities(sendRing);
+	sendRing->tail_sequence = new_tail_sequence;
+	sendRing->tx_sequence = new_tail_sequence;
+	sendRing->head_sequence += shift; // natural overflow
+}
 //===== SEND RING ======================================================================================================
@@ -59,6 +59,9 @@ typedef struct {
 #define SKY_CONFIG_FLAG_REQUIRE_SEQUENCE         (0b0100)
 #define SKY_CONFIG_FLAG_USE_CRC32                (0b1000)
 
+/* Size classes of the slab element buffer of a virtual channel */
+#define SKY_VC_SLAB_CLASSES                      3
+
 /*
  * Per virtual channel configurations
  */
@@ -78,11 +81,59 @@ typedef struct {
 	/* Is authentication code (HMAC) required for the virtual channel */
 	uint8_t require_authentication;
 
+	/* Boolean toggle for whether compressed frame headers are offered in the ARQ handshake.
+	 * Compression is used only when both peers enable it. The identity is then replaced with
+	 * a link ID and the ARQ/TDD control fields are sent relative to the last acknowledged values. */
+	uint8_t header_compression;
+
+	/* Boolean toggle for whether 16 bit ARQ sequences are requested in the ARQ handshake. They are used if either
+	 * peer requests them, otherwise the sequences are sent with 8 bits. 8 bits can't tell apart more than 127
+	 * packets in flight, so this is turned on automatically for rings longer than that. */
+	uint8_t wide_sequences;
+
+	/* Boolean toggle for storing payloads preferably in runs of adjacent elements of the element buffer
+	 * instead of whichever elements were freed last. See EB_ALLOC_CONTIGUOUS. */
+	uint8_t contiguous_allocation;
+
+	/* Boolean toggle for keeping the element links apart from the payload data in the element buffer.
+	 * See EB_LAYOUT_SPLIT. Most useful together with contiguous_allocation. */
+	uint8_t split_element_layout;
+
+	/* Elements of the shared element pool guaranteed to and at most held by the virtual channel.
+	 * 0 maximum for no limit other than the pool. Ignored unless SkyPoolConfig element_count is set. */
+	int32_t pool_minimum_elements;
+	int32_t pool_maximum_elements;
+
+	/* Element counts of the size classes of 32, 96 and SKY_PAYLOAD_MAX_LEN + 2 usable bytes. If any is set, the
+	 * virtual channel stores its payloads in a slab element buffer of these classes instead of usable_element_size
+	 * elements. Classes of 0 elements are left out. Not used with the shared element pool. */
+	int32_t slab_element_counts[SKY_VC_SLAB_CLASSES];
+
 	//uint8_t tx_key, rx_key;
 
 } SkyVCConfig;
 
 
+/*
+ * Shared element pool configuration
+ */
+typedef struct {
+
+	/* Number of elements in one element buffer shared by all virtual channels. Each virtual channel can borrow
+	 * the elements the others are not using, within its pool_minimum_elements and pool_maximum_elements.
+	 * 0 gives every virtual channel its own buffer, sized for each of its ring slots holding a maximum size payload. */
+	int32_t element_count;
+
+	/* Usable size of single element in the shared buffer. Used instead of the usable_element_size of the virtual channels. */
+	int usable_element_size;
+
+	/* Allocation policy and layout of the shared buffer. Used instead of those of the virtual channels. */
+	uint8_t contiguous_allocation;
+	uint8_t split_element_layout;
+
+} SkyPoolConfig;
+
+
 /*
  * HMAC configurations
  */
@@ -117,6 +168,20 @@ typedef struct
 	/* How many idle frames are created per window per virtual channel where ARQ is active. */
 	int8_t idle_frames_per_window;
 
+	/* How many unacknowledged payloads a virtual channel may retransmit per window without being asked,
+	 * when it has nothing else to send. The oldest ones are sent first. 0 disables speculative retransmissions. */
+	int8_t speculative_resends_per_window;
+
+	/* Number of consecutive payloads covered by one XOR parity payload. A parity is sent after each group, so the
+	 * peer can recover one lost payload per group without a retransmit request, at the cost of 1/parity_group_size
+	 * extra airtime. Can be changed while the link is running, for example based on the observed loss. 0 disables. */
+	int8_t parity_group_size;
+
+	/* Number of RS codewords of transmitted payload frames kept, so that a retransmission only updates the parity for
+	 * the bytes that changed instead of encoding the whole frame again. Each one takes about 260 bytes and a nonzero
+	 * value adds a 7 KB parity table. Used only by the sky_tx_with_fec family. 0 disables. */
+	int16_t fec_cache_frames;
+
 } SkyARQConfig;
 
 
@@ -132,6 +197,7 @@ struct sky_conf {
 	SkyHMACConfig	hmac; // HMAC Configuration
 	SkyVCConfig     vc[SKY_NUM_VIRTUAL_CHANNELS]; // Virtual channel configurations
 	SkyARQConfig    arq; // Automatic repeat request configurations
+	SkyPoolConfig   pool; // Shared element pool configuration
 	uint8_t         identity[SKY_MAX_IDENTITY_LEN]; // Identity
 	unsigned int    identity_len; // Length of identity in bytes
 };
@@ -109,8 +109,8 @@ struct sky_diag
 };
 
 
-/* Allocate and initialize a new diagnostics object */
-SkyDiagnostics* sky_diag_create();
+/* Allocate and initialize a new diagnostics object from the arena, or from the heap if 'arena' is NULL */
+SkyDiagnostics* sky_diag_create(SkyArena* arena);
 
 /* Destroy and free the diagnostics object */
 void sky_diag_destroy(SkyDiagnostics* diag);
@@ -11,6 +11,33 @@
 #define EB_NULL_IDX                 (EB_MAX_ELEMENT_COUNT + 2) // Index used for null pointer.
 #define EB_LEN_BYTES                ((int)sizeof(sky_element_length_t)) // Length of the element buffer in bytes.
 
+/* Allocation policies */
+#define EB_ALLOC_FREE_LIST          0 // Take the most recently freed elements. O(1) per element.
+#define EB_ALLOC_CONTIGUOUS         1 // Prefer a run of adjacent free elements, searched onwards from the last written one.
+
+/* Pool layouts */
+#define EB_LAYOUT_INTERLEAVED       0 // Each element holds its previous and next links followed by its data.
+#define EB_LAYOUT_SPLIT             1 // Data of all elements back to back, followed by separate previous and next link arrays.
+
+/* Slab buffers */
+#define EB_MAX_SLABS                3 // Most size classes in a slab buffer.
+
+/* Quotas */
+#define EB_MAX_OWNERS               16   // Most owners that can share an element buffer.
+#define EB_NO_OWNER                 0xFF // Owner of the chains not charged to any quota.
+
+/* Fill level gauges */
+#define EB_CHAIN_LENGTH_BINS        SKY_CHAIN_LENGTH_BINS // Bins of the chain length histogram. The last one counts the longer chains too.
+
+// Share of a shared element buffer given to one owner.
+typedef struct
+{
+	int32_t minimum;    // Elements kept free for the owner even if the others fill the buffer.
+	int32_t maximum;    // Most elements the owner may hold. 0 for no limit other than the buffer itself.
+	int32_t used;       // Elements held by the owner.
+	int32_t peak;       // Most elements held by the owner at once.
+} SkyElementQuota;
+
 // Element Buffer.
 struct sky_element_buffer_s
 {
@@ -20,6 +47,13 @@ struct sky_element_buffer_s
 	/* Index of last written element */
 	sky_element_idx_t last_write_index;
 
+	/* First element of the free list. Free elements are linked through their next field. */
+	sky_element_idx_t free_head;
+
+	/* Elements from this index onwards have not been taken since the last wipe. They are free whatever their
+	 * links say, and are initialized when first taken. */
+	sky_element_idx_t fresh_index;
+
 	/* Number of free elements */
 	int32_t free_elements;
 
@@ -31,8 +65,50 @@ struct sky_element_buffer_s
 
 	/* Amount of space usable by payload in element.  */
 	int32_t element_usable_space;
+
+	/* One of EB_ALLOC_* */
+	uint8_t allocation_policy;
+
+	/* Bitmap of free elements, bit set if free. Kept instead of the free list with EB_ALLOC_CONTIGUOUS. */
+	uint32_t* free_map;
+
+	/* One of EB_LAYOUT_* */
+	uint8_t layout;
+
+	/* Link arrays within the pool with EB_LAYOUT_SPLIT. NULL otherwise. */
+	sky_element_idx_t* previous_links;
+	sky_element_idx_t* next_links;
+
+	/* Quotas of the owners sharing the buffer, and the owner of the chain starting at each element. NULL if not shared. */
+	SkyElementQuota* quotas;
+	uint8_t* chain_owner;
+	uint8_t quota_count;
+
+	/* Free elements kept for the owners that hold less than their minimum. */
+	int32_t reserved_elements;
+
+	/* Size classes of a slab buffer, smallest first, each an element buffer of its own. The indexes of a class
+	 * follow those of the smaller classes, starting from its base. slab_count is 0 for a plain buffer. */
+	SkyElementBuffer* slabs[EB_MAX_SLABS];
+	sky_element_idx_t slab_base[EB_MAX_SLABS];
+	uint8_t slab_count;
+
+	/* Most elements in use at once, and the number of stored chains by their length in elements. Kept up to date
+	 * as chains are stored and deleted, so they can be read at any time. A wipe keeps the peak. */
+	int32_t peak_used_elements;
+	int32_t chain_lengths[EB_CHAIN_LENGTH_BINS];
 };
 
+// Fragmentation statistics of an element buffer.
+typedef struct
+{
+	int32_t free_elements;      // Number of free elements.
+	int32_t free_runs;          // Number of runs of adjacent free elements.
+	int32_t largest_free_run;   // Length of the longest run of adjacent free elements.
+	int32_t chains;             // Number of stored payloads.
+	int32_t fragmented_chains;  // Stored payloads whose elements are not adjacent and in order in the pool.
+} SkyElementBufferStats;
+
 // Element within the buffer.
 typedef struct
 {
@@ -45,9 +121,40 @@ typedef struct
  * Create a new element buffer
  *
  * Args:
- *     buffer: Element buffer to be destroyed
+ *     arena: Memory the buffer is taken from, or NULL to allocate it with SKY_MALLOC
+ *     usable_element_size: Usable size of the elements
+ *     element_count: Number of elements, at most EB_MAX_ELEMENT_COUNT
  */
-SkyElementBuffer* sky_element_buffer_create(int32_t usable_element_size, int32_t element_count);
+SkyElementBuffer* sky_element_buffer_create(SkyArena* arena, int32_t usable_element_size, int32_t element_count);
+
+/*
+ * Create a slab element buffer with size classes of different element sizes. A payload is stored in the smallest
+ * class that fits it in a single element, or in a larger or finally a smaller class if that one is full.
+ * Quotas are not supported. Other functions work as with a single size buffer, over all the classes.
+ *
+ * Args:
+ *     arena: Memory the buffer and its classes are taken from, or NULL to allocate them with SKY_MALLOC
+ *     usable_element_sizes: Usable size of the elements of each class, in ascending order
+ *     element_counts: Number of elements in each class. In total at most EB_MAX_ELEMENT_COUNT.
+ *     n_classes: Number of classes, 1 to EB_MAX_SLABS
+ */
+SkyElementBuffer* sky_element_buffer_create_slab(SkyArena* arena, const int32_t* usable_element_sizes, const int32_t* element_counts, int n_classes);
+
+/*
+ * Returns the number of bytes taken from an arena by sky_element_buffer_create, see sky_create_in.
+ *
+ * Args:
+ *     usable_element_size: Usable size of the elements
+ *     element_count: Number of elements
+ *     policy: Allocation policy set after creation
+ *     owners: Number of owners the quotas are enabled for, or 0
+ */
+size_t sky_element_buffer_required_memory(int32_t usable_element_size, int32_t element_count, int policy, int owners);
+
+/*
+ * Returns the number of bytes taken from an arena by sky_element_buffer_create_slab, see sky_create_in.
+ */
+size_t sky_element_buffer_slab_required_memory(const int32_t* usable_element_sizes, const int32_t* element_counts, int n_classes, int policy);
 
 /*
  * Destroy element buffer
@@ -59,14 +166,92 @@ void sky_element_buffer_destroy(SkyElementBuffer* buffer);
 
 /*
  * Erase all data in buffer and marks all elements free.
+ * Takes constant time with the free list policy, as the elements are initialized lazily as they are taken.
+ * With EB_ALLOC_CONTIGUOUS the free map is also reset, one bit per element.
  *
  * Args:
  *     buffer: Element buffer
  */
 void sky_element_buffer_wipe(SkyElementBuffer* buffer);
 
+/*
+ * Select how free elements are picked for new payloads. Can be changed only while the buffer is empty.
+ * Returns 0 on success, or SKY_RET_EBUFFER_NOT_EMPTY.
+ *
+ * Args:
+ *     arena: Memory the free map is taken from the first time it is needed, or NULL to allocate it with SKY_MALLOC
+ *     buffer: Element buffer
+ *     policy: EB_ALLOC_FREE_LIST or EB_ALLOC_CONTIGUOUS
+ */
+int sky_element_buffer_set_allocation_policy(SkyArena* arena, SkyElementBuffer* buffer, int policy);
+
+/*
+ * Select the layout of the pool. Can be changed only while the buffer is empty.
+ * With EB_LAYOUT_SPLIT chain walks and free element checks touch only the compact link arrays,
+ * and the data of adjacent elements is contiguous so that a chain stored in a run is copied with a single memcpy.
+ * Returns 0 on success, or SKY_RET_EBUFFER_NOT_EMPTY.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     layout: EB_LAYOUT_INTERLEAVED or EB_LAYOUT_SPLIT
+ */
+int sky_element_buffer_set_layout(SkyElementBuffer* buffer, int layout);
+
+/*
+ * Share the buffer between 'owners' owners, each charged for the elements of the payloads stored for it.
+ * The quotas start without minimum or maximum. Can be enabled only while the buffer is empty.
+ * Returns 0 on success, SKY_RET_EBUFFER_NOT_EMPTY or SKY_RET_EBUFFER_INVALID_QUOTA.
+ *
+ * Args:
+ *     arena: Memory the quotas are taken from the first time they are enabled, or NULL to allocate them with SKY_MALLOC
+ *     buffer: Element buffer
+ *     owners: Number of owners, 1 to EB_MAX_OWNERS
+ */
+int sky_element_buffer_enable_quotas(SkyArena* arena, SkyElementBuffer* buffer, int owners);
+
+/*
+ * Set the quota of an owner. The minimum number of elements stays available to the owner
+ * however full the others fill the buffer, and the owner can't hold more than the maximum.
+ * Returns 0 on success, or SKY_RET_EBUFFER_INVALID_QUOTA if the owner is invalid or
+ * the minimums of all owners together exceed the buffer.
+ *
+ * Args:
+ *     buffer: Element buffer with quotas enabled
+ *     owner: Owner index
+ *     minimum: Guaranteed number of elements
+ *     maximum: Largest number of elements, 0 for no limit
+ */
+int sky_element_buffer_set_quota(SkyElementBuffer* buffer, int owner, int32_t minimum, int32_t maximum);
+
+/*
+ * Get the number of elements that can still be stored for an owner. Same as the free element count without quotas.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     owner: Owner index, or EB_NO_OWNER
+ */
+int sky_element_buffer_available_elements(SkyElementBuffer* buffer, int owner);
+
+/*
+ * Compute fragmentation statistics by walking the whole pool. Meant for sizing pools, not for the data path.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     stats: Statistics are written here
+ */
+void sky_element_buffer_get_stats(SkyElementBuffer* buffer, SkyElementBufferStats* stats);
+
+/*
+ * Start the peaks of the buffer and of its quotas over from the current fill level.
+ *
+ * Args:
+ *     buffer: Element buffer
+ */
+void sky_element_buffer_reset_peaks(SkyElementBuffer* buffer);
+
 /*
  * Get the number of elements required for storing 'length' bytes.
+ * In a slab buffer, elements of the class the payload is stored in when the buffer is empty.
  *
  * Args:
  *     buffer: Element buffer
@@ -74,6 +259,35 @@ void sky_element_buffer_wipe(SkyElementBuffer* buffer);
  */
 int sky_element_buffer_element_requirement_for(SkyElementBuffer* buffer, int32_t length);
 
+/*
+ * Get the number of payload bytes that still fit in the buffer as a single payload.
+ * Every payload takes a length field and is rounded up to whole elements, so several smaller ones fit less.
+ *
+ * Args:
+ *     buffer: Element buffer
+ */
+int sky_element_buffer_free_space(SkyElementBuffer* buffer);
+
+/*
+ * Same as sky_element_buffer_free_space, but limited by the quota of the owner.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     owner: Owner index, or EB_NO_OWNER
+ */
+int sky_element_buffer_free_space_for(SkyElementBuffer* buffer, int owner);
+
+/*
+ * Returns 1 if all of the 'count' packets could be stored for the owner, 0 otherwise.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     owner: Owner index, or EB_NO_OWNER
+ *     packets: Packets, one fragment each
+ *     count: Number of packets
+ */
+int sky_element_buffer_can_store_all(SkyElementBuffer* buffer, int owner, const struct sky_iovec* packets, int count);
+
 /*
  * Returns the length of data in index 'idx'. Or negative error if no such data exists.
  *
@@ -93,12 +307,44 @@ int sky_element_buffer_get_data_length(SkyElementBuffer* buffer, sky_element_idx
  */
 int sky_element_buffer_store(SkyElementBuffer* buffer, const uint8_t* data, sky_element_length_t length);
 
+/*
+ * Store the concatenation of 'iovcnt' fragments to the buffer, and returns the index address, or negative error if no space.
+ * The fragments are copied directly to the element chain.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     iov: Array of fragments
+ *     iovcnt: Number of fragments
+ */
+int sky_element_buffer_store_iov(SkyElementBuffer* buffer, const struct sky_iovec* iov, int iovcnt);
+
+/*
+ * Same as sky_element_buffer_store_iov, but the payload is charged to the quota of the owner
+ * and returns SKY_RET_EBUFFER_NO_SPACE if it doesn't fit in what is available for the owner.
+ *
+ * Args:
+ *     buffer: Element buffer
+ *     owner: Owner index, or EB_NO_OWNER
+ *     iov: Array of fragments
+ *     iovcnt: Number of fragments
+ */
+int sky_element_buffer_store_iov_for(SkyElementBuffer* buffer, int owner, const struct sky_iovec* iov, int iovcnt);
+
 /*
  * Reads a payload from address index 'idx' that was previously returned by store function.
  * Or returns error if there is no payload or it is too long.
  */
 int sky_element_buffer_read(SkyElementBuffer* buffer, uint8_t* target, sky_element_idx_t idx, unsigned int max_len);
 
+/*
+ * Get read-only views to the payload at index 'idx' without copying it.
+ * Writes one span per block of physically adjacent data, at most one per element of the chain, to 'spans'
+ * and returns the number of spans written, or negative error if the index is invalid or 'max_spans'
+ * is less than the number of elements in the chain.
+ * The spans stay valid until the payload is deleted.
+ */
+int sky_element_buffer_get_spans(SkyElementBuffer* buffer, sky_element_idx_t idx, struct sky_iovec* spans, int max_spans);
+
 /*
  * Delete a payload at index 'idx'
  *
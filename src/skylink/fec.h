@@ -51,4 +51,73 @@ int sky_fec_decode(SkyRadioFrame *frame, SkyDiagnostics *diag);
 int sky_fec_encode(SkyRadioFrame *frame);
 
 
+/*
+ * Encode Forward error correction code on the frame to be transmit and
+ * write the whitened result directly to an external buffer.
+ * The frame itself is left untouched.
+ *
+ * params:
+ *   frame: Frame to be encoded.
+ *   out: Output buffer for the encoded frame.
+ *   max_length: Size of the output buffer.
+ *
+ * returns:
+ *   Number of bytes written on success. Negative return code on error.
+ */
+int sky_fec_encode_to(const SkyRadioFrame *frame, uint8_t *out, unsigned int max_length);
+
+
+/*
+ * Codeword of a transmitted frame, kept so that the parity can be updated when the same payload is sent again.
+ */
+typedef struct {
+	int32_t key;                               // Key the frame was encoded with, or -1 if the entry is unused.
+	uint16_t length;                           // Length of the message part.
+	uint8_t codeword[RS_MSGLEN + RS_PARITYS];  // Message followed by its parity, before whitening.
+} SkyFecCacheEntry;
+
+/*
+ * The code is linear, so the parity of a frame which differs from an earlier one only in a few bytes is the earlier
+ * parity XOR the parity of the difference. The parity of a single symbol at each message position is tabulated,
+ * which makes the update cost 32 table lookups per changed byte.
+ */
+struct sky_fec_cache_s {
+	uint8_t parity_log[RS_MSGLEN][RS_PARITYS]; // Parity of a unit symbol at each position of a full message, in index form.
+	int entry_count;
+	SkyFecCacheEntry entries[];
+};
+
+
+/*
+ * Create a codeword cache with room for 'entry_count' frames.
+ *
+ * params:
+ *   arena: Memory the cache is taken from, or NULL to allocate it with SKY_MALLOC.
+ *   entry_count: Number of codewords kept. Entries are direct mapped by their key.
+ */
+SkyFecCache* sky_fec_cache_create(SkyArena* arena, int entry_count);
+
+/* Returns the number of bytes the cache takes from an arena, see sky_create_in. */
+size_t sky_fec_cache_required_memory(int entry_count);
+
+/* Free the codeword cache. */
+void sky_fec_cache_destroy(SkyFecCache* cache);
+
+
+/*
+ * Encode Forward error correction code on the frame like sky_fec_encode, reusing the parity of the
+ * codeword cached under the same key when the frames differ only in a few bytes.
+ * The codeword of the frame replaces the cached one.
+ *
+ * params:
+ *   cache: Codeword cache.
+ *   frame: Frame to be encoded.
+ *   key: Identifies the payload carried by the frame. Negative to encode without the cache.
+ *
+ * returns:
+ *   O on success. Negative return code on error.
+ */
+int sky_fec_encode_cached(SkyFecCache* cache, SkyRadioFrame* frame, int32_t key);
+
+
 #endif /* __SKYLINK_FEC_H__ */
@@ -15,6 +15,16 @@
 #define SKYLINK_FRAME_VERSION_MASK      (0xF8)
 #define SKYLINK_FRAME_IDENTITY_MASK     (0x07)
 
+/*
+ * Identity length value which marks a compressed frame header.
+ * The identity field is then replaced by a single link ID byte negotiated during the ARQ handshake.
+ */
+#define SKY_IDENTITY_LEN_COMPRESSED     (0)
+#define SKY_LINK_ID_LEN                 (1)
+
+/* The top bit of the link ID tells which end of the link (ARQ initiator or responder) sent the frame. */
+#define SKY_LINK_ID_DIRECTION_BIT       (0x80)
+
 /*
  * Frame header flags
  * - vc: 2 bits
@@ -72,8 +82,19 @@ struct sky_radio_frame
 #define EXTENSION_ARQ_HANDSHAKE         3
 #define EXTENSION_MAC_TDD_CONTROL       4
 #define EXTENSION_HMAC_SEQUENCE_RESET   5
+#define EXTENSION_ARQ_CTRL_COMPRESSED   6
+#define EXTENSION_MAC_TDD_COMPRESSED    7
+#define EXTENSION_ARQ_SACK              8
+#define EXTENSION_ARQ_PARITY            9
 
 
+/*
+ * ARQ extensions carrying sequence numbers (sequence, request, wide request, parity and control) come in two forms.
+ * The structs below describe the wide form with 16 bit sequences. In the narrow form each sequence is a single byte
+ * and the following fields move accordingly. The form is told by the extension length, so these extensions must be
+ * read with sky_frame_read_arq_sequence() and the other readers below instead of the struct members.
+ */
+
 /* ARQ Sequence */
 typedef struct __attribute__((__packed__)) {
 	sky_arq_sequence_t sequence;
@@ -85,6 +106,25 @@ typedef struct __attribute__((__packed__)) {
 	sky_arq_mask_t mask;
 } ExtARQReq;
 
+/* Wide ARQ Retransmit Request. Same semantics as ExtARQReq but the mask is 32 or 64 bits wide.
+ * The mask is in network byte order and its width is given by the extension length together with the sequence form.
+ * The sequence is always a missing packet but not necessarily the receive head: next to a narrow request at the head,
+ * the frame can carry one wide request for a window further out, so a horizon wider than the mask is covered in turns. */
+#define SKY_ARQ_SACK_MASK_MIN_BYTES     4
+#define SKY_ARQ_SACK_MASK_MAX_BYTES     8
+typedef struct __attribute__((__packed__)) {
+	sky_arq_sequence_t sequence;
+	uint8_t mask[SKY_ARQ_SACK_MASK_MAX_BYTES];
+} ExtARQSack;
+
+/* ARQ Parity. Payload of the frame is the XOR of 'count' consecutive payloads starting from 'sequence',
+ * each zero padded to the length of the longest one. 'length' is the XOR of their lengths. */
+typedef struct __attribute__((__packed__)) {
+	sky_arq_sequence_t sequence;
+	uint8_t count;
+	uint8_t length;
+} ExtARQParity;
+
 /* ARQ control sequence */
 typedef struct __attribute__((__packed__)) {
 	sky_arq_sequence_t tx_sequence;
@@ -109,6 +149,16 @@ typedef struct __attribute__((__packed__)) {
 	uint16_t sequence;
 } ExtHMACSequenceReset;
 
+/* Compressed ARQ control. 4 least significant bits of TX sequence (high nibble) and RX sequence (low nibble) */
+typedef struct __attribute__((__packed__)) {
+	uint8_t sequences;
+} ExtARQCtrlCompressed;
+
+/* Compressed TDD MAC Control. Window length is omitted and the previously announced one is assumed. */
+typedef struct __attribute__((__packed__)) {
+	uint16_t remaining;
+} ExtTDDControlCompressed;
+
 /* General Extension Header struct */
 typedef struct __attribute__((__packed__)) {
 	uint8_t type    : 4;
@@ -120,6 +170,10 @@ typedef struct __attribute__((__packed__)) {
 		ExtARQHandshake ARQHandshake;
 		ExtTDDControl TDDControl;
 		ExtHMACSequenceReset HMACSequenceReset;
+		ExtARQCtrlCompressed ARQCtrlCompressed;
+		ExtTDDControlCompressed TDDControlCompressed;
+		ExtARQSack ARQSack;
+		ExtARQParity ARQParity;
 	};
 } SkyHeaderExtension;
 
@@ -167,6 +221,10 @@ typedef struct {
 	const SkyHeaderExtension* arq_handshake;
 	const SkyHeaderExtension* mac_tdd;
 	const SkyHeaderExtension* hmac_reset;
+	const SkyHeaderExtension* arq_ctrl_compressed;
+	const SkyHeaderExtension* mac_tdd_compressed;
+	const SkyHeaderExtension* arq_sack;
+	const SkyHeaderExtension* arq_parity;
 	const uint8_t* payload;
 	unsigned int payload_len;
 } SkyParsedFrame;
@@ -177,6 +235,7 @@ typedef struct {
 	SkyStaticHeader* hdr;
 	SkyRadioFrame* frame;
 	uint8_t *ptr; // write pointer
+	int32_t payload_sequence; // ARQ sequence of the payload written to the frame, or -1
 } SkyTransmitFrame;
 
 /*
@@ -201,20 +260,80 @@ void sky_frame_clear(SkyRadioFrame* frame);
 /*
  * (internal)
  * Add ARQ sequence number to the frame.
+ * Like in the other ARQ extensions, sequences are sent with 16 bits if 'wide_sequences' is set and with 8 bits otherwise.
  */
-int sky_frame_add_extension_arq_sequence(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence);
+int sky_frame_add_extension_arq_sequence(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, int wide_sequences);
 
 /*
  * (internal)
  * Add ARQ Retransmit Request header to the frame.
  */
-int sky_frame_add_extension_arq_request(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_mask_t mask);
+int sky_frame_add_extension_arq_request(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_mask_t mask, int wide_sequences);
+
+/*
+ * (internal)
+ * Add wide ARQ Retransmit Request header to the frame.
+ * The mask is sent with 32 bits if it fits, otherwise with 64 bits.
+ */
+int sky_frame_add_extension_arq_sack(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, sky_arq_wide_mask_t mask, int wide_sequences);
+
+/*
+ * (internal)
+ * Get the number of bytes the wide ARQ Retransmit Request takes in the frame for given mask.
+ */
+unsigned int sky_frame_get_arq_sack_length(sky_arq_wide_mask_t mask, int wide_sequences);
+
+/*
+ * (internal)
+ * Get the data length of an ARQ extension with narrow (8 bit) or wide (16 bit) sequences.
+ * For the wide retransmit request the length with the shortest mask is returned.
+ */
+unsigned int sky_frame_get_arq_extension_length(unsigned int type, int wide_sequences);
+
+/*
+ * (internal)
+ * Read the 'field'th sequence from a parsed ARQ extension. Narrow sequences are resolved to the sequence
+ * nearest to 'reference', so the true value must be within 127 steps of it.
+ */
+sky_arq_sequence_t sky_frame_read_arq_sequence(const SkyHeaderExtension *extension, unsigned int field, sky_arq_sequence_t reference);
+
+/*
+ * (internal)
+ * Read the mask from a parsed ARQ Retransmit Request header.
+ */
+sky_arq_mask_t sky_frame_read_arq_request_mask(const SkyHeaderExtension *extension);
+
+/*
+ * (internal)
+ * Read the mask from a parsed wide ARQ Retransmit Request header.
+ * Returns the width of the mask in bits.
+ */
+int sky_frame_read_arq_sack_mask(const SkyHeaderExtension *extension, sky_arq_wide_mask_t *mask);
+
+/*
+ * (internal)
+ * Read the group size and the XOR of the payload lengths from a parsed ARQ Parity header.
+ */
+void sky_frame_read_arq_parity(const SkyHeaderExtension *extension, uint8_t *count, uint8_t *length_parity);
+
+/*
+ * (internal)
+ * Add ARQ Parity header to the frame. The parity itself is added as the payload.
+ */
+int sky_frame_add_extension_arq_parity(SkyTransmitFrame *tx_frame, sky_arq_sequence_t sequence, uint8_t count, uint8_t length, int wide_sequences);
 
 /*
  * (internal)
  * Add ARQ Control header to the frame.
  */
-int sky_frame_add_extension_arq_ctrl(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence);
+int sky_frame_add_extension_arq_ctrl(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence, int wide_sequences);
+
+/*
+ * (internal)
+ * Add compressed ARQ Control header to the frame.
+ * Only the 4 least significant bits of the sequences are transmitted.
+ */
+int sky_frame_add_extension_arq_ctrl_compressed(SkyTransmitFrame *tx_frame, sky_arq_sequence_t tx_sequence, sky_arq_sequence_t rx_sequence);
 
 /*
  * (internal)
@@ -228,6 +347,12 @@ int sky_frame_add_extension_arq_handshake(SkyTransmitFrame *tx_frame, uint8_t st
  */
 int sky_frame_add_extension_mac_tdd_control(SkyTransmitFrame *tx_frame, uint16_t window, uint16_t remaining);
 
+/*
+ * (internal)
+ * Add compressed MAC TDD control header (without window length) to the frame.
+ */
+int sky_frame_add_extension_mac_tdd_compressed(SkyTransmitFrame *tx_frame, uint16_t remaining);
+
 /*
  * (internal)
  * Add HMAC sequence reset header to the frame.
@@ -240,6 +365,12 @@ int sky_frame_add_extension_hmac_sequence_reset(SkyTransmitFrame *tx_frame, uint
  */
 int sky_frame_extend_with_payload(SkyTransmitFrame *tx_frame, const uint8_t *payload, unsigned int payload_length);
 
+/*
+ * Get the length of the identity field in the frame.
+ * For compressed headers this is the length of the link ID field.
+ */
+unsigned int sky_frame_get_identity_field_length(const SkyRadioFrame* frame);
+
 /*
  * Get number of bytes left in the frame.
  */
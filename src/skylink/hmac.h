@@ -50,8 +50,11 @@ struct sky_hmac
 
 #endif
 
-/* Allocate and initialize HMAC state instance */
-SkyHMAC *sky_hmac_create(SkyHMACConfig *config);
+/* Allocate and initialize HMAC state instance from the arena, or from the heap if 'arena' is NULL */
+SkyHMAC *sky_hmac_create(SkyArena *arena, SkyHMACConfig *config);
+
+/* Returns the number of bytes the HMAC state takes from an arena, see sky_create_in. */
+size_t sky_hmac_required_memory(const SkyHMACConfig *config);
 
 /* Free HMAC resources */
 void sky_hmac_destroy(SkyHMAC *hmac);
@@ -54,9 +54,10 @@ struct sky_mac_s {
  *	Create a new TDD/MAC instance.
  *
  *	params:
+ *  	arena: Memory the instance is taken from, or NULL to allocate it with SKY_MALLOC.
  *  	config: Pointer to configuration struct. The allocation must always be available.
  */
-SkyMAC* sky_mac_create(SkyMACConfig* config);
+SkyMAC* sky_mac_create(SkyArena* arena, SkyMACConfig* config);
 
 
 /*
@@ -117,6 +118,12 @@ int32_t mac_own_window_remaining(SkyMAC* mac, sky_tick_t now);
 int32_t mac_peer_window_remaining(SkyMAC* mac, sky_tick_t now);
 
 
+/*
+ *	Returns the length of the full TDD cycle (both windows and the gaps) in ticks.
+ */
+sky_tick_t mac_get_cycle_length(SkyMAC* mac);
+
+
 /*
  *	Returns boolean whether MAC thinks it is our time to speak at now.
  */
@@ -157,4 +164,10 @@ bool mac_idle_frame_needed(SkyMAC* mac, sky_tick_t now);
  */
 int mac_set_frame_fields(SkyMAC *mac, SkyTransmitFrame *tx_frame, sky_tick_t now);
 
+/*
+ * Same as mac_set_frame_fields() but omits the window length when the peer already knows it.
+ * The window length can change only when a window opens, so the first frame of each window carries it in full.
+ */
+int mac_set_compressed_frame_fields(SkyMAC *mac, SkyTransmitFrame *tx_frame, sky_tick_t now);
+
 #endif // __SKYLINK_MAC_H__
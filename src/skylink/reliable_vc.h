@@ -10,14 +10,25 @@
 #define ARQ_STATE_OFF			0
 #define ARQ_STATE_IN_INIT		1
 #define ARQ_STATE_ON			2
+#define ARQ_STATE_RESYNC		3
+
+/* ARQ handshake peer_state field. Low nibble carries the ARQ state and upper bits the session options. */
+#define ARQ_HANDSHAKE_STATE_MASK        0x0F
+#define ARQ_HANDSHAKE_FLAG_COMPRESSION  0x80
+#define ARQ_HANDSHAKE_FLAG_WIDE_SEQUENCES 0x40
+
+/* Maximum number of spans a packet can occupy. (SKY_PAYLOAD_MAX_LEN stored in the smallest allowed elements) */
+#define SKY_VC_MAX_PACKET_SPANS         16
 
 
 struct sky_virtual_channel_s {
+	const SkyVCConfig* config;          // Pointer to the virtual channel configuration.
 	SkyElementBuffer* elementBuffer;    // Storage structure shared by the sendRing and rcvRing.
+	uint8_t shared_element_buffer;      // 1 if the element buffer is the pool of the whole link, owned by the handle.
 	SkySendRing* sendRing;              // Sequence ring tracking sent payloads and their sequence numbering.
 	SkyRcvRing* rcvRing;                // Sequence ring tracking received payloads and their sequence numbering.
 
-	uint8_t arq_state_flag;             // A flag with 3 valid states: OFF/INIT/ON.
+	uint8_t arq_state_flag;             // A flag with 4 valid states: OFF/INIT/ON/RESYNC. *5
 	uint8_t handshake_send;	            // A flag set to indicate a need to send a handshake extension on next transmission window.
 	uint32_t arq_session_identifier;    // A unique identifier of the current arq session, if arq is on.
 	uint8_t need_recall;                // A flag set to indicate a need to send rend recall extension. *1
@@ -25,16 +36,74 @@ struct sky_virtual_channel_s {
 	sky_tick_t last_rx_tick;            // Tick of last time a new continuous payloads was received, or we confirmed sync with peer.
 	sky_tick_t last_ctrl_send_tick;     // Tick of last time a control extension was transmitted.
 	int16_t unconfirmed_payloads;       //
+	uint8_t header_compression;         // A flag set when both peers agreed on compressed headers during the handshake.
+	uint8_t wide_sequences;             // A flag set when 16 bit sequences are used on the link. Agreed during the handshake.
+	uint8_t link_initiator;             // A flag set if we initiated the current arq session. Selects the link ID direction bit.
+	uint8_t resync_realigned;           // A flag set once the send ring is realigned to the peer's resync request. *5
+	sky_arq_sequence_t last_ctrl_rx_sequence; // Receive head sequence sent in the last control extension.
+	sky_arq_sequence_t sack_sequence;   // Where the next retransmit request window past the first one is looked for. *6
+
+	/* Round trip time estimation. *2 */
+	int32_t srtt;                       // Smoothed round trip time in ticks, scaled by 8.
+	int32_t rttvar;                     // Round trip time variation in ticks, scaled by 4.
+	int32_t rto;                        // Retransmission timeout in ticks. 0 until the first round trip has been measured.
+	uint8_t rtt_probe_active;           // A flag set when a packet is being timed.
+	sky_arq_sequence_t rtt_probe_sequence; // Sequence of the packet being timed.
+	sky_tick_t rtt_probe_tick;          // Tick of the first transmission of the timed packet.
+	sky_tick_t retransmit_timer_tick;   // Tick of the last payload transmission or acknowledgement progress.
+
+	/* Speculative retransmissions. *3 */
+	sky_arq_sequence_t speculative_sequence; // Next unacknowledged sequence to be retransmitted speculatively.
+	uint8_t speculative_resends_in_window;   // Speculative retransmissions made during the current window.
+	sky_tick_t window_start_tick;            // Tick of the first frame sent during the current window.
+
+	/* Packet level forward erasure coding. *4 */
+	sky_arq_sequence_t parity_sequence; // First sequence of the next parity group.
 };
 
 // *1 In the case where a received control extension reveals that the latest received payload is not the latest
 // the peer has sent, we need to recall this packet, despite our horizon being empty.
 
+// *2 One packet at a time is timed from its first transmission until a control extension acknowledges it.
+// Packets that get retransmitted meanwhile are not sampled (Karn's algorithm). The estimate follows Jacobson's
+// algorithm and is used to retransmit unacknowledged packets without waiting for the peer to request them.
+
+// *3 When the window still has time left after all new payloads have been sent, the unacknowledged payloads
+// are resent oldest first, up to arq.speculative_resends_per_window per window. This recovers lost tail packets
+// a full TDD cycle earlier than waiting for the peer's retransmit request. A packet is only resent once its latest
+// transmission is a smoothed round trip old, or before a round trip has been measured, once it was sent in an earlier
+// window. Younger packets could not have been acknowledged yet, so resending them would only waste the window.
+
+// *4 After every arq.parity_group_size transmitted payloads, a frame carrying their XOR is sent. The receiver
+// reconstructs a single missing payload of the group from it, provided the rest of the group is still in its ring.
+
+// *5 When a control extension shows the peer's transmit sequence detached from our receive ring, the packets ahead
+// of our receive head are dropped and a RESYNC handshake is sent with the session identifier and a control extension.
+// The peer first acknowledges everything up to our receive head, then renumbers the rest of its send ring to start
+// from our receive head and sends it again. Readable and queued packets survive on both ends. RESYNC ends when the
+// peer's handshake response or a control extension in sync with us is received, or when the ARQ timeout falls back
+// to the off state. The peer realigns only once per resync: repeated requests are answered with the handshake
+// response until a frame without a request shows that we have left RESYNC. So when both ends resync at the same
+// time, each realigns once and the control extensions sent with the requests bring both back on.
+
+// *6 Every retransmit request reports the packets just past the receive head, up to ARQ_HORIZON_MAP_BITS of them.
+// When only the 16 bit request fits, the frame also carries one more window starting from the next missing packet
+// further out, so a horizon wider than a single window is swept through in consecutive frames rather than as the
+// head creeps forward.
+
 
 
 /* Create a virtual channel instance */
 SkyVirtualChannel* sky_vc_create(SkyVCConfig* config);
 
+/* Create a virtual channel instance in the arena, or on the heap if 'arena' is NULL. With 'pool' not NULL, the payloads
+ * are stored in the shared element buffer, charged to the quota 'owner'. The buffer is not destroyed with the virtual channel. */
+SkyVirtualChannel* sky_vc_create_in_pool(SkyArena* arena, SkyVCConfig* config, SkyElementBuffer* pool, int owner);
+
+/* Returns the number of bytes a virtual channel takes from an arena, see sky_create_in. With 'in_pool' not 0,
+ * the virtual channel uses a shared element buffer. */
+size_t sky_vc_required_memory(const SkyVCConfig* config, int in_pool);
+
 /* Destroy a virtual channel instance */
 void sky_vc_destroy(SkyVirtualChannel* vchannel);
 
@@ -52,9 +121,32 @@ void sky_vc_wipe_to_arq_on_state(SkyVirtualChannel* vchannel, uint32_t identifie
 // Processes a handshake received in a packet.
 int sky_vc_handle_handshake(SkyVirtualChannel* vchannel, uint8_t peer_state, uint32_t identifier);
 
+/*
+ * Returns the link ID to be used in place of the identity on the next transmitted frame,
+ * or negative value if compressed headers can't be used and the full identity must be sent.
+ */
+int sky_vc_get_tx_link_id(SkyVirtualChannel* vchannel);
+
+/*
+ * Validate link ID of a received frame with compressed header.
+ * Returns SKY_RET_OK if the link ID belongs to the peer, SKY_RET_FILTERED_BY_IDENTITY for own frames
+ * or SKY_RET_UNKNOWN_LINK_ID if no such link has been negotiated.
+ */
+int sky_vc_check_rx_link_id(SkyVirtualChannel* vchannel, uint8_t link_id);
+
 // If too much time has passed since previous successful communication, fall back to non-reliable state.
 void sky_vc_check_timeouts(SkyVirtualChannel* vchannel, sky_tick_t now, sky_tick_t timeout);
 
+/*
+ * Schedule all unacknowledged packets for retransmission if none of them has been acknowledged within
+ * the retransmission timeout. The timeout is never shorter than 'min_rto', which should cover the TDD cycle.
+ * Returns the number of packets scheduled.
+ */
+int sky_vc_check_retransmit_timeout(SkyVirtualChannel* vchannel, sky_tick_t now, sky_tick_t min_rto, sky_tick_t max_rto);
+
+// Feed a round trip time sample in ticks to the estimator.
+void sky_vc_update_rtt(SkyVirtualChannel* vchannel, int32_t sample);
+
 
 
 
@@ -63,6 +155,32 @@ void sky_vc_check_timeouts(SkyVirtualChannel* vchannel, sky_tick_t now, sky_tick
 // Push packet to buffer. Return the save address index, or -1.
 int sky_vc_push_packet_to_send(SkyVirtualChannel *vchannel, const uint8_t *payload, unsigned int length);
 
+// Push packet gathered from 'iovcnt' fragments to buffer without staging them to a contiguous buffer first.
+int sky_vc_push_packet_to_send_iov(SkyVirtualChannel *vchannel, const struct sky_iovec *iov, int iovcnt);
+
+/*
+ * Push packet to buffer with a priority and a time-to-live. While ARQ is off, packets with a higher priority are sent
+ * first and a packet still queued 'ttl' ticks after 'now' is dropped. Zero 'ttl' never expires. Neither affects
+ * the order while ARQ is on. Priorities from SKY_SEND_PRIORITY_CLASSES up are the same as the highest class.
+ * Return the sequence of the packet, or negative error code.
+ */
+int sky_vc_push_packet_with_options(SkyVirtualChannel *vchannel, const uint8_t *payload, unsigned int length,
+                                    uint8_t priority, sky_tick_t ttl, sky_tick_t now);
+
+/*
+ * Push 'count' packets, each given as one contiguous fragment, to buffer as a group.
+ * Either all of them are queued or, if any one doesn't fit in the send ring or the element buffer, none of them.
+ * Returns the sequence of the first packet, or negative error code.
+ */
+int sky_vc_push_batch(SkyVirtualChannel *vchannel, const struct sky_iovec *packets, int count);
+
+// Returns the number of packets that can still be pushed to the send ring.
+int sky_vc_count_free_send_slots(SkyVirtualChannel* vchannel);
+
+// Returns the number of payload bytes the buffer can still take as one packet. Shared with the received packets,
+// and in a shared pool limited by the quota of the virtual channel.
+int sky_vc_count_free_send_bytes(SkyVirtualChannel* vchannel);
+
 // Returns boolean 1/0 whether the send ring is full.
 int sky_vc_send_buffer_is_full(SkyVirtualChannel* vchannel);
 
@@ -96,9 +214,30 @@ int sky_vc_push_rx_packet_monotonic(SkyVirtualChannel* vchannel, const uint8_t *
 // Pushes a radio received message of particular sequence to buffer.
 int sky_vc_push_rx_packet(SkyVirtualChannel *vchannel, const uint8_t *src, unsigned int length, sky_arq_sequence_t sequence, sky_tick_t now);
 
+// Repairs a missing packet of a parity group with a received parity payload. Returns how many steps the head advances or negative error code.
+int sky_vc_push_rx_parity(SkyVirtualChannel *vchannel, const uint8_t *parity, unsigned int length, sky_arq_sequence_t sequence, int count,
+                          uint8_t length_parity, sky_tick_t now);
+
 // Read next message to tgt buffer. Return number of bytes written on success, or negative error code.
 int sky_vc_read_next_received(SkyVirtualChannel* vchannel, uint8_t *tgt, unsigned int max_length);
 
+/*
+ * Get read-only views to the next received message without copying it out of the buffer.
+ * Writes up to 'max_spans' spans (SKY_VC_MAX_PACKET_SPANS is always enough) and returns the number of spans written,
+ * or negative error code. The spans remain valid until sky_vc_release_received() is called.
+ */
+int sky_vc_peek_next_received(SkyVirtualChannel* vchannel, struct sky_iovec *spans, int max_spans);
+
+// Remove the message previously accessed with sky_vc_peek_next_received(). Return zero on success, or negative error code.
+int sky_vc_release_received(SkyVirtualChannel* vchannel);
+
+/*
+ * Read all readable messages, up to 'max', in one pass. The messages are copied one after another to 'arena'
+ * and described in 'out'. Reading stops early at a message that doesn't fit in the rest of the arena.
+ * Returns the number of messages read, or negative error code if not even the first message fits.
+ */
+int sky_vc_read_received_batch(SkyVirtualChannel* vchannel, SkyPacketView *out, int max, uint8_t *arena, size_t arena_len);
+
 // How many messages there are in buffer as a continuous sequence, and thus readable by sky_vc_read_next_received()
 int sky_vc_count_readable_rcv_packets(SkyVirtualChannel* vchannel);
 
@@ -2,12 +2,21 @@
 #define __SKYLINK_SEQUENCE_RING_H__
 
 #include "skylink/skylink.h"
+#include "sky_platform.h"
 
-/* */
-#define ARQ_RESEND_SCHEDULE_DEPTH       16
+/* Largest accepted horizon width and ring length. */
+#define ARQ_MAXIMUM_HORIZON             2048
+#define ARQ_MAXIMUM_RING_LENGTH         4096
 
-/* */
-#define ARQ_MAXIMUM_HORIZON             64
+/* Number of packets past the head covered by the horizon bitmap, and by a single retransmit request window.
+ * The horizon beyond it is covered with further windows, see rcvRing_get_horizon_window(). */
+#define ARQ_HORIZON_MAP_BITS            64
+
+/* Most sequences in flight that can be resolved from the 8 bit sequences sent in narrow sessions. */
+#define ARQ_NARROW_SEQUENCE_WINDOW      127
+
+/* Number of priority classes of queued packets. Higher priorities are queued in the highest class. */
+#define SKY_SEND_PRIORITY_CLASSES       8
 
 
 /* Sequence ring item */
@@ -21,9 +30,27 @@ typedef struct __attribute__((__packed__))
 
 } RingItem;
 
+/* Delivery options of a packet in the send ring. Only used while ARQ is off, except for the transmission tick. */
+typedef struct
+{
+	// Tick when the packet was pushed.
+	sky_tick_t push_tick;
+
+	// Ticks after the push when the packet is dropped instead of sent. Zero means it never expires.
+	sky_tick_t ttl;
+
+	// Packets with a higher priority are sent first. FIFO within the same priority. Below SKY_SEND_PRIORITY_CLASSES.
+	uint8_t priority;
+
+	// Tick of the latest transmission of the packet. Set by the virtual channel while ARQ is on.
+	sky_tick_t tx_tick;
+
+} SendItemOptions;
+
 struct sky_send_ring_s
 {
 	RingItem* buff;     // The ring.
+	SendItemOptions* options; // Delivery options of each slot of the ring.
 	int length;	        // Size of the ring
 	int head;           // Ring index next packet pushed by upper stack will obtain.
 	int tx_head;        // The first untransmitted packet. (if tx_head == head, nothing to transmit)
@@ -32,8 +59,14 @@ struct sky_send_ring_s
 	sky_arq_sequence_t  tx_sequence;    // Sequence of the first untransmitted packet. That is, the packet pointed to by tx_head.
 	sky_arq_sequence_t  tail_sequence;  // Sequence of the packet at tail. Essentially "ring[wrap(tail)].sequence".
 	int storage_count;  // Number of packets stored.
+	int peak_storage_count; // Most packets stored at once. Kept over wipes.
 	unsigned int resend_count;   // Number of sequence numbers scheduled for resend.
-	sky_arq_sequence_t resend_list[ARQ_RESEND_SCHEDULE_DEPTH];
+	uint32_t* resend_pending;    // Bitmap of ring slots scheduled for resend.
+	sky_arq_sequence_t* resend_fifo; // Scheduled sequences in the order they were requested. Same capacity as the ring.
+	int resend_fifo_head;        // Index of the oldest sequence in the FIFO.
+	int resend_fifo_count;       // Number of sequences in the FIFO. Can include acknowledged ones that are skipped when popped.
+	uint8_t element_owner;       // Quota owner charged for the payloads in a shared element buffer. EB_NO_OWNER by default.
+	uint16_t queued_per_priority[SKY_SEND_PRIORITY_CLASSES]; // Number of untransmitted packets of each priority class.
 };
 
 struct sky_rcv_ring_s
@@ -64,6 +97,19 @@ struct sky_rcv_ring_s
 
 	// Number of packets stored.
 	int storage_count;
+
+	// Most packets stored at once. Kept over wipes.
+	int peak_storage_count;
+
+	// Presence of the packets ahead of head. Bit i is set if packet with sequence head_sequence+1+i is stored.
+	// Covers the first ARQ_HORIZON_MAP_BITS packets of the horizon.
+	sky_arq_wide_mask_t horizon_map;
+
+	// Sequence after the last packet received ahead of the head. Behind the head when there is none.
+	sky_arq_sequence_t horizon_end;
+
+	// Quota owner charged for the payloads in a shared element buffer. EB_NO_OWNER by default.
+	uint8_t element_owner;
 };
 
 /*
@@ -84,13 +130,17 @@ struct sky_rcv_ring_s
  */
 
 
-/* Create a recieve ring instance */
-SkyRcvRing *sky_rcv_ring_create(int length, int horizon_width, sky_arq_sequence_t initial_sequence);
+/* Create a recieve ring instance in the arena, or on the heap if 'arena' is NULL */
+SkyRcvRing *sky_rcv_ring_create(SkyArena *arena, int length, int horizon_width, sky_arq_sequence_t initial_sequence);
+
+/* Returns the number of bytes a receive ring of the given length takes from an arena, see sky_create_in. */
+size_t sky_rcv_ring_required_memory(int length);
 
 /* Destroy a recieve ring. */
 void sky_rcv_ring_destroy(SkyRcvRing* rcvRing);
 
-/* Clear/Wipe all contents of the recieve ring. */
+/* Clear/Wipe all contents of the recieve ring. Only the slots in use are visited, so the time taken
+ * follows the number of packets stored rather than the length of the ring. */
 void sky_rcv_ring_wipe(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t initial_sequence);
 
 /* Returns the amount of packets that can be read from the ring. (>=0) */
@@ -102,24 +152,66 @@ int rcvRing_count_readable_packets(SkyRcvRing* rcvRing);
  */
 int rcvRing_read_next_received(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, uint8_t *target, unsigned int max_length);
 
+/* Gets read-only views to the next readable payload without removing it from the ring.
+ * Returns number of spans written, or negative error code.
+ */
+int rcvRing_peek_next_received(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, struct sky_iovec *spans, int max_spans);
+
+/* Removes the next readable payload from the ring. Returns 0 on success or negative error code. */
+int rcvRing_release_next_received(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer);
+
+/* Reads up to 'max' readable payloads into 'arena' and describes them in 'views'. Tail and head are moved once.
+ * Returns number of payloads read (>=0), or negative error code if the first payload doesn't fit in the arena.
+ */
+int rcvRing_read_received_batch(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, SkyPacketView *views, int max,
+                                uint8_t *arena, size_t arena_len);
+
 /* Pushes a payload received with "sequence". Returns how many steps the head advances (>=0) or negative error code. */
 int rcvRing_push_rx_packet(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, const uint8_t *src, unsigned int length, sky_arq_sequence_t sequence);
 
 /* Constructs a bitmap of horizon where 0 represents a missing packet, and 1 a packet that is present in the horizon. So perfectly clear state is 0 */
 int rcvRing_get_horizon_bitmap(SkyRcvRing* rcvRing);
 
-/* Returns a state code as to is the RcvRing "has received all packets the peer has sent", "is some packets behind" or "is way out of sync, irreversiby so" */
-int rcvRing_get_sequence_sync_status(SkyRcvRing* rcvRing, sky_arq_sequence_t peer_tx_head_sequence_by_ctrl);
+/* Same as rcvRing_get_horizon_bitmap() but covers ARQ_HORIZON_MAP_BITS packets. */
+sky_arq_wide_mask_t rcvRing_get_horizon_bitmap_wide(SkyRcvRing* rcvRing);
 
+/* Number of sequences from the head up to and including the last packet received ahead of it. 0 if there is none. */
+int rcvRing_get_horizon_extent(SkyRcvRing* rcvRing);
 
+/* Get a retransmit request window starting from the first missing packet at least 'from' steps past the head.
+ * Bit i of the mask is set if packet 'start'+1+i has been received or is past the last received packet, so that
+ * only the gaps are requested. Returns the number of steps past the head the window ends at, or
+ * SKY_RET_RING_EMPTY if nothing is missing from 'from' up to the last received packet. */
+int rcvRing_get_horizon_window(SkyRcvRing* rcvRing, int from, sky_arq_sequence_t* start, sky_arq_wide_mask_t* mask);
 
-/* Create new send sequence number ring buffer */
-SkySendRing *sky_send_ring_create(int length, sky_arq_sequence_t initial_sequence);
+/* Reconstructs the single missing payload of a parity group of 'count' sequences starting from 'sequence'.
+ * 'parity' holds the parity payload and is XORed in place into the missing payload, whose sequence is written to 'missing'.
+ * Returns the length of the reconstructed payload, SKY_RET_RING_PACKET_ALREADY_IN if nothing is missing,
+ * or SKY_RET_RING_INVALID_SEQUENCE if the group can't be repaired. */
+int rcvRing_reconstruct_from_parity(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t sequence, int count,
+                                    uint8_t length_parity, uint8_t *parity, unsigned int parity_length, sky_arq_sequence_t *missing);
+
+/* Returns a state code as to is the RcvRing "has received all packets the peer has sent", "is some packets behind" or "is way out of sync, irreversiby so".
+ * 'wide_sequences' tells whether the sequence was sent with 16 bits, which sets how far ahead the peer can be. */
+int rcvRing_get_sequence_sync_status(SkyRcvRing* rcvRing, sky_arq_sequence_t peer_tx_head_sequence_by_ctrl, int wide_sequences);
+
+/* Deletes the packets received ahead of the head, which are not readable yet. Used when the peer's sequences
+ * can no longer be trusted. Returns the number of packets deleted. */
+int rcvRing_drop_horizon(SkyRcvRing *rcvRing, SkyElementBuffer *elementBuffer);
+
+
+
+/* Create new send sequence number ring buffer in the arena, or on the heap if 'arena' is NULL */
+SkySendRing *sky_send_ring_create(SkyArena *arena, int length, sky_arq_sequence_t initial_sequence);
+
+/* Returns the number of bytes a send ring of the given length takes from an arena, see sky_create_in. */
+size_t sky_send_ring_required_memory(int length);
 
 /* Destroy send ring */
 void sky_send_ring_destroy(SkySendRing* sendRing);
 
-/* Clear/wipe all the contents of the send ring */
+/* Clear/wipe all the contents of the send ring. Only the slots from tail to head are visited, so the time taken
+ * follows the number of packets stored rather than the length of the ring. */
 void sky_send_ring_wipe(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t initial_sequence);
 
 /* Returns boolean 1/0 whether the ring is full. (Full: tail == head+1. "Push_packet_to_send" will fail) */
@@ -134,12 +226,41 @@ int sendRing_get_recall_ring_index(SkySendRing *sendRing, sky_arq_sequence_t rec
 /* Pushes a new packet to be sent. Returns the (nonnegative) sequence it is associated with, or a negative error code. */
 int sendRing_push_packet_to_send(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const uint8_t* payload, unsigned int length);
 
+/* Pushes a new packet gathered from 'iovcnt' fragments. Returns the (nonnegative) sequence it is associated with, or a negative error code. */
+int sendRing_push_packet_to_send_iov(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* iov, int iovcnt);
+
+/* Pushes a new packet with a priority and a time-to-live in ticks (0 for none).
+ * Returns the (nonnegative) sequence it is associated with, or a negative error code.
+ */
+int sendRing_push_packet_with_options(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* iov, int iovcnt,
+                                      uint8_t priority, sky_tick_t ttl, sky_tick_t now);
+
+/* Prepares the next packet to be sent while ARQ is off: Moves the highest priority packet to the front and drops
+ * expired packets that reach the front. Sequences stay with the ring slots. Returns the number of packets dropped.
+ * Packets are only searched for when one of a higher class than the front is waiting behind it.
+ */
+int sendRing_prepare_unreliable_tx(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, sky_tick_t now);
+
+/* (internal) Recounts the untransmitted packets of each priority class after tx_head has been set directly. */
+void sendRing_count_queued_priorities(SkySendRing* sendRing);
+
+/* Pushes 'count' packets, each given as one contiguous fragment, only if all of them fit in the ring and the element buffer.
+ * Returns the sequence of the first packet, or a negative error code in which case nothing was pushed.
+ */
+int sendRing_push_batch(SkySendRing* sendRing, SkyElementBuffer* elementBuffer, const struct sky_iovec* packets, int count);
+
 /* Schedules a particular sequence to be resent (if possible). Returns 0 if successful, negative error code otherwise. */
 int sendRing_schedule_resend(SkySendRing *sendRing, sky_arq_sequence_t sequence);
 
+/* Returns the sequence that will be resent next (>=0) without removing it from the schedule, or negative error code. */
+int sendRing_get_next_resend_sequence(SkySendRing *sendRing);
+
 /* Schedules resend for the sequence argument, and all the sequences pointed to by the mask if possible. */
 int sendRing_schedule_resends_by_mask(SkySendRing *sendRing, sky_arq_sequence_t sequence, sky_arq_mask_t mask);
 
+/* Same as sendRing_schedule_resends_by_mask() but for a mask of 'mask_bits' width. */
+int sendRing_schedule_resends_by_wide_mask(SkySendRing *sendRing, sky_arq_sequence_t sequence, sky_arq_wide_mask_t mask, int mask_bits);
+
 /* Calculates the number of free ring slots for packets. */
 int sendRing_count_free_send_slots(SkySendRing* sendRing);
 
@@ -152,10 +273,20 @@ int sendRing_read_to_tx(SkySendRing *sendRing, SkyElementBuffer *elementBuffer,
 /* Writes sequence and length of the next payload to be sent into according pointer aguments. Returns 0 on success, negative error code otherwise. */
 int sendRing_peek_next_tx_size_and_sequence(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, int include_resend, sky_arq_sequence_t *sequence);
 
+/* Calculates the XOR parity of 'count' transmitted payloads starting from 'sequence' to 'target' (SKY_PAYLOAD_MAX_LEN bytes).
+ * XOR of the payload lengths is written to 'length_parity'. Returns the parity length, or a negative error code
+ * if any of the payloads is no longer in the ring. */
+int sendRing_build_parity(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t sequence, int count,
+                          uint8_t *target, uint8_t *length_parity);
+
 /* Deletes all payloads with sequences up to "new_tail_sequences". Accordingly, tail moves up to this sequence.
  * Returns the number of steps tail advances, or a negative errorcode if the sequence was not between tail and tx_head. */
 int sendRing_clean_tail_up_to(SkySendRing *sendRing, SkyElementBuffer *elementBuffer, sky_arq_sequence_t new_tail_sequence);
 
+/* Renumbers the stored packets so that the tail gets "new_tail_sequence" and moves tx_head back to the tail,
+ * so that every unacknowledged packet is transmitted again. The resend schedule is cleared. */
+void sendRing_realign(SkySendRing *sendRing, sky_arq_sequence_t new_tail_sequence);
+
 
 
 #endif //__SKYLINK_SEQUENCE_RING_H__
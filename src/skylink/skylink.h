@@ -2,6 +2,7 @@
 #define __SKYLINK_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 //============ DEFINES =================================================================================================
 //======================================================================================================================
@@ -20,6 +21,7 @@
 #define SKY_RET_INVALID_EXT_LENGTH          (-6)
 #define SKY_RET_REDUNDANT_EXTENSIONS        (-7)
 #define SKY_RET_FILTERED_BY_IDENTITY        (-8)
+#define SKY_RET_UNKNOWN_LINK_ID             (-14)
 
 // CRC
 #define SKY_RET_CRC_INVALID_LENGTH          (-9)
@@ -69,6 +71,13 @@
 #define SKY_RET_EBUFFER_CHAIN_CORRUPTED		(-111)
 #define SKY_RET_EBUFFER_NO_SPACE			(-112)
 #define SKY_RET_EBUFFER_TOO_LONG_PAYLOAD	(-113)
+#define SKY_RET_EBUFFER_NOT_EMPTY			(-114)
+#define SKY_RET_EBUFFER_INVALID_QUOTA		(-115)
+
+// SNAPSHOT
+#define SKY_RET_SNAPSHOT_NO_SPACE			(-120)
+#define SKY_RET_SNAPSHOT_INVALID			(-121)
+#define SKY_RET_SNAPSHOT_MISMATCH			(-122)
 
 
 
@@ -78,25 +87,29 @@
  */
 #define SKY_NUM_VIRTUAL_CHANNELS            (4)
 
+/*
+ * Number of bins in the chain length histogram of SkyVCFillLevel.
+ * Bin i counts the payloads stored in i+1 elements, the last bin also the longer ones.
+ */
+#define SKY_CHAIN_LENGTH_BINS               (8)
+
 
 //============ TYPES ===================================================================================================
 //======================================================================================================================
 
-/* ARQ sequence number type  */
-#ifndef SKY_16BIT_ARQ_SEQUENCES
-typedef uint8_t sky_arq_sequence_t;
-#define sky_arq_seq_hton(x) (x)
-#define sky_arq_seq_ntoh(x) (x)
-#else
+/* ARQ sequence number type. Sequences are always tracked with 16 bits. On the link they are sent with 8 or 16 bits
+ * depending on what was agreed in the ARQ handshake, and the 8 bit form is resolved against the local sequences. */
 typedef uint16_t sky_arq_sequence_t;
 #define sky_arq_seq_hton(x) sky_hton16((x))
 #define sky_arq_seq_ntoh(x) sky_ntoh16((x))
-#endif
 
 typedef uint16_t sky_arq_mask_t;
 #define sky_arq_mask_hton(x) sky_hton16((x))
 #define sky_arq_mask_ntoh(x) sky_ntoh16((x))
 
+/* Selective acknowledgement mask covering the whole ARQ horizon */
+typedef uint64_t sky_arq_wide_mask_t;
+
 typedef uint16_t sky_arq_window_t;
 #define sky_arq_window_hton(x) sky_hton16((x))
 #define sky_arq_window_ntoh(x) sky_ntoh16((x))
@@ -105,6 +118,24 @@ typedef uint16_t sky_arq_window_t;
 typedef uint16_t sky_element_idx_t;
 typedef uint16_t sky_element_length_t;
 
+/*
+ * Scatter-gather fragment of a payload. Fragments are concatenated in the given order.
+ * Also used as a read-only view to a payload stored inside the protocol buffers.
+ */
+struct sky_iovec {
+	const void* iov_base;
+	size_t iov_len;
+};
+
+/*
+ * A received packet copied out by a batch read. Points to the arena given to the read.
+ */
+typedef struct {
+	const uint8_t* data;
+	unsigned int length;
+	sky_arq_sequence_t sequence;
+} SkyPacketView;
+
 
 
 // Declare all structs so that we can start creating pointers
@@ -118,6 +149,8 @@ typedef struct sky_radio_frame SkyRadioFrame;
 typedef struct sky_element_buffer_s SkyElementBuffer;
 typedef struct sky_send_ring_s SkySendRing;
 typedef struct sky_rcv_ring_s SkyRcvRing;
+typedef struct sky_arena_s SkyArena;
+typedef struct sky_fec_cache_s SkyFecCache;
 
 /* Virtual Channel State */
 typedef struct __attribute__((__packed__)) {
@@ -156,6 +189,49 @@ typedef struct __attribute__((__packed__)) {
 } SkyState;
 
 
+/* Fill levels of the rings and the element buffer of a virtual channel. */
+typedef struct {
+	/*
+	 * Packets in the send ring, sent or not, and the most there has been at once.
+	 * The ring holds at most its length minus one.
+	 */
+	uint16_t send_ring_used;
+	uint16_t send_ring_peak;
+
+	/*
+	 * Sent packets scheduled for resend.
+	 */
+	uint16_t resend_queue;
+
+	/*
+	 * Received packets in the receive ring, readable or waiting in the horizon, and the most there has been at once.
+	 */
+	uint16_t rcv_ring_used;
+	uint16_t rcv_ring_peak;
+
+	/*
+	 * Elements of the element buffer held by the virtual channel, the most it has held at once, and the elements
+	 * it can still take. With the shared element pool, its share of the pool.
+	 */
+	int32_t used_elements;
+	int32_t peak_elements;
+	int32_t free_elements;
+
+	/*
+	 * Number of stored payloads by the number of elements they take. With the shared element pool,
+	 * the payloads of all the virtual channels.
+	 */
+	int32_t chain_lengths[SKY_CHAIN_LENGTH_BINS];
+
+} SkyVCFillLevel;
+
+
+/* Fill levels of all the virtual channels, see sky_get_fill_levels. */
+typedef struct {
+	SkyVCFillLevel vc[SKY_NUM_VIRTUAL_CHANNELS];
+} SkyFillLevels;
+
+
 /* Struct to store pointers to all the data structures related to a protocol instance. */
 struct sky_all {
 	SkyConfig*          conf;                 // Configuration
@@ -163,6 +239,10 @@ struct sky_all {
 	SkyVirtualChannel*  virtual_channels[SKY_NUM_VIRTUAL_CHANNELS]; // ARQ capable buffers
 	SkyMAC*             mac;                  // MAC state
 	SkyHMAC*            hmac;                 // HMAC authentication state
+	SkyElementBuffer*   element_pool;         // Element buffer shared by the virtual channels, or NULL
+	SkyFecCache*        fec_cache;            // Codewords of transmitted payload frames, or NULL if disabled
+	int32_t             tx_fec_key;           // Cache key of the last frame made by sky_tx, or -1 if it carries no payload
+	void*               arena;                // Memory given to sky_create_in, or NULL if allocated with SKY_MALLOC
 };
 
 /* Idenfity filter callback function type */
@@ -180,6 +260,28 @@ typedef int (*SkyReceiveFilterCallback)(const SkyHandle, const uint8_t *, unsign
  */
 SkyHandle sky_create(SkyConfig* config);
 
+/*
+ * Returns the number of bytes needed by sky_create_in for an instance of the configuration.
+ *
+ * Args:
+ *    config: Pointer to Skylink configuration struct.
+ */
+size_t sky_required_memory(const SkyConfig* config);
+
+/*
+ * Create new Skylink protocol instance without heap allocations. All of the state is laid out in the arena,
+ * each allocation starting on a cache line of its own. Instances are created one at a time.
+ * Destroying the instance frees nothing, the arena can be reused after it.
+ * Returns NULL if the arena is smaller than sky_required_memory(config).
+ *
+ * Args:
+ *    arena: Memory for the instance. Must outlive the instance.
+ *    len: Size of the arena in bytes.
+ *    config: Pointer to Skylink configuration struct.
+ *            The config struct is not copied and it must outlive the instance created.
+ */
+SkyHandle sky_create_in(void* arena, size_t len, SkyConfig* config);
+
 /*
  * Destroy Skylink instance and free all of its memory.
  *
@@ -197,6 +299,58 @@ void sky_destroy(SkyHandle self);
  */
 void sky_get_state(SkyHandle self, SkyState* state);
 
+/*
+ * Get the fill levels of the rings and the element buffers of the virtual channels.
+ * The levels are kept up to date as packets come and go, so this is cheap enough to call every tick.
+ * The peaks cover the time since the creation of the instance or the last sky_reset_fill_peaks.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ *    levels: The fill levels are stored here.
+ */
+void sky_get_fill_levels(SkyHandle self, SkyFillLevels* levels);
+
+/*
+ * Start the peaks of the fill levels over from the current levels, for example at the start of a pass.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ */
+void sky_reset_fill_peaks(SkyHandle self);
+
+/*
+ * Save the state of the instance to a versioned binary image: the ARQ state and the queued and received
+ * packets of every virtual channel, the MAC timing and the HMAC sequences. Restoring the image with
+ * sky_restore continues the link where it was, provided that the tick keeps counting from the same base.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ *    buf: Target for the image, or NULL to get the length of the image only.
+ *    len: Size of the target.
+ *
+ * Returns:
+ *    Length of the image, or SKY_RET_SNAPSHOT_NO_SPACE if it doesn't fit.
+ */
+int sky_snapshot(SkyHandle self, void* buf, size_t len);
+
+/*
+ * Restore the state saved by sky_snapshot to an instance created with the same configuration.
+ * All packets in the instance are replaced with those of the image.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ *    buf: Image
+ *    len: Length of the image
+ *
+ * Returns:
+ *    0 on success.
+ *    SKY_RET_SNAPSHOT_INVALID if the image is corrupted or of another version.
+ *    SKY_RET_SNAPSHOT_MISMATCH if the rings or the element buffers of the instance differ from those of the image.
+ *    An image failing the checksum, version or ring length checks leaves the instance as it was. After those,
+ *    an error leaves the virtual channels wiped.
+ */
+int sky_restore(SkyHandle self, const void* buf, size_t len);
+
 /*
  * Generate a new frame to be sent. The frame won't have any FEC or Golay included yet.
  *
@@ -241,6 +395,39 @@ int sky_tx_with_fec(SkyHandle self, SkyRadioFrame *frame);
  */
 int sky_tx_with_golay(SkyHandle self, SkyRadioFrame *frame);
 
+/*
+ * Generate a new frame to be sent directly into a buffer owned by the caller.
+ * The FEC is calculated and whitening applied while writing the output,
+ * so no intermediate copy of the encoded frame is made.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ *    out: Output buffer for the encoded frame.
+ *    max_length: Size of the output buffer.
+ *
+ * Returns:
+ *    <0 if there was an error.
+ *    0 if there's nothing to be sent.
+ *    >0 number of bytes written to the output buffer.
+ */
+int sky_tx_with_fec_to(SkyHandle self, uint8_t *out, unsigned int max_length);
+
+/*
+ * Generate a new frame to be sent directly into a buffer owned by the caller.
+ * The frame will have the FEC and Golay header included.
+ *
+ * Args:
+ *    self: Pointer to Skylink instance
+ *    out: Output buffer for the encoded frame.
+ *    max_length: Size of the output buffer.
+ *
+ * Returns:
+ *    <0 if there was an error.
+ *    0 if there's nothing to be sent.
+ *    >0 number of bytes written to the output buffer.
+ */
+int sky_tx_with_golay_to(SkyHandle self, uint8_t *out, unsigned int max_length);
+
 /*
  * Pass received frame for the protocol logic.
  * The frame doesn't have FEC or Golay included.
@@ -2,6 +2,7 @@
 #define __SKYLINK_UTILITIES_H__
 
 #include <stdint.h>
+#include <stddef.h>
 #include "sky_platform.h"
 
 
@@ -60,6 +61,27 @@ sky_tick_t sky_get_tick_time();
 // GLOBAL TIME =====================================================================================================
 
 
+// MEMORY ==========================================================================================================
+
+// Alignment of the allocations from an arena given to sky_create_in. Can be set by the platform.
+#ifndef SKY_CACHE_LINE_SIZE
+#define SKY_CACHE_LINE_SIZE	64
+#endif
+
+// Space taken from an arena by an allocation of 'size' bytes. Every allocation starts on a cache line of its own.
+#define SKY_ARENA_SIZE(size)	((((size_t)(size)) + SKY_CACHE_LINE_SIZE - 1) & ~(size_t)(SKY_CACHE_LINE_SIZE - 1))
+
+// Free part of the memory given to sky_create_in. Passed to the create functions of the parts of the instance.
+struct sky_arena_s
+{
+	uint8_t* next;  // First free cache line.
+	uint8_t* end;   // End of the memory.
+};
+
+// Takes 'size' bytes from the arena, or allocates them with SKY_MALLOC if 'arena' is NULL.
+// Returns NULL if the arena is exhausted.
+void* sky_allocate(struct sky_arena_s* arena, size_t size);
+// MEMORY ==========================================================================================================
 
 
 #endif //__SKYLINK_UTILITIES_H__
@@ -108,18 +108,18 @@ int sky_rx(SkyHandle self, const SkyRadioFrame* frame)
 	if (version != SKYLINK_FRAME_VERSION_BYTE)
 		return SKY_RET_INVALID_VERSION;
 
-	// Validate identity field
+	// Validate identity field. Zero identity length marks a compressed header with a link ID instead.
 	parsed.identity = &frame->raw[1];
 	parsed.identity_len = (frame->raw[0] & SKYLINK_FRAME_IDENTITY_MASK);
-	if (parsed.identity_len == 0 || parsed.identity_len > SKY_MAX_IDENTITY_LEN)
+	if (parsed.identity_len > SKY_MAX_IDENTITY_LEN)
 		return SKY_RET_INVALID_VERSION;
 
-	// Identity filtering
-	if (filter_by_identity(self, parsed.identity, parsed.identity_len)) // TODO: Filtering callback function
+	// Identity filtering. Link IDs are checked once the virtual channel is known.
+	if (parsed.identity_len != SKY_IDENTITY_LEN_COMPRESSED && filter_by_identity(self, parsed.identity, parsed.identity_len)) // TODO: Filtering callback function
 		return SKY_RET_FILTERED_BY_IDENTITY;
 
 	// Get start position for header and payload. Copy header to parsed frame structure.
-	const unsigned header_start = 1 + parsed.identity_len;
+	const unsigned header_start = 1 + sky_frame_get_identity_field_length(frame);
 	memcpy(&parsed.hdr, &frame->raw[header_start], sizeof(SkyStaticHeader));
 	const unsigned payload_start = header_start + sizeof(SkyStaticHeader) + parsed.hdr.extension_length;
 
@@ -136,6 +136,12 @@ int sky_rx(SkyHandle self, const SkyRadioFrame* frame)
 		return SKY_RET_INVALID_VC;
 #endif
 
+	// Compressed header is accepted only from the peer of a negotiated link.
+	if (parsed.identity_len == SKY_IDENTITY_LEN_COMPRESSED) {
+		if ((ret = sky_vc_check_rx_link_id(self->virtual_channels[vc], parsed.identity[0])) < 0)
+			return ret;
+	}
+
 	// Extract the frame payload
 	parsed.payload = &frame->raw[payload_start];
 
@@ -170,17 +176,23 @@ int sky_rx(SkyHandle self, const SkyRadioFrame* frame)
 static void sky_rx_process_ext_mac_control(SkyHandle self, int rx_time_ticks, SkyParsedFrame* parsed)
 {
 	// Check if the frame has a MAC/TDD extension
-	const SkyHeaderExtension *tdd_ext = parsed->mac_tdd;
-	if (tdd_ext == NULL)
+	if (parsed->mac_tdd == NULL && parsed->mac_tdd_compressed == NULL)
 		return;
 
 	// No unauthenticated MAC updates and frame is not authenticated.
 	if (self->conf->mac.unauthenticated_mac_updates == 0 && (parsed->hdr.flags & SKY_FLAG_AUTHENTICATED) == 0)
 		return;
 
-	// Get window and remaining time
-	uint16_t w = sky_ntoh16(tdd_ext->TDDControl.window);
-	uint16_t r = sky_ntoh16(tdd_ext->TDDControl.remaining);
+	// Get window and remaining time. Compressed control omits the window which is then assumed unchanged.
+	uint16_t w, r;
+	if (parsed->mac_tdd != NULL) {
+		w = sky_ntoh16(parsed->mac_tdd->TDDControl.window);
+		r = sky_ntoh16(parsed->mac_tdd->TDDControl.remaining);
+	}
+	else {
+		w = (uint16_t)self->mac->peer_window_length;
+		r = sky_ntoh16(parsed->mac_tdd_compressed->TDDControlCompressed.remaining);
+	}
 
 	// Print debug info
 	SKY_PRINTF(SKY_DIAG_MAC | SKY_DIAG_DEBUG, "MAC Updated: Window length %d, window remaining %d\n", w, r);
@@ -135,9 +135,13 @@ int sky_tx(SkyHandle self, SkyRadioFrame* frame)
 
 
 	// Check the virtual channels' timeout conditions.
-	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i)  // TODO: Do only every N ticks?
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i) { // TODO: Do only every N ticks?
 		sky_vc_check_timeouts(self->virtual_channels[i], now, self->conf->arq.timeout_ticks);
 
+		// Peer can't acknowledge anything faster than one TDD cycle. Leave time for a second attempt before the ARQ timeout.
+		sky_vc_check_retransmit_timeout(self->virtual_channels[i], now, mac_get_cycle_length(self->mac), self->conf->arq.timeout_ticks / 2);
+	}
+
 	//if (!can_send) return 0; ?????????
 
 	// Pick a virtual channel to transmit on.
@@ -160,18 +164,30 @@ int sky_tx(SkyHandle self, SkyRadioFrame* frame)
 	 */
 	SkyTransmitFrame tx_frame;
 	tx_frame.frame = frame;
+	tx_frame.payload_sequence = -1;
 	sky_frame_clear(frame);
 
-	// Set the start byte
-	const unsigned int identity_len = self->conf->identity_len;
-	frame->raw[0] = SKYLINK_FRAME_VERSION_BYTE | identity_len;
-	tx_frame.ptr = &frame->raw[1];
-	frame->length = 1;
-
-	// Copy source identifier
-	memcpy(&frame->raw[1], self->conf->identity, identity_len);
-	tx_frame.ptr += identity_len;
-	frame->length += identity_len;
+	// Use compressed header if the virtual channel has negotiated a link ID.
+	int link_id = sky_vc_get_tx_link_id(self->virtual_channels[vc]);
+	if (link_id >= 0) {
+		// Set the start byte and replace the source identifier with the link ID
+		frame->raw[0] = SKYLINK_FRAME_VERSION_BYTE | SKY_IDENTITY_LEN_COMPRESSED;
+		frame->raw[1] = (uint8_t)link_id;
+		tx_frame.ptr = &frame->raw[1 + SKY_LINK_ID_LEN];
+		frame->length = 1 + SKY_LINK_ID_LEN;
+	}
+	else {
+		// Set the start byte
+		const unsigned int identity_len = self->conf->identity_len;
+		frame->raw[0] = SKYLINK_FRAME_VERSION_BYTE | identity_len;
+		tx_frame.ptr = &frame->raw[1];
+		frame->length = 1;
+
+		// Copy source identifier
+		memcpy(&frame->raw[1], self->conf->identity, identity_len);
+		tx_frame.ptr += identity_len;
+		frame->length += identity_len;
+	}
 
 	// Set the static header
 	SkyStaticHeader *hdr = (SkyStaticHeader*)tx_frame.ptr;
@@ -182,7 +198,10 @@ int sky_tx(SkyHandle self, SkyRadioFrame* frame)
 
 #ifdef SKY_USE_TDD_MAC
 	/* Add TDD MAC extension. */
-	mac_set_frame_fields(self->mac, &tx_frame, now);
+	if (link_id >= 0)
+		mac_set_compressed_frame_fields(self->mac, &tx_frame, now);
+	else
+		mac_set_frame_fields(self->mac, &tx_frame, now);
 #endif
 
 	/* Add HMAC reset extension if required. */
@@ -211,6 +230,9 @@ int sky_tx(SkyHandle self, SkyRadioFrame* frame)
 		sky_extend_with_crc32(frame);
 #endif
 
+	// Frames carrying the same payload share a key in the FEC codeword cache.
+	self->tx_fec_key = (tx_frame.payload_sequence >= 0) ? (int32_t)((vc << 16) | tx_frame.payload_sequence) : -1;
+
 	// Increment counters
 	self->mac->total_frames_sent_in_current_window++;
 	self->mac->frames_sent_in_current_window_per_vc[vc]++;
@@ -233,7 +255,10 @@ int sky_tx_with_fec(SkyHandle self, SkyRadioFrame *frame) {
 		SKY_ASSERT(frame->length + RS_PARITYS <= sizeof(frame->raw));
 
 		/* Apply Forward Error Correction (FEC) coding */
-		sky_fec_encode(frame);
+		if (self->fec_cache != NULL)
+			sky_fec_encode_cached(self->fec_cache, frame, self->tx_fec_key);
+		else
+			sky_fec_encode(frame);
 	}
 	// Return whether or not the frame succesfully created.
 	return ret;
@@ -250,7 +275,7 @@ int sky_tx_with_golay(SkyHandle self, SkyRadioFrame* frame) {
 
 		/* Move the data by 3 bytes to make room for the PHY header */
 		for (unsigned int i = frame->length; i != 0; i--)
-			frame->raw[i + 3] = frame->raw[i];
+			frame->raw[i + 2] = frame->raw[i - 1];
 
 		/* Add PHY header */
 		uint32_t phy_header = frame->length;
@@ -264,3 +289,50 @@ int sky_tx_with_golay(SkyHandle self, SkyRadioFrame* frame) {
 	// Return whether or not the frame succesfully created.
 	return ret;
 }
+
+
+// Generate a new frame with FEC coding into a caller owned buffer.
+int sky_tx_with_fec_to(SkyHandle self, uint8_t *out, unsigned int max_length) {
+
+	// The frame length is known only after it has been generated, so make sure
+	// the largest possible frame fits before anything gets consumed from the send rings.
+	if (max_length < SKY_FRAME_MAX_LEN + RS_PARITYS)
+		return SKY_RET_RS_INVALID_LENGTH;
+
+	// Generate a new frame to be sent.
+	SkyRadioFrame frame;
+	int ret = sky_tx(self, &frame);
+	if (ret != 1)
+		return ret;
+
+	// The cache updates the parity in the frame, so the result is copied out afterwards.
+	if (self->fec_cache != NULL) {
+		sky_fec_encode_cached(self->fec_cache, &frame, self->tx_fec_key);
+		memcpy(out, frame.raw, frame.length);
+		return frame.length;
+	}
+
+	// Encode and whiten directly to the output buffer.
+	return sky_fec_encode_to(&frame, out, max_length);
+}
+
+// Generate a new frame with FEC and Golay coding into a caller owned buffer.
+int sky_tx_with_golay_to(SkyHandle self, uint8_t *out, unsigned int max_length) {
+
+	if (max_length < 3)
+		return SKY_RET_RS_INVALID_LENGTH;
+
+	// Generate a new frame with FEC coding right after the PHY header.
+	int ret = sky_tx_with_fec_to(self, &out[3], max_length - 3);
+	if (ret <= 0)
+		return ret;
+
+	/* Add PHY header */
+	uint32_t phy_header = ret;
+	encode_golay24(&phy_header);
+	out[0] = 0xff & (phy_header >> 16);
+	out[1] = 0xff & (phy_header >> 8);
+	out[2] = 0xff & (phy_header >> 0);
+
+	return ret + 3;
+}
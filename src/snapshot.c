@@ -0,0 +1,466 @@
+#include "skylink/skylink.h"
+#include "skylink/reliable_vc.h"
+#include "skylink/sequence_ring.h"
+#include "skylink/element_buffer.h"
+#include "skylink/mac.h"
+#include "skylink/hmac.h"
+#include "skylink/crc.h"
+#include "skylink/utilities.h"
+
+#include "sky_platform.h"
+
+#include <string.h> // memcpy
+
+
+/*
+Snapshot and restore of a protocol instance.
+
+The image starts with a header that tells the version and the ring lengths of each virtual channel, so that an
+image of another configuration is rejected before anything is restored. The header is followed by the MAC timing,
+the HMAC sequences and each virtual channel: its ARQ state, the send ring with its resend schedule and the receive
+ring. Only the ring slots holding a packet are saved, each with its sequence and payload. Element indexes are not
+saved, the payloads are stored again when restored and the slots point to the new chains. All fields are in network
+byte order and the image ends with a CRC-32 of the rest of it.
+
+The window state of the MAC (whether the window is open and the frames sent in it) is not saved since the window
+is reopened by the tick after the restore.
+*/
+
+#define SNAPSHOT_MAGIC      0x534B5953 // "SKYS"
+#define SNAPSHOT_VERSION    1
+
+// Length of the header: magic, version, number of virtual channels and the ring lengths of each.
+#define SNAPSHOT_HEADER_LEN (4 + 1 + 1 + SKY_NUM_VIRTUAL_CHANNELS * 6)
+
+
+//Cursor writing to an image. Without a target, only the length is counted.
+typedef struct {
+	uint8_t* buf;
+	size_t len;
+	size_t pos;
+} SnapshotWriter;
+
+//Cursor reading an image. Reading past the end sets the overrun flag and returns zeros.
+typedef struct {
+	const uint8_t* buf;
+	size_t len;
+	size_t pos;
+	int overrun;
+} SnapshotReader;
+
+
+static void put_bytes(SnapshotWriter* w, const void* data, size_t n)
+{
+	if (w->buf != NULL && w->pos + n <= w->len)
+		memcpy(w->buf + w->pos, data, n);
+	w->pos += n;
+}
+
+static void put_u8(SnapshotWriter* w, uint8_t v)
+{
+	put_bytes(w, &v, 1);
+}
+
+static void put_u16(SnapshotWriter* w, uint16_t v)
+{
+	v = sky_hton16(v);
+	put_bytes(w, &v, 2);
+}
+
+static void put_u32(SnapshotWriter* w, uint32_t v)
+{
+	v = sky_hton32(v);
+	put_bytes(w, &v, 4);
+}
+
+static const uint8_t* get_bytes(SnapshotReader* r, size_t n)
+{
+	if (r->overrun || r->pos + n > r->len) {
+		r->overrun = 1;
+		return NULL;
+	}
+	const uint8_t* p = r->buf + r->pos;
+	r->pos += n;
+	return p;
+}
+
+static uint8_t get_u8(SnapshotReader* r)
+{
+	const uint8_t* p = get_bytes(r, 1);
+	return (p != NULL) ? p[0] : 0;
+}
+
+static uint16_t get_u16(SnapshotReader* r)
+{
+	uint16_t v = 0;
+	const uint8_t* p = get_bytes(r, 2);
+	if (p != NULL)
+		memcpy(&v, p, 2);
+	return sky_ntoh16(v);
+}
+
+static uint32_t get_u32(SnapshotReader* r)
+{
+	uint32_t v = 0;
+	const uint8_t* p = get_bytes(r, 4);
+	if (p != NULL)
+		memcpy(&v, p, 4);
+	return sky_ntoh32(v);
+}
+
+
+//Writes the payload of a ring slot as its length followed by the data.
+static void put_payload(SnapshotWriter* w, SkyElementBuffer* buffer, sky_element_idx_t idx)
+{
+	struct sky_iovec spans[SKY_VC_MAX_PACKET_SPANS];
+	int n_spans = sky_element_buffer_get_spans(buffer, idx, spans, SKY_VC_MAX_PACKET_SPANS);
+	SKY_ASSERT(n_spans >= 0);
+	put_u16(w, (uint16_t)sky_element_buffer_get_data_length(buffer, idx));
+	for (int i = 0; i < n_spans; i++)
+		put_bytes(w, spans[i].iov_base, spans[i].iov_len);
+}
+
+//Reads a payload and stores it for the owner. Returns the index of the new chain, or negative error.
+static int get_payload(SnapshotReader* r, SkyElementBuffer* buffer, uint8_t owner)
+{
+	uint16_t length = get_u16(r);
+	struct sky_iovec iov = { get_bytes(r, length), length };
+	if (r->overrun)
+		return SKY_RET_SNAPSHOT_INVALID;
+	return sky_element_buffer_store_iov_for(buffer, owner, &iov, 1);
+}
+
+//Number of ring slots holding a packet.
+static int count_stored(const RingItem* ring, int length)
+{
+	int n = 0;
+	for (int i = 0; i < length; i++)
+		if (ring[i].idx != EB_NULL_IDX)
+			n++;
+	return n;
+}
+
+
+// Steps from 'from' forward to 'to' on a ring of the given length.
+static int ring_distance(int from, int to, int length)
+{
+	return (to - from + length) % length;
+}
+
+static void put_send_ring(SnapshotWriter* w, SkySendRing* ring, SkyElementBuffer* buffer)
+{
+	put_u16(w, (uint16_t)ring->head);
+	put_u16(w, (uint16_t)ring->tx_head);
+	put_u16(w, (uint16_t)ring->tail);
+	put_u16(w, ring->head_sequence);
+	put_u16(w, ring->tx_sequence);
+	put_u16(w, ring->tail_sequence);
+
+	//The resend schedule: the slots pending and the requested sequences in their order.
+	for (int i = 0; i < (ring->length + 31) / 32; i++)
+		put_u32(w, ring->resend_pending[i]);
+	put_u16(w, (uint16_t)ring->resend_fifo_count);
+	for (int i = 0; i < ring->resend_fifo_count; i++)
+		put_u16(w, ring->resend_fifo[(ring->resend_fifo_head + i) % ring->length]);
+
+	//The packets with their delivery options.
+	put_u16(w, (uint16_t)count_stored(ring->buff, ring->length));
+	for (int i = 0; i < ring->length; i++) {
+		if (ring->buff[i].idx == EB_NULL_IDX)
+			continue;
+		put_u16(w, (uint16_t)i);
+		put_u16(w, ring->buff[i].sequence);
+		put_u32(w, (uint32_t)ring->options[i].push_tick);
+		put_u32(w, (uint32_t)ring->options[i].ttl);
+		put_u8(w, ring->options[i].priority);
+		put_u32(w, (uint32_t)ring->options[i].tx_tick);
+		put_payload(w, buffer, ring->buff[i].idx);
+	}
+}
+
+static int get_send_ring(SnapshotReader* r, SkySendRing* ring, SkyElementBuffer* buffer)
+{
+	ring->head = get_u16(r);
+	ring->tx_head = get_u16(r);
+	ring->tail = get_u16(r);
+	ring->head_sequence = get_u16(r);
+	ring->tx_sequence = get_u16(r);
+	ring->tail_sequence = get_u16(r);
+	if (ring->head >= ring->length || ring->tx_head >= ring->length || ring->tail >= ring->length)
+		return SKY_RET_SNAPSHOT_INVALID;
+
+	//The ring is wiped by visiting the slots from tail to head only, so nothing may be restored outside them.
+	const int stored = ring_distance(ring->tail, ring->head, ring->length);
+	const int sent = ring_distance(ring->tail, ring->tx_head, ring->length);
+	if (sent > stored)
+		return SKY_RET_SNAPSHOT_INVALID;
+
+	ring->resend_count = 0;
+	for (int i = 0; i < (ring->length + 31) / 32; i++) {
+		ring->resend_pending[i] = get_u32(r);
+		for (uint32_t bits = ring->resend_pending[i]; bits != 0; bits &= bits - 1) {
+			if (ring_distance(ring->tail, i * 32 + __builtin_ctz(bits), ring->length) >= sent) {
+				ring->resend_pending[i] = 0;
+				return SKY_RET_SNAPSHOT_INVALID;
+			}
+			ring->resend_count++;
+		}
+	}
+	ring->resend_fifo_head = 0;
+	ring->resend_fifo_count = get_u16(r);
+	if (ring->resend_fifo_count > ring->length)
+		return SKY_RET_SNAPSHOT_INVALID;
+	for (int i = 0; i < ring->resend_fifo_count; i++)
+		ring->resend_fifo[i] = get_u16(r);
+
+	ring->storage_count = get_u16(r);
+	for (int i = 0; i < ring->storage_count; i++) {
+		int slot = get_u16(r);
+		if (slot >= ring->length || ring_distance(ring->tail, slot, ring->length) >= stored)
+			return SKY_RET_SNAPSHOT_INVALID;
+		ring->buff[slot].sequence = get_u16(r);
+		ring->options[slot].push_tick = (sky_tick_t)get_u32(r);
+		ring->options[slot].ttl = (sky_tick_t)get_u32(r);
+		ring->options[slot].priority = get_u8(r);
+		if (ring->options[slot].priority >= SKY_SEND_PRIORITY_CLASSES)
+			return SKY_RET_SNAPSHOT_INVALID;
+		ring->options[slot].tx_tick = (sky_tick_t)get_u32(r);
+		int idx = get_payload(r, buffer, ring->element_owner);
+		if (idx < 0)
+			return idx;
+		ring->buff[slot].idx = (sky_element_idx_t)idx;
+	}
+	if (ring->storage_count > ring->peak_storage_count)
+		ring->peak_storage_count = ring->storage_count;
+	sendRing_count_queued_priorities(ring);
+	return r->overrun ? SKY_RET_SNAPSHOT_INVALID : 0;
+}
+
+
+static void put_rcv_ring(SnapshotWriter* w, SkyRcvRing* ring, SkyElementBuffer* buffer)
+{
+	put_u16(w, (uint16_t)ring->head);
+	put_u16(w, (uint16_t)ring->tail);
+	put_u16(w, ring->head_sequence);
+	put_u16(w, ring->tail_sequence);
+	put_u32(w, (uint32_t)(ring->horizon_map >> 32));
+	put_u32(w, (uint32_t)ring->horizon_map);
+
+	put_u16(w, (uint16_t)count_stored(ring->buff, ring->length));
+	for (int i = 0; i < ring->length; i++) {
+		if (ring->buff[i].idx == EB_NULL_IDX)
+			continue;
+		put_u16(w, (uint16_t)i);
+		put_u16(w, ring->buff[i].sequence);
+		put_payload(w, buffer, ring->buff[i].idx);
+	}
+}
+
+static int get_rcv_ring(SnapshotReader* r, SkyRcvRing* ring, SkyElementBuffer* buffer)
+{
+	ring->head = get_u16(r);
+	ring->tail = get_u16(r);
+	ring->head_sequence = get_u16(r);
+	ring->tail_sequence = get_u16(r);
+	ring->horizon_map = (sky_arq_wide_mask_t)get_u32(r) << 32;
+	ring->horizon_map |= get_u32(r);
+	if (ring->head >= ring->length || ring->tail >= ring->length)
+		return SKY_RET_SNAPSHOT_INVALID;
+
+	//The ring is wiped by visiting the readable slots and the horizon only, so nothing may be restored outside them.
+	//Until the end of the horizon is found, the whole horizon is taken as received.
+	const int readable = ring_distance(ring->tail, ring->head, ring->length);
+	ring->horizon_end = (sky_arq_sequence_t)(ring->head_sequence + ring->horizon_width + 1);
+	if (readable + ring->horizon_width + 1 > ring->length)
+		return SKY_RET_SNAPSHOT_INVALID;
+
+	ring->storage_count = get_u16(r);
+	for (int i = 0; i < ring->storage_count; i++) {
+		int slot = get_u16(r);
+		if (slot >= ring->length || ring_distance(ring->tail, slot, ring->length) > readable + ring->horizon_width)
+			return SKY_RET_SNAPSHOT_INVALID;
+		ring->buff[slot].sequence = get_u16(r);
+		int idx = get_payload(r, buffer, ring->element_owner);
+		if (idx < 0)
+			return idx;
+		ring->buff[slot].idx = (sky_element_idx_t)idx;
+	}
+
+	// The end of the packets received ahead of the head is found from the slots.
+	ring->horizon_end = ring->head_sequence;
+	for (int i = 0; i <= ring->horizon_width; i++)
+		if (ring->buff[(ring->head + i) % ring->length].idx != EB_NULL_IDX)
+			ring->horizon_end = (sky_arq_sequence_t)(ring->head_sequence + i + 1);
+	if (ring->storage_count > ring->peak_storage_count)
+		ring->peak_storage_count = ring->storage_count;
+	return r->overrun ? SKY_RET_SNAPSHOT_INVALID : 0;
+}
+
+
+static void put_vc(SnapshotWriter* w, SkyVirtualChannel* vc)
+{
+	put_u8(w, vc->arq_state_flag);
+	put_u8(w, vc->handshake_send);
+	put_u32(w, vc->arq_session_identifier);
+	put_u8(w, vc->need_recall);
+	put_u32(w, (uint32_t)vc->last_tx_tick);
+	put_u32(w, (uint32_t)vc->last_rx_tick);
+	put_u32(w, (uint32_t)vc->last_ctrl_send_tick);
+	put_u16(w, (uint16_t)vc->unconfirmed_payloads);
+	put_u8(w, vc->header_compression);
+	put_u8(w, vc->wide_sequences);
+	put_u8(w, vc->link_initiator);
+	put_u8(w, vc->resync_realigned);
+	put_u16(w, vc->last_ctrl_rx_sequence);
+	put_u16(w, vc->sack_sequence);
+	put_u32(w, (uint32_t)vc->srtt);
+	put_u32(w, (uint32_t)vc->rttvar);
+	put_u32(w, (uint32_t)vc->rto);
+	put_u8(w, vc->rtt_probe_active);
+	put_u16(w, vc->rtt_probe_sequence);
+	put_u32(w, (uint32_t)vc->rtt_probe_tick);
+	put_u32(w, (uint32_t)vc->retransmit_timer_tick);
+	put_u16(w, vc->speculative_sequence);
+	put_u8(w, vc->speculative_resends_in_window);
+	put_u32(w, (uint32_t)vc->window_start_tick);
+	put_u16(w, vc->parity_sequence);
+
+	put_send_ring(w, vc->sendRing, vc->elementBuffer);
+	put_rcv_ring(w, vc->rcvRing, vc->elementBuffer);
+}
+
+static int get_vc(SnapshotReader* r, SkyVirtualChannel* vc)
+{
+	vc->arq_state_flag = get_u8(r);
+	vc->handshake_send = get_u8(r);
+	vc->arq_session_identifier = get_u32(r);
+	vc->need_recall = get_u8(r);
+	vc->last_tx_tick = (sky_tick_t)get_u32(r);
+	vc->last_rx_tick = (sky_tick_t)get_u32(r);
+	vc->last_ctrl_send_tick = (sky_tick_t)get_u32(r);
+	vc->unconfirmed_payloads = (int16_t)get_u16(r);
+	vc->header_compression = get_u8(r);
+	vc->wide_sequences = get_u8(r);
+	vc->link_initiator = get_u8(r);
+	vc->resync_realigned = get_u8(r);
+	vc->last_ctrl_rx_sequence = get_u16(r);
+	vc->sack_sequence = get_u16(r);
+	vc->srtt = (int32_t)get_u32(r);
+	vc->rttvar = (int32_t)get_u32(r);
+	vc->rto = (int32_t)get_u32(r);
+	vc->rtt_probe_active = get_u8(r);
+	vc->rtt_probe_sequence = get_u16(r);
+	vc->rtt_probe_tick = (sky_tick_t)get_u32(r);
+	vc->retransmit_timer_tick = (sky_tick_t)get_u32(r);
+	vc->speculative_sequence = get_u16(r);
+	vc->speculative_resends_in_window = get_u8(r);
+	vc->window_start_tick = (sky_tick_t)get_u32(r);
+	vc->parity_sequence = get_u16(r);
+
+	int ret = get_send_ring(r, vc->sendRing, vc->elementBuffer);
+	if (ret < 0)
+		return ret;
+	return get_rcv_ring(r, vc->rcvRing, vc->elementBuffer);
+}
+
+
+//Writes the image of the instance. Without a target, only counts its length.
+static size_t put_instance(SnapshotWriter* w, SkyHandle self)
+{
+	put_u32(w, SNAPSHOT_MAGIC);
+	put_u8(w, SNAPSHOT_VERSION);
+	put_u8(w, SKY_NUM_VIRTUAL_CHANNELS);
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		put_u16(w, (uint16_t)self->virtual_channels[i]->sendRing->length);
+		put_u16(w, (uint16_t)self->virtual_channels[i]->rcvRing->length);
+		put_u16(w, (uint16_t)self->virtual_channels[i]->rcvRing->horizon_width);
+	}
+
+	put_u32(w, (uint32_t)self->mac->T0);
+	put_u32(w, (uint32_t)self->mac->my_window_length);
+	put_u32(w, (uint32_t)self->mac->peer_window_length);
+	put_u32(w, (uint32_t)self->mac->last_belief_update);
+	put_u32(w, (uint32_t)self->mac->window_adjust_counter);
+	put_u8(w, self->mac->vc_round_robin_start);
+
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		put_u16(w, self->hmac->sequence_tx[i]);
+		put_u16(w, self->hmac->sequence_rx[i]);
+		put_u8(w, self->hmac->vc_enforcement_need[i]);
+	}
+
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++)
+		put_vc(w, self->virtual_channels[i]);
+	return w->pos;
+}
+
+
+// ==== PUBLIC FUNCTIONS ===============================================================================================
+
+//Saves the state of the instance. Returns the length of the image, or negative error if it doesn't fit.
+int sky_snapshot(SkyHandle self, void* buf, size_t len)
+{
+	//Count the length first so that nothing is written if the image doesn't fit.
+	SnapshotWriter counter = { NULL, 0, 0 };
+	size_t image_len = put_instance(&counter, self) + 4;
+	if (buf == NULL)
+		return (int)image_len;
+	if (image_len > len)
+		return SKY_RET_SNAPSHOT_NO_SPACE;
+
+	SnapshotWriter w = { buf, len, 0 };
+	put_instance(&w, self);
+	put_u32(&w, sky_crc32(w.buf, (unsigned int)w.pos));
+	return (int)w.pos;
+}
+
+//Restores the state saved by sky_snapshot. Returns 0 on success, or negative error.
+int sky_restore(SkyHandle self, const void* buf, size_t len)
+{
+	//Check the integrity and the version of the image, and that its rings match the instance, before touching anything.
+	if (len < SNAPSHOT_HEADER_LEN + 4)
+		return SKY_RET_SNAPSHOT_INVALID;
+	SnapshotReader r = { buf, len - 4, 0, 0 };
+	SnapshotReader crc = { (const uint8_t*)buf + len - 4, 4, 0, 0 };
+	if (get_u32(&crc) != sky_crc32(r.buf, (unsigned int)r.len))
+		return SKY_RET_SNAPSHOT_INVALID;
+	if (get_u32(&r) != SNAPSHOT_MAGIC || get_u8(&r) != SNAPSHOT_VERSION || get_u8(&r) != SKY_NUM_VIRTUAL_CHANNELS)
+		return SKY_RET_SNAPSHOT_INVALID;
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		const SkyVirtualChannel* vc = self->virtual_channels[i];
+		const int send_ring_len = get_u16(&r);
+		const int rcv_ring_len = get_u16(&r);
+		const int horizon_width = get_u16(&r);
+		if (send_ring_len != vc->sendRing->length || rcv_ring_len != vc->rcvRing->length || horizon_width != vc->rcvRing->horizon_width)
+			return SKY_RET_SNAPSHOT_MISMATCH;
+	}
+
+	self->mac->T0 = (sky_tick_t)get_u32(&r);
+	self->mac->my_window_length = (sky_tick_t)get_u32(&r);
+	self->mac->peer_window_length = (sky_tick_t)get_u32(&r);
+	self->mac->last_belief_update = (sky_tick_t)get_u32(&r);
+	self->mac->window_adjust_counter = (int32_t)get_u32(&r);
+	self->mac->vc_round_robin_start = get_u8(&r);
+
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		self->hmac->sequence_tx[i] = get_u16(&r);
+		self->hmac->sequence_rx[i] = get_u16(&r);
+		self->hmac->vc_enforcement_need[i] = get_u8(&r);
+	}
+
+	//Empty every virtual channel first, so that a shared element buffer has room for all of the payloads.
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++)
+		sky_vc_wipe_to_arq_off_state(self->virtual_channels[i]);
+	int ret = 0;
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS && ret == 0; i++)
+		ret = get_vc(&r, self->virtual_channels[i]);
+	if (ret == 0 && r.pos != r.len)
+		ret = SKY_RET_SNAPSHOT_INVALID;
+	if (ret == 0)
+		return 0;
+
+	//Leave no half restored virtual channels. A payload that doesn't fit means the element buffers are configured differently.
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++)
+		sky_vc_wipe_to_arq_off_state(self->virtual_channels[i]);
+	return (ret == SKY_RET_SNAPSHOT_INVALID) ? SKY_RET_SNAPSHOT_INVALID : SKY_RET_SNAPSHOT_MISMATCH;
+}
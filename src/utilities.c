@@ -7,13 +7,52 @@
 #include "skylink/mac.h"
 #include "skylink/reliable_vc.h"
 #include "skylink/hmac.h"
+#include "skylink/element_buffer.h"
+#include "skylink/fec.h"
 
 #include "sky_platform.h"
 
 #include <string.h> // memset, memcpy
 
-// Create new Skylink protocol instance based on the configuration struct.
-SkyHandle sky_create(SkyConfig *config)
+// Sanity check pool parameters and set to default if invalid value in config.
+static void check_pool_config(SkyPoolConfig *pool_conf)
+{
+	if (pool_conf->element_count > EB_MAX_ELEMENT_COUNT)
+		pool_conf->element_count = EB_MAX_ELEMENT_COUNT;
+	if (pool_conf->usable_element_size < 12 || pool_conf->usable_element_size > 500)
+		pool_conf->usable_element_size = 32;
+}
+
+// Create the element buffer shared by all virtual channels and give every virtual channel its quota.
+static SkyElementBuffer* create_element_pool(SkyArena *arena, SkyConfig *config)
+{
+	SkyPoolConfig *pool_conf = &config->pool;
+	check_pool_config(pool_conf);
+
+	SkyElementBuffer *pool = sky_element_buffer_create(arena, pool_conf->usable_element_size, pool_conf->element_count);
+	SKY_ASSERT(pool != NULL);
+	if (pool_conf->contiguous_allocation == 1)
+		sky_element_buffer_set_allocation_policy(arena, pool, EB_ALLOC_CONTIGUOUS);
+	if (pool_conf->split_element_layout == 1)
+		sky_element_buffer_set_layout(pool, EB_LAYOUT_SPLIT);
+	sky_element_buffer_enable_quotas(arena, pool, SKY_NUM_VIRTUAL_CHANNELS);
+
+	// A minimum that doesn't fit in the pool with the earlier ones, or is above the maximum, is dropped.
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i) {
+		SkyVCConfig *vc_conf = &config->vc[i];
+		if (vc_conf->pool_maximum_elements < 0)
+			vc_conf->pool_maximum_elements = 0;
+		if (vc_conf->pool_minimum_elements < 0 ||
+		    sky_element_buffer_set_quota(pool, i, vc_conf->pool_minimum_elements, vc_conf->pool_maximum_elements) < 0) {
+			vc_conf->pool_minimum_elements = 0;
+			sky_element_buffer_set_quota(pool, i, 0, vc_conf->pool_maximum_elements);
+		}
+	}
+	return pool;
+}
+
+// Create new Skylink protocol instance in the arena, or with SKY_MALLOC if 'arena' is NULL.
+static SkyHandle create_instance(SkyArena *arena, SkyConfig *config)
 {
 
 	// Sanity check identity length
@@ -28,10 +67,16 @@ SkyHandle sky_create(SkyConfig *config)
 		arq_conf->idle_frame_threshold = 1000;
 	if (arq_conf->idle_frames_per_window < 1 || arq_conf->idle_frames_per_window > 4)
 		arq_conf->idle_frames_per_window = 1;
+	if (arq_conf->speculative_resends_per_window < 0 || arq_conf->speculative_resends_per_window > 16)
+		arq_conf->speculative_resends_per_window = 0;
+	if (arq_conf->parity_group_size < 0 || arq_conf->parity_group_size == 1 || arq_conf->parity_group_size > 16)
+		arq_conf->parity_group_size = 0;
+	if (arq_conf->fec_cache_frames < 0 || arq_conf->fec_cache_frames > 256)
+		arq_conf->fec_cache_frames = 0;
 
 
 	//Allocate memory for Skylink instance and set it to zero.
-	SkyHandle handle = SKY_MALLOC(sizeof(struct sky_all));
+	SkyHandle handle = sky_allocate(arena, sizeof(struct sky_all));
 	SKY_ASSERT(handle != NULL);
 	memset(handle, 0, sizeof(struct sky_all));
 
@@ -39,21 +84,33 @@ SkyHandle sky_create(SkyConfig *config)
 	handle->conf = config;
 
 	// Create diagnostics instance.
-	handle->diag = sky_diag_create();
+	handle->diag = sky_diag_create(arena);
 	SKY_ASSERT(handle != NULL);
 
 	// Create TDD/MAC instance.
-	handle->mac = sky_mac_create(&config->mac);
+	handle->mac = sky_mac_create(arena, &config->mac);
 	SKY_ASSERT(handle->mac != NULL);
 
 	// Create HMAC instance.
-	handle->hmac = sky_hmac_create(&config->hmac);
+	handle->hmac = sky_hmac_create(arena, &config->hmac);
 	SKY_ASSERT(handle->hmac != NULL);
 
+	// Create the shared element pool.
+	if (config->pool.element_count > 0)
+		handle->element_pool = create_element_pool(arena, config);
+
+	// Create the FEC codeword cache.
+	handle->tx_fec_key = -1;
+	if (arq_conf->fec_cache_frames > 0)
+		handle->fec_cache = sky_fec_cache_create(arena, arq_conf->fec_cache_frames);
+
 	// Create virtual channels.
 	for (unsigned int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i)
 	{
-		handle->virtual_channels[i] = sky_vc_create(&config->vc[i]);
+		if (handle->element_pool != NULL)
+			handle->virtual_channels[i] = sky_vc_create_in_pool(arena, &config->vc[i], handle->element_pool, i);
+		else
+			handle->virtual_channels[i] = sky_vc_create_in_pool(arena, &config->vc[i], NULL, EB_NO_OWNER);
 		SKY_ASSERT(handle->hmac != NULL);
 	}
 
@@ -61,18 +118,90 @@ SkyHandle sky_create(SkyConfig *config)
 	return handle;
 }
 
+// Create new Skylink protocol instance based on the configuration struct.
+SkyHandle sky_create(SkyConfig *config)
+{
+	return create_instance(NULL, config);
+}
+
+// Number of bytes sky_create_in needs for an instance of the configuration. Mirrors the allocations of sky_create.
+size_t sky_required_memory(const SkyConfig *config)
+{
+	// Room for aligning the start of the arena.
+	size_t size = SKY_CACHE_LINE_SIZE - 1;
+	size += SKY_ARENA_SIZE(sizeof(struct sky_all));
+	size += SKY_ARENA_SIZE(sizeof(SkyDiagnostics));
+	size += SKY_ARENA_SIZE(sizeof(SkyMAC));
+	size += sky_hmac_required_memory(&config->hmac);
+
+	const int in_pool = (config->pool.element_count > 0);
+	if (in_pool) {
+		SkyPoolConfig pool_conf = config->pool;
+		check_pool_config(&pool_conf);
+		size += sky_element_buffer_required_memory(pool_conf.usable_element_size, pool_conf.element_count,
+		                                           (pool_conf.contiguous_allocation == 1) ? EB_ALLOC_CONTIGUOUS : EB_ALLOC_FREE_LIST,
+		                                           SKY_NUM_VIRTUAL_CHANNELS);
+	}
+	if (config->arq.fec_cache_frames > 0 && config->arq.fec_cache_frames <= 256)
+		size += sky_fec_cache_required_memory(config->arq.fec_cache_frames);
+	for (unsigned int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i)
+		size += sky_vc_required_memory(&config->vc[i], in_pool);
+	return size;
+}
+
+// Create new Skylink protocol instance with all of its state in the given arena.
+SkyHandle sky_create_in(void *arena, size_t len, SkyConfig *config)
+{
+	if (arena == NULL || len < sky_required_memory(config))
+		return NULL;
+
+	// Every allocation of the creation is taken from the arena, starting from its first cache line.
+	SkyArena cursor;
+	cursor.next = (uint8_t*)(((uintptr_t)arena + SKY_CACHE_LINE_SIZE - 1) & ~(uintptr_t)(SKY_CACHE_LINE_SIZE - 1));
+	cursor.end = (uint8_t*)arena + len;
+	SkyHandle handle = create_instance(&cursor, config);
+
+	if (handle != NULL)
+		handle->arena = arena;
+	return handle;
+}
+
 // Destroy Skylink instance and free all of its memory.
 void sky_destroy(SkyHandle handle)
 {
+	// The memory of an instance created in an arena belongs to the caller.
+	if (handle->arena != NULL)
+		return;
+
 	sky_diag_destroy(handle->diag);
 	sky_mac_destroy(handle->mac);
 	sky_hmac_destroy(handle->hmac);
 	for (unsigned int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; ++i)
 		sky_vc_destroy(handle->virtual_channels[i]);
+	if (handle->element_pool != NULL)
+		sky_element_buffer_destroy(handle->element_pool);
+	if (handle->fec_cache != NULL)
+		sky_fec_cache_destroy(handle->fec_cache);
 	SKY_FREE(handle);
 }
 
 
+// MEMORY ==========================================================================================================
+
+// Takes the next cache lines of the arena, or allocates from the heap without one.
+void* sky_allocate(SkyArena* arena, size_t size)
+{
+	if (arena == NULL)
+		return SKY_MALLOC(size);
+	size = SKY_ARENA_SIZE(size);
+	if (size > (size_t)(arena->end - arena->next))
+		return NULL;
+	void* ptr = arena->next;
+	arena->next += size;
+	return ptr;
+}
+
+
 // GENERAL PURPOSE =====================================================================================================
 /*
 *	Functions for swapping endian ordering if needed.
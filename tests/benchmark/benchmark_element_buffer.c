@@ -0,0 +1,131 @@
+/*
+Benchmark for element_buffer.c
+
+Measures the average latency of storing, reading and deleting a payload as a function of how full the buffer is.
+The buffer is first filled to the given level with payloads of random length and then churned by deleting
+random payloads and storing new ones, so that the free elements are scattered around the pool as in a long
+running link. At every fill level the timed store is immediately followed by the timed read and delete, so the
+level stays constant during the measurement. Both allocation policies, and the split layout together with the
+contiguous allocation, are measured, and the fragmentation statistics of the buffer are printed after the
+measurement at each level.
+*/
+
+#include "skylink/element_buffer.h"
+#include "tools.h"
+
+
+#define ELEMENT_USABLE_SIZE     32
+#define ELEMENT_COUNT           8192
+#define MAX_PAYLOAD_LEN         200
+#define MAX_STORED              ELEMENT_COUNT
+#define CHURN_ROUNDS            (4 * ELEMENT_COUNT)
+#define TIMED_ROUNDS            20000
+
+
+static int stored[MAX_STORED];
+static int n_stored = 0;
+
+// Store a random length payload. Returns 0 on success.
+static int store_random(SkyElementBuffer* buffer, const uint8_t* payload)
+{
+	int idx = sky_element_buffer_store(buffer, payload, (sky_element_length_t)(1 + rand() % MAX_PAYLOAD_LEN));
+	if (idx < 0)
+		return idx;
+	stored[n_stored++] = idx;
+	return 0;
+}
+
+// Delete a random stored payload.
+static void delete_random(SkyElementBuffer* buffer)
+{
+	int i = rand() % n_stored;
+	sky_element_buffer_delete(buffer, (sky_element_idx_t)stored[i]);
+	stored[i] = stored[--n_stored];
+}
+
+// Fraction of the elements in use.
+static double fill_level(SkyElementBuffer* buffer)
+{
+	return 1.0 - (double)buffer->free_elements / buffer->element_count;
+}
+
+// Run the benchmark with the given allocation policy and layout. Returns 0 if the buffer is still consistent afterwards.
+static int run(int policy, int layout, const uint8_t* payload)
+{
+	uint8_t target[MAX_PAYLOAD_LEN];
+	srand(1);
+	n_stored = 0;
+	SkyElementBuffer* buffer = sky_element_buffer_create(NULL, ELEMENT_USABLE_SIZE, ELEMENT_COUNT);
+	sky_element_buffer_set_allocation_policy(NULL, buffer, policy);
+	sky_element_buffer_set_layout(buffer, layout);
+
+	printf("Element buffer: %d elements of %d bytes, %s allocation, %s layout\n", ELEMENT_COUNT, ELEMENT_USABLE_SIZE,
+	       (policy == EB_ALLOC_CONTIGUOUS) ? "contiguous" : "free list", (layout == EB_LAYOUT_SPLIT) ? "split" : "interleaved");
+	printf(" fill %%   store ns    read ns   delete ns   free runs   largest run   fragmented %%\n");
+
+	for (int level = 0; level <= 95; level += 5) {
+
+		// Fill up to the level and scatter the free elements.
+		while (fill_level(buffer) < level / 100.0)
+			if (store_random(buffer, payload) < 0)
+				break;
+		for (int i = 0; i < CHURN_ROUNDS && n_stored > 0; i++) {
+			delete_random(buffer);
+			while (fill_level(buffer) < level / 100.0)
+				if (store_random(buffer, payload) < 0)
+					break;
+		}
+
+		// Time store and delete pairs. The stored payload is deleted right away so the level doesn't change.
+		uint64_t store_us = 0, read_us = 0, delete_us = 0;
+		int n_timed = 0;
+		for (int i = 0; i < TIMED_ROUNDS; i++) {
+			sky_element_length_t length = (sky_element_length_t)(1 + rand() % MAX_PAYLOAD_LEN);
+
+			uint64_t t0 = monotonic_microseconds();
+			int idx = sky_element_buffer_store(buffer, payload, length);
+			uint64_t t1 = monotonic_microseconds();
+			if (idx < 0)
+				continue;
+			sky_element_buffer_read(buffer, target, (sky_element_idx_t)idx, MAX_PAYLOAD_LEN);
+			uint64_t t2 = monotonic_microseconds();
+			sky_element_buffer_delete(buffer, (sky_element_idx_t)idx);
+			uint64_t t3 = monotonic_microseconds();
+
+			store_us += t1 - t0;
+			read_us += t2 - t1;
+			delete_us += t3 - t2;
+			n_timed++;
+		}
+
+		if (n_timed == 0)
+			break;
+		SkyElementBufferStats stats;
+		sky_element_buffer_get_stats(buffer, &stats);
+		printf("  %3d   %9.1f  %9.1f   %9.1f   %9d   %11d   %12.1f\n", level, 1000.0 * store_us / n_timed,
+		       1000.0 * read_us / n_timed, 1000.0 * delete_us / n_timed,
+		       stats.free_runs, stats.largest_free_run, stats.chains ? 100.0 * stats.fragmented_chains / stats.chains : 0.0);
+	}
+
+	int ok = sky_element_buffer_entire_buffer_is_ok(buffer);
+	sky_element_buffer_destroy(buffer);
+	if (!ok)
+		printf("Element buffer corrupted!\n");
+	printf("\n");
+	return ok ? 0 : 1;
+}
+
+int main()
+{
+	uint8_t payload[MAX_PAYLOAD_LEN];
+	for (int i = 0; i < MAX_PAYLOAD_LEN; i++)
+		payload[i] = (uint8_t)i;
+
+	if (run(EB_ALLOC_FREE_LIST, EB_LAYOUT_INTERLEAVED, payload) != 0)
+		return 1;
+	if (run(EB_ALLOC_CONTIGUOUS, EB_LAYOUT_INTERLEAVED, payload) != 0)
+		return 1;
+	if (run(EB_ALLOC_CONTIGUOUS, EB_LAYOUT_SPLIT, payload) != 0)
+		return 1;
+	return 0;
+}
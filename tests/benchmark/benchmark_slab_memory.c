@@ -0,0 +1,127 @@
+/*
+Memory efficiency benchmark for the slab element buffer.
+
+Compares single size element buffers of small, medium and full payload elements against a slab buffer of
+32, 96 and SKY_PAYLOAD_MAX_LEN + 2 byte classes that take the same amount of pool memory. The payload lengths are
+drawn from distributions resembling telemetry, mixed traffic and bulk transfers. The buffer is first filled until
+a store fails and then churned by deleting a random payload and storing new ones until a store fails again,
+as a virtual channel would when the buffer runs full. The payload bytes held at the failures tell how much of
+the pool memory carries payload, the rest being lost to links, length fields and the unused ends of elements.
+The elements per payload tell how long the chains are that have to be walked to read a payload.
+*/
+
+#include "skylink/element_buffer.h"
+#include "skylink/frame.h"
+#include "tools.h"
+
+
+#define POOL_BYTES              16384
+#define MAX_STORED              4096
+#define CHURN_ROUNDS            5000
+
+
+static int stored[MAX_STORED];
+static int n_stored = 0;
+
+// Payload length distributions, as probabilities of length ranges.
+typedef struct {
+	const char* name;
+	int n_ranges;
+	struct { int percent, min, max; } ranges[3];
+} Distribution;
+
+static const Distribution distributions[] = {
+	{ "telemetry", 2, { { 80, 8, 40 }, { 20, 41, 100 } } },
+	{ "mixed", 3, { { 50, 8, 40 }, { 30, 41, 120 }, { 20, 121, SKY_PAYLOAD_MAX_LEN } } },
+	{ "bulk", 2, { { 20, 8, 40 }, { 80, 150, SKY_PAYLOAD_MAX_LEN } } },
+};
+
+// Draw a payload length from the distribution.
+static int random_length(const Distribution* dist)
+{
+	int p = rand() % 100;
+	for (int i = 0; i < dist->n_ranges; i++) {
+		if (p < dist->ranges[i].percent)
+			return dist->ranges[i].min + rand() % (dist->ranges[i].max - dist->ranges[i].min + 1);
+		p -= dist->ranges[i].percent;
+	}
+	return dist->ranges[dist->n_ranges - 1].max;
+}
+
+// Store payloads until a store fails. Returns the number of payload bytes held.
+static int fill(SkyElementBuffer* buffer, const Distribution* dist, const uint8_t* payload, int* held_bytes)
+{
+	while (n_stored < MAX_STORED) {
+		int length = random_length(dist);
+		int idx = sky_element_buffer_store(buffer, payload, (sky_element_length_t)length);
+		if (idx < 0)
+			break;
+		stored[n_stored++] = idx;
+		*held_bytes += length;
+	}
+	return *held_bytes;
+}
+
+// Run the distribution on the buffer. Prints the average number of payloads and payload bytes held when full.
+static int run(SkyElementBuffer* buffer, const char* name, const Distribution* dist, const uint8_t* payload)
+{
+	srand(1);
+	n_stored = 0;
+	int held_bytes = 0;
+	double sum_bytes = 0, sum_packets = 0, sum_elements = 0;
+
+	fill(buffer, dist, payload, &held_bytes);
+	for (int i = 0; i < CHURN_ROUNDS && n_stored > 0; i++) {
+		int j = rand() % n_stored;
+		held_bytes -= sky_element_buffer_get_data_length(buffer, (sky_element_idx_t)stored[j]);
+		sky_element_buffer_delete(buffer, (sky_element_idx_t)stored[j]);
+		stored[j] = stored[--n_stored];
+		sum_bytes += fill(buffer, dist, payload, &held_bytes);
+		sum_packets += n_stored;
+		sum_elements += buffer->element_count - buffer->free_elements;
+	}
+
+	printf("  %-10s %-22s %9.1f %11.0f %11.1f %12.2f\n", dist->name, name, sum_packets / CHURN_ROUNDS, sum_bytes / CHURN_ROUNDS,
+	       100.0 * sum_bytes / CHURN_ROUNDS / POOL_BYTES, sum_elements / sum_packets);
+
+	int ok = sky_element_buffer_entire_buffer_is_ok(buffer);
+	sky_element_buffer_wipe(buffer);
+	if (!ok)
+		printf("Element buffer corrupted!\n");
+	return ok ? 0 : 1;
+}
+
+int main()
+{
+	uint8_t payload[SKY_PAYLOAD_MAX_LEN];
+	for (int i = 0; i < SKY_PAYLOAD_MAX_LEN; i++)
+		payload[i] = (uint8_t)i;
+
+	// Single size buffers with all of the pool in one element size.
+	const int32_t plain_sizes[] = { 32, 64, SKY_PAYLOAD_MAX_LEN + EB_LEN_BYTES };
+	SkyElementBuffer* buffers[4];
+	char names[4][32];
+	for (int i = 0; i < 3; i++) {
+		buffers[i] = sky_element_buffer_create(NULL, plain_sizes[i], POOL_BYTES / (plain_sizes[i] + 4));
+		snprintf(names[i], sizeof(names[i]), "%d byte elements", (int)plain_sizes[i]);
+	}
+
+	// Slab buffer with 40 %, 30 % and 30 % of the pool in the classes.
+	const int32_t slab_sizes[] = { 32, 96, SKY_PAYLOAD_MAX_LEN + EB_LEN_BYTES };
+	const int32_t slab_counts[] = { 4 * POOL_BYTES / 10 / (32 + 4), 3 * POOL_BYTES / 10 / (96 + 4), 3 * POOL_BYTES / 10 / (slab_sizes[2] + 4) };
+	buffers[3] = sky_element_buffer_create_slab(NULL, slab_sizes, slab_counts, 3);
+	snprintf(names[3], sizeof(names[3]), "slab %d/%d/%d", (int)slab_sizes[0], (int)slab_sizes[1], (int)slab_sizes[2]);
+
+	printf("Payloads held in a full %d byte pool, averaged over %d churn rounds\n", POOL_BYTES, CHURN_ROUNDS);
+	printf("  traffic    buffer                  payloads       bytes   payload %%   elements/pl\n");
+	for (size_t d = 0; d < sizeof(distributions) / sizeof(distributions[0]); d++) {
+		for (int i = 0; i < 4; i++)
+			if (run(buffers[i], names[i], &distributions[d], payload) != 0)
+				return 1;
+		printf("\n");
+	}
+
+	for (int i = 0; i < 4; i++)
+		sky_element_buffer_destroy(buffers[i]);
+	return 0;
+}
@@ -39,8 +39,31 @@ int main() {
 	printf("=======================\n");
 	printf("  %ld bytes allocated\n", allocated_bytes);
 	printf("  %d allocations\n", allocations);
+	printf("  %ld bytes for sky_create_in\n", sky_required_memory(config));
 	printf("=======================\n");
 
+	printf("\n-- Fill levels with random traffic --\n");
+	uint8_t payload[SKY_PAYLOAD_MAX_LEN];
+	fillrand(payload, sizeof(payload));
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		SkyVirtualChannel* vc = handle->virtual_channels[i];
+		while (sky_vc_push_packet_to_send(vc, payload, randint_i32(1, SKY_PAYLOAD_MAX_LEN)) >= 0);
+		while (sky_vc_push_rx_packet_monotonic(vc, payload, randint_i32(1, SKY_PAYLOAD_MAX_LEN)) >= 0);
+	}
+
+	SkyFillLevels levels;
+	sky_get_fill_levels(handle, &levels);
+	for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+		const SkyVCFillLevel* level = &levels.vc[i];
+		printf("  VC %d: send ring %d (peak %d), rcv ring %d (peak %d), elements %d used (peak %d), %d free\n", i,
+		       level->send_ring_used, level->send_ring_peak, level->rcv_ring_used, level->rcv_ring_peak,
+		       (int)level->used_elements, (int)level->peak_elements, (int)level->free_elements);
+		printf("        chain lengths:");
+		for (int j = 0; j < SKY_CHAIN_LENGTH_BINS; j++)
+			printf(" %d", (int)level->chain_lengths[j]);
+		printf("\n");
+	}
+
 	sky_destroy(handle);
 	free(config);
 	return 0;
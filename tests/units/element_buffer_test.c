@@ -35,7 +35,7 @@ static void test1(){
 static void test1_pass(int verbose){
 	reseed_random();
 	int elecount = 1700;
-	SkyElementBuffer* buffer = sky_element_buffer_create(64, elecount);
+	SkyElementBuffer* buffer = sky_element_buffer_create(NULL, 64, elecount);
 	buffer->last_write_index = randint_i32(0, elecount-1);
 
 	//generate N_pl test messages
@@ -230,7 +230,7 @@ static TestJob new_job(int minlen, int maxlen, int elecount){
 	job.n_msgs = elecount * 2;
 	job.general_direction = DIR_FORWARD;
 	job.n_in = 0;
-	job.buffer = sky_element_buffer_create(64, elecount);
+	job.buffer = sky_element_buffer_create(NULL, 64, elecount);
 	job.msgs = x_alloc(sizeof(TestMsg*) * job.n_msgs);
 	job.total_stored_content = 0;
 	for (int i = 0; i < job.n_msgs; ++i) {
@@ -384,7 +384,7 @@ static void test2(){
 //==== STORAGE SPACE UTILIZATION RATIO TEST ============================================================================
 //======================================================================================================================
 static double obtain_ratio(int elecount, int elesize, int pl_minsize, int pl_maxsize){
-	SkyElementBuffer* buffer = sky_element_buffer_create(elesize, elecount);
+	SkyElementBuffer* buffer = sky_element_buffer_create(NULL, elesize, elecount);
 	int n_strings = 0;
 	int content  = 0;
 	uint8_t* payload = x_alloc(pl_maxsize+20);
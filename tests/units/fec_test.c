@@ -41,7 +41,7 @@ void test1(){
 
 static int test1_round(){
 	SkyRadioFrame* frame = sky_frame_create();
-	SkyDiagnostics* diag = sky_diag_create();
+	SkyDiagnostics* diag = sky_diag_create(NULL);
 
 	int length = randint_i32(16+8, RS_MSGLEN);
 	int n_corrupt_bytes = randint_i32(0, 16); //16 seems like the highest with 100% success rate
@@ -81,7 +81,7 @@ static void test1_round()
 	if(randint_i32(0,1) == 1){
 		n_extensions++;
 		extension_arq_ctrl = 1;
-		sky_frame_add_extension_arq_ctrl(sframe, ctrl_tx, ctrl_rx);
+		sky_frame_add_extension_arq_ctrl(sframe, ctrl_tx, ctrl_rx, 1);
 	}
 
 	int extension_arq_handshake = 0;
@@ -99,7 +99,7 @@ static void test1_round()
 	if(randint_i32(0,1) == 1){
 		n_extensions++;
 		extension_arq_sequence = 1;
-		sky_frame_add_extension_arq_sequence(sframe, arq_sequence);
+		sky_frame_add_extension_arq_sequence(sframe, arq_sequence, 1);
 	}
 
 
@@ -109,7 +109,7 @@ static void test1_round()
 	if(randint_i32(0,1) == 1){
 		n_extensions++;
 		extension_arq_rrequest = 1;
-		sky_frame_add_extension_arq_request(sframe, rr_sequence, mask);
+		sky_frame_add_extension_arq_request(sframe, rr_sequence, mask, 1);
 	}
 
 
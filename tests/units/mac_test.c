@@ -38,7 +38,7 @@ void mac_test_cycle(){
 	config.shift_threshold_ticks = randint_i32(3, 100000);
 	config.unauthenticated_mac_updates = randint_i32(0,1);
 	config.carrier_sense_ticks = randint_i32(1,210);
-	SkyMAC* mac = sky_mac_create(&config);
+	SkyMAC* mac = sky_mac_create(NULL, &config);
 
 	//randomize state variables.
 	mac->total_frames_sent_in_current_window = 0;
@@ -35,7 +35,7 @@ void shuffle(int *array, size_t n)
 
 // Test the element buffer creation function
 TEST(create_element_buffer){
-    SkyElementBuffer* buff =  sky_element_buffer_create(20,100);
+    SkyElementBuffer* buff =  sky_element_buffer_create(NULL, 20,100);
     check_element_buffer(buff,20,100);
     sky_element_buffer_destroy(buff);
 }
@@ -45,7 +45,7 @@ TEST(create_element_buffer){
 
 TEST(store_and_read_data){
     // Create a buffer with 16 usable byte elements and 100 elements.
-    SkyElementBuffer* buff =  sky_element_buffer_create(16,100);
+    SkyElementBuffer* buff =  sky_element_buffer_create(NULL, 16,100);
 
     // Check the created buffer
     check_element_buffer(buff,16,100);
@@ -77,6 +77,34 @@ TEST(store_and_read_data){
     sky_element_buffer_destroy(buff);
 }
 
+// Test storing data gathered from multiple fragments. Fragment borders don't align with element borders.
+TEST(store_iov){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,100);
+    uint8_t *data = create_payload(50);
+
+    // Split the data in uneven fragments, including an empty one.
+    struct sky_iovec iov[4] = {
+        { data, 3 },
+        { data + 3, 0 },
+        { data + 3, 30 },
+        { data + 33, 17 }
+    };
+    int idx = sky_element_buffer_store_iov(buff, iov, 4);
+    ASSERT(idx == 0, "Invalid index. Expected: %d, got: %d", 0, idx);
+    ASSERT(buff->free_elements == 100 - sky_element_buffer_element_requirement_for(buff, 50));
+    ASSERT(sky_element_buffer_get_data_length(buff, idx) == 50);
+    ASSERT(sky_element_buffer_valid_chain(buff, idx));
+
+    // Read back and compare to the original.
+    uint8_t read_data[50];
+    int ret = sky_element_buffer_read(buff, read_data, idx, sizeof(read_data));
+    ASSERT(ret == 50, "Invalid read length: %d", ret);
+    ASSERT_MEMORY(read_data, data, 50);
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
 // Test the two functions for checking element requirements.
 TEST(element_requirements){
     // Element usable space is element size - 4 bytes.
@@ -98,7 +126,7 @@ TEST(element_requirements){
     for(int i = 0; i < n; i++){
         int usable_element_size = (rand() % 10000) + 1; // Zero division error if usable element size is 0.
         int length = rand() % 100000;
-        SkyElementBuffer* buff =  sky_element_buffer_create(usable_element_size,100);
+        SkyElementBuffer* buff =  sky_element_buffer_create(NULL, usable_element_size,100);
         int requirements = sky_element_buffer_element_requirement_for(buff,length);
         ASSERT(requirements == ((length+usable_element_size+1)/usable_element_size), "element_size: %d, length: %d, requirements: %d Got value: %d",usable_element_size,length,requirements,((length+usable_element_size+1)/usable_element_size));
         sky_element_buffer_destroy(buff);
@@ -108,7 +136,7 @@ TEST(element_requirements){
 // Test the wipe function, should wipe all elements in the buffer. Store multiple elements and wipe them. Check that the buffer is empty.
 TEST(wipe_element_buffer){
     // Create a buffer with 16 usable byte elements and 1000 elements.
-    SkyElementBuffer* buff =  sky_element_buffer_create(16,1000);
+    SkyElementBuffer* buff =  sky_element_buffer_create(NULL, 16,1000);
 
     // Check the created buffer
     check_element_buffer(buff,16,1000);
@@ -158,7 +186,7 @@ TEST(wipe_element_buffer){
 Have multiple chains and make sure that only the correct chain is deleted.*/
 TEST(delete_element){
     // Create a buffer with 16 usable byte elements and 1000 elements.
-    SkyElementBuffer* buff =  sky_element_buffer_create(16,1000);
+    SkyElementBuffer* buff =  sky_element_buffer_create(NULL, 16,1000);
 
     // Check the created buffer
     check_element_buffer(buff,16,1000);
@@ -225,4 +253,360 @@ TEST(delete_element){
 
 }
 
+// Test that deleted elements are reused from the free list, also when the buffer is full.
+TEST(free_list_reuse){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,100);
+    uint8_t *data = create_payload(80);
+    uint8_t read_data[40];
+    int idx[34];
+
+    // Fill the buffer completely with 3 element chains and one single element.
+    for (int i = 0; i < 33; i++) {
+        idx[i] = sky_element_buffer_store(buff, data, 40);
+        ASSERT(idx[i] >= 0, "Store %d failed: %d", i, idx[i]);
+    }
+    idx[33] = sky_element_buffer_store(buff, data, 10);
+    ASSERT(idx[33] >= 0);
+    ASSERT(buff->free_elements == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 1) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Free two chains far apart. A new chain is stored over them.
+    ASSERT(sky_element_buffer_delete(buff, idx[3]) == 0);
+    ASSERT(sky_element_buffer_delete(buff, idx[30]) == 0);
+    ASSERT(buff->free_elements == 6);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+    int new_idx = sky_element_buffer_store(buff, data, 80);
+    ASSERT(new_idx >= 0, "Store failed: %d", new_idx);
+    ASSERT(buff->free_elements == 0);
+    ASSERT(sky_element_buffer_valid_chain(buff, new_idx));
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+    ASSERT(sky_element_buffer_read(buff, read_data, new_idx, 40) == SKY_RET_EBUFFER_TOO_LONG_PAYLOAD);
+
+    // The rest of the chains are intact.
+    for (int i = 0; i < 33; i++) {
+        if (i == 3 || i == 30)
+            continue;
+        ASSERT(sky_element_buffer_read(buff, read_data, idx[i], 40) == 40);
+        ASSERT_MEMORY(read_data, data, 40);
+    }
+
+    // Wiping frees every element.
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+    ASSERT(sky_element_buffer_store(buff, data, 40) == 0);
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
+// Test that the contiguous policy places chains in runs of adjacent elements and the fragmentation statistics.
+TEST(contiguous_allocation){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,40);
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_CONTIGUOUS) == 0);
+    uint8_t *data = create_payload(60);
+    uint8_t read_data[60];
+    SkyElementBufferStats stats;
+
+    // 20 single element payloads fill half of the buffer.
+    int idx[20];
+    for (int i = 0; i < 20; i++) {
+        idx[i] = sky_element_buffer_store(buff, data, 10);
+        ASSERT(idx[i] == i, "Expected index %d, got %d", i, idx[i]);
+    }
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_FREE_LIST) == SKY_RET_EBUFFER_NOT_EMPTY);
+
+    // Punch single element holes. A 4 element payload still goes to the run after them.
+    for (int i = 0; i < 20; i += 2)
+        ASSERT(sky_element_buffer_delete(buff, idx[i]) == 0);
+    sky_element_buffer_get_stats(buff, &stats);
+    ASSERT(stats.free_elements == 30 && stats.free_runs == 11 && stats.largest_free_run == 20);
+    ASSERT(stats.chains == 10 && stats.fragmented_chains == 0);
+    int long_idx = sky_element_buffer_store(buff, data, 60);
+    ASSERT(long_idx == 20, "Expected index 20, got %d", long_idx);
+    ASSERT(sky_element_buffer_read(buff, read_data, long_idx, 60) == 60);
+    ASSERT_MEMORY(read_data, data, 60);
+
+    // Fill the rest of the run so that only the holes are left. The next chain is split over them in order.
+    while (buff->free_elements > 10)
+        ASSERT(sky_element_buffer_store(buff, data, 10) >= 20);
+    int split_idx = sky_element_buffer_store(buff, data, 60);
+    ASSERT(split_idx >= 0);
+    ASSERT(sky_element_buffer_read(buff, read_data, split_idx, 60) == 60);
+    ASSERT_MEMORY(read_data, data, 60);
+    sky_element_buffer_get_stats(buff, &stats);
+    ASSERT(stats.free_elements == 6 && stats.fragmented_chains == 1, "free %d fragmented %d", stats.free_elements, stats.fragmented_chains);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Back to the free list once the buffer is empty.
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_FREE_LIST) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 60) == 0);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
+// Test that the split layout keeps the data of adjacent elements contiguous, so that it is copied and exposed in one block.
+TEST(split_layout){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,40);
+    ASSERT(sky_element_buffer_set_layout(buff, EB_LAYOUT_SPLIT) == 0);
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_CONTIGUOUS) == 0);
+    uint8_t *data = create_payload(60);
+    uint8_t read_data[60];
+    struct sky_iovec spans[4];
+
+    // A contiguous chain is a single span.
+    int idx = sky_element_buffer_store(buff, data, 60);
+    ASSERT(idx == 0, "Expected index 0, got %d", idx);
+    ASSERT(sky_element_buffer_set_layout(buff, EB_LAYOUT_INTERLEAVED) == SKY_RET_EBUFFER_NOT_EMPTY);
+    ASSERT(sky_element_buffer_read(buff, read_data, idx, 60) == 60);
+    ASSERT_MEMORY(read_data, data, 60);
+    ASSERT(sky_element_buffer_get_spans(buff, idx, spans, 4) == 1);
+    ASSERT(spans[0].iov_len == 60);
+    ASSERT_MEMORY(spans[0].iov_base, data, 60);
+    ASSERT(sky_element_buffer_get_spans(buff, idx, spans, 3) < 0);
+
+    // Fill the buffer with single element payloads and punch holes so that the next chain is fragmented.
+    while (buff->free_elements > 0)
+        ASSERT(sky_element_buffer_store(buff, data, 10) >= 0);
+    for (int i = 4; i < 40; i += 3)
+        ASSERT(sky_element_buffer_delete(buff, i) == 0);
+    ASSERT(sky_element_buffer_delete(buff, 5) == 0);
+    idx = sky_element_buffer_store(buff, data, 60);
+    ASSERT(idx == 4, "Expected index 4, got %d", idx);
+    ASSERT(sky_element_buffer_read(buff, read_data, idx, 60) == 60);
+    ASSERT_MEMORY(read_data, data, 60);
+    ASSERT(sky_element_buffer_get_spans(buff, idx, spans, 4) == 3);
+    ASSERT(spans[0].iov_len == 30 && spans[1].iov_len == 16 && spans[2].iov_len == 14);
+    ASSERT_MEMORY(spans[0].iov_base, data, 30);
+    ASSERT_MEMORY(spans[1].iov_base, data + 30, 16);
+    ASSERT_MEMORY(spans[2].iov_base, data + 46, 14);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    ASSERT(sky_element_buffer_delete(buff, idx) == 0);
+    ASSERT(sky_element_buffer_delete(buff, 0) == 0);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Back to the interleaved layout once the buffer is empty.
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_set_layout(buff, EB_LAYOUT_INTERLEAVED) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 60) == 0);
+    ASSERT(sky_element_buffer_get_spans(buff, 0, spans, 4) == 4);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
+// Test chains much longer than a handful of elements, with both allocation policies.
+TEST(long_chains){
+    uint8_t *data = create_payload(1000);
+    uint8_t *read_data = malloc(1000);
+    for (int policy = EB_ALLOC_FREE_LIST; policy <= EB_ALLOC_CONTIGUOUS; policy++) {
+        // 4 byte elements, so a 1000 byte payload takes 251 elements.
+        SkyElementBuffer* buff = sky_element_buffer_create(NULL, 4, 600);
+        ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, policy) == 0);
+        int idx = sky_element_buffer_store(buff, data, 1000);
+        ASSERT(idx == 0, "Policy %d: expected index 0, got %d", policy, idx);
+        ASSERT(buff->free_elements == 600 - 251);
+
+        // Fragment the rest of the buffer and store another one over the holes.
+        int small[87];
+        for (int i = 0; i < 87; i++)
+            small[i] = sky_element_buffer_store(buff, data, 6); // 2 elements each
+        for (int i = 0; i < 87; i += 2)
+            ASSERT(sky_element_buffer_delete(buff, small[i]) == 0);
+        int idx2 = sky_element_buffer_store(buff, data, 1000);
+        ASSERT(idx2 >= 0, "Policy %d: store failed: %d", policy, idx2);
+        ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+        ASSERT(sky_element_buffer_read(buff, read_data, idx, 1000) == 1000);
+        ASSERT_MEMORY(read_data, data, 1000);
+        ASSERT(sky_element_buffer_read(buff, read_data, idx2, 1000) == 1000);
+        ASSERT_MEMORY(read_data, data, 1000);
+        ASSERT(sky_element_buffer_delete(buff, idx) == 0);
+        ASSERT(sky_element_buffer_delete(buff, idx2) == 0);
+        ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+        sky_element_buffer_destroy(buff);
+    }
+    free(read_data);
+    free(data);
+}
+
+// Test that wiping leaves the elements untouched and they are initialized as they are taken again.
+TEST(lazy_wipe){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,100);
+    uint8_t *data = create_payload(40);
+    uint8_t read_data[40];
+    struct sky_iovec spans[3];
+    int idx[10];
+
+    for (int i = 0; i < 10; i++)
+        idx[i] = sky_element_buffer_store(buff, data, 40);
+    ASSERT(buff->fresh_index == 30);
+    sky_element_buffer_wipe(buff);
+    ASSERT(buff->fresh_index == 0 && buff->free_elements == 100);
+
+    // The old chains are gone although their links are still in the pool.
+    for (int i = 0; i < 10; i++) {
+        ASSERT(sky_element_buffer_read(buff, read_data, idx[i], 40) == SKY_RET_EBUFFER_INVALID_INDEX);
+        ASSERT(sky_element_buffer_get_data_length(buff, idx[i]) == SKY_RET_EBUFFER_INVALID_INDEX);
+        ASSERT(sky_element_buffer_get_spans(buff, idx[i], spans, 3) == SKY_RET_EBUFFER_INVALID_INDEX);
+        ASSERT(sky_element_buffer_delete(buff, idx[i]) == SKY_RET_EBUFFER_INVALID_INDEX);
+        ASSERT(!sky_element_buffer_valid_chain(buff, idx[i]));
+    }
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // New chains take the elements in ascending order over the stale ones.
+    ASSERT(sky_element_buffer_store(buff, data, 10) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 40) == 1);
+    ASSERT(buff->fresh_index == 4);
+    ASSERT(sky_element_buffer_delete(buff, 0) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 40) == 0); // Freed element first, then untouched ones.
+    ASSERT(buff->fresh_index == 6);
+    ASSERT(sky_element_buffer_read(buff, read_data, 0, 40) == 40);
+    ASSERT_MEMORY(read_data, data, 40);
+    ASSERT(sky_element_buffer_get_data_length(buff, 4) == SKY_RET_EBUFFER_INVALID_INDEX);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // With the contiguous policy the elements are taken from the free map.
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_CONTIGUOUS) == 0);
+    for (int i = 0; i < 10; i++)
+        ASSERT(sky_element_buffer_store(buff, data, 40) == 3 * i);
+    ASSERT(sky_element_buffer_delete(buff, 3) == 0);
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+    ASSERT(sky_element_buffer_store(buff, data, 40) == 0);
+    ASSERT(sky_element_buffer_read(buff, read_data, 0, 40) == 40);
+    ASSERT(sky_element_buffer_read(buff, read_data, 3, 40) == SKY_RET_EBUFFER_INVALID_INDEX);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
+// Test sharing a buffer between owners with minimum and maximum quotas.
+TEST(element_quotas){
+    SkyElementBuffer* buff = sky_element_buffer_create(NULL, 16,40);
+    uint8_t *data = create_payload(14);
+    struct sky_iovec iov = { data, 14 }; // One element each.
+    int idx[40];
+
+    // Quotas can be enabled only on an empty buffer and the minimums must fit in the buffer together.
+    idx[0] = sky_element_buffer_store(buff, data, 14);
+    ASSERT(sky_element_buffer_enable_quotas(NULL, buff, 2) == SKY_RET_EBUFFER_NOT_EMPTY);
+    sky_element_buffer_wipe(buff);
+    ASSERT(sky_element_buffer_enable_quotas(NULL, buff, EB_MAX_OWNERS + 1) == SKY_RET_EBUFFER_INVALID_QUOTA);
+    ASSERT(sky_element_buffer_enable_quotas(NULL, buff, 2) == 0);
+    ASSERT(sky_element_buffer_set_quota(buff, 0, 10, 0) == 0);
+    ASSERT(sky_element_buffer_set_quota(buff, 1, 5, 20) == 0);
+    ASSERT(sky_element_buffer_set_quota(buff, 1, 31, 0) == SKY_RET_EBUFFER_INVALID_QUOTA);
+    ASSERT(sky_element_buffer_set_quota(buff, 1, 21, 20) == SKY_RET_EBUFFER_INVALID_QUOTA);
+    ASSERT(sky_element_buffer_set_quota(buff, 2, 0, 0) == SKY_RET_EBUFFER_INVALID_QUOTA);
+    ASSERT(buff->reserved_elements == 15);
+    ASSERT(sky_element_buffer_available_elements(buff, 0) == 35);
+    ASSERT(sky_element_buffer_available_elements(buff, 1) == 20);
+    ASSERT(sky_element_buffer_available_elements(buff, EB_NO_OWNER) == 25);
+
+    // Owner 1 stops at its maximum.
+    for (int i = 0; i < 20; i++)
+        ASSERT(sky_element_buffer_store_iov_for(buff, 1, &iov, 1) >= 0);
+    ASSERT(sky_element_buffer_store_iov_for(buff, 1, &iov, 1) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(buff->quotas[1].used == 20);
+    ASSERT(sky_element_buffer_free_space_for(buff, 1) == 0);
+
+    // Chains of no owner can't take the minimum of owner 0.
+    for (int i = 0; i < 10; i++)
+        idx[i] = sky_element_buffer_store(buff, data, 14);
+    ASSERT(sky_element_buffer_store(buff, data, 14) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(sky_element_buffer_available_elements(buff, 0) == 10);
+    for (int i = 10; i < 20; i++)
+        idx[i] = sky_element_buffer_store_iov_for(buff, 0, &iov, 1);
+    ASSERT(buff->free_elements == 0 && buff->reserved_elements == 0);
+    ASSERT(buff->quotas[0].used == 10);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Deleting credits the elements back to the owner of the chain.
+    ASSERT(sky_element_buffer_delete(buff, idx[10]) == 0);
+    ASSERT(buff->quotas[0].used == 9 && buff->reserved_elements == 1);
+    ASSERT(sky_element_buffer_available_elements(buff, 1) == 0);
+    ASSERT(sky_element_buffer_available_elements(buff, 0) == 1);
+    ASSERT(sky_element_buffer_delete(buff, idx[0]) == 0);
+    ASSERT(sky_element_buffer_available_elements(buff, EB_NO_OWNER) == 1);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Wiping resets the charges.
+    sky_element_buffer_wipe(buff);
+    ASSERT(buff->quotas[0].used == 0 && buff->quotas[1].used == 0 && buff->reserved_elements == 15);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
+// Test that a slab buffer stores each payload in the smallest class that fits it and falls back to the other classes.
+TEST(slab_buffer){
+    const int32_t sizes[3] = { 32, 96, 183 };
+    const int32_t counts[3] = { 8, 2, 2 }; // Indexes 0-7, 8-9 and 10-11.
+    SkyElementBuffer* buff = sky_element_buffer_create_slab(NULL, sizes, counts, 3);
+    ASSERT(buff->element_count == 12 && buff->free_elements == 12);
+    ASSERT(sky_element_buffer_enable_quotas(NULL, buff, 2) == SKY_RET_EBUFFER_INVALID_QUOTA);
+    ASSERT(sky_element_buffer_element_requirement_for(buff, 20) == 1);
+    ASSERT(sky_element_buffer_element_requirement_for(buff, 150) == 1);
+    uint8_t *data = create_payload(181);
+    uint8_t read_data[181];
+
+    ASSERT(sky_element_buffer_store(buff, data, 20) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 60) == 8);
+    ASSERT(sky_element_buffer_store(buff, data, 150) == 10);
+    ASSERT(sky_element_buffer_store(buff, data, 181) == 11);
+
+    // The largest class is full and the 96 byte class has one element left, so this goes to 4 elements of 32 bytes.
+    ASSERT(sky_element_buffer_store(buff, data, 100) == 1);
+    ASSERT(buff->free_elements == 4);
+    ASSERT(sky_element_buffer_free_space(buff) == 94);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // The batch check places the packets as the stores would.
+    struct sky_iovec batch[3] = { { data, 60 }, { data, 60 }, { data, 60 } };
+    ASSERT(sky_element_buffer_can_store_all(buff, EB_NO_OWNER, batch, 2) == 1);
+    ASSERT(sky_element_buffer_can_store_all(buff, EB_NO_OWNER, batch, 3) == 0);
+
+    // Calls are passed on to the class holding the chain.
+    ASSERT(sky_element_buffer_get_data_length(buff, 11) == 181);
+    ASSERT(sky_element_buffer_read(buff, read_data, 11, 181) == 181);
+    ASSERT_MEMORY(read_data, data, 181);
+    ASSERT(sky_element_buffer_read(buff, read_data, 1, 181) == 100);
+    ASSERT_MEMORY(read_data, data, 100);
+    struct sky_iovec spans[4];
+    ASSERT(sky_element_buffer_get_spans(buff, 10, spans, 4) == 1);
+    ASSERT(spans[0].iov_len == 150);
+    ASSERT(sky_element_buffer_valid_chain(buff, 8));
+    ASSERT(sky_element_buffer_read(buff, read_data, 9, 181) == SKY_RET_EBUFFER_INVALID_INDEX);
+    ASSERT(sky_element_buffer_delete(buff, 12) == SKY_RET_EBUFFER_INVALID_INDEX);
+    SkyElementBufferStats stats;
+    sky_element_buffer_get_stats(buff, &stats);
+    ASSERT(stats.chains == 5 && stats.free_elements == 4);
+
+    ASSERT(sky_element_buffer_delete(buff, 8) == 0);
+    ASSERT(buff->free_elements == 5);
+    ASSERT(sky_element_buffer_store(buff, data, 60) == 8);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    // Wiping empties every class, after which the policy can be changed.
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_CONTIGUOUS) == SKY_RET_EBUFFER_NOT_EMPTY);
+    sky_element_buffer_wipe(buff);
+    ASSERT(buff->free_elements == 12);
+    ASSERT(sky_element_buffer_read(buff, read_data, 11, 181) == SKY_RET_EBUFFER_INVALID_INDEX);
+    ASSERT(sky_element_buffer_set_allocation_policy(NULL, buff, EB_ALLOC_CONTIGUOUS) == 0);
+    ASSERT(sky_element_buffer_store(buff, data, 181) == 10);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(buff));
+
+    free(data);
+    sky_element_buffer_destroy(buff);
+}
+
 //TODO: Implement tests for using invalid arguments for the functions.
\ No newline at end of file
@@ -4,7 +4,7 @@
 TEST(fec_successful)
 {
 	SkyRadioFrame* frame = sky_frame_create();
-	SkyDiagnostics* diag = sky_diag_create();
+	SkyDiagnostics* diag = sky_diag_create(NULL);
 
 	int length = randint_i32(16+8, RS_MSGLEN);
 	int n_corrupt_bytes = randint_i32(0, 16); // RS(223,256) can correct up to 16 byte errors.
@@ -64,6 +64,83 @@ TEST(fec_successful)
 	free(ref);
 }
 
+/*
+ * Encoding to an external buffer should produce the same bytes as encoding in place.
+ */
+TEST(fec_encode_to)
+{
+	SkyRadioFrame* frame = sky_frame_create();
+	SkyRadioFrame* ref = sky_frame_create();
+
+	int length = randint_i32(16+8, RS_MSGLEN);
+	fillrand(frame->raw, length);
+	frame->length = length;
+	memcpy(ref, frame, sizeof(SkyRadioFrame));
+
+	uint8_t out[RS_MSGLEN + RS_PARITYS];
+	ASSERT(sky_fec_encode_to(frame, out, length + RS_PARITYS - 1) == SKY_RET_RS_INVALID_LENGTH);
+	ASSERT(sky_fec_encode_to(frame, out, sizeof(out)) == length + RS_PARITYS);
+
+	// Source frame is not touched
+	ASSERT((int)frame->length == length);
+	ASSERT(memcmp(frame->raw, ref->raw, length) == 0);
+
+	sky_fec_encode(ref);
+	ASSERT((int)ref->length == length + RS_PARITYS);
+	ASSERT(memcmp(out, ref->raw, ref->length) == 0);
+
+	sky_frame_destroy(frame);
+	sky_frame_destroy(ref);
+}
+
+/*
+ * Updating the parity of a cached codeword should give the same bytes as encoding the frame from scratch.
+ */
+TEST(fec_encode_cached)
+{
+	SkyFecCache* cache = sky_fec_cache_create(NULL, 4);
+	SkyRadioFrame* frame = sky_frame_create();
+	SkyRadioFrame* ref = sky_frame_create();
+	uint8_t message[RS_MSGLEN];
+
+	// The parity is written after the message in the frame.
+	const int max_length = sizeof(frame->raw) - RS_PARITYS;
+
+	for (int round = 0; round < 200; round++) {
+		const int32_t key = randint_i32(0, 7);
+		int length = randint_i32(16+8, max_length);
+		fillrand(message, length);
+
+		// The previous frame of the key, if it has the same length, is the one that gets patched.
+		const SkyFecCacheEntry* entry = &cache->entries[key % 4];
+		if (entry->key == key && randint_i32(0, 3) != 0) {
+			length = entry->length;
+			memcpy(message, entry->codeword, length);
+			int n_changes = randint_i32(0, length / 4);
+			for (int i = 0; i < n_changes; i++)
+				message[randint_i32(0, length - 1)] = (uint8_t)randint_u32(0, 255);
+		}
+
+		memcpy(frame->raw, message, length);
+		frame->length = length;
+		memcpy(ref->raw, message, length);
+		ref->length = length;
+
+		ASSERT(sky_fec_encode_cached(cache, frame, (round % 10 == 0) ? -1 : key) == SKY_RET_OK);
+		sky_fec_encode(ref);
+		ASSERT(frame->length == ref->length);
+		ASSERT(memcmp(frame->raw, ref->raw, ref->length) == 0, "round %d", round);
+	}
+
+	// Too long frame to be encoded
+	frame->length = RS_MSGLEN + 1;
+	ASSERT(sky_fec_encode_cached(cache, frame, 1) == SKY_RET_RS_INVALID_LENGTH);
+
+	sky_frame_destroy(frame);
+	sky_frame_destroy(ref);
+	sky_fec_cache_destroy(cache);
+}
+
 /*
  *
  */
@@ -15,7 +15,7 @@ SkyHandle handle_create(SkyConfig* config){
 }
 
 SkyHMAC *hmac_create(SkyHandle handle){
-    SkyHMAC* hmac = sky_hmac_create(&handle->conf->hmac);
+    SkyHMAC* hmac = sky_hmac_create(NULL, &handle->conf->hmac);
     return hmac;
 }
 
@@ -25,7 +25,7 @@ TEST(mac_create){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Check that the struct is not NULL.
     ASSERT(mac != NULL, "Create MAC failed.");
@@ -86,7 +86,7 @@ TEST(mac_create_invalid_config){
     config->unauthenticated_mac_updates = 0;
     config->shift_threshold_ticks = 10000;
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(config);
+    SkyMAC* mac = sky_mac_create(NULL, config);
 
     // Assert values of the config, should change to defaults.
     ASSERT(mac->config->maximum_window_length_ticks == 200, "MAC window length ticks should be 200, was: %d", mac->config->maximum_window_length_ticks);
@@ -127,7 +127,7 @@ TEST(mac_create_invalid_config){
     config->unauthenticated_mac_updates = 0;
     config->shift_threshold_ticks = 10000;
     // Create SkyMAC struct.
-    mac = sky_mac_create(config);
+    mac = sky_mac_create(NULL, config);
 
     // Assert values of the config, should change to defaults.
     ASSERT(mac->config->maximum_window_length_ticks == 800, "MAC window length ticks should be 100, was: %d", mac->config->maximum_window_length_ticks);
@@ -157,7 +157,7 @@ TEST(mac_window_shift){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Tests:
     // Shift positive and negative lengths. Should shift backward by same amount no matter the sign.
@@ -195,7 +195,7 @@ TEST(mac_window_shift_wrap_around){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Tests:
     // Check that T0 is 0.
@@ -236,7 +236,7 @@ TEST(mac_window_expand){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Tests:
     // Check my window length and T0.
@@ -276,7 +276,7 @@ TEST(mac_window_shrink){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Tests:
     // Set my window length to max.
@@ -315,7 +315,7 @@ TEST(mac_window_times){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
     int n = 10000;
     int increment = 1;
     int now = 0;
@@ -374,7 +374,7 @@ TEST(mac_reset_to_send){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
     int n = 100000;
     // Tests:
     // Reseting no matter the time should result in mac_can_send(mac, now) == true.
@@ -420,7 +420,7 @@ TEST(mac_belief_update){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Test both versions of T0 calculation.
     // Initial values:
@@ -504,7 +504,7 @@ TEST(mac_carrier_sense){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
 
     // Tests:
     ASSERT(mac->config->carrier_sense_ticks == 200, "MAC carrier sense ticks should be 200, was: %d", mac->config->carrier_sense_ticks);
@@ -537,7 +537,7 @@ TEST(mac_is_idle_frame_needed){
     // Create SkyHandle struct.
     SkyHandle handle = sky_create(config);
     // Create SkyMAC struct.
-    SkyMAC* mac = sky_mac_create(&handle->conf->mac);
+    SkyMAC* mac = sky_mac_create(NULL, &handle->conf->mac);
     mac->last_belief_update = 1000;
 
     // Tests:
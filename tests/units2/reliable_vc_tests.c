@@ -49,10 +49,91 @@ TEST(sky_state){
     sky_destroy(handle);
 }
 
+// Test the fill levels of the rings and element buffers.
+TEST(fill_levels){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->vc[3].slab_element_counts[0] = 4;
+    config->vc[3].slab_element_counts[2] = 2;
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel* vc = handle->virtual_channels[0];
+    SkyFillLevels levels;
+    uint8_t *pl = create_payload(SKY_PAYLOAD_MAX_LEN);
+    uint8_t tgt[SKY_PAYLOAD_MAX_LEN];
+    sky_arq_sequence_t sequence;
+
+    // Three payloads of one element and one of two, two of them sent and one scheduled for resend.
+    sky_vc_wipe_to_arq_on_state(vc, 10);
+    for (int i = 0; i < 3; i++)
+        ASSERT(sky_vc_push_packet_to_send(vc, pl, 100) >= 0);
+    ASSERT(sky_vc_push_packet_to_send(vc, pl, SKY_PAYLOAD_MAX_LEN) >= 0);
+    ASSERT(sky_vc_read_packet_for_tx(vc, tgt, &sequence, 1) >= 0);
+    ASSERT(sky_vc_read_packet_for_tx(vc, tgt, &sequence, 1) >= 0);
+    ASSERT(sendRing_schedule_resend(vc->sendRing, 0) == 0);
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 50, 0, 0) >= 0);
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 50, 2, 0) >= 0);
+
+    sky_get_fill_levels(handle, &levels);
+    ASSERT(levels.vc[0].send_ring_used == 4 && levels.vc[0].send_ring_peak == 4);
+    ASSERT(levels.vc[0].resend_queue == 1);
+    ASSERT(levels.vc[0].rcv_ring_used == 2 && levels.vc[0].rcv_ring_peak == 2);
+    ASSERT(levels.vc[0].used_elements == 7 && levels.vc[0].peak_elements == 7, "%d", levels.vc[0].used_elements);
+    ASSERT(levels.vc[0].free_elements == vc->elementBuffer->element_count - 7);
+    ASSERT(levels.vc[0].chain_lengths[0] == 5 && levels.vc[0].chain_lengths[1] == 1);
+    ASSERT(levels.vc[1].send_ring_used == 0 && levels.vc[1].used_elements == 0 && levels.vc[1].chain_lengths[0] == 0);
+
+    // The levels go down as packets are read and acknowledged, the peaks stay.
+    ASSERT(sky_vc_read_next_received(vc, tgt, sizeof(tgt)) == 0);
+    ASSERT(sendRing_clean_tail_up_to(vc->sendRing, vc->elementBuffer, 2) >= 0);
+    sky_get_fill_levels(handle, &levels);
+    ASSERT(levels.vc[0].send_ring_used == 2 && levels.vc[0].send_ring_peak == 4);
+    ASSERT(levels.vc[0].resend_queue == 0);
+    ASSERT(levels.vc[0].rcv_ring_used == 1 && levels.vc[0].rcv_ring_peak == 2);
+    ASSERT(levels.vc[0].used_elements == 4 && levels.vc[0].peak_elements == 7);
+    ASSERT(levels.vc[0].chain_lengths[0] == 2 && levels.vc[0].chain_lengths[1] == 1);
+
+    // Resetting starts the peaks from the current levels. Wiping keeps them.
+    sky_reset_fill_peaks(handle);
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_get_fill_levels(handle, &levels);
+    ASSERT(levels.vc[0].send_ring_used == 0 && levels.vc[0].send_ring_peak == 2);
+    ASSERT(levels.vc[0].rcv_ring_used == 0 && levels.vc[0].rcv_ring_peak == 1);
+    ASSERT(levels.vc[0].used_elements == 0 && levels.vc[0].peak_elements == 4);
+    ASSERT(levels.vc[0].chain_lengths[0] == 0 && levels.vc[0].chain_lengths[1] == 0);
+
+    // A slab buffer counts the payloads of all its classes.
+    ASSERT(sky_vc_push_packet_to_send(handle->virtual_channels[3], pl, 20) >= 0);
+    ASSERT(sky_vc_push_packet_to_send(handle->virtual_channels[3], pl, SKY_PAYLOAD_MAX_LEN) >= 0);
+    sky_get_fill_levels(handle, &levels);
+    ASSERT(levels.vc[3].used_elements == 2 && levels.vc[3].peak_elements == 2 && levels.vc[3].free_elements == 4);
+    ASSERT(levels.vc[3].chain_lengths[0] == 2);
+    sky_destroy(handle);
+
+    // With the shared pool, the elements charged to each virtual channel.
+    config->pool.element_count = 40;
+    config->pool.usable_element_size = 175;
+    config->vc[2].pool_maximum_elements = 10;
+    handle = sky_create(config);
+    for (int i = 0; i < 3; i++)
+        ASSERT(sky_vc_push_packet_to_send(handle->virtual_channels[2], pl, 100) >= 0);
+    ASSERT(sky_vc_push_rx_packet_monotonic(handle->virtual_channels[1], pl, 100) >= 0);
+    ASSERT(sky_vc_read_next_received(handle->virtual_channels[1], tgt, sizeof(tgt)) == 0);
+    sky_get_fill_levels(handle, &levels);
+    ASSERT(levels.vc[2].used_elements == 3 && levels.vc[2].peak_elements == 3 && levels.vc[2].free_elements == 7);
+    ASSERT(levels.vc[1].used_elements == 0 && levels.vc[1].peak_elements == 1 && levels.vc[1].free_elements == 37);
+    ASSERT(levels.vc[1].chain_lengths[0] == 3);
+    sky_reset_fill_peaks(handle);
+    ASSERT(handle->element_pool->quotas[1].peak == 0 && handle->element_pool->peak_used_elements == 3);
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
 // Test creating a virtual channel. Check that it is created correctly.
 TEST(vc_create){
     // Valid config.
-    SkyVCConfig *vcConfig = malloc(sizeof(SkyVCConfig));
+    SkyVCConfig *vcConfig = calloc(1, sizeof(SkyVCConfig));
     vcConfig->send_ring_len = 10;
     vcConfig->rcv_ring_len = 10;
     vcConfig->horizon_width = 4;
@@ -106,8 +187,8 @@ TEST(vc_create){
     sky_vc_destroy(vc);
 
     // Invalid config, greater than maximum values.
-    vcConfig->send_ring_len = 1000;
-    vcConfig->rcv_ring_len = 1000;
+    vcConfig->send_ring_len = ARQ_MAXIMUM_RING_LENGTH + 1;
+    vcConfig->rcv_ring_len = ARQ_MAXIMUM_RING_LENGTH + 1;
     vcConfig->horizon_width = 1000;
     vcConfig->usable_element_size = 1000;
     vc = sky_vc_create(vcConfig);
@@ -133,10 +214,146 @@ TEST(vc_create){
     free(vcConfig);
 }
 
+// Test virtual channels sharing one element pool within their quotas.
+TEST(shared_element_pool){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->pool.element_count = 40;
+    config->pool.usable_element_size = 175; // One element per payload.
+    config->vc[1].pool_maximum_elements = 10;
+    config->vc[2].pool_minimum_elements = 8;
+    config->vc[3].pool_minimum_elements = 33; // Doesn't fit with the minimum of VC 2 and is dropped.
+    SkyHandle handle = sky_create(config);
+    ASSERT(handle->element_pool != NULL);
+    ASSERT(config->vc[3].pool_minimum_elements == 0);
+    SkyVirtualChannel** vcs = handle->virtual_channels;
+    for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++)
+        ASSERT(vcs[i]->elementBuffer == handle->element_pool && vcs[i]->shared_element_buffer == 1);
+    uint8_t *pl = create_payload(100);
+
+    // VC 0 borrows half of the pool. VC 1 stops at its maximum.
+    for (int i = 0; i < 20; i++)
+        ASSERT(sky_vc_push_packet_to_send(vcs[0], pl, 100) >= 0);
+    for (int i = 0; i < 10; i++)
+        ASSERT(sky_vc_push_packet_to_send(vcs[1], pl, 100) >= 0);
+    ASSERT(sky_vc_push_packet_to_send(vcs[1], pl, 100) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(sky_vc_count_free_send_bytes(vcs[1]) == 0);
+
+    // The minimum of VC 2 stays available for it.
+    ASSERT(sky_vc_push_packet_to_send(vcs[0], pl, 100) >= 0);
+    ASSERT(sky_vc_push_packet_to_send(vcs[0], pl, 100) >= 0);
+    ASSERT(sky_vc_push_packet_to_send(vcs[0], pl, 100) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(sky_vc_push_rx_packet_monotonic(vcs[3], pl, 100) == SKY_RET_EBUFFER_NO_SPACE);
+    for (int i = 0; i < 8; i++)
+        ASSERT(sky_vc_push_packet_to_send(vcs[2], pl, 100) >= 0);
+    ASSERT(handle->element_pool->free_elements == 0);
+
+    // Wiping a VC frees only its own payloads.
+    sky_vc_wipe_to_arq_off_state(vcs[0]);
+    ASSERT(handle->element_pool->free_elements == 22);
+    ASSERT(sky_vc_count_packets_to_tx(vcs[1], 0) == 10);
+    ASSERT(handle->element_pool->quotas[1].used == 10 && handle->element_pool->quotas[2].used == 8);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(handle->element_pool));
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
+// Test creating an instance in a caller supplied arena, with own element buffers and with a shared pool.
+TEST(create_in_arena){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->vc[1].contiguous_allocation = 1;
+    config->vc[2].slab_element_counts[0] = 20;
+    config->vc[2].slab_element_counts[2] = 10;
+    uint8_t *pl = create_payload(100);
+    uint8_t read_back[100];
+
+    for (int shared = 0; shared <= 1; shared++) {
+        config->pool.element_count = shared ? 40 : 0;
+        config->pool.contiguous_allocation = 1;
+        size_t required = sky_required_memory(config);
+        uint8_t *arena = malloc(required + 1);
+
+        // Too little memory is refused before anything is created.
+        ASSERT(sky_create_in(arena + 1, required - 1, config) == NULL);
+
+        // Every allocation is made from the arena, each on a cache line of its own.
+        SkyHandle handle = sky_create_in(arena + 1, required, config);
+        ASSERT(handle != NULL);
+        ASSERT(handle->arena == arena + 1);
+        ASSERT((uintptr_t)handle % SKY_CACHE_LINE_SIZE == 0);
+        for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+            SkyVirtualChannel* vc = handle->virtual_channels[i];
+            ASSERT((uint8_t*)vc > arena && (uint8_t*)vc < arena + required + 1);
+            ASSERT((uint8_t*)vc->sendRing->options > arena && (uint8_t*)vc->sendRing->options < arena + required + 1);
+            ASSERT(vc->elementBuffer->slab_count == (shared ? 0 : (i == 2) ? 2 : 0));
+            ASSERT(sky_vc_push_packet_to_send(vc, pl, 100) >= 0);
+            ASSERT(sky_vc_push_rx_packet_monotonic(vc, pl, 100) >= 0);
+            ASSERT(sky_vc_read_next_received(vc, read_back, 100) == 0);
+            ASSERT_MEMORY(read_back, pl, 100);
+        }
+        if (shared)
+            ASSERT((uint8_t*)handle->element_pool->free_map > arena && (uint8_t*)handle->element_pool->free_map < arena + required + 1);
+
+        // Destroying frees nothing, the arena is freed by the caller.
+        sky_destroy(handle);
+        free(arena);
+    }
+
+    // The cursor is given to each allocation. An instance created on the heap meanwhile takes nothing from the arena.
+    config->pool.element_count = 0;
+    size_t required = sky_element_buffer_required_memory(16, 10, EB_ALLOC_FREE_LIST, 0);
+    uint8_t *memory = malloc(required);
+    SkyArena cursor = { memory, memory + required };
+    SkyElementBuffer *buffer = sky_element_buffer_create(&cursor, 16, 10);
+    ASSERT((uint8_t*)buffer == memory);
+    ASSERT(cursor.next == memory + required);
+    SkyHandle handle = sky_create(config);
+    ASSERT(handle != NULL);
+    ASSERT((uint8_t*)handle < memory || (uint8_t*)handle >= memory + required);
+    ASSERT(cursor.next == memory + required);
+    ASSERT(sky_allocate(&cursor, 1) == NULL);
+    sky_destroy(handle);
+    free(memory);
+
+    free(pl);
+    free(config);
+}
+
+// Test a virtual channel with a slab element buffer.
+TEST(slab_element_buffer){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->vc[0].slab_element_counts[0] = 4;
+    config->vc[0].slab_element_counts[2] = 1; // No 96 byte class.
+    config->vc[1].slab_element_counts[1] = -1;
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel* vc = handle->virtual_channels[0];
+    ASSERT(vc->elementBuffer->slab_count == 2 && vc->elementBuffer->element_count == 5);
+    ASSERT(handle->virtual_channels[1]->elementBuffer->slab_count == 0);
+    ASSERT(config->vc[1].slab_element_counts[1] == 0);
+    uint8_t *pl = create_payload(SKY_PAYLOAD_MAX_LEN);
+
+    // A maximum length payload takes the one large element, the next ones the small elements.
+    ASSERT(sky_vc_push_packet_to_send(vc, pl, SKY_PAYLOAD_MAX_LEN) >= 0);
+    ASSERT(sky_vc_count_free_send_bytes(vc) == 4 * 32 - 2);
+    struct sky_iovec batch[3] = { { pl, 60 }, { pl, 60 }, { pl, 60 } };
+    ASSERT(sky_vc_push_batch(vc, batch, 3) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(sky_vc_push_batch(vc, batch, 2) >= 0);
+    ASSERT(vc->elementBuffer->free_elements == 0);
+    ASSERT(sky_element_buffer_entire_buffer_is_ok(vc->elementBuffer));
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
 // Test changing arq states from off to init to on and back to off.
 TEST(arq_state_change){
     // Create config
-    SkyVCConfig *vcConfig = malloc(sizeof(SkyVCConfig));
+    SkyVCConfig *vcConfig = calloc(1, sizeof(SkyVCConfig));
     vcConfig->send_ring_len = 10;
     vcConfig->rcv_ring_len = 10;
     vcConfig->horizon_width = 4;
@@ -194,7 +411,7 @@ A timeout means that the current time subtracted by the last tx or rx tick is gr
 */
 TEST(check_timeouts){
     // Create config
-    SkyVCConfig *vcConfig = malloc(sizeof(SkyVCConfig));
+    SkyVCConfig *vcConfig = calloc(1, sizeof(SkyVCConfig));
     vcConfig->send_ring_len = 10;
     vcConfig->rcv_ring_len = 10;
     vcConfig->horizon_width = 4;
@@ -246,6 +463,20 @@ TEST(vc_content_to_send){
     ASSERT(sRing >= 0, "VC sendRing_push_packet_to_send error: %d", sRing);
     // Check that there is content to send.
     ASSERT(sky_vc_content_to_send(handle->virtual_channels[0], config, 0, 0) == 1, "VC sendable content is not 1, it is: %d", sky_vc_content_to_send(handle->virtual_channels[0], config, 0, 0));
+    // The query brings the most urgent packet to the front. Expired packets behind it are left for later.
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[0], const_pl, 100, 0, 10, 0) >= 0);
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[0], const_pl, 100, 3, 0, 0) >= 0);
+    ASSERT(sky_vc_content_to_send(handle->virtual_channels[0], config, 100, 0) == 1);
+    ASSERT(sky_vc_count_packets_to_tx(handle->virtual_channels[0], 0) == 3);
+    ASSERT(handle->virtual_channels[0]->sendRing->options[handle->virtual_channels[0]->sendRing->tx_head].priority == 3);
+    sky_send_ring_wipe(handle->virtual_channels[0]->sendRing, handle->virtual_channels[0]->elementBuffer, 0);
+    // Only expired packets is nothing to send. They are dropped by the query.
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[0], const_pl, 100, 0, 10, 0) >= 0);
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[0], const_pl, 100, 2, 20, 0) >= 0);
+    ASSERT(sky_vc_content_to_send(handle->virtual_channels[0], config, 100, 0) == 0);
+    ASSERT(sky_vc_count_packets_to_tx(handle->virtual_channels[0], 0) == 0);
+    sky_send_ring_wipe(handle->virtual_channels[0]->sendRing, handle->virtual_channels[0]->elementBuffer, 0);
+    sendRing_push_packet_to_send(handle->virtual_channels[0]->sendRing, handle->virtual_channels[0]->elementBuffer, const_pl, 100);
     // ARQ IN INIT, tests if frames_sent_in_this_vc_window < config->arq.idle_frames_per_window:
     // Change arq state to init.
     sky_vc_wipe_to_arq_init_state(handle->virtual_channels[0]);
@@ -319,6 +550,10 @@ TEST(fill_frame){
     SkyRadioFrame frame;
     init_tx(&frame, &TXframe);
     unsigned int init_len = TXframe.frame->length;
+    // Default rings are short enough for 8 bit sequences.
+    const unsigned int seq_len = sky_frame_get_arq_extension_length(EXTENSION_ARQ_SEQUENCE, 0);
+    const unsigned int req_len = sky_frame_get_arq_extension_length(EXTENSION_ARQ_REQUEST, 0);
+    const unsigned int ctrl_len = sky_frame_get_arq_extension_length(EXTENSION_ARQ_CTRL, 0);
     // ARQ OFF:
     // Nothing in send ring:
     int ret = sky_vc_fill_frame(handle->virtual_channels[0], config, &TXframe, 0, 0);
@@ -373,20 +608,20 @@ TEST(fill_frame){
     ret = sky_vc_fill_frame(handle->virtual_channels[0], config, &TXframe, 0, 3);
     ASSERT(ret == 1, "There was no arq request to be sent when there should be one. %d" , ret);
     // Check that extension was added properly to the frame by testing that length is increased by sizeof(ExtARQRequest) + 1.
-    ASSERT(TXframe.frame->length == init_len + sizeof(ExtARQReq) + 1, "Frame length should be %d, it was %d", init_len + sizeof(ExtARQReq) + 1, TXframe.frame->length);
+    ASSERT(TXframe.frame->length == init_len + req_len + 1, "Frame length should be %d, it was %d", init_len + req_len + 1, TXframe.frame->length);
     // Make frame reusable.
-    TXframe.ptr -= sizeof(ExtARQReq) + 1;
-    TXframe.frame->length -= sizeof(ExtARQReq) + 1;
+    TXframe.ptr -= req_len + 1;
+    TXframe.frame->length -= req_len + 1;
     // Need idle frames: (idle frames per window is 4 Should add ARQCtrl extension.
     // Wipe RCV ring:
     sky_rcv_ring_wipe(handle->virtual_channels[0]->rcvRing, handle->virtual_channels[0]->elementBuffer, 0);
     ret = sky_vc_fill_frame(handle->virtual_channels[0], config, &TXframe, 10000, 3);
     ASSERT(ret == 1, "There was no idle frame to be sent when there should be one. %d", ret);
-    // Check that extension was added properly to the frame by testing that length is increased by sizeof(ExtARQCtrl) + 1.
-    ASSERT(TXframe.frame->length == init_len + sizeof(ExtARQCtrl) + 1, "Frame length should be %d, it was %d", init_len + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2, TXframe.frame->length);
+    // Check that extension was added properly to the frame by testing that length is increased by ctrl_len + 1.
+    ASSERT(TXframe.frame->length == init_len + ctrl_len + 1, "Frame length should be %d, it was %d", init_len + ctrl_len + seq_len + 2, TXframe.frame->length);
     // Make frame reusable. 
-    TXframe.ptr -= sizeof(ExtARQCtrl) + 1;
-    TXframe.frame->length -= sizeof(ExtARQCtrl) + 1;
+    TXframe.ptr -= ctrl_len + 1;
+    TXframe.frame->length -= ctrl_len + 1;
     // Something to send:
     // Add payload to send ring.
     sRing = sendRing_push_packet_to_send(handle->virtual_channels[0]->sendRing, handle->virtual_channels[0]->elementBuffer, const_pl, 100);
@@ -394,14 +629,14 @@ TEST(fill_frame){
     // sky_vc_fill_frame() should be able to fill a frame.
     ret = sky_vc_fill_frame(handle->virtual_channels[0], config, &TXframe, 0, 4);
     ASSERT(ret == 1, "sky_vc_fill_frame() should return 1 when arq is off and there is something to send, %d", ret);
-    ASSERT(TXframe.frame->length == init_len + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2 + 100, "Frame length should be %d, it was %d", init_len + sizeof(ExtARQCtrl) + 1 + 100, TXframe.frame->length);
+    ASSERT(TXframe.frame->length == init_len + ctrl_len + seq_len + 2 + 100, "Frame length should be %d, it was %d", init_len + ctrl_len + 1 + 100, TXframe.frame->length);
     // Check that frame raw is the same as the payload in for loop. Init_tx sets identity etc. so there is already some data before payload.
-    for(unsigned int i = init_len + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2; i < TXframe.frame->length ; i++){
-        ASSERT(TXframe.frame->raw[i] == i - (init_len + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2), "%d is not equal to %d", TXframe.frame->raw[i], i - (init_len + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2));
+    for(unsigned int i = init_len + ctrl_len + seq_len + 2; i < TXframe.frame->length ; i++){
+        ASSERT(TXframe.frame->raw[i] == i - (init_len + ctrl_len + seq_len + 2), "%d is not equal to %d", TXframe.frame->raw[i], i - (init_len + ctrl_len + seq_len + 2));
     }
     // Make frame reusable.
-    TXframe.ptr -= 100 + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2;
-    TXframe.frame->length -= 100 + sizeof(ExtARQCtrl) + sizeof(ExtARQSeq) + 2;
+    TXframe.ptr -= 100 + ctrl_len + seq_len + 2;
+    TXframe.frame->length -= 100 + ctrl_len + seq_len + 2;
     TXframe.hdr->flag_has_payload = 0;
     ASSERT(TXframe.frame->length == init_len, "Frame length should be %d, it was %d", init_len, TXframe.frame->length);
     // Payload too large:
@@ -488,6 +723,593 @@ TEST(handle_handshake){
 
 }
 
+// Test negotiating header compression in the handshake and resolving compressed ARQ control.
+TEST(handshake_header_compression){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->vc[0].header_compression = 1;
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel *vc = handle->virtual_channels[0];
+
+    // Peer doesn't offer compression, so it is not used.
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_vc_handle_handshake(vc, ARQ_STATE_IN_INIT, 0x12345678);
+    ASSERT(vc->arq_state_flag == ARQ_STATE_ON, "VC arq_state is not ARQ_STATE_ON, it is: %d", vc->arq_state_flag);
+    ASSERT(vc->header_compression == 0, "Compression should be off, it is: %d", vc->header_compression);
+
+    // Peer offers compression. Still full identity until the handshake response has been sent.
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_vc_handle_handshake(vc, ARQ_STATE_IN_INIT | ARQ_HANDSHAKE_FLAG_COMPRESSION, 0x12345678);
+    ASSERT(vc->header_compression == 1, "Compression should be on, it is: %d", vc->header_compression);
+    ASSERT(sky_vc_get_tx_link_id(vc) < 0, "Link ID should not be used while handshake is pending");
+    vc->handshake_send = 0;
+
+    // Responder's link ID has direction bit cleared and the initiator's set.
+    int link_id = sky_vc_get_tx_link_id(vc);
+    ASSERT(link_id >= 0 && (link_id & SKY_LINK_ID_DIRECTION_BIT) == 0, "link_id: %d", link_id);
+    ASSERT(sky_vc_check_rx_link_id(vc, link_id) == SKY_RET_FILTERED_BY_IDENTITY);
+    ASSERT(sky_vc_check_rx_link_id(vc, link_id | SKY_LINK_ID_DIRECTION_BIT) == SKY_RET_OK);
+    ASSERT(sky_vc_check_rx_link_id(vc, (link_id + 1) | SKY_LINK_ID_DIRECTION_BIT) == SKY_RET_UNKNOWN_LINK_ID);
+
+    // Compressed control sequences are resolved relative to the acknowledged values.
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    uint8_t *pl = create_payload(10);
+    for (int i = 0; i < 3; i++)
+        sendRing_push_packet_to_send(vc->sendRing, vc->elementBuffer, pl, 10);
+    vc->sendRing->tx_head = 3;
+    vc->sendRing->tx_sequence = 3;
+    init_tx(&frame, &TXframe);
+    sky_frame_add_extension_arq_ctrl_compressed(&TXframe, 0, 2);
+    ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+    ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+    sky_vc_process_frame(vc, &parsed, 10);
+    ASSERT(vc->sendRing->tail_sequence == 2, "Tail sequence should be 2, it is: %d", vc->sendRing->tail_sequence);
+
+    // Without negotiated compression the link ID can't be resolved.
+    sky_vc_wipe_to_arq_off_state(vc);
+    ASSERT(sky_vc_get_tx_link_id(vc) < 0);
+    ASSERT(sky_vc_check_rx_link_id(vc, link_id | SKY_LINK_ID_DIRECTION_BIT) == SKY_RET_UNKNOWN_LINK_ID);
+
+    sky_destroy(handle);
+    free(config);
+    free(pl);
+}
+
+// Test negotiating the sequence width in the handshake and resolving 8 bit sequences.
+TEST(handshake_wide_sequences){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel *vc = handle->virtual_channels[0];
+
+    // Neither side asks for wide sequences.
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_vc_handle_handshake(vc, ARQ_STATE_IN_INIT, 0x12345678);
+    ASSERT(vc->arq_state_flag == ARQ_STATE_ON, "VC arq_state is not ARQ_STATE_ON, it is: %d", vc->arq_state_flag);
+    ASSERT(vc->wide_sequences == 0, "Wide sequences should be off, it is: %d", vc->wide_sequences);
+
+    // Peer asks for them.
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_vc_handle_handshake(vc, ARQ_STATE_IN_INIT | ARQ_HANDSHAKE_FLAG_WIDE_SEQUENCES, 0x12345678);
+    ASSERT(vc->wide_sequences == 1, "Wide sequences should be on, it is: %d", vc->wide_sequences);
+
+    // 8 bit sequences are resolved around the receive head, also across the wrap.
+    sky_vc_wipe_to_arq_off_state(vc);
+    sky_vc_handle_handshake(vc, ARQ_STATE_IN_INIT, 0x12345678);
+    sky_rcv_ring_wipe(vc->rcvRing, vc->elementBuffer, 65534);
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    uint8_t *pl = create_payload(10);
+    for (int i = 0; i < 3; i++) {
+        init_tx(&frame, &TXframe);
+        sky_frame_add_extension_arq_sequence(&TXframe, (sky_arq_sequence_t)(65534 + i), 0);
+        ASSERT(sky_frame_extend_with_payload(&TXframe, pl, 10) == SKY_RET_OK);
+        ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+        ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+        ASSERT(sky_vc_process_frame(vc, &parsed, 10) == 0);
+    }
+    ASSERT(vc->rcvRing->head_sequence == 1, "Head sequence should be 1, it is: %d", vc->rcvRing->head_sequence);
+
+    // Rings longer than 8 bit sequences can resolve always ask for wide ones.
+    config->vc[0].send_ring_len = ARQ_NARROW_SEQUENCE_WINDOW + 1;
+    SkyVirtualChannel *long_vc = sky_vc_create(&config->vc[0]);
+    ASSERT(config->vc[0].wide_sequences == 1);
+    ASSERT(long_vc->sendRing->length == ARQ_NARROW_SEQUENCE_WINDOW + 1);
+    sky_vc_destroy(long_vc);
+
+    sky_destroy(handle);
+    free(config);
+    free(pl);
+}
+
+// Detached sequences are recovered with a resync instead of waiting for the ARQ timeout.
+TEST(detached_resync){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle_a = sky_create(config);
+    SkyHandle handle_b = sky_create(config);
+    SkyVirtualChannel *a = handle_a->virtual_channels[0];
+    SkyVirtualChannel *b = handle_b->virtual_channels[0];
+    // The identifier is stored as it was read from the peer's handshake, that is, in the peer's byte order.
+    sky_vc_wipe_to_arq_on_state(a, 10);
+    sky_vc_wipe_to_arq_on_state(b, sky_hton32(10));
+    a->handshake_send = 0;
+    b->handshake_send = 0;
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    uint8_t tgt[100];
+    uint8_t *pl = create_payload(20);
+
+    // A has one readable packet and one in its horizon.
+    ASSERT(sky_vc_push_rx_packet(a, pl, 20, 0, 0) == 1);
+    ASSERT(sky_vc_push_rx_packet(a, pl, 20, 3, 0) == 0);
+
+    // B has lost track of the sequences and sends two of its three packets.
+    sky_send_ring_wipe(b->sendRing, b->elementBuffer, 1000);
+    for (int i = 0; i < 3; i++) {
+        pl[0] = i;
+        ASSERT(sky_vc_push_packet_to_send(b, pl, 20) >= 0);
+    }
+    for (int i = 0; i < 2; i++) {
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(b, config, &TXframe, 10, 0) == 1);
+        ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+        ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+        sky_vc_process_frame(a, &parsed, 10);
+    }
+
+    // A notices the detached sequences. The horizon is dropped but the readable packet stays.
+    ASSERT(a->arq_state_flag == ARQ_STATE_RESYNC, "A should resync, state is: %d", a->arq_state_flag);
+    ASSERT(a->rcvRing->storage_count == 1, "Storage count should be 1, it is: %d", a->rcvRing->storage_count);
+    ASSERT(sky_vc_count_readable_rcv_packets(a) == 1);
+    ASSERT(sky_vc_get_tx_link_id(a) < 0);
+
+    // A sends the resync request with its receive head. B realigns and sends all three packets again.
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_content_to_send(a, config, 20, 0) == 1);
+    ASSERT(sky_vc_fill_frame(a, config, &TXframe, 20, 0) == 1);
+    ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+    ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+    ASSERT(parsed.arq_handshake != NULL && parsed.arq_ctrl != NULL);
+    sky_vc_process_frame(b, &parsed, 20);
+    ASSERT(b->arq_state_flag == ARQ_STATE_ON);
+    // With 8 bit sequences on the link only the low bits of B's numbering have to agree with A.
+    sky_arq_sequence_t tail = b->sendRing->tail_sequence;
+    ASSERT((uint8_t)tail == 1, "Tail sequence should end with 1, it is: %d", tail);
+    ASSERT(b->sendRing->tx_sequence == tail && b->sendRing->head_sequence == (sky_arq_sequence_t)(tail + 3));
+    ASSERT(sky_vc_count_packets_to_tx(b, 1) == 3);
+    ASSERT(b->handshake_send == 1);
+
+    // The handshake response ends the resync and the packets go through in order.
+    for (int i = 0; i < 3; i++) {
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(b, config, &TXframe, 30, 0) == 1);
+        ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+        ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+        sky_vc_process_frame(a, &parsed, 30);
+        ASSERT(a->arq_state_flag == ARQ_STATE_ON, "A should be back on, state is: %d", a->arq_state_flag);
+    }
+    ASSERT(a->rcvRing->head_sequence == 4, "Head sequence should be 4, it is: %d", a->rcvRing->head_sequence);
+    ASSERT(sky_vc_read_next_received(a, tgt, 100) == 0);
+    for (int i = 0; i < 3; i++) {
+        ASSERT(sky_vc_read_next_received(a, tgt, 100) == 0);
+        ASSERT(tgt[0] == i, "Packet %d read out of order: %d", i, tgt[0]);
+    }
+
+    // Without a response the ARQ timeout still applies.
+    sky_vc_update_rx_sync(a, a->rcvRing->head_sequence - 1, 40);
+    ASSERT(a->arq_state_flag == ARQ_STATE_RESYNC);
+    sky_vc_check_timeouts(a, 100000, 1000);
+    ASSERT(a->arq_state_flag == ARQ_STATE_OFF);
+
+    sky_destroy(handle_a);
+    sky_destroy(handle_b);
+    free(config);
+    free(pl);
+}
+
+// Fill a frame on one end and process it on the other. Without a receiver the frame is lost.
+// Returns the length of the payload carried, or -1 if there was nothing to send.
+static int pass_frame(SkyVirtualChannel *from, SkyVirtualChannel *to, SkyConfig *config, sky_tick_t now)
+{
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    init_tx(&frame, &TXframe);
+    if (sky_vc_fill_frame(from, config, &TXframe, now, 0) != 1)
+        return -1;
+    ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+    ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+    if (to != NULL)
+        sky_vc_process_frame(to, &parsed, now);
+    return parsed.payload_len;
+}
+
+// Resync after lost acknowledgements. Packets the peer already has are not delivered again.
+TEST(resync_after_lost_acks){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle_a = sky_create(config);
+    SkyHandle handle_b = sky_create(config);
+    SkyVirtualChannel *a = handle_a->virtual_channels[0];
+    SkyVirtualChannel *b = handle_b->virtual_channels[0];
+    sky_vc_wipe_to_arq_on_state(a, 10);
+    sky_vc_wipe_to_arq_on_state(b, sky_hton32(10));
+    a->handshake_send = 0;
+    b->handshake_send = 0;
+    uint8_t tgt[100];
+    uint8_t *pl = create_payload(20);
+    int reads[5] = { 0 };
+
+    // B sends five packets. The fourth is lost and none of A's acknowledgements get through.
+    for (int i = 0; i < 5; i++) {
+        pl[0] = i;
+        ASSERT(sky_vc_push_packet_to_send(b, pl, 20) >= 0);
+        ASSERT(pass_frame(b, i == 3 ? NULL : a, config, 10) == 20);
+    }
+    while (sky_vc_read_next_received(a, tgt, 100) >= 0)
+        reads[tgt[0]]++;
+    ASSERT(a->rcvRing->head_sequence == 3);
+    ASSERT(b->sendRing->tail_sequence == 0);
+
+    // A detaches and drops the fifth packet from its horizon.
+    sky_vc_update_rx_sync(a, a->rcvRing->head_sequence - 1, 20);
+    ASSERT(a->arq_state_flag == ARQ_STATE_RESYNC);
+
+    // B takes the resync request as an acknowledgement of the first three and sends the rest again.
+    ASSERT(pass_frame(a, b, config, 20) == 0);
+    ASSERT(b->sendRing->tail_sequence == 3 && b->sendRing->tx_sequence == 3 && b->sendRing->head_sequence == 5);
+    ASSERT(sky_vc_count_packets_to_tx(b, 1) == 2);
+
+    // Repeated requests don't make B start over.
+    ASSERT(pass_frame(b, NULL, config, 30) == 20);
+    ASSERT(pass_frame(a, b, config, 30) == 0);
+    ASSERT(b->sendRing->tx_sequence == 4, "Tx sequence should be 4, it is: %d", b->sendRing->tx_sequence);
+    ASSERT(b->handshake_send == 1);
+
+    // The lost response is sent again and A gets the rest.
+    for (int i = 0; i < 4; i++) {
+        pass_frame(b, a, config, 40 + i);
+        pass_frame(a, b, config, 40 + i);
+    }
+    ASSERT(a->arq_state_flag == ARQ_STATE_ON && b->arq_state_flag == ARQ_STATE_ON);
+    while (sky_vc_read_next_received(a, tgt, 100) >= 0)
+        reads[tgt[0]]++;
+    for (int i = 0; i < 5; i++)
+        ASSERT(reads[i] == 1, "Packet %d read %d times", i, reads[i]);
+    ASSERT(b->sendRing->tail_sequence == 5);
+
+    sky_destroy(handle_a);
+    sky_destroy(handle_b);
+    free(config);
+    free(pl);
+}
+
+// Both ends resync at the same time. Each realigns once and the packets go through once.
+TEST(simultaneous_resync){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle_a = sky_create(config);
+    SkyHandle handle_b = sky_create(config);
+    SkyVirtualChannel *vcs[2] = { handle_a->virtual_channels[0], handle_b->virtual_channels[0] };
+    sky_vc_wipe_to_arq_on_state(vcs[0], 10);
+    sky_vc_wipe_to_arq_on_state(vcs[1], sky_hton32(10));
+    vcs[0]->handshake_send = 0;
+    vcs[1]->handshake_send = 0;
+    uint8_t tgt[100];
+    uint8_t *pl = create_payload(20);
+    int reads[2][3] = { { 0 } };
+
+    // Two frames a window, and the windows of both cross.
+    SkyTransmitFrame TXframes[2][2];
+    SkyRadioFrame frames[2][2];
+    SkyParsedFrame parsed[2][2];
+    int sent[2][2];
+    int payloads[2] = { 0, 0 };
+
+    // Both have lost track of their sequences and send the first of three packets. Both notice the detach.
+    for (int v = 0; v < 2; v++) {
+        sky_send_ring_wipe(vcs[v]->sendRing, vcs[v]->elementBuffer, 1000 * (v + 1));
+        for (int i = 0; i < 3; i++) {
+            pl[0] = i;
+            ASSERT(sky_vc_push_packet_to_send(vcs[v], pl, 20) >= 0);
+        }
+        init_tx(&frames[v][0], &TXframes[v][0]);
+        ASSERT(sky_vc_fill_frame(vcs[v], config, &TXframes[v][0], 10, 0) == 1);
+        ASSERT(start_parsing(TXframes[v][0].frame, &parsed[v][0]) == 0);
+        ASSERT(sky_frame_parse_extension_headers(TXframes[v][0].frame, &parsed[v][0]) == 0);
+    }
+    for (int v = 0; v < 2; v++)
+        sky_vc_process_frame(vcs[1 - v], &parsed[v][0], 10);
+    for (int v = 0; v < 2; v++)
+        ASSERT(vcs[v]->arq_state_flag == ARQ_STATE_RESYNC, "VC %d state: %d", v, vcs[v]->arq_state_flag);
+
+    // Each gets the requests of the other while resyncing itself.
+    for (int w = 0; w < 6; w++) {
+        for (int v = 0; v < 2; v++) {
+            for (int f = 0; f < 2; f++) {
+                init_tx(&frames[v][f], &TXframes[v][f]);
+                sent[v][f] = sky_vc_fill_frame(vcs[v], config, &TXframes[v][f], 20 + w, f) == 1;
+                if (!sent[v][f])
+                    continue;
+                ASSERT(start_parsing(TXframes[v][f].frame, &parsed[v][f]) == 0);
+                ASSERT(sky_frame_parse_extension_headers(TXframes[v][f].frame, &parsed[v][f]) == 0);
+                if (parsed[v][f].payload_len > 0)
+                    payloads[v]++;
+            }
+        }
+        for (int v = 0; v < 2; v++)
+            for (int f = 0; f < 2; f++)
+                if (sent[v][f])
+                    sky_vc_process_frame(vcs[1 - v], &parsed[v][f], 20 + w);
+    }
+
+    // Both are back on and every packet was sent once after the resync and read once.
+    for (int v = 0; v < 2; v++) {
+        ASSERT(vcs[v]->arq_state_flag == ARQ_STATE_ON, "VC %d state: %d", v, vcs[v]->arq_state_flag);
+        ASSERT(payloads[v] == 3, "VC %d sent %d payloads", v, payloads[v]);
+        while (sky_vc_read_next_received(vcs[v], tgt, 100) >= 0)
+            reads[v][tgt[0]]++;
+        for (int i = 0; i < 3; i++)
+            ASSERT(reads[v][i] == 1, "VC %d packet %d read %d times", v, i, reads[v][i]);
+        ASSERT(sky_vc_count_packets_to_tx(vcs[v], 1) == 0);
+    }
+
+    sky_destroy(handle_a);
+    sky_destroy(handle_b);
+    free(config);
+    free(pl);
+}
+
+// Round trip time estimation and retransmission timeout.
+TEST(retransmit_timeout){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel *vc = handle->virtual_channels[0];
+    sky_vc_wipe_to_arq_on_state(vc, 10);
+    vc->handshake_send = 0;
+    ASSERT(vc->rto == 0);
+
+    // Jacobson's estimator: first sample sets RTO to 3R, then it converges towards the samples.
+    sky_vc_update_rtt(vc, 1000);
+    ASSERT(vc->rto == 3000, "RTO should be 3000, it is: %d", vc->rto);
+    for (int i = 0; i < 50; i++)
+        sky_vc_update_rtt(vc, 1000);
+    ASSERT(vc->rto >= 1000 && vc->rto < 1100, "RTO should converge to 1000, it is: %d", vc->rto);
+
+    // Send three packets. First one of them is timed.
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    uint8_t *pl = create_payload(20);
+    for (int i = 0; i < 3; i++) {
+        sky_vc_push_packet_to_send(vc, pl, 20);
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 100 + i, 0) == 1);
+    }
+    ASSERT(vc->rtt_probe_active == 1 && vc->rtt_probe_sequence == 0 && vc->rtt_probe_tick == 100);
+
+    // Nothing happens within the timeout or the TDD cycle, which is used as the minimum.
+    ASSERT(sky_vc_check_retransmit_timeout(vc, 1100, 50, 10000) == 0);
+    ASSERT(sky_vc_check_retransmit_timeout(vc, 1200, 2000, 10000) == 0);
+
+    // Peer acknowledges the first packet. Its round trip is sampled and the timer restarted.
+    int32_t srtt = vc->srtt;
+    sky_vc_update_tx_sync(vc, 1, 600);
+    ASSERT(vc->rtt_probe_active == 0);
+    ASSERT(vc->srtt < srtt, "SRTT should shrink after a 500 tick sample, %d >= %d", vc->srtt, srtt);
+
+    // Tail packets are scheduled after the timeout and the timeout is backed off.
+    int32_t rto = vc->rto;
+    ASSERT(sky_vc_check_retransmit_timeout(vc, 600 + rto, 50, 10000) == 0);
+    ASSERT(sky_vc_check_retransmit_timeout(vc, 601 + rto, 50, 10000) == 2);
+    ASSERT(sendRing_get_next_resend_sequence(vc->sendRing) == 1);
+    ASSERT(vc->rto == 2 * rto, "RTO should be doubled to %d, it is: %d", 2 * rto, vc->rto);
+
+    // Already recovering, so nothing more is scheduled.
+    ASSERT(sky_vc_check_retransmit_timeout(vc, 100000, 50, 10000) == 0);
+
+    // Retransmitted packets are not timed.
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 5000, 0) == 1);
+    ASSERT(vc->rtt_probe_active == 0);
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
+// Losses far beyond the presence map are requested window by window in consecutive frames.
+TEST(long_horizon_requests){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    config->vc[0].send_ring_len = 300;
+    config->vc[0].rcv_ring_len = 300;
+    config->vc[0].horizon_width = 250;
+    config->vc[0].wide_sequences = 1;
+    SkyHandle handle_a = sky_create(config);
+    SkyHandle handle_b = sky_create(config);
+    SkyVirtualChannel *a = handle_a->virtual_channels[0];
+    SkyVirtualChannel *b = handle_b->virtual_channels[0];
+    sky_vc_wipe_to_arq_on_state(a, 10);
+    sky_vc_wipe_to_arq_on_state(b, sky_hton32(10));
+    a->handshake_send = 0;
+    b->handshake_send = 0;
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    uint8_t tgt[SKY_PAYLOAD_MAX_LEN];
+    sky_arq_sequence_t sequence;
+    uint8_t *pl = create_payload(20);
+
+    // B sends 200 packets. A receives the first one and the last 50.
+    for (int i = 0; i < 200; i++) {
+        ASSERT(sky_vc_push_packet_to_send(b, pl, 20) >= 0);
+        ASSERT(sky_vc_read_packet_for_tx(b, tgt, &sequence, 1) >= 0);
+    }
+    ASSERT(sky_vc_push_rx_packet(a, pl, 20, 0, 10) >= 0);
+    for (int i = 150; i < 200; i++)
+        ASSERT(sky_vc_push_rx_packet(a, pl, 20, i, 10) >= 0);
+
+    // Next to the 16 bit request at the head, each frame reports the following window.
+    // Windows with nothing received are sent with the short mask. The last one marks the received packets, and then it starts over.
+    const sky_arq_sequence_t starts[5] = { 18, 51, 84, 117, 18 };
+    for (int i = 0; i < 5; i++) {
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(a, config, &TXframe, 20, 0) == 1);
+        ASSERT(start_parsing(TXframe.frame, &parsed) == 0);
+        ASSERT(sky_frame_parse_extension_headers(TXframe.frame, &parsed) == 0);
+        ASSERT(parsed.arq_request != NULL && parsed.arq_sack != NULL);
+        ASSERT(sky_frame_read_arq_sequence(parsed.arq_sack, 0, 0) == starts[i], "Window %d starts at %d", i, sky_frame_read_arq_sequence(parsed.arq_sack, 0, 0));
+        if (i == 0) {
+            // The first frame alone has the sender resend 1 to 50.
+            ASSERT(sky_vc_process_frame(b, &parsed, 20) == 0);
+            ASSERT(b->sendRing->resend_count == 50, "Resend count: %d", b->sendRing->resend_count);
+        }
+    }
+
+    free(pl);
+    sky_destroy(handle_a);
+    sky_destroy(handle_b);
+    free(config);
+}
+
+// Speculative retransmissions of unacknowledged payloads during leftover window time.
+TEST(speculative_resend){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel *vc = handle->virtual_channels[0];
+    sky_vc_wipe_to_arq_on_state(vc, 10);
+    vc->handshake_send = 0;
+
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    uint8_t *pl = create_payload(20);
+    for (int i = 0; i < 3; i++) {
+        sky_vc_push_packet_to_send(vc, pl, 20);
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 0, i) == 1);
+    }
+
+    // Disabled by default.
+    ASSERT(sky_vc_content_to_send(vc, config, 0, 3) == 0);
+
+    // Payloads sent in the current window are not resent before a round trip has been measured.
+    config->arq.speculative_resends_per_window = 2;
+    ASSERT(sky_vc_content_to_send(vc, config, 10, 3) == 0);
+
+    // In the next window the oldest unacknowledged payloads are resent first, as long as the window budget allows.
+    for (int i = 0; i < 2; i++) {
+        ASSERT(sky_vc_content_to_send(vc, config, 1000, i) == 1);
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 1000, i) == 1);
+        ASSERT(TXframe.hdr->flag_has_payload == 1);
+        ASSERT(vc->speculative_sequence == i + 1, "Speculative sequence should be %d, was: %d", i + 1, vc->speculative_sequence);
+    }
+    ASSERT(vc->speculative_resends_in_window == 2);
+    ASSERT(sky_vc_content_to_send(vc, config, 1000, 2) == 0);
+
+    // New payloads go before speculative retransmissions.
+    sky_vc_push_packet_to_send(vc, pl, 20);
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 2000, 0) == 1);
+    ASSERT(vc->speculative_resends_in_window == 0);
+    ASSERT(vc->sendRing->tx_sequence == 4);
+
+    // Continues from where it left off, but stops at the payload sent in this window.
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 2000, 1) == 1);
+    ASSERT(vc->speculative_sequence == 3);
+    ASSERT(sky_vc_content_to_send(vc, config, 2000, 2) == 0);
+
+    // The next window resends it and wraps back to the oldest one.
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 3000, 0) == 1);
+    ASSERT(vc->speculative_sequence == 4);
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 3000, 1) == 1);
+    ASSERT(TXframe.hdr->flag_has_payload == 1);
+    ASSERT(vc->speculative_sequence == 1);
+
+    // With a round trip estimate, a payload is resent only once its latest transmission is a round trip old.
+    sky_vc_update_rtt(vc, 500);
+    ASSERT(sky_vc_content_to_send(vc, config, 3400, 0) == 1);
+    sky_vc_update_tx_sync(vc, 3, 3400);
+    ASSERT(sky_vc_content_to_send(vc, config, 3400, 0) == 0);
+    ASSERT(sky_vc_content_to_send(vc, config, 3500, 0) == 1);
+
+    // Acknowledged payloads are not resent.
+    sky_vc_update_tx_sync(vc, 4, 3500);
+    ASSERT(sky_vc_content_to_send(vc, config, 3500, 0) == 0);
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
+// A parity frame is sent after each complete group of packets.
+TEST(parity_frames){
+    SkyConfig *config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle = sky_create(config);
+    SkyVirtualChannel *vc = handle->virtual_channels[0];
+    sky_vc_wipe_to_arq_on_state(vc, 10);
+    vc->handshake_send = 0;
+    config->arq.parity_group_size = 2;
+
+    SkyTransmitFrame TXframe;
+    SkyRadioFrame frame;
+    SkyParsedFrame parsed;
+    uint8_t *pl = create_payload(40);
+    for (int i = 0; i < 3; i++)
+        sky_vc_push_packet_to_send(vc, pl, 40 - i);
+
+    // Two packets complete the first group.
+    for (int i = 0; i < 2; i++) {
+        init_tx(&frame, &TXframe);
+        ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 0, i) == 1);
+    }
+
+    // Parity goes before the third packet.
+    ASSERT(sky_vc_content_to_send(vc, config, 0, 2) == 1);
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 0, 2) == 1);
+    ASSERT(start_parsing(&frame, &parsed) == SKY_RET_OK);
+    ASSERT(sky_frame_parse_extension_headers(&frame, &parsed) == SKY_RET_OK);
+    ASSERT(parsed.arq_sequence == NULL);
+    ASSERT(parsed.arq_parity != NULL);
+    ASSERT(parsed.arq_ctrl != NULL);
+    uint8_t count, length_parity;
+    ASSERT(sky_frame_read_arq_sequence(parsed.arq_parity, 0, 0) == 0);
+    sky_frame_read_arq_parity(parsed.arq_parity, &count, &length_parity);
+    ASSERT(count == 2);
+    ASSERT(length_parity == (40 ^ 39));
+    ASSERT(frame.length - (parsed.payload - frame.raw) == 40);
+    ASSERT(vc->parity_sequence == 2);
+    ASSERT(vc->sendRing->tx_sequence == 2);
+
+    // Group is not complete before the fourth packet.
+    init_tx(&frame, &TXframe);
+    ASSERT(sky_vc_fill_frame(vc, config, &TXframe, 0, 3) == 1);
+    ASSERT(vc->sendRing->tx_sequence == 3);
+    ASSERT(sky_vc_content_to_send(vc, config, 0, 4) == 0);
+
+    // Disabling parities moves the next group forward.
+    config->arq.parity_group_size = 0;
+    init_tx(&frame, &TXframe);
+    sky_vc_fill_frame(vc, config, &TXframe, 0, 4);
+    ASSERT(vc->parity_sequence == 3);
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
 // Test processing parsed frames. Execution depends on ARQ state.
 TEST(process_frame){
     // Create config
@@ -505,9 +1327,9 @@ TEST(process_frame){
     ASSERT(sRing >= 0, "VC sendRing_push_packet_to_send error: %d", sRing);
     // Create a parsed frame.
     SkyParsedFrame parsed;
-    sky_frame_add_extension_arq_sequence(&TXframe, 0);
-	sky_frame_add_extension_arq_request(&TXframe, 1, 2);
-	sky_frame_add_extension_arq_ctrl(&TXframe, 0, 0);
+    sky_frame_add_extension_arq_sequence(&TXframe, 0, 0);
+	sky_frame_add_extension_arq_request(&TXframe, 1, 2, 0);
+	sky_frame_add_extension_arq_ctrl(&TXframe, 0, 0, 0);
 	sky_frame_add_extension_arq_handshake(&TXframe, 1, 2);
 	ASSERT(sky_frame_extend_with_payload(&TXframe, const_pl, 100) == SKY_RET_OK);
     int ret = start_parsing(TXframe.frame, &parsed);
@@ -542,7 +1364,7 @@ TEST(process_frame){
     ASSERT(ret == 0, "sky_vc_process_frame() should return 0 when successful, %d", ret);
     // Check sendring resend list and resend count.:
     // Process frame again with new tx head to allow resend list to fill. (Sendring is wiped when processing with handshake)
-    ASSERT(handle->virtual_channels[0]->sendRing->resend_list[0] == 1, "Resend list[0] should be 1, it is: %d", handle->virtual_channels[0]->sendRing->resend_list[0]);
+    ASSERT(sendRing_get_next_resend_sequence(handle->virtual_channels[0]->sendRing) == 1, "Next resend should be 1, it is: %d", sendRing_get_next_resend_sequence(handle->virtual_channels[0]->sendRing));
     ASSERT(handle->virtual_channels[0]->sendRing->resend_count == 1, "Resend count should be 1, it is: %d", handle->virtual_channels[0]->sendRing->resend_count);
    
     sky_vc_wipe_to_arq_off_state(handle->virtual_channels[0]);
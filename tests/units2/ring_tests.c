@@ -50,10 +50,11 @@ void check_send_ring(SkySendRing *send_ring, int length, int original_sequence)
         ASSERT(send_ring->buff[i].sequence == 0, "Sequence %d at send ring buffer index %d is not zero.", send_ring->buff[i].sequence, i);
     }
 
-    // Check that resend_list is empty.
-    for (int i = 0; i < ARQ_RESEND_SCHEDULE_DEPTH; i++)
+    // Check that the resend schedule is empty.
+    ASSERT(send_ring->resend_fifo_count == 0, "Resend FIFO count is not 0, it is %d.", send_ring->resend_fifo_count);
+    for (int i = 0; i < send_ring->length; i++)
     {
-        ASSERT(send_ring->resend_list[i] == 0, "Resend list index %d is not zero.", i);
+        ASSERT(((send_ring->resend_pending[i / 32] >> (i % 32)) & 1) == 0, "Ring slot %d is scheduled for resend.", i);
     }
 }
 
@@ -63,8 +64,8 @@ void check_send_ring(SkySendRing *send_ring, int length, int original_sequence)
 TEST(create_rings)
 {
     // Create a send ring and a receive ring.
-    SkyRcvRing *rcv_ring = sky_rcv_ring_create(20, 3, 0);
-    SkySendRing *send_ring = sky_send_ring_create(20, 0);
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 20, 3, 0);
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 20, 0);
 
     // Check that the rings are created correctly.
 
@@ -76,8 +77,8 @@ TEST(create_rings)
     sky_send_ring_destroy(send_ring);
 
     // Create rings with different parameters.
-    rcv_ring = sky_rcv_ring_create(100, 4, 123);
-    send_ring = sky_send_ring_create(100, 123);
+    rcv_ring = sky_rcv_ring_create(NULL, 100, 4, 123);
+    send_ring = sky_send_ring_create(NULL, 100, 123);
 
     // Check that the rings are created correctly.
 
@@ -88,15 +89,15 @@ TEST(create_rings)
     sky_rcv_ring_destroy(rcv_ring);
     sky_send_ring_destroy(send_ring);
 
-    // Test creating a sequence that naturally wraps around. (Sequence number higher than max of u_int8_t) (300 translates to 44)
+    // Test creating a sequence that naturally wraps around. (Sequence number higher than max of sky_arq_sequence_t) (65836 translates to 300)
 
-    rcv_ring = sky_rcv_ring_create(100, 4, 300);
-    send_ring = sky_send_ring_create(100, 300);
+    rcv_ring = sky_rcv_ring_create(NULL, 100, 4, 65836);
+    send_ring = sky_send_ring_create(NULL, 100, 65836);
 
     // Check that the rings are created correctly.
 
-    check_rcv_ring(rcv_ring, 100, 4, 44);
-    check_send_ring(send_ring, 100, 44);
+    check_rcv_ring(rcv_ring, 100, 4, 300);
+    check_send_ring(send_ring, 100, 300);
 
     // Free the rings.
     sky_rcv_ring_destroy(rcv_ring);
@@ -105,28 +106,35 @@ TEST(create_rings)
     // Test creating rings with invalid parameters.
 
     // LEN < 3
-    rcv_ring = sky_rcv_ring_create(2, 4, 0);
-    send_ring = sky_send_ring_create(2, 0);
+    rcv_ring = sky_rcv_ring_create(NULL, 2, 4, 0);
+    send_ring = sky_send_ring_create(NULL, 2, 0);
 
     ASSERT(rcv_ring == NULL, "Receive ring is not NULL with invalid length.");
     ASSERT(send_ring == NULL, "Send ring is not NULL with invalid length.");
 
     // LEN < (HORIZON_WIDTH + 3)
 
-    rcv_ring = sky_rcv_ring_create(5, 4, 0);
+    rcv_ring = sky_rcv_ring_create(NULL, 5, 4, 0);
     // Invalid send ring length (No horizon width)
-    send_ring = sky_send_ring_create(2, 0);
+    send_ring = sky_send_ring_create(NULL, 2, 0);
 
     ASSERT(rcv_ring == NULL, "Receive ring is not NULL with invalid horizon width.");
     ASSERT(send_ring == NULL, "Send ring is not NULL with invalid length.");
+
+    // LEN > ARQ_MAXIMUM_RING_LENGTH
+    rcv_ring = sky_rcv_ring_create(NULL, ARQ_MAXIMUM_RING_LENGTH + 1, 4, 0);
+    send_ring = sky_send_ring_create(NULL, ARQ_MAXIMUM_RING_LENGTH + 1, 0);
+
+    ASSERT(rcv_ring == NULL, "Receive ring is not NULL with too long length.");
+    ASSERT(send_ring == NULL, "Send ring is not NULL with too long length.");
 }
 
 // Test that the rings are destroyed correctly.
 TEST(destroy_rings)
 {
     // Create a send ring and a receive ring.
-    SkyRcvRing *rcv_ring = sky_rcv_ring_create(20, 3, 0);
-    SkySendRing *send_ring = sky_send_ring_create(20, 0);
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 20, 3, 0);
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 20, 0);
 
     // Check that the rings are created correctly.
 
@@ -144,8 +152,8 @@ TEST(destroy_rings)
 TEST(wipe_rings)
 {
     // Create a send ring and a receive ring.
-    SkyRcvRing *rcv_ring = sky_rcv_ring_create(20, 3, 0);
-    SkySendRing *send_ring = sky_send_ring_create(20, 0);
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 20, 3, 0);
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 20, 0);
 
     // Check that the rings are created correctly.
 
@@ -154,50 +162,47 @@ TEST(wipe_rings)
 
     // Create an element buffer for both rings and fill it with some data.
 
-    SkyElementBuffer *rcv_eb = sky_element_buffer_create(10, 20);
-
-    SkyElementBuffer *send_eb = sky_element_buffer_create(10, 20);
-
-    // Fill the element buffers with some data.
-    for (int i = 0; i < 20; i++)
-    {
-        // Create data with length 10 for both element buffers.
-        u_int8_t *data = malloc(10);
-        u_int8_t *data2 = malloc(10);
-        for (int j = 0; j < 10; j++)
-        {
-            data[j] = i;
-            data2[j] = i;
-        }
-        // Data needs to be const for the element buffer store function.
-        const u_int8_t *const_data = data;
-        const u_int8_t *const_data2 = data2;
-
-        // Write the data to the element buffers.
-        sky_element_buffer_store(rcv_eb, const_data, 10);
-        sky_element_buffer_store(send_eb, const_data2, 10);
+    SkyElementBuffer *rcv_eb = sky_element_buffer_create(NULL, 10, 20);
+
+    SkyElementBuffer *send_eb = sky_element_buffer_create(NULL, 10, 20);
+
+    // Move the rings around the end and leave packets in every part of them: readable and ahead of the head in the
+    // receive ring, acknowledged, sent, scheduled for resend and unsent in the send ring.
+    uint8_t data[10] = { 0 };
+    uint8_t tgt[10];
+    sky_arq_sequence_t sequence;
+    for (int i = 0; i < 17; i++) {
+        ASSERT(rcvRing_push_rx_packet(rcv_ring, rcv_eb, data, 10, i) >= 0);
+        ASSERT(rcvRing_read_next_received(rcv_ring, rcv_eb, tgt, 10) == 0);
+        ASSERT(sendRing_push_packet_to_send(send_ring, send_eb, data, 10) >= 0);
+        ASSERT(sendRing_read_to_tx(send_ring, send_eb, tgt, &sequence, 0) >= 0);
+        ASSERT(sendRing_clean_tail_up_to(send_ring, send_eb, i + 1) == 1);
     }
+    ASSERT(rcvRing_push_rx_packet(rcv_ring, rcv_eb, data, 10, 17) >= 0);
+    ASSERT(rcvRing_push_rx_packet(rcv_ring, rcv_eb, data, 10, 18) >= 0);
+    ASSERT(rcvRing_push_rx_packet(rcv_ring, rcv_eb, data, 10, 20) >= 0);
+    for (int i = 0; i < 5; i++)
+        ASSERT(sendRing_push_packet_to_send(send_ring, send_eb, data, 10) >= 0);
+    for (int i = 0; i < 3; i++)
+        ASSERT(sendRing_read_to_tx(send_ring, send_eb, tgt, &sequence, 0) >= 0);
+    ASSERT(sendRing_schedule_resend(send_ring, 18) == 0);
+    ASSERT(rcv_eb->free_elements < 20 && send_eb->free_elements < 20);
+
+    // Wiping visits only the slots in use and deletes their payloads.
+    sky_rcv_ring_wipe(rcv_ring, rcv_eb, 0);
+    sky_send_ring_wipe(send_ring, send_eb, 0);
+    check_rcv_ring(rcv_ring, 20, 3, 0);
+    check_send_ring(send_ring, 20, 0);
+    ASSERT(rcv_eb->free_elements == 20 && send_eb->free_elements == 20);
 
-    // Check that the element buffers are filled correctly. This is not a test for the element buffer, so we don't need extensive testing.
-    // Functionality of storing to the element buffer will be tested in another test.
-    ASSERT(rcv_eb->free_elements == 0, "Element buffer free elements is not 0, it is %d.", rcv_eb->free_elements);
-    ASSERT(send_eb->free_elements == 0, "Element buffer free elements is not 0, it is %d.", send_eb->free_elements);
-
-    // Change values of the rcv_ring and send_ring to make sure that the wipe function sets them to the correct values.
+    // Dirty the counters once more.
     rcv_ring->head_sequence = 123;
     rcv_ring->tail_sequence = 123;
-    rcv_ring->head = 123;
-    rcv_ring->tail = 123;
-    rcv_ring->storage_count = 123;
-
     send_ring->head_sequence = 123;
     send_ring->tail_sequence = 123;
-    send_ring->head = 123;
-    send_ring->tail = 123;
-    send_ring->storage_count = 123;
-    send_ring->tx_head = 123;
     send_ring->tx_sequence = 123;
     send_ring->resend_count = 123;
+    send_ring->resend_fifo_count = 12;
 
     // Wipe the rings.
     sky_rcv_ring_wipe(rcv_ring, NULL, 0);
@@ -217,8 +222,8 @@ TEST(wipe_rings)
 TEST(push_and_read_packets)
 {
     // Create a send ring and a receive ring.
-    SkyRcvRing *rcv_ring = sky_rcv_ring_create(20, 3, 0);
-    SkySendRing *send_ring = sky_send_ring_create(20, 0);
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 20, 3, 0);
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 20, 0);
 
     // Check that the rings are created correctly.
 
@@ -227,7 +232,7 @@ TEST(push_and_read_packets)
 
     // Create an element buffer for both rings and fill it with some data. (Element usable space is 16 bytes.)
 
-    SkyElementBuffer *eb = sky_element_buffer_create(16, 20);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 20);
 
     ASSERT(eb->free_elements == 20, "Element buffer free elements is not 20, it is %d.", eb->free_elements);
 
@@ -313,7 +318,9 @@ TEST(push_and_read_packets)
     memset(pl, 0, 120);
 
     // Read the data from the element buffer.
-    sendRing_read_to_tx(send_ring, eb, pl, &send_ring->buff[0].sequence, 0);
+    sky_arq_sequence_t sequence;
+    sendRing_read_to_tx(send_ring, eb, pl, &sequence, 0);
+    send_ring->buff[0].sequence = sequence;
 
     // Check that the data was read correctly. This also asserts that the data was written correctly.
     for (int i = 0; i < 120; i++)
@@ -355,18 +362,225 @@ TEST(push_and_read_packets)
     sky_send_ring_destroy(send_ring);
 }
 
-// Test wrapping around the ring indexes and naturally wrapping around the sequence number with u_int8_t overflow.
+// Test accessing received packets in place and releasing them.
+TEST(peek_and_release)
+{
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 20, 3, 0);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 20);
+    u_int8_t *pl = create_payload(40);
+
+    // Nothing to peek or release in empty ring.
+    struct sky_iovec spans[4];
+    ASSERT(rcvRing_peek_next_received(rcv_ring, eb, spans, 4) == SKY_RET_RING_EMPTY);
+    ASSERT(rcvRing_release_next_received(rcv_ring, eb) == SKY_RET_RING_EMPTY);
+
+    // 40 bytes take 3 elements: 14 + 16 + 10 bytes.
+    rcvRing_push_rx_packet(rcv_ring, eb, pl, 40, 0);
+    ASSERT(rcvRing_peek_next_received(rcv_ring, eb, spans, 2) == SKY_RET_EBUFFER_TOO_LONG_PAYLOAD);
+    int n = rcvRing_peek_next_received(rcv_ring, eb, spans, 4);
+    ASSERT(n == 3, "Span count is not 3, it is %d.", n);
+    ASSERT(spans[0].iov_len == 14 && spans[1].iov_len == 16 && spans[2].iov_len == 10);
+
+    // The spans concatenate to the original payload.
+    int cursor = 0;
+    for (int i = 0; i < n; i++) {
+        ASSERT_MEMORY(spans[i].iov_base, &pl[cursor], spans[i].iov_len);
+        cursor += spans[i].iov_len;
+    }
+
+    // Peeking doesn't consume the packet.
+    ASSERT(rcvRing_count_readable_packets(rcv_ring) == 1);
+    ASSERT(rcvRing_peek_next_received(rcv_ring, eb, spans, 4) == 3);
+
+    // Releasing frees the elements and advances the tail.
+    ASSERT(rcvRing_release_next_received(rcv_ring, eb) == SKY_RET_OK);
+    ASSERT(rcvRing_count_readable_packets(rcv_ring) == 0);
+    ASSERT(rcv_ring->tail_sequence == 1, "Tail sequence is not 1, it is %d.", rcv_ring->tail_sequence);
+    ASSERT(eb->free_elements == 20, "Element buffer free elements is not 20, it is %d.", eb->free_elements);
+
+    free(pl);
+    sky_element_buffer_destroy(eb);
+    sky_rcv_ring_destroy(rcv_ring);
+}
+
+TEST(read_received_batch)
+{
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 12, 4, 0);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 40);
+    u_int8_t *pl = create_payload(40);
+    SkyPacketView views[8];
+    uint8_t arena[100];
+
+    // Empty ring reads nothing.
+    ASSERT(rcvRing_read_received_batch(rcv_ring, eb, views, 8, arena, sizeof(arena)) == 0);
+
+    // Five packets across the ring wrap, the last one behind a gap.
+    rcv_ring->head = rcv_ring->tail = 10;
+    for (int i = 0; i < 4; i++)
+        ASSERT(rcvRing_push_rx_packet(rcv_ring, eb, &pl[i], 10 + i, i) == 1);
+    ASSERT(rcvRing_push_rx_packet(rcv_ring, eb, pl, 10, 5) == 0);
+
+    // Limited by the view count.
+    int n = rcvRing_read_received_batch(rcv_ring, eb, views, 2, arena, sizeof(arena));
+    ASSERT(n == 2, "Read %d packets", n);
+    ASSERT(views[0].data == arena && views[0].length == 10 && views[0].sequence == 0);
+    ASSERT(views[1].data == arena + 10 && views[1].length == 11 && views[1].sequence == 1);
+    ASSERT_MEMORY(views[1].data, &pl[1], 11);
+    ASSERT(rcv_ring->tail == 0 && rcv_ring->tail_sequence == 2);
+
+    // Limited by the arena. The packet that didn't fit stays in the ring.
+    n = rcvRing_read_received_batch(rcv_ring, eb, views, 8, arena, 20);
+    ASSERT(n == 1, "Read %d packets", n);
+    ASSERT(views[0].length == 12 && views[0].sequence == 2);
+    ASSERT(rcvRing_read_received_batch(rcv_ring, eb, views, 8, arena, 10) == SKY_RET_EBUFFER_TOO_LONG_PAYLOAD);
+    ASSERT(rcvRing_count_readable_packets(rcv_ring) == 1);
+
+    // Filling the gap makes the rest readable in one go.
+    ASSERT(rcvRing_push_rx_packet(rcv_ring, eb, pl, 40, 4) == 2);
+    n = rcvRing_read_received_batch(rcv_ring, eb, views, 8, arena, sizeof(arena));
+    ASSERT(n == 3, "Read %d packets", n);
+    ASSERT(views[0].sequence == 3 && views[1].sequence == 4 && views[2].sequence == 5);
+    ASSERT_MEMORY(views[1].data, pl, 40);
+    ASSERT(rcv_ring->tail_sequence == 6 && rcv_ring->head_sequence == 6);
+    ASSERT(rcv_ring->storage_count == 0);
+    ASSERT(eb->free_elements == 40, "Element buffer free elements is not 40, it is %d.", eb->free_elements);
+
+    free(pl);
+    sky_element_buffer_destroy(eb);
+    sky_rcv_ring_destroy(rcv_ring);
+}
+
+TEST(push_batch)
+{
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 6, 0);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 10);
+    u_int8_t *pl = create_payload(160);
+    struct sky_iovec packets[6];
+    for (int i = 0; i < 6; i++) {
+        packets[i].iov_base = &pl[i];
+        packets[i].iov_len = 10;
+    }
+
+    // One packet in the ring already. Five slots is more than what is left.
+    ASSERT(sendRing_push_packet_to_send(send_ring, eb, pl, 10) == 0);
+    ASSERT(sendRing_count_free_send_slots(send_ring) == 4);
+    ASSERT(sendRing_push_batch(send_ring, eb, packets, 5) == SKY_RET_RING_RING_FULL);
+    ASSERT(send_ring->head_sequence == 1 && send_ring->storage_count == 1);
+
+    // Slots would be enough but the elements are not. Nothing is stored.
+    packets[1].iov_len = 150;
+    ASSERT(sendRing_push_batch(send_ring, eb, packets, 3) == SKY_RET_EBUFFER_NO_SPACE);
+    ASSERT(send_ring->head_sequence == 1 && send_ring->storage_count == 1);
+    ASSERT(eb->free_elements == 9, "Element buffer free elements is not 9, it is %d.", eb->free_elements);
+    ASSERT(sky_element_buffer_free_space(eb) == 9 * 16 - 2);
+
+    // Fitting batch gets consecutive sequences.
+    packets[1].iov_len = 40;
+    ASSERT(sendRing_push_batch(send_ring, eb, packets, 3) == 1);
+    ASSERT(send_ring->head_sequence == 4 && send_ring->storage_count == 4);
+    ASSERT(eb->free_elements == 4, "Element buffer free elements is not 4, it is %d.", eb->free_elements);
+    for (int i = 0; i < 4; i++) {
+        uint8_t tgt[60];
+        sky_arq_sequence_t sequence;
+        int ret = sendRing_read_to_tx(send_ring, eb, tgt, &sequence, 0);
+        ASSERT(ret == (i == 2 ? 40 : 10), "Read %d bytes", ret);
+        ASSERT(sequence == i);
+        if (i > 0)
+            ASSERT_MEMORY(tgt, packets[i - 1].iov_base, ret);
+    }
+
+    free(pl);
+    sky_element_buffer_destroy(eb);
+    sky_send_ring_destroy(send_ring);
+}
+
+TEST(priority_and_expiry)
+{
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 8, 0);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 20);
+    u_int8_t *pl = create_payload(10);
+
+    // Bulk, housekeeping that expires after 100 ticks, bulk, urgent command.
+    const uint8_t priorities[] = { 0, 1, 0, 2 };
+    const sky_tick_t ttls[] = { 0, 100, 0, 0 };
+    for (int i = 0; i < 4; i++) {
+        struct sky_iovec iov = { &pl[i], 4 };
+        ASSERT(sendRing_push_packet_with_options(send_ring, eb, &iov, 1, priorities[i], ttls[i], 1000) == i);
+    }
+
+    // Urgent first, then housekeeping while it is valid. Sequences stay in order.
+    const int expected[] = { 3, 1, 0, 2 };
+    for (int i = 0; i < 4; i++) {
+        ASSERT(sendRing_prepare_unreliable_tx(send_ring, eb, 1050) == 0);
+        uint8_t tgt[10];
+        sky_arq_sequence_t sequence;
+        ASSERT(sendRing_read_to_tx(send_ring, eb, tgt, &sequence, 0) == 4);
+        ASSERT(sequence == i, "Sequence is not %d, it is %d.", i, sequence);
+        ASSERT_MEMORY(tgt, &pl[expected[i]], 4);
+        sendRing_clean_tail_up_to(send_ring, eb, send_ring->tx_sequence);
+    }
+    ASSERT(eb->free_elements == 20);
+
+    // Expired housekeeping is dropped when it would be next.
+    for (int i = 0; i < 3; i++) {
+        struct sky_iovec iov = { &pl[i], 4 };
+        sendRing_push_packet_with_options(send_ring, eb, &iov, 1, priorities[i], ttls[i], 1000);
+    }
+    ASSERT(sendRing_prepare_unreliable_tx(send_ring, eb, 1101) == 1);
+    ASSERT(sendRing_count_packets_to_send(send_ring, 0) == 2);
+    ASSERT(send_ring->tail_sequence == 5 && send_ring->tx_sequence == 5);
+    ASSERT(eb->free_elements == 18);
+
+    // Time-to-live runs over the tick wrap.
+    sky_send_ring_wipe(send_ring, eb, 0);
+    struct sky_iovec iov = { pl, 4 };
+    sendRing_push_packet_with_options(send_ring, eb, &iov, 1, 0, 100, MOD_TIME_TICKS - 10);
+    ASSERT(sendRing_prepare_unreliable_tx(send_ring, eb, 50) == 0);
+    ASSERT(sendRing_prepare_unreliable_tx(send_ring, eb, 91) == 1);
+    ASSERT(sendRing_count_packets_to_send(send_ring, 0) == 0);
+
+    // Untransmitted packets are counted per class. Priorities past the classes go to the highest one.
+    sky_send_ring_wipe(send_ring, eb, 0);
+    const uint8_t more_priorities[] = { 1, 200, 1, SKY_SEND_PRIORITY_CLASSES - 1 };
+    for (int i = 0; i < 4; i++) {
+        struct sky_iovec iov = { &pl[i], 4 };
+        sendRing_push_packet_with_options(send_ring, eb, &iov, 1, more_priorities[i], 0, 0);
+    }
+    ASSERT(send_ring->queued_per_priority[1] == 2);
+    ASSERT(send_ring->queued_per_priority[SKY_SEND_PRIORITY_CLASSES - 1] == 2);
+    const int more_expected[] = { 1, 3, 0, 2 };
+    for (int i = 0; i < 4; i++) {
+        uint8_t tgt[10];
+        sky_arq_sequence_t sequence;
+        ASSERT(sendRing_prepare_unreliable_tx(send_ring, eb, 0) == 0);
+        ASSERT(sendRing_read_to_tx(send_ring, eb, tgt, &sequence, 0) == 4);
+        ASSERT_MEMORY(tgt, &pl[more_expected[i]], 4);
+    }
+    for (int i = 0; i < SKY_SEND_PRIORITY_CLASSES; i++)
+        ASSERT(send_ring->queued_per_priority[i] == 0, "Class %d count: %d", i, send_ring->queued_per_priority[i]);
+
+    // Realigning makes the transmitted packets queued again.
+    sendRing_realign(send_ring, 100);
+    ASSERT(send_ring->queued_per_priority[1] == 2);
+    ASSERT(send_ring->queued_per_priority[SKY_SEND_PRIORITY_CLASSES - 1] == 2);
+
+    free(pl);
+    sky_element_buffer_destroy(eb);
+    sky_send_ring_destroy(send_ring);
+}
+
+// Test wrapping around the ring indexes and naturally wrapping around the 16-bit sequence number from 65535 to 0.
 TEST(wrap_around)
 {
     // Create a send ring and a receive ring and push multiple packets to them in order to have packets on both sides of the wrap around.
 
-    SkyRcvRing *rcv_ring = sky_rcv_ring_create(8, 3, 250);
-    SkySendRing *send_ring = sky_send_ring_create(8, 250);
+    SkyRcvRing *rcv_ring = sky_rcv_ring_create(NULL, 8, 3, 65530);
+    SkySendRing *send_ring = sky_send_ring_create(NULL, 8, 65530);
 
     // Check that the rings are created correctly.
 
-    check_rcv_ring(rcv_ring, 8, 3, 250);
-    check_send_ring(send_ring, 8, 250);
+    check_rcv_ring(rcv_ring, 8, 3, 65530);
+    check_send_ring(send_ring, 8, 65530);
 
     // Set the head and tail to 5 to have packets on both sides of the wrap around.
 
@@ -378,7 +592,7 @@ TEST(wrap_around)
 
     // Create an element buffer for both rings and fill it with some data. (Element usable space is 16 bytes.)
 
-    SkyElementBuffer *eb = sky_element_buffer_create(16, 200);
+    SkyElementBuffer *eb = sky_element_buffer_create(NULL, 16, 200);
 
     ASSERT(eb->free_elements == 200, "Element buffer free elements is not 200, it is %d.", eb->free_elements);
     ASSERT(eb->element_usable_space == 16, "Element buffer usable space is not 16, it is %d.", eb->element_usable_space);
@@ -392,13 +606,13 @@ TEST(wrap_around)
     // Push the packets to the rings.
     for (int i = 0; i < 7; i++)
     {
-        int pushed = rcvRing_push_rx_packet(rcv_ring, eb, &const_pl[12 * i], 12, 250 + i);
+        int pushed = rcvRing_push_rx_packet(rcv_ring, eb, &const_pl[12 * i], 12, 65530 + i);
         int pushed2 = sendRing_push_packet_to_send(send_ring, eb, &const_pl[12 * i], 12);
         ASSERT(pushed >= 0, "Packet %d was not pushed to receive ring. Error code: %d", i, pushed);
         ASSERT(pushed2 >= 0, "Packet %d was not pushed to send ring. Error code: %d", i, pushed2);
     }
     int j = 0;
-    u_int8_t seq = 250;
+    sky_arq_sequence_t seq = 65530;
     // Check that the packets were pushed correctly.
     for (u_int8_t i = 5; i != 4; i++, j++)
     {
@@ -458,7 +672,9 @@ TEST(wrap_around)
     // Read the data from the element buffer.
     for (int i = 0; i < 7; i++)
     {
-        int read = sendRing_read_to_tx(send_ring, eb, &pl[12 * i], &send_ring->buff[i].sequence, 0);
+        sky_arq_sequence_t sequence;
+        int read = sendRing_read_to_tx(send_ring, eb, &pl[12 * i], &sequence, 0);
+        send_ring->buff[i].sequence = sequence;
         ASSERT(read >= 0, "Packet %d was not read from send ring. Error code: %d", i, read);
     }
 
@@ -499,7 +715,7 @@ TEST(resend_list)
 {
 
     // Create a send ring.
-    SkyVCConfig config;
+    SkyVCConfig config = { 0 };
     config.send_ring_len = 10;
     config.rcv_ring_len = 10;
     config.horizon_width = 4;
@@ -522,16 +738,65 @@ TEST(resend_list)
     vc->sendRing->tx_head = 19;
     // Schedule resends by mask-> 0b00110011 Resend list should have sequences 1, 4, 5, 8. Index 9 shouldn't be filled, because tx_head ahead of tail == sequence_ahead_of_tail.
     sendRing_schedule_resends_by_mask(vc->sendRing, 1, 0b00110011);
-    // Check that resend list is filled correctly.
-    ASSERT(vc->sendRing->resend_list[0] == 1, "Resend list index 0 is not 1, it is %d.", vc->sendRing->resend_list[0]);
-    ASSERT(vc->sendRing->resend_list[1] == 4, "Resend list index 1 is not 4, it is %d.", vc->sendRing->resend_list[1]);
-    ASSERT(vc->sendRing->resend_list[2] == 5, "Resend list index 2 is not 5, it is %d.", vc->sendRing->resend_list[2]);
-    ASSERT(vc->sendRing->resend_list[3] == 8, "Resend list index 3 is not 8, it is %d.", vc->sendRing->resend_list[3]);
-    ASSERT(vc->sendRing->resend_list[4] == 0, "Resend list index 4 is not 0, it is %d.", vc->sendRing->resend_list[4]);
-    ASSERT(vc->sendRing->resend_list[5] == 0, "Resend list index 5 is not 0, it is %d.", vc->sendRing->resend_list[5]);
-    ASSERT(vc->sendRing->resend_list[6] == 0, "Resend list index 6 is not 0, it is %d.", vc->sendRing->resend_list[6]);
-    ASSERT(vc->sendRing->resend_list[7] == 0, "Resend list index 7 is not 0, it is %d.", vc->sendRing->resend_list[7]);
+    // Check that resend schedule is filled correctly.
+    const int expected[] = { 1, 4, 5, 8 };
+    ASSERT(vc->sendRing->resend_count == 4, "Resend count is not 4, it is %d.", vc->sendRing->resend_count);
+    ASSERT(vc->sendRing->resend_fifo_count == 4, "Resend FIFO count is not 4, it is %d.", vc->sendRing->resend_fifo_count);
+    for (int i = 0; i < 4; i++)
+        ASSERT(vc->sendRing->resend_fifo[i] == expected[i], "Resend FIFO index %d is not %d, it is %d.", i, expected[i], vc->sendRing->resend_fifo[i]);
+
+    // Scheduling again doesn't create duplicates.
+    ASSERT(sendRing_schedule_resend(vc->sendRing, 4) == SKY_RET_OK);
+    ASSERT(vc->sendRing->resend_count == 4, "Resend count is not 4, it is %d.", vc->sendRing->resend_count);
+    ASSERT(sendRing_get_next_resend_sequence(vc->sendRing) == 1);
 
+    sky_vc_destroy(vc);
+}
+
+// Send ring: Resends are popped in the order they were scheduled and more than 16 can be pending.
+TEST(resend_schedule_order)
+{
+    SkyVCConfig config = { 0 };
+    config.send_ring_len = 40;
+    config.rcv_ring_len = 10;
+    config.horizon_width = 4;
+    config.usable_element_size = 60;
+    SkyVirtualChannel *vc = sky_vc_create(&config);
+
+    uint8_t *pl = create_payload(30);
+    uint8_t tgt[100];
+    sky_arq_sequence_t seq;
+    for (int i = 0; i < 30; i++) {
+        ASSERT(sky_vc_push_packet_to_send(vc, pl, 30) == i);
+        ASSERT(sendRing_read_to_tx(vc->sendRing, vc->elementBuffer, tgt, &seq, 0) == 30);
+    }
+
+    // Schedule all sent packets in reverse order.
+    for (int i = 29; i >= 0; i--)
+        ASSERT(sendRing_schedule_resend(vc->sendRing, i) == SKY_RET_OK);
+    ASSERT(sendRing_count_packets_to_send(vc->sendRing, 1) == 30);
+    ASSERT(sendRing_schedule_resend(vc->sendRing, 30) == SKY_RET_RING_CANNOT_RECALL);
+
+    // Pop a few and then reschedule one of them.
+    for (int i = 29; i >= 27; i--) {
+        ASSERT(sendRing_read_to_tx(vc->sendRing, vc->elementBuffer, tgt, &seq, 1) == 30);
+        ASSERT(seq == i, "Popped %d instead of %d", seq, i);
+    }
+    ASSERT(sendRing_schedule_resend(vc->sendRing, 28) == SKY_RET_OK);
+
+    // Acknowledge the first ten. The rest come out in scheduling order.
+    sendRing_clean_tail_up_to(vc->sendRing, vc->elementBuffer, 10);
+    for (int i = 26; i >= 10; i--) {
+        ASSERT(sendRing_read_to_tx(vc->sendRing, vc->elementBuffer, tgt, &seq, 1) == 30);
+        ASSERT(seq == i, "Popped %d instead of %d", seq, i);
+    }
+    ASSERT(sendRing_read_to_tx(vc->sendRing, vc->elementBuffer, tgt, &seq, 1) == 30);
+    ASSERT(seq == 28);
+    ASSERT(vc->sendRing->resend_count == 0);
+    ASSERT(sendRing_get_next_resend_sequence(vc->sendRing) == SKY_RET_RING_EMPTY);
+
+    free(pl);
+    sky_vc_destroy(vc);
 }
 
 // Recieve ring: Test having packets be lost and them pushing them afterwards.
@@ -540,7 +805,7 @@ TEST(resend_list)
 TEST(lost_packets)
 {
     // Create config
-    SkyVCConfig config;
+    SkyVCConfig config = { 0 };
     config.send_ring_len = 15;
     config.rcv_ring_len = 15;
     config.horizon_width = 4;
@@ -621,12 +886,222 @@ TEST(lost_packets)
     sky_vc_destroy(vc);
 }
 
+// Receive ring: The presence map should cover the start of the horizon and follow the head as it advances.
+TEST(wide_horizon_bitmap)
+{
+    SkyVCConfig config = { 0 };
+    config.send_ring_len = 10;
+    config.rcv_ring_len = 70;
+    config.horizon_width = ARQ_HORIZON_MAP_BITS;
+    config.usable_element_size = 60;
+    SkyVirtualChannel *vc = sky_vc_create(&config);
+    check_rcv_ring(vc->rcvRing, 70, ARQ_HORIZON_MAP_BITS, 0);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == 0);
+
+    uint8_t *pl = create_payload(20);
+    const int sequences[] = { 0, 2, 20, 40, 63 };
+    for (unsigned int i = 0; i < ARRAY_SZ(sequences); i++)
+        ASSERT(sky_vc_push_rx_packet(vc, pl, 20, sequences[i], 10) >= 0);
+
+    // Head waits for sequence 1. Narrow bitmap sees only the first 16 packets past the head.
+    ASSERT(vc->rcvRing->head_sequence == 1);
+    sky_arq_wide_mask_t expected = (1ULL << 0) | (1ULL << 18) | (1ULL << 38) | (1ULL << 61);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == expected);
+    ASSERT(rcvRing_get_horizon_bitmap(vc->rcvRing) == 0x0001, "%04x", rcvRing_get_horizon_bitmap(vc->rcvRing));
+
+    // Receiving the missing packet advances the head by two and the map with it.
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 1, 10) >= 0);
+    ASSERT(vc->rcvRing->head_sequence == 3);
+    expected = (1ULL << 16) | (1ULL << 36) | (1ULL << 59);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == expected);
+    ASSERT(rcvRing_get_horizon_bitmap(vc->rcvRing) == 0);
+
+    // Last sequence of the horizon uses the highest bit.
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 3 + ARQ_HORIZON_MAP_BITS, 10) >= 0);
+    ASSERT((rcvRing_get_horizon_bitmap_wide(vc->rcvRing) >> 63) == 1);
+
+    // Wiping clears the map.
+    sky_rcv_ring_wipe(vc->rcvRing, vc->elementBuffer, 0);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == 0);
+
+    free(pl);
+    sky_vc_destroy(vc);
+}
+
+// Receive ring: Horizon longer than the presence map. Packets past the map enter it as the head advances.
+TEST(long_horizon)
+{
+    SkyVCConfig config = { 0 };
+    config.send_ring_len = 10;
+    config.rcv_ring_len = 1000;
+    config.horizon_width = 500;
+    config.usable_element_size = 60;
+    SkyVirtualChannel *vc = sky_vc_create(&config);
+    check_rcv_ring(vc->rcvRing, 1000, 500, 0);
+
+    uint8_t *pl = create_payload(20);
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 400, 10) >= 0);
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 100, 10) >= 0);
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 501, 10) == SKY_RET_RING_INVALID_SEQUENCE);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == 0);
+
+    // Head at 36 puts the packet 100 on the highest bit of the map.
+    for (int i = 0; i < 36; i++)
+        ASSERT(sky_vc_push_rx_packet(vc, pl, 20, i, 10) >= 0);
+    ASSERT(vc->rcvRing->head_sequence == 36);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == (1ULL << 63));
+
+    // Filling the gap takes the head past packet 100. Packet 400 enters the map 64 sequences before the head reaches it.
+    for (int i = 36; i < 100; i++)
+        ASSERT(sky_vc_push_rx_packet(vc, pl, 20, i, 10) >= 0);
+    ASSERT(vc->rcvRing->head_sequence == 101);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == 0);
+    for (int i = 101; i < 340; i++)
+        ASSERT(sky_vc_push_rx_packet(vc, pl, 20, i, 10) >= 0);
+    ASSERT(rcvRing_get_horizon_bitmap_wide(vc->rcvRing) == (1ULL << 59));
+
+    free(pl);
+    sky_vc_destroy(vc);
+}
+
+// Receive ring: Retransmit request windows past the presence map reach the last packet received in the horizon.
+TEST(horizon_windows)
+{
+    SkyVCConfig config = { 0 };
+    config.send_ring_len = 10;
+    config.rcv_ring_len = 1000;
+    config.horizon_width = 500;
+    config.usable_element_size = 60;
+    SkyVirtualChannel *vc = sky_vc_create(&config);
+    sky_arq_sequence_t start;
+    sky_arq_wide_mask_t mask;
+
+    // Nothing ahead of the head.
+    ASSERT(rcvRing_get_horizon_extent(vc->rcvRing) == 0);
+    ASSERT(rcvRing_get_horizon_window(vc->rcvRing, 0, &start, &mask) == SKY_RET_RING_EMPTY);
+
+    uint8_t *pl = create_payload(20);
+    const int received[4] = { 1, 100, 101, 200 };
+    for (int i = 0; i < 4; i++)
+        ASSERT(sky_vc_push_rx_packet(vc, pl, 20, received[i], 10) >= 0);
+    ASSERT(rcvRing_get_horizon_extent(vc->rcvRing) == 201);
+
+    // Each window starts at a missing packet and marks the received ones.
+    ASSERT(rcvRing_get_horizon_window(vc->rcvRing, ARQ_HORIZON_MAP_BITS + 1, &start, &mask) == 130);
+    ASSERT(start == 65);
+    ASSERT(mask == ((1ULL << 34) | (1ULL << 35)));
+    ASSERT(rcvRing_get_horizon_window(vc->rcvRing, 130, &start, &mask) == 195);
+    ASSERT(start == 130);
+    ASSERT(mask == 0);
+
+    // Packets past the last received one are not requested.
+    ASSERT(rcvRing_get_horizon_window(vc->rcvRing, 195, &start, &mask) == 260);
+    ASSERT(start == 195);
+    ASSERT(mask == (~0ULL << 4));
+    ASSERT(rcvRing_get_horizon_window(vc->rcvRing, 260, &start, &mask) == SKY_RET_RING_EMPTY);
+
+    // Once the head passes the last packet, nothing is ahead.
+    ASSERT(sky_vc_push_rx_packet(vc, pl, 20, 0, 10) >= 0);
+    for (int i = 2; i < 200; i++)
+        if (i != 100 && i != 101)
+            ASSERT(sky_vc_push_rx_packet(vc, pl, 20, i, 10) >= 0);
+    ASSERT(vc->rcvRing->head_sequence == 201);
+    ASSERT(rcvRing_get_horizon_extent(vc->rcvRing) == 0);
+
+    // Sync tolerance follows the sequence width.
+    ASSERT(rcvRing_get_sequence_sync_status(vc->rcvRing, 201 + 127, 0) == SKY_RET_RING_SEQUENCES_OUT_OF_SYNC);
+    ASSERT(rcvRing_get_sequence_sync_status(vc->rcvRing, 201 + 128, 0) == SKY_RET_RING_SEQUENCES_DETACHED);
+    ASSERT(rcvRing_get_sequence_sync_status(vc->rcvRing, 201 + 2000, 1) == SKY_RET_RING_SEQUENCES_OUT_OF_SYNC);
+    ASSERT(rcvRing_get_sequence_sync_status(vc->rcvRing, 201 - 1, 1) == SKY_RET_RING_SEQUENCES_DETACHED);
+
+    free(pl);
+    sky_vc_destroy(vc);
+}
+
+// Parity of sent packets should repair a single lost packet on the receiving side.
+TEST(parity_repair)
+{
+    SkyVCConfig config = { 0 };
+    config.send_ring_len = 10;
+    config.rcv_ring_len = 10;
+    config.horizon_width = 4;
+    config.usable_element_size = 32;
+    SkyVirtualChannel *tx = sky_vc_create(&config);
+    SkyVirtualChannel *rx = sky_vc_create(&config);
+
+    // Packets of different lengths.
+    const int lengths[4] = { 10, 25, SKY_PAYLOAD_MAX_LEN, 7 };
+    uint8_t *pls[4];
+    uint8_t tgt[SKY_PAYLOAD_MAX_LEN];
+    sky_arq_sequence_t seq;
+    for (int i = 0; i < 4; i++) {
+        pls[i] = create_payload(lengths[i]);
+        ASSERT(sky_vc_push_packet_to_send(tx, pls[i], lengths[i]) == i);
+    }
+
+    // Only transmitted packets can be covered.
+    uint8_t parity[SKY_PAYLOAD_MAX_LEN];
+    uint8_t length_parity;
+    ASSERT(sendRing_build_parity(tx->sendRing, tx->elementBuffer, 0, 4, parity, &length_parity) == SKY_RET_RING_CANNOT_RECALL);
+    for (int i = 0; i < 4; i++)
+        ASSERT(sendRing_read_to_tx(tx->sendRing, tx->elementBuffer, tgt, &seq, 0) == lengths[i]);
+    int parity_length = sendRing_build_parity(tx->sendRing, tx->elementBuffer, 0, 4, parity, &length_parity);
+    ASSERT(parity_length == SKY_PAYLOAD_MAX_LEN, "Parity length: %d", parity_length);
+    ASSERT(length_parity == (uint8_t)(10 ^ 25 ^ SKY_PAYLOAD_MAX_LEN ^ 7));
+
+    // Nothing is missing.
+    for (int i = 0; i < 4; i++)
+        sky_vc_push_rx_packet(rx, pls[i], lengths[i], i, 10);
+    ASSERT(sky_vc_push_rx_parity(rx, parity, parity_length, 0, 4, length_parity, 10) == SKY_RET_RING_PACKET_ALREADY_IN);
+
+    // Lose each of the packets in turn and repair it.
+    for (int lost = 0; lost < 4; lost++) {
+        sky_rcv_ring_wipe(rx->rcvRing, rx->elementBuffer, 0);
+        for (int i = 0; i < 4; i++)
+            if (i != lost)
+                sky_vc_push_rx_packet(rx, pls[i], lengths[i], i, 10);
+        ASSERT(sky_vc_count_readable_rcv_packets(rx) == lost);
+
+        ASSERT(sky_vc_push_rx_parity(rx, parity, parity_length, 0, 4, length_parity, 10) >= 0);
+        ASSERT(sky_vc_count_readable_rcv_packets(rx) == 4);
+        for (int i = 0; i < 4; i++) {
+            ASSERT(sky_element_buffer_get_data_length(rx->elementBuffer, rx->rcvRing->buff[rx->rcvRing->tail].idx) == lengths[i]);
+            ASSERT(sky_vc_read_next_received(rx, tgt, sizeof(tgt)) == 0);
+            ASSERT(memcmp(tgt, pls[i], lengths[i]) == 0, "Packet %d differs when %d was lost", i, lost);
+        }
+    }
+
+    // Two losses can't be repaired.
+    sky_rcv_ring_wipe(rx->rcvRing, rx->elementBuffer, 0);
+    sky_vc_push_rx_packet(rx, pls[0], lengths[0], 0, 10);
+    sky_vc_push_rx_packet(rx, pls[3], lengths[3], 3, 10);
+    ASSERT(sky_vc_push_rx_parity(rx, parity, parity_length, 0, 4, length_parity, 10) == SKY_RET_RING_INVALID_SEQUENCE);
+
+    // Neither if the rest of the group has already been read.
+    sky_rcv_ring_wipe(rx->rcvRing, rx->elementBuffer, 0);
+    for (int i = 0; i < 3; i++)
+        sky_vc_push_rx_packet(rx, pls[i], lengths[i], i, 10);
+    ASSERT(sky_vc_read_next_received(rx, tgt, sizeof(tgt)) == 0);
+    ASSERT(sky_vc_push_rx_parity(rx, parity, parity_length, 0, 4, length_parity, 10) == SKY_RET_RING_INVALID_SEQUENCE);
+    ASSERT(sky_vc_count_readable_rcv_packets(rx) == 2);
+
+    // Acknowledged packets are not available for parity anymore.
+    sendRing_clean_tail_up_to(tx->sendRing, tx->elementBuffer, 1);
+    ASSERT(sendRing_build_parity(tx->sendRing, tx->elementBuffer, 0, 4, parity, &length_parity) == SKY_RET_RING_CANNOT_RECALL);
+    ASSERT(sendRing_build_parity(tx->sendRing, tx->elementBuffer, 1, 3, parity, &length_parity) == SKY_PAYLOAD_MAX_LEN);
+
+    for (int i = 0; i < 4; i++)
+        free(pls[i]);
+    sky_vc_destroy(tx);
+    sky_vc_destroy(rx);
+}
+
 // Test continuous pushing of packets to rings. (Should not cause any problems.)
 TEST(continuous_pushing)
 {
     int n = 30000; // Amount of packets to be pushed. Make smaller for faster testing.
     // Create config
-    SkyVCConfig config;
+    SkyVCConfig config = { 0 };
     config.send_ring_len = 15;
     config.rcv_ring_len = 15;
     config.horizon_width = 4;
@@ -649,8 +1124,8 @@ TEST(continuous_pushing)
         ASSERT(vc->sendRing->head == positive_modulo(i, 15), "Head is not %d, it is %d.", positive_modulo(i, 10), vc->sendRing->head);
 
         // Check head sequences.
-        ASSERT(vc->rcvRing->head_sequence == positive_modulo(i, 256), "Head sequence is not %d, it is %d.", positive_modulo(i, 256), vc->rcvRing->head_sequence);
-        ASSERT(vc->sendRing->head_sequence == positive_modulo(i, 256), "Head sequence is not %d, it is %d, I: %d.", positive_modulo(i, 256), vc->sendRing->head_sequence, i);
+        ASSERT(vc->rcvRing->head_sequence == positive_modulo(i, 65536), "Head sequence is not %d, it is %d.", positive_modulo(i, 65536), vc->rcvRing->head_sequence);
+        ASSERT(vc->sendRing->head_sequence == positive_modulo(i, 65536), "Head sequence is not %d, it is %d, I: %d.", positive_modulo(i, 65536), vc->sendRing->head_sequence, i);
 
         // Create a payload.
         u_int8_t *pl = create_payload(64);
@@ -667,7 +1142,7 @@ TEST(continuous_pushing)
 
         // Check that the packets weres pushed correctly.
         ASSERT(recieve_ret == 1, "Packet: %d, was not pushed to receive ring. Error code: %d", i, recieve_ret);
-        ASSERT(send_ret == positive_modulo(i, 256), "Packet: %d, was not pushed to send ring. Error code: %d", positive_modulo(i, 256), send_ret);
+        ASSERT(send_ret == positive_modulo(i, 65536), "Packet: %d, was not pushed to send ring. Error code: %d", positive_modulo(i, 65536), send_ret);
     
         // Free the payload.
         free(pl);
@@ -693,8 +1168,8 @@ TEST(continuous_pushing)
             ASSERT(vc->rcvRing->tail == positive_modulo(i, 15), "Tail is not %d, it is %d.", positive_modulo(i, 10), vc->rcvRing->tail);
             ASSERT(vc->sendRing->tail == positive_modulo(i, 15), "Tail is not %d, it is %d.", i, vc->sendRing->tail);
             // Check that the tail sequences were moved correctly.
-            ASSERT(vc->rcvRing->tail_sequence == positive_modulo(i, 256), "Tail sequence is not %d, it is %d.", positive_modulo(i, 256), vc->rcvRing->tail_sequence);
-            ASSERT(vc->sendRing->tail_sequence == positive_modulo(i, 256), "Tail sequence is not %d, it is %d.", positive_modulo(i, 256), vc->sendRing->tail_sequence);
+            ASSERT(vc->rcvRing->tail_sequence == positive_modulo(i, 65536), "Tail sequence is not %d, it is %d.", positive_modulo(i, 65536), vc->rcvRing->tail_sequence);
+            ASSERT(vc->sendRing->tail_sequence == positive_modulo(i, 65536), "Tail sequence is not %d, it is %d.", positive_modulo(i, 65536), vc->sendRing->tail_sequence);
         }
     }
 
@@ -77,6 +77,50 @@ TEST(tx_rx_with_golay_and_fec){
     free(config2);
     free(config);
 }
+TEST(tx_rx_with_golay_to_buffer){
+    SkyRadioFrame frame;
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    SkyConfig* config2 = malloc(sizeof(SkyConfig));
+    default_config(config);
+    default_config(config2);
+    SkyHandle handle = sky_create(config);
+    memcpy(config2->identity, "AAAA", 4);
+    SkyHandle handle2 = sky_create(config2);
+    handle->mac->last_belief_update = 0;
+    sky_vc_wipe_to_arq_on_state(handle->virtual_channels[0], 0x1234);
+    sky_vc_wipe_to_arq_on_state(handle2->virtual_channels[0], 0x1234);
+    handle->virtual_channels[0]->handshake_send = 0;
+    handle2->virtual_channels[0]->handshake_send = 0;
+    u_int8_t *pl = create_payload(60);
+    sendRing_push_packet_to_send(handle->virtual_channels[0]->sendRing, handle->virtual_channels[0]->elementBuffer, pl, 60);
+
+    // Too small output buffer is rejected without consuming the packet.
+    uint8_t out[3 + SKY_FRAME_MAX_LEN + RS_PARITYS];
+    int ret = sky_tx_with_golay_to(handle, out, sizeof(out) - 1);
+    ASSERT(ret == SKY_RET_RS_INVALID_LENGTH, "ret was %d", ret);
+    ASSERT(sendRing_count_packets_to_send(handle->virtual_channels[0]->sendRing, 0) == 1);
+
+    ret = sky_tx_with_golay_to(handle, out, sizeof(out));
+    ASSERT(ret > 3 + RS_PARITYS, "sky_tx_with_golay_to failed: %d", ret);
+
+    // Hand the encoded bytes to the receiver as a radio would.
+    memcpy(frame.raw, out, ret);
+    frame.length = ret;
+    ret = sky_rx_with_golay(handle2, &frame);
+    ASSERT(ret == 0, "sky_rx_with_golay failed with error code: %d", ret);
+    ASSERT(sky_vc_count_readable_rcv_packets(handle2->virtual_channels[0]) == 1);
+    uint8_t tgt[100];
+    ret = sky_vc_read_next_received(handle2->virtual_channels[0], tgt, 100);
+    ASSERT(ret == 0, "ret was %d", ret);
+    ASSERT(memcmp(tgt, pl, 60) == 0);
+
+    free(pl);
+    sky_destroy(handle);
+    sky_destroy(handle2);
+    free(config2);
+    free(config);
+}
+
 // No golay also ARQ off
 TEST(tx_rx_with_fec){
     SkyTransmitFrame TXframe;
@@ -162,6 +206,55 @@ TEST(tx_rx){
     free(config2);
     free(config);  
 }
+// Compressed header on an established link
+TEST(tx_rx_compressed_header){
+    SkyRadioFrame frame;
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    SkyConfig* config2 = malloc(sizeof(SkyConfig));
+    default_config(config);
+    default_config(config2);
+    config->vc[0].header_compression = 1;
+    config2->vc[0].header_compression = 1;
+    SkyHandle handle = sky_create(config);
+    memcpy(config2->identity, "AAAA", 4);
+    SkyHandle handle2 = sky_create(config2);
+    handle->mac->last_belief_update = 0;
+
+    // Established link with compression negotiated. Handle is the initiator.
+    sky_vc_wipe_to_arq_on_state(handle->virtual_channels[0], 0x1234);
+    sky_vc_wipe_to_arq_on_state(handle2->virtual_channels[0], 0x1234);
+    handle->virtual_channels[0]->handshake_send = 0;
+    handle->virtual_channels[0]->header_compression = 1;
+    handle->virtual_channels[0]->link_initiator = 1;
+    handle2->virtual_channels[0]->handshake_send = 0;
+    handle2->virtual_channels[0]->header_compression = 1;
+
+    u_int8_t *pl = create_payload(60);
+    sky_vc_push_packet_to_send(handle->virtual_channels[0], pl, 60);
+    int ret = sky_tx(handle, &frame);
+    ASSERT(ret == 1, "sky_tx failed: %d", ret);
+    ASSERT((frame.raw[0] & SKYLINK_FRAME_IDENTITY_MASK) == SKY_IDENTITY_LEN_COMPRESSED, "Header should be compressed");
+    ASSERT((frame.raw[1] & SKY_LINK_ID_DIRECTION_BIT) != 0, "Initiator should set the direction bit");
+
+    // Own frame is filtered and the peer accepts it.
+    ret = sky_rx(handle, &frame);
+    ASSERT(ret == SKY_RET_FILTERED_BY_IDENTITY, "sky_rx should filter own frame: %d", ret);
+    ret = sky_rx(handle2, &frame);
+    ASSERT(ret == 0, "sky_rx failed with error code: %d", ret);
+    ASSERT(sky_vc_count_readable_rcv_packets(handle2->virtual_channels[0]) == 1);
+
+    // Peer that hasn't negotiated compression can't resolve the link.
+    handle2->virtual_channels[0]->header_compression = 0;
+    ret = sky_rx(handle2, &frame);
+    ASSERT(ret == SKY_RET_UNKNOWN_LINK_ID, "sky_rx should fail with unknown link: %d", ret);
+
+    free(pl);
+    sky_destroy(handle);
+    sky_destroy(handle2);
+    free(config2);
+    free(config);
+}
+
 TEST(continuous_tx_rx){
     // N times NOTE: pushes same package, could be changed to have different packages (Ran succesfully with n = 300000).:
     int n = 1000;
@@ -214,7 +307,80 @@ TEST(continuous_tx_rx){
     free(config2);
     free(config);
 }
- 
+
+// A virtual channel whose queued packets have all expired doesn't start a frame.
+TEST(tx_expired_packets){
+    SkyRadioFrame frame;
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    SkyHandle handle = sky_create(config);
+    uint8_t *pl = create_payload(30);
+
+    sky_tick(0);
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[2], pl, 30, 0, 10, 0) >= 0);
+    handle->mac->T0 = 400;
+    sky_tick(500);
+    ASSERT(mac_can_send(handle->mac, 500));
+    ASSERT(sky_tx(handle, &frame) == 0);
+    ASSERT(sky_vc_count_packets_to_tx(handle->virtual_channels[2], 0) == 0);
+
+    // One that hasn't expired is still sent.
+    ASSERT(sky_vc_push_packet_with_options(handle->virtual_channels[2], pl, 30, 0, 1000, 500) >= 0);
+    ASSERT(sky_tx(handle, &frame) == 1);
+    ASSERT(frame.length > 30);
+
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
+
+// A retransmitted payload reuses the cached codeword and the patched parity still decodes without errors.
+TEST(tx_rx_with_fec_cache){
+    SkyRadioFrame frame, first, copy;
+    SkyDiagnostics diag = { 0 };
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    SkyConfig* config2 = malloc(sizeof(SkyConfig));
+    default_config(config);
+    default_config(config2);
+    config->arq.fec_cache_frames = 8;
+    SkyHandle handle = sky_create(config);
+    memcpy(config2->identity, "AAAA", 4);
+    SkyHandle handle2 = sky_create(config2);
+    ASSERT(handle->fec_cache != NULL);
+    ASSERT(handle2->fec_cache == NULL);
+    handle->mac->last_belief_update = 0;
+    sky_vc_wipe_to_arq_on_state(handle->virtual_channels[0], 0);
+    sky_vc_wipe_to_arq_on_state(handle2->virtual_channels[0], 0);
+    handle->virtual_channels[0]->handshake_send = 0;
+    handle2->virtual_channels[0]->handshake_send = 0;
+
+    uint8_t *pl = create_payload(60);
+    SkySendRing *sendRing = handle->virtual_channels[0]->sendRing;
+    const sky_arq_sequence_t sequence = sendRing->head_sequence;
+    ASSERT(sendRing_push_packet_to_send(sendRing, handle->virtual_channels[0]->elementBuffer, pl, 60) >= 0);
+    ASSERT(sky_tx_with_fec(handle, &frame) == 1);
+    ASSERT(handle->tx_fec_key == sequence, "key %d", handle->tx_fec_key);
+    memcpy(&first, &frame, sizeof(SkyRadioFrame));
+    ASSERT(sky_rx_with_fec(handle2, &frame) == 0);
+
+    // The retransmission differs from the first frame only in a few header bytes.
+    ASSERT(sendRing_schedule_resend(sendRing, sequence) == 0);
+    ASSERT(sky_tx_with_fec(handle, &frame) == 1);
+    ASSERT(handle->tx_fec_key == sequence, "key %d", handle->tx_fec_key);
+    ASSERT(frame.length == first.length, "%d %d", frame.length, first.length);
+    ASSERT(memcmp(frame.raw, first.raw, frame.length) != 0);
+    memcpy(&copy, &frame, sizeof(SkyRadioFrame));
+    ASSERT(sky_fec_decode(&copy, &diag) == 0);
+    ASSERT(diag.rx_fec_errs == 0);
+    ASSERT(sky_rx_with_fec(handle2, &frame) == 0);
+
+    free(pl);
+    sky_destroy(handle);
+    sky_destroy(handle2);
+    free(config2);
+    free(config);
+}
+
 
 // Possible bug note: If Arq state is in init / idle frame without payload is sent payload length will be set to 0 in sky_rx. (No flag set.)
 // If vc requires authentication, then authentication will fail because payload length < HMAC length.
@@ -0,0 +1,155 @@
+// Tests for saving and restoring the state of a skylink instance.
+
+#include "units.h"
+
+// Bring the instance to a state with something in every part of the image.
+static void fill_state(SkyHandle handle, const uint8_t *pl)
+{
+    SkyVirtualChannel* vc0 = handle->virtual_channels[0];
+    SkyVirtualChannel* vc1 = handle->virtual_channels[1];
+    SkyVirtualChannel* vc2 = handle->virtual_channels[2];
+
+    // ARQ on with packets sent, unacknowledged and scheduled for resend.
+    sky_vc_wipe_to_arq_on_state(vc0, 10);
+    for (int i = 0; i < 5; i++)
+        ASSERT(sky_vc_push_packet_to_send(vc0, pl, 20 + 30 * i) >= 0);
+    uint8_t tgt[SKY_PAYLOAD_MAX_LEN];
+    sky_arq_sequence_t sequence;
+    for (int i = 0; i < 3; i++)
+        ASSERT(sky_vc_read_packet_for_tx(vc0, tgt, &sequence, 1) >= 0);
+    ASSERT(sendRing_schedule_resend(vc0->sendRing, 1) == 0);
+    vc0->last_tx_tick = 1000;
+
+    // Received packets, one of them ahead of the head in the horizon.
+    ASSERT(sky_vc_push_rx_packet(vc1, pl, 50, 0, 100) >= 0);
+    ASSERT(sky_vc_push_rx_packet(vc1, pl + 1, 60, 1, 100) >= 0);
+    ASSERT(sky_vc_push_rx_packet(vc1, pl + 2, 70, 3, 100) >= 0);
+
+    // Queued packets with priorities and time to live.
+    ASSERT(sky_vc_push_packet_with_options(vc2, pl, 30, 0, 0, 0) >= 0);
+    ASSERT(sky_vc_push_packet_with_options(vc2, pl + 3, 40, 2, 500, 0) >= 0);
+
+    handle->mac->T0 = 12345;
+    handle->mac->vc_round_robin_start = 2;
+    handle->hmac->sequence_tx[1] = 77;
+    handle->hmac->sequence_rx[2] = 1234;
+}
+
+// Test that a restored instance continues from the same state.
+TEST(snapshot_restore){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    uint8_t *pl = create_payload(SKY_PAYLOAD_MAX_LEN);
+    SkyHandle handle = sky_create(config);
+    fill_state(handle, pl);
+
+    // NULL target gives the length, a too small target is refused.
+    int len = sky_snapshot(handle, NULL, 0);
+    ASSERT(len > 0);
+    uint8_t *image = malloc(len);
+    ASSERT(sky_snapshot(handle, image, len - 1) == SKY_RET_SNAPSHOT_NO_SPACE);
+    ASSERT(sky_snapshot(handle, image, len) == len);
+
+    SkyHandle restored = sky_create(config);
+    ASSERT(sky_restore(restored, image, len) == 0);
+    ASSERT(restored->mac->T0 == 12345);
+    ASSERT(restored->mac->vc_round_robin_start == 2);
+    ASSERT(restored->hmac->sequence_tx[1] == 77);
+    ASSERT(restored->hmac->sequence_rx[2] == 1234);
+
+    // The image of the restored instance is the same, even though the packets may sit in other elements.
+    uint8_t *image2 = malloc(len);
+    ASSERT(sky_snapshot(restored, image2, len) == len);
+    ASSERT_MEMORY(image, image2, len);
+
+    for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+        SkyVirtualChannel* a = handle->virtual_channels[i];
+        SkyVirtualChannel* b = restored->virtual_channels[i];
+        ASSERT(b->arq_state_flag == a->arq_state_flag, "VC: %d", i);
+        ASSERT(b->arq_session_identifier == a->arq_session_identifier, "VC: %d", i);
+        ASSERT(b->last_tx_tick == a->last_tx_tick, "VC: %d", i);
+        ASSERT(b->sendRing->resend_count == a->sendRing->resend_count, "VC: %d", i);
+        ASSERT(b->sendRing->storage_count == a->sendRing->storage_count, "VC: %d", i);
+        ASSERT(sky_vc_count_packets_to_tx(b, 1) == sky_vc_count_packets_to_tx(a, 1), "VC: %d", i);
+        ASSERT(sky_vc_count_readable_rcv_packets(b) == sky_vc_count_readable_rcv_packets(a), "VC: %d", i);
+        ASSERT(b->elementBuffer->free_elements == a->elementBuffer->free_elements, "VC: %d", i);
+        ASSERT(sky_element_buffer_entire_buffer_is_ok(b->elementBuffer), "VC: %d", i);
+
+        // Both give out the same packets in the same order.
+        uint8_t ta[SKY_PAYLOAD_MAX_LEN], tb[SKY_PAYLOAD_MAX_LEN];
+        sky_arq_sequence_t sa, sb;
+        int la, lb;
+        while ((la = sky_vc_read_packet_for_tx(a, ta, &sa, 1)) >= 0) {
+            lb = sky_vc_read_packet_for_tx(b, tb, &sb, 1);
+            ASSERT(la == lb && sa == sb, "VC: %d %d %d", i, la, lb);
+            ASSERT_MEMORY(ta, tb, la);
+        }
+        ASSERT(sky_vc_read_packet_for_tx(b, tb, &sb, 1) < 0);
+        while ((la = sky_vc_read_next_received(a, ta, sizeof(ta))) >= 0) {
+            lb = sky_vc_read_next_received(b, tb, sizeof(tb));
+            ASSERT(la == lb, "VC: %d %d %d", i, la, lb);
+        }
+        ASSERT(sky_vc_read_next_received(b, tb, sizeof(tb)) < 0);
+    }
+
+    // The packet in the horizon becomes readable once the missing one arrives.
+    SkyVirtualChannel* vc1 = restored->virtual_channels[1];
+    ASSERT(sky_vc_push_rx_packet(vc1, pl, 10, 2, 200) >= 0);
+    uint8_t tgt[SKY_PAYLOAD_MAX_LEN];
+    ASSERT(sky_vc_read_next_received(vc1, tgt, sizeof(tgt)) == 0);
+    ASSERT(sky_vc_read_next_received(vc1, tgt, sizeof(tgt)) == 0);
+    ASSERT_MEMORY(tgt, pl + 2, 70);
+
+    free(image2);
+    free(image);
+    free(pl);
+    sky_destroy(restored);
+    sky_destroy(handle);
+    free(config);
+}
+
+// Test that corrupted or incompatible images are refused.
+TEST(snapshot_refused){
+    SkyConfig* config = malloc(sizeof(SkyConfig));
+    default_config(config);
+    uint8_t *pl = create_payload(SKY_PAYLOAD_MAX_LEN);
+    SkyHandle handle = sky_create(config);
+    fill_state(handle, pl);
+    int len = sky_snapshot(handle, NULL, 0);
+    uint8_t *image = malloc(len);
+    ASSERT(sky_snapshot(handle, image, len) == len);
+
+    // A corrupted image leaves the instance as it was.
+    SkyHandle other = sky_create(config);
+    ASSERT(sky_vc_push_packet_to_send(other->virtual_channels[3], pl, 100) >= 0);
+    image[len / 2] ^= 0x40;
+    ASSERT(sky_restore(other, image, len) == SKY_RET_SNAPSHOT_INVALID);
+    ASSERT(sky_restore(other, image, len - 5) == SKY_RET_SNAPSHOT_INVALID);
+    ASSERT(sky_restore(other, image, 3) == SKY_RET_SNAPSHOT_INVALID);
+    ASSERT(sky_vc_count_packets_to_tx(other->virtual_channels[3], 1) == 1);
+    image[len / 2] ^= 0x40;
+    sky_destroy(other);
+
+    // Rings of another length.
+    config->vc[1].rcv_ring_len += 2;
+    other = sky_create(config);
+    ASSERT(sky_restore(other, image, len) == SKY_RET_SNAPSHOT_MISMATCH);
+    sky_destroy(other);
+    config->vc[1].rcv_ring_len -= 2;
+
+    // An element buffer too small for the packets leaves the virtual channels wiped.
+    config->vc[0].slab_element_counts[0] = 2;
+    other = sky_create(config);
+    ASSERT(sky_vc_push_packet_to_send(other->virtual_channels[3], pl, 100) >= 0);
+    ASSERT(sky_restore(other, image, len) == SKY_RET_SNAPSHOT_MISMATCH);
+    for (int i = 0; i < SKY_NUM_VIRTUAL_CHANNELS; i++) {
+        ASSERT(sky_vc_count_packets_to_tx(other->virtual_channels[i], 1) == 0, "VC: %d", i);
+        ASSERT(sky_element_buffer_entire_buffer_is_ok(other->virtual_channels[i]->elementBuffer), "VC: %d", i);
+    }
+    sky_destroy(other);
+
+    free(image);
+    free(pl);
+    sky_destroy(handle);
+    free(config);
+}
@@ -32,9 +32,52 @@ void default_config(SkyConfig* config)
 	config->vc[2].require_authentication        = 0;
 	config->vc[3].require_authentication        = 0;
 
+	config->vc[0].header_compression            = 0;
+	config->vc[1].header_compression            = 0;
+	config->vc[2].header_compression            = 0;
+	config->vc[3].header_compression            = 0;
+
+	config->vc[0].wide_sequences                = 0;
+	config->vc[1].wide_sequences                = 0;
+	config->vc[2].wide_sequences                = 0;
+	config->vc[3].wide_sequences                = 0;
+
+	config->vc[0].contiguous_allocation         = 0;
+	config->vc[1].contiguous_allocation         = 0;
+	config->vc[2].contiguous_allocation         = 0;
+	config->vc[3].contiguous_allocation         = 0;
+
+	config->vc[0].split_element_layout          = 0;
+	config->vc[1].split_element_layout          = 0;
+	config->vc[2].split_element_layout          = 0;
+	config->vc[3].split_element_layout          = 0;
+
+	config->vc[0].pool_minimum_elements         = 0;
+	config->vc[1].pool_minimum_elements         = 0;
+	config->vc[2].pool_minimum_elements         = 0;
+	config->vc[3].pool_minimum_elements         = 0;
+
+	config->vc[0].pool_maximum_elements         = 0;
+	config->vc[1].pool_maximum_elements         = 0;
+	config->vc[2].pool_maximum_elements         = 0;
+	config->vc[3].pool_maximum_elements         = 0;
+
+	memset(config->vc[0].slab_element_counts, 0, sizeof(config->vc[0].slab_element_counts));
+	memset(config->vc[1].slab_element_counts, 0, sizeof(config->vc[1].slab_element_counts));
+	memset(config->vc[2].slab_element_counts, 0, sizeof(config->vc[2].slab_element_counts));
+	memset(config->vc[3].slab_element_counts, 0, sizeof(config->vc[3].slab_element_counts));
+
+	config->pool.element_count                  = 0;
+	config->pool.usable_element_size            = 32;
+	config->pool.contiguous_allocation          = 0;
+	config->pool.split_element_layout           = 0;
+
 	config->arq.timeout_ticks                   = 26000;
 	config->arq.idle_frame_threshold            = config->arq.timeout_ticks / 4;
 	config->arq.idle_frames_per_window          = 1;
+	config->arq.speculative_resends_per_window  = 0;
+	config->arq.parity_group_size               = 0;
+	config->arq.fec_cache_frames                = 0;
 
 
 	config->hmac.key_length = sizeof(dummy_key1);
@@ -128,11 +171,11 @@ int start_parsing(SkyRadioFrame *frame, SkyParsedFrame *parsed)
 	// Validate identity field
 	parsed->identity = &frame->raw[1];
 	parsed->identity_len = (frame->raw[0] & SKYLINK_FRAME_IDENTITY_MASK);
-	if (parsed->identity_len == 0 || parsed->identity_len > SKY_MAX_IDENTITY_LEN)
+	if (parsed->identity_len > SKY_MAX_IDENTITY_LEN)
 		return SKY_RET_INVALID_VERSION;
 
 	// Parse header
-	const unsigned header_start = 1 + parsed->identity_len;
+	const unsigned header_start = 1 + sky_frame_get_identity_field_length(frame);
 	memcpy(&parsed->hdr, &frame->raw[header_start], sizeof(SkyStaticHeader));
 	const unsigned payload_start = header_start + sizeof(SkyStaticHeader) + parsed->hdr.extension_length;
 	if (payload_start > frame->length)